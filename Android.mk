@@ -39,6 +39,7 @@ LOCAL_SRC_FILES := \
     android/jni/jni_utils.cc \
     android/jni/platform_file_jni.cc \
     android/net/android_network_library_impl.cc \
+    android/net/cert_chain_verify_cache.cc \
     android/ui/base/l10n/l10n_util.cc \
     \
     app/sql/connection.cc \
@@ -128,6 +129,7 @@ LOCAL_SRC_FILES += \
     base/synchronization/waitable_event_posix.cc \
     \
     base/threading/platform_thread_posix.cc \
+    base/threading/simple_thread.cc \
     base/threading/thread.cc \
     base/threading/thread_checker_impl.cc \
     base/threading/thread_collision_warner.cc \
@@ -370,8 +372,11 @@ LOCAL_SRC_FILES += \
     chrome/browser/autofill/autofill_download.cc \
     chrome/browser/autofill/autofill_field.cc \
     chrome/browser/autofill/autofill_manager.cc \
+    chrome/browser/autofill/autofill_merge_index.cc \
     chrome/browser/autofill/autofill_metrics.cc \
     chrome/browser/autofill/autofill_profile.cc \
+    chrome/browser/autofill/autofill_query_cache.cc \
+    chrome/browser/autofill/autofill_suggestion_index.cc \
     chrome/browser/autofill/autofill_type.cc \
     chrome/browser/autofill/autofill_xml_parser.cc \
     chrome/browser/autofill/contact_info.cc \
@@ -4,6 +4,7 @@
 
 #include "android/net/android_network_library_impl.h"
 
+#include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "android/jni/jni_utils.h"
 
@@ -16,12 +17,10 @@ const char* const kClassPathName = "android/net/http/CertificateChainValidator";
 // Convert X509 chain to DER format bytes.
 jobjectArray GetCertificateByteArray(
     JNIEnv* env,
-    const std::vector<std::string> cert_chain) {
+    jclass byte_array_class,
+    const std::vector<std::string>& cert_chain) {
   size_t count = cert_chain.size();
   DCHECK_GT(count, 0U);
-  // TODO(joth): See if we can centrally cache common classes like this, e.g.
-  // as JniConstants does.
-  jclass byte_array_class = env->FindClass("[B");
   jobjectArray joa = env->NewObjectArray(count, byte_array_class, NULL);
   if (joa == NULL)
     return NULL;
@@ -35,17 +34,21 @@ jobjectArray GetCertificateByteArray(
       return NULL;
     }
 
-    jbyte* bytes = env->GetByteArrayElements(byte_array, NULL);
-    DCHECK(bytes);
-    size_t copied = cert_chain[i].copy(reinterpret_cast<char*>(bytes), len);
-    DCHECK_EQ(copied, len);
-    env->ReleaseByteArrayElements(byte_array, bytes, 0);
+    // Copies straight into the Java array, without pinning it.
+    env->SetByteArrayRegion(byte_array, 0, len,
+                            reinterpret_cast<const jbyte*>(
+                                cert_chain[i].data()));
     env->SetObjectArrayElement(joa, i, byte_array);
     env->DeleteLocalRef(byte_array);
   }
   return joa;
 }
 
+// The number of verification results cached, and for how long.  Results
+// expire, as the trusted roots can change.
+const size_t kMaxCachedVerifications = 256;
+const int kVerificationTimeToLiveMinutes = 10;
+
 }  // namespace
 
 AndroidNetworkLibraryImpl::VerifyResult
@@ -53,7 +56,15 @@ AndroidNetworkLibraryImpl::VerifyResult
         const std::vector<std::string>& cert_chain,
         const std::string& hostname,
         const std::string& auth_type) {
-  if (!cert_verifier_class_)
+  return verify_cache_.Verify(cert_chain, hostname, auth_type);
+}
+
+AndroidNetworkLibraryImpl::VerifyResult
+    AndroidNetworkLibraryImpl::VerifyUncached(
+        const std::vector<std::string>& cert_chain,
+        const std::string& hostname,
+        const std::string& auth_type) {
+  if (!cert_verifier_class_ || !byte_array_class_)
     return VERIFY_INVOCATION_ERROR;
 
   JNIEnv* env = jni::GetJNIEnv();
@@ -68,7 +79,8 @@ AndroidNetworkLibraryImpl::VerifyResult
   }
   DCHECK(verify_fn);
 
-  jobjectArray chain_byte_array = GetCertificateByteArray(env, cert_chain);
+  jobjectArray chain_byte_array =
+      GetCertificateByteArray(env, byte_array_class_, cert_chain);
   if (!chain_byte_array)
     return VERIFY_INVOCATION_ERROR;
 
@@ -131,7 +143,11 @@ void AndroidNetworkLibraryImpl::InitWithApplicationContext(JNIEnv* env,
 }
 
 AndroidNetworkLibraryImpl::AndroidNetworkLibraryImpl(JNIEnv* env)
-    : cert_verifier_class_(NULL) {
+    : cert_verifier_class_(NULL),
+      byte_array_class_(NULL),
+      ALLOW_THIS_IN_INITIALIZER_LIST(verify_cache_(
+          this, kMaxCachedVerifications,
+          base::TimeDelta::FromMinutes(kVerificationTimeToLiveMinutes))) {
   jclass cls = env->FindClass(kClassPathName);
   if (jni::CheckException(env) || !cls) {
       NOTREACHED() << "Unable to load class " << kClassPathName;
@@ -139,10 +155,23 @@ AndroidNetworkLibraryImpl::AndroidNetworkLibraryImpl(JNIEnv* env)
     cert_verifier_class_ = static_cast<jclass>(env->NewGlobalRef(cls));
     env->DeleteLocalRef(cls);
   }
+
+  // Looked up once here, as FindClass() is slow and, from a worker thread,
+  // may not see the application's class loader.
+  cls = env->FindClass("[B");
+  if (jni::CheckException(env) || !cls) {
+    NOTREACHED() << "Unable to load class [B";
+  } else {
+    byte_array_class_ = static_cast<jclass>(env->NewGlobalRef(cls));
+    env->DeleteLocalRef(cls);
+  }
 }
 
 AndroidNetworkLibraryImpl::~AndroidNetworkLibraryImpl() {
+  JNIEnv* env = jni::GetJNIEnv();
   if (cert_verifier_class_)
-    jni::GetJNIEnv()->DeleteGlobalRef(cert_verifier_class_);
+    env->DeleteGlobalRef(cert_verifier_class_);
+  if (byte_array_class_)
+    env->DeleteGlobalRef(byte_array_class_);
 }
 
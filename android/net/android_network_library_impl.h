@@ -12,10 +12,13 @@
 #include <string>
 #include <vector>
 
+#include "android/net/cert_chain_verify_cache.h"
 #include "net/base/android_network_library.h"
 #include "net/base/net_export.h"
 
-class NET_EXPORT AndroidNetworkLibraryImpl : public net::AndroidNetworkLibrary {
+class NET_EXPORT AndroidNetworkLibraryImpl
+    : public net::AndroidNetworkLibrary,
+      public CertChainVerifyCache::Verifier {
  public:
   static void InitWithApplicationContext(JNIEnv* env, jobject context);
 
@@ -24,11 +27,20 @@ class NET_EXPORT AndroidNetworkLibraryImpl : public net::AndroidNetworkLibrary {
       const std::string& hostname,
       const std::string& auth_type);
 
+  // CertChainVerifyCache::Verifier implementation, verifying through Java:
+  virtual VerifyResult VerifyUncached(
+      const std::vector<std::string>& cert_chain,
+      const std::string& hostname,
+      const std::string& auth_type);
+
  private:
   explicit AndroidNetworkLibraryImpl(JNIEnv* env);
   virtual ~AndroidNetworkLibraryImpl();
 
   jclass cert_verifier_class_;
+  jclass byte_array_class_;
+
+  CertChainVerifyCache verify_cache_;
 
   DISALLOW_COPY_AND_ASSIGN(AndroidNetworkLibraryImpl);
 };
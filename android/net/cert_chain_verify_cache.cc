@@ -0,0 +1,134 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "android/net/cert_chain_verify_cache.h"
+
+#include "base/logging.h"
+#include "base/sha1.h"
+
+CertChainVerifyCache::CertChainVerifyCache(Verifier* verifier,
+                                           size_t max_entries,
+                                           base::TimeDelta time_to_live)
+    : verifier_(verifier),
+      max_entries_(max_entries),
+      time_to_live_(time_to_live),
+      in_flight_done_(&lock_),
+      hits_(0),
+      joins_(0) {
+  DCHECK(verifier_);
+  DCHECK_GE(max_entries_, 1U);
+}
+
+CertChainVerifyCache::~CertChainVerifyCache() {
+  DCHECK(in_flight_.empty());
+}
+
+CertChainVerifyCache::VerifyResult CertChainVerifyCache::Verify(
+    const std::vector<std::string>& cert_chain,
+    const std::string& hostname,
+    const std::string& auth_type) {
+  const std::string key = GetKey(cert_chain, hostname, auth_type);
+  VerifyResult result;
+  {
+    base::AutoLock lock(lock_);
+    bool joined = false;
+    while (true) {
+      if (LookupLocked(key, base::Time::Now(), &result)) {
+        ++hits_;
+        return result;
+      }
+      if (in_flight_.find(key) == in_flight_.end())
+        break;
+      // Wait for the verification in progress.  If it fails, this caller
+      // makes its own attempt.
+      if (!joined) {
+        joined = true;
+        ++joins_;
+      }
+      in_flight_done_.Wait();
+    }
+    in_flight_.insert(key);
+  }
+
+  result = verifier_->VerifyUncached(cert_chain, hostname, auth_type);
+
+  base::AutoLock lock(lock_);
+  in_flight_.erase(key);
+  if (result != net::AndroidNetworkLibrary::VERIFY_INVOCATION_ERROR)
+    InsertLocked(key, result, base::Time::Now());
+  in_flight_done_.Broadcast();
+  return result;
+}
+
+size_t CertChainVerifyCache::size() const {
+  base::AutoLock lock(lock_);
+  return cache_.size();
+}
+
+uint64 CertChainVerifyCache::hits() const {
+  base::AutoLock lock(lock_);
+  return hits_;
+}
+
+uint64 CertChainVerifyCache::joins() const {
+  base::AutoLock lock(lock_);
+  return joins_;
+}
+
+// static
+std::string CertChainVerifyCache::GetKey(
+    const std::vector<std::string>& cert_chain,
+    const std::string& hostname,
+    const std::string& auth_type) {
+  // Neither string holds a NUL, and the fingerprints have a fixed length, so
+  // distinct verifications have distinct keys.
+  std::string key;
+  key.reserve(hostname.size() + auth_type.size() + 2 +
+              cert_chain.size() * base::SHA1_LENGTH);
+  key.append(hostname);
+  key.push_back('\0');
+  key.append(auth_type);
+  key.push_back('\0');
+  for (std::vector<std::string>::const_iterator iter = cert_chain.begin();
+       iter != cert_chain.end(); ++iter) {
+    key.append(base::SHA1HashString(*iter));
+  }
+  return key;
+}
+
+bool CertChainVerifyCache::LookupLocked(const std::string& key,
+                                        base::Time now,
+                                        VerifyResult* result) {
+  lock_.AssertAcquired();
+  std::map<std::string, CachedResult>::iterator iter = cache_.find(key);
+  if (iter == cache_.end())
+    return false;
+  if (now >= iter->second.expiry) {
+    cache_.erase(iter);
+    return false;
+  }
+  *result = iter->second.result;
+  return true;
+}
+
+void CertChainVerifyCache::InsertLocked(const std::string& key,
+                                        VerifyResult result,
+                                        base::Time now) {
+  lock_.AssertAcquired();
+  if (cache_.size() >= max_entries_ && cache_.find(key) == cache_.end()) {
+    std::map<std::string, CachedResult>::iterator iter, cur;
+    for (iter = cache_.begin(); iter != cache_.end(); ) {
+      cur = iter++;
+      if (now >= cur->second.expiry)
+        cache_.erase(cur);
+    }
+    // If no result has expired, drop the first one.
+    if (cache_.size() >= max_entries_)
+      cache_.erase(cache_.begin());
+  }
+
+  CachedResult& cached = cache_[key];
+  cached.result = result;
+  cached.expiry = now + time_to_live_;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ANDROID_NET_CERT_CHAIN_VERIFY_CACHE_H_
+#define ANDROID_NET_CERT_CHAIN_VERIFY_CACHE_H_
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+#include "net/base/android_network_library.h"
+
+// Caches the results of certificate chain verifications, keyed by the
+// hostname, the authentication type and the fingerprints of the certificates,
+// so that connections to the same hosts don't each pay for a verification.
+// Results expire after a while, which bounds how long a change to the trusted
+// roots takes to be seen.  Concurrent verifications of the same chain are made
+// once, the other callers waiting for its result.  Can be used from any
+// thread.
+class CertChainVerifyCache {
+ public:
+  typedef net::AndroidNetworkLibrary::VerifyResult VerifyResult;
+
+  // Makes the verifications that are not cached.
+  class Verifier {
+   public:
+    virtual VerifyResult VerifyUncached(
+        const std::vector<std::string>& cert_chain,
+        const std::string& hostname,
+        const std::string& auth_type) = 0;
+
+   protected:
+    virtual ~Verifier() {}
+  };
+
+  // |verifier| must outlive the cache.  Holds at most |max_entries| results,
+  // each for |time_to_live|.
+  CertChainVerifyCache(Verifier* verifier,
+                       size_t max_entries,
+                       base::TimeDelta time_to_live);
+  ~CertChainVerifyCache();
+
+  // Returns the cached result for the chain if any, otherwise verifies it
+  // through the verifier.  VERIFY_INVOCATION_ERROR is never cached.
+  VerifyResult Verify(const std::vector<std::string>& cert_chain,
+                      const std::string& hostname,
+                      const std::string& auth_type);
+
+  size_t size() const;
+  uint64 hits() const;
+  uint64 joins() const;
+
+ private:
+  struct CachedResult {
+    VerifyResult result;
+    base::Time expiry;
+  };
+
+  // Returns the key of a verification: |hostname| and |auth_type|, each
+  // followed by a NUL, then the SHA-1 hash of each certificate in order.
+  static std::string GetKey(const std::vector<std::string>& cert_chain,
+                            const std::string& hostname,
+                            const std::string& auth_type);
+
+  // Sets |result| to the unexpired result cached for |key|, if any.  Must be
+  // called with |lock_| held.
+  bool LookupLocked(const std::string& key, base::Time now,
+                    VerifyResult* result);
+
+  // Caches |result| for |key|, dropping expired results, or else the first,
+  // when full.  Must be called with |lock_| held.
+  void InsertLocked(const std::string& key, VerifyResult result,
+                    base::Time now);
+
+  Verifier* verifier_;
+  const size_t max_entries_;
+  const base::TimeDelta time_to_live_;
+
+  // Guards the members below.
+  mutable base::Lock lock_;
+
+  std::map<std::string, CachedResult> cache_;
+
+  // The keys being verified, and the condition signaled each time one of
+  // these verifications completes.
+  std::set<std::string> in_flight_;
+  base::ConditionVariable in_flight_done_;
+
+  uint64 hits_;
+  uint64 joins_;
+
+  DISALLOW_COPY_AND_ASSIGN(CertChainVerifyCache);
+};
+
+#endif  // ANDROID_NET_CERT_CHAIN_VERIFY_CACHE_H_
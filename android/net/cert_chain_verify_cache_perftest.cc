@@ -0,0 +1,174 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Verifies bursts of connections to a few hosts through a stub verifier that
+// stands in for the JNI round trip, and logs how long each verification takes
+// with and without the cache, and how many verifications reach the verifier
+// when many threads verify the same chain at once:
+//   $ ./perf_tests --gtest_filter=CertChainVerifyCachePerfTest.*
+
+#include <string>
+#include <vector>
+
+#include "android/net/cert_chain_verify_cache.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+typedef net::AndroidNetworkLibrary AndroidNetworkLibrary;
+
+const size_t kHostCount = 20;
+const size_t kConnectionsPerHost = 50;
+
+// Roughly what converting a chain and verifying it in Java costs.
+const int kVerifyTimeMs = 2;
+
+const size_t kThreadCount = 8;
+
+// Returns the certificate chain served by host |i|: its own certificate, and
+// an intermediate shared by all hosts.
+std::vector<std::string> MakeChain(size_t i) {
+  std::vector<std::string> chain;
+  chain.push_back(std::string(1200, 'a' + i % 26) + base::UintToString(i));
+  chain.push_back(std::string(1500, 'i'));
+  return chain;
+}
+
+std::string MakeHostname(size_t i) {
+  return "host" + base::UintToString(i) + ".example.com";
+}
+
+class StubVerifier : public CertChainVerifyCache::Verifier {
+ public:
+  explicit StubVerifier(AndroidNetworkLibrary::VerifyResult result)
+      : result_(result),
+        calls_(0) {
+  }
+  virtual ~StubVerifier() {}
+
+  virtual AndroidNetworkLibrary::VerifyResult VerifyUncached(
+      const std::vector<std::string>& cert_chain,
+      const std::string& hostname,
+      const std::string& auth_type) {
+    {
+      base::AutoLock lock(lock_);
+      ++calls_;
+    }
+    base::PlatformThread::Sleep(kVerifyTimeMs);
+    return result_;
+  }
+
+  int calls() {
+    base::AutoLock lock(lock_);
+    return calls_;
+  }
+
+ private:
+  const AndroidNetworkLibrary::VerifyResult result_;
+  base::Lock lock_;
+  int calls_;
+
+  DISALLOW_COPY_AND_ASSIGN(StubVerifier);
+};
+
+// Verifies the chain of host 0 through a cache.
+class VerifyRunner : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit VerifyRunner(CertChainVerifyCache* cache)
+      : cache_(cache),
+        result_(AndroidNetworkLibrary::VERIFY_INVOCATION_ERROR) {
+  }
+  virtual ~VerifyRunner() {}
+
+  virtual void Run() {
+    result_ = cache_->Verify(MakeChain(0), MakeHostname(0), "RSA");
+  }
+
+  AndroidNetworkLibrary::VerifyResult result() const { return result_; }
+
+ private:
+  CertChainVerifyCache* cache_;
+  AndroidNetworkLibrary::VerifyResult result_;
+
+  DISALLOW_COPY_AND_ASSIGN(VerifyRunner);
+};
+
+}  // namespace
+
+TEST(CertChainVerifyCachePerfTest, ConnectionBursts) {
+  std::vector<std::vector<std::string> > chains;
+  std::vector<std::string> hostnames;
+  for (size_t i = 0; i < kHostCount; ++i) {
+    chains.push_back(MakeChain(i));
+    hostnames.push_back(MakeHostname(i));
+  }
+  const size_t verifications = kHostCount * kConnectionsPerHost;
+
+  StubVerifier uncached(AndroidNetworkLibrary::VERIFY_OK);
+  PerfTimeLogger uncached_timer("CertChainVerifyCache_uncached");
+  for (size_t i = 0; i < verifications; ++i) {
+    EXPECT_EQ(AndroidNetworkLibrary::VERIFY_OK,
+              uncached.VerifyUncached(chains[i % kHostCount],
+                                      hostnames[i % kHostCount], "RSA"));
+  }
+  uncached_timer.Done();
+
+  StubVerifier verifier(AndroidNetworkLibrary::VERIFY_OK);
+  CertChainVerifyCache cache(&verifier, 256, base::TimeDelta::FromMinutes(10));
+  PerfTimeLogger cached_timer("CertChainVerifyCache_cached");
+  for (size_t i = 0; i < verifications; ++i) {
+    EXPECT_EQ(AndroidNetworkLibrary::VERIFY_OK,
+              cache.Verify(chains[i % kHostCount], hostnames[i % kHostCount],
+                           "RSA"));
+  }
+  cached_timer.Done();
+
+  EXPECT_EQ(static_cast<int>(kHostCount), verifier.calls());
+  EXPECT_EQ(verifications - kHostCount, cache.hits());
+
+  // A chain served for another host is verified again.
+  cache.Verify(chains[0], hostnames[1], "RSA");
+  EXPECT_EQ(static_cast<int>(kHostCount) + 1, verifier.calls());
+}
+
+TEST(CertChainVerifyCachePerfTest, ConcurrentVerifications) {
+  StubVerifier verifier(AndroidNetworkLibrary::VERIFY_NO_TRUSTED_ROOT);
+  CertChainVerifyCache cache(&verifier, 256, base::TimeDelta::FromMinutes(10));
+
+  ScopedVector<VerifyRunner> runners;
+  ScopedVector<base::DelegateSimpleThread> threads;
+  PerfTimeLogger timer("CertChainVerifyCache_concurrent");
+  for (size_t i = 0; i < kThreadCount; ++i) {
+    runners.push_back(new VerifyRunner(&cache));
+    threads.push_back(new base::DelegateSimpleThread(runners[i], "verify"));
+    threads[i]->Start();
+  }
+  for (size_t i = 0; i < kThreadCount; ++i)
+    threads[i]->Join();
+  timer.Done();
+
+  // Every thread gets the result of the single verification.
+  EXPECT_EQ(1, verifier.calls());
+  EXPECT_EQ(kThreadCount - 1, cache.hits());
+  for (size_t i = 0; i < kThreadCount; ++i) {
+    EXPECT_EQ(AndroidNetworkLibrary::VERIFY_NO_TRUSTED_ROOT,
+              runners[i]->result());
+  }
+}
+
+TEST(CertChainVerifyCachePerfTest, InvocationErrorsAreNotCached) {
+  StubVerifier verifier(AndroidNetworkLibrary::VERIFY_INVOCATION_ERROR);
+  CertChainVerifyCache cache(&verifier, 256, base::TimeDelta::FromMinutes(10));
+  cache.Verify(MakeChain(0), MakeHostname(0), "RSA");
+  cache.Verify(MakeChain(0), MakeHostname(0), "RSA");
+  EXPECT_EQ(2, verifier.calls());
+  EXPECT_EQ(0U, cache.size());
+}
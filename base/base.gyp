@@ -273,6 +273,21 @@
         }],
       ],
     },
+    {
+      'target_name': 'base_perftests',
+      'type': 'executable',
+      'dependencies': [
+        'base',
+        'test_support_base',
+        'test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'sources': [
+        'file_util_perftest.cc',
+        'metrics/stats_table_perftest.cc',
+        'observer_list_perftest.cc',
+      ],
+    },
     {
       'target_name': 'test_support_base',
       'type': '<(library)',
@@ -20,8 +20,12 @@ class DirReaderFallback {
   bool Next() { return false; }
   // Return the name of the current directory entry.
   const char* name() { return 0;}
+  // Return the DT_* type of the current entry, or 0 (DT_UNKNOWN).
+  unsigned char type() const { return 0; }
   // Return the file descriptor which is being used.
   int fd() const { return -1; }
+  // Returns true if the iteration ended because of a read error.
+  bool failed() const { return false; }
   // Returns true if this is a no-op fallback class (for testing).
   static bool IsFallback() { return true; }
 };
@@ -6,6 +6,7 @@
 #define BASE_DIR_READER_LINUX_H_
 #pragma once
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
@@ -32,7 +33,8 @@ class DirReaderLinux {
   explicit DirReaderLinux(const char* directory_path)
       : fd_(open(directory_path, O_RDONLY | O_DIRECTORY)),
         offset_(0),
-        size_(0) {
+        size_(0),
+        failed_(false) {
   }
 
   ~DirReaderLinux() {
@@ -47,6 +49,7 @@ class DirReaderLinux {
   }
 
   // Move to the next entry returning false if the iteration is complete.
+  // A getdents64() error also ends the iteration; see |failed|.
   bool Next() {
     if (size_) {
       union {
@@ -64,7 +67,7 @@ class DirReaderLinux {
     if (r == 0)
       return false;
     if (r == -1) {
-      DPLOG(FATAL) << "getdents64 returned an error: " << errno;
+      failed_ = true;
       return false;
     }
     size_ = r;
@@ -84,10 +87,30 @@ class DirReaderLinux {
     return dirent->d_name;
   }
 
+  // Return the DT_* type of the current entry.  May be DT_UNKNOWN if the
+  // file system does not report it.
+  unsigned char type() const {
+    if (!size_)
+      return DT_UNKNOWN;
+
+    union {
+      const unsigned char *bufp;
+      const linux_dirent* dirent;
+    };
+    bufp = &buf_[offset_];
+    return dirent->d_type;
+  }
+
   int fd() const {
     return fd_;
   }
 
+  // Returns true if the iteration ended because getdents64() failed rather
+  // than because the end of the directory was reached.
+  bool failed() const {
+    return failed_;
+  }
+
   static bool IsFallback() {
     return false;
   }
@@ -96,6 +119,7 @@ class DirReaderLinux {
   const int fd_;
   unsigned char buf_[512];
   size_t offset_, size_;
+  bool failed_;
 
   DISALLOW_COPY_AND_ASSIGN(DirReaderLinux);
 };
@@ -15,6 +15,9 @@
 #include "base/logging.h"
 #include "base/string_piece.h"
 #include "base/string_util.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/simple_thread.h"
 #include "base/utf_string_conversions.h"
 
 namespace {
@@ -290,6 +293,44 @@ int64 ComputeDirectorySize(const FilePath& root_path) {
   return running_size;
 }
 
+namespace {
+
+// Adds up the sizes of the files seen by a ParallelFileEnumerator.
+class DirectorySizeDelegate : public ParallelFileEnumerator::Delegate {
+ public:
+  DirectorySizeDelegate() : size_(0) {}
+
+  virtual void OnEntry(const FilePath& path, FileEnumerator* enumerator) {
+    FileEnumerator::FindInfo info;
+    enumerator->GetFindInfo(&info);
+#if defined(OS_WIN)
+    LARGE_INTEGER li = { info.nFileSizeLow, info.nFileSizeHigh };
+    int64 size = li.QuadPart;
+#else
+    int64 size = info.stat.st_size;
+#endif
+    base::AutoLock lock(lock_);
+    size_ += size;
+  }
+
+  int64 size() const { return size_; }
+
+ private:
+  base::Lock lock_;
+  int64 size_;
+};
+
+}  // namespace
+
+int64 ComputeDirectorySizeInParallel(const FilePath& root_path,
+                                     int num_threads) {
+  DirectorySizeDelegate delegate;
+  ParallelFileEnumerator enumerator(root_path, FileEnumerator::FILES,
+                                    num_threads);
+  enumerator.Run(&delegate);
+  return delegate.size();
+}
+
 int64 ComputeFilesSize(const FilePath& directory,
                        const FilePath::StringType& pattern) {
   int64 running_size = 0;
@@ -407,4 +448,114 @@ bool FileEnumerator::ShouldSkip(const FilePath& path) {
   return IsDot(path) || (IsDotDot(path) && !(INCLUDE_DOT_DOT & file_type_));
 }
 
+///////////////////////////////////////////////
+// ParallelFileEnumerator
+
+namespace {
+
+// The state shared by the threads of a ParallelFileEnumerator::Run().  Each
+// thread runs Run() until there are no directories left to list and no
+// thread that could still find more.
+class ParallelWalk : public base::DelegateSimpleThread::Delegate {
+ public:
+  ParallelWalk(const FilePath& root_path,
+               FileEnumerator::FILE_TYPE file_type,
+               ParallelFileEnumerator::Delegate* delegate)
+      : file_type_(file_type),
+        delegate_(delegate),
+        directory_available_(&lock_),
+        busy_threads_(0) {
+    pending_paths_.push_back(root_path);
+  }
+
+  virtual void Run() {
+    FilePath directory;
+    while (TakeDirectory(&directory)) {
+      std::vector<FilePath> subdirectories;
+      ListDirectory(directory, &subdirectories);
+      FinishDirectory(subdirectories);
+    }
+  }
+
+ private:
+  // Waits for a directory to list.  Returns false once the walk is done.
+  bool TakeDirectory(FilePath* directory) {
+    base::AutoLock lock(lock_);
+    while (pending_paths_.empty()) {
+      if (busy_threads_ == 0)
+        return false;
+      directory_available_.Wait();
+    }
+    *directory = pending_paths_.back();
+    pending_paths_.pop_back();
+    busy_threads_++;
+    return true;
+  }
+
+  void FinishDirectory(const std::vector<FilePath>& subdirectories) {
+    base::AutoLock lock(lock_);
+    pending_paths_.insert(pending_paths_.end(), subdirectories.begin(),
+                          subdirectories.end());
+    busy_threads_--;
+    // Wake everybody up if there is new work, or if we were the last busy
+    // thread, so that the idle threads notice that the walk is over.
+    if (!subdirectories.empty() || busy_threads_ == 0)
+      directory_available_.Broadcast();
+  }
+
+  void ListDirectory(const FilePath& directory,
+                     std::vector<FilePath>* subdirectories) {
+    FileEnumerator enumerator(directory, false,
+        static_cast<FileEnumerator::FILE_TYPE>(
+            file_type_ | FileEnumerator::DIRECTORIES));
+    for (FilePath current = enumerator.Next(); !current.empty();
+         current = enumerator.Next()) {
+      bool is_directory = enumerator.IsDirectoryEntry();
+      if (is_directory)
+        subdirectories->push_back(current);
+      if ((is_directory && (file_type_ & FileEnumerator::DIRECTORIES)) ||
+          (!is_directory && (file_type_ & FileEnumerator::FILES)))
+        delegate_->OnEntry(current, &enumerator);
+    }
+  }
+
+  const FileEnumerator::FILE_TYPE file_type_;
+  ParallelFileEnumerator::Delegate* const delegate_;
+
+  // Protects the members below.
+  base::Lock lock_;
+  // Signalled when |pending_paths_| grows or the walk is over.
+  base::ConditionVariable directory_available_;
+  // Directories which still need to be listed.
+  std::vector<FilePath> pending_paths_;
+  // The number of threads currently listing a directory.
+  int busy_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelWalk);
+};
+
+}  // namespace
+
+ParallelFileEnumerator::ParallelFileEnumerator(
+    const FilePath& root_path,
+    FileEnumerator::FILE_TYPE file_type,
+    int num_threads)
+    : root_path_(root_path),
+      file_type_(file_type),
+      num_threads_(num_threads) {
+  DCHECK(!(file_type & FileEnumerator::INCLUDE_DOT_DOT));
+  DCHECK_GT(num_threads, 0);
+}
+
+ParallelFileEnumerator::~ParallelFileEnumerator() {
+}
+
+void ParallelFileEnumerator::Run(Delegate* delegate) {
+  ParallelWalk walk(root_path_, file_type_, delegate);
+  base::DelegateSimpleThreadPool pool("ParallelFileEnumerator", num_threads_);
+  pool.AddWork(&walk, num_threads_);
+  pool.Start();
+  pool.JoinAll();
+}
+
 }  // namespace
@@ -84,6 +84,11 @@ BASE_API int CountFilesCreatedAfter(const FilePath& path,
 // particularly speedy in any platform.
 BASE_API int64 ComputeDirectorySize(const FilePath& root_path);
 
+// Like ComputeDirectorySize(), but walks the tree with a
+// ParallelFileEnumerator using |num_threads| threads.
+BASE_API int64 ComputeDirectorySizeInParallel(const FilePath& root_path,
+                                              int num_threads);
+
 // Returns the total number of bytes used by all files matching the provided
 // |pattern|, on this |directory| (without recursion). If the path does not
 // exist the function returns 0.
@@ -457,9 +462,15 @@ class BASE_API FileEnumerator {
   // Returns an empty string if there are no more results.
   FilePath Next();
 
-  // Write the file info into |info|.
+  // Write the file info into |info|.  On POSIX the enumerator only stat()s
+  // an entry when it has to, so this may cost a stat() call.
   void GetFindInfo(FindInfo* info);
 
+  // Returns true if the entry last returned by Next() is a directory.
+  // Unlike GetFindInfo(), this never needs to stat() the entry on file
+  // systems which report the entry type when listing a directory.
+  bool IsDirectoryEntry() const;
+
   // Looks inside a FindInfo and determines if it's a directory.
   static bool IsDirectory(const FindInfo& info);
 
@@ -478,13 +489,26 @@ class BASE_API FileEnumerator {
 #elif defined(OS_POSIX)
   struct DirectoryEntryInfo {
     FilePath filename;
+    // The DT_* type reported by the directory listing, DT_UNKNOWN if the
+    // file system does not report types.
+    unsigned char type;
+    // |stat| is only filled in once |has_stat| is true.
+    bool has_stat;
     struct stat stat;
   };
 
-  // Read the filenames in source into the vector of DirectoryEntryInfo's
+  // Read the filenames in source into the vector of DirectoryEntryInfo's.
+  // Entries are only stat()ed when the listing doesn't tell whether they
+  // are directories.
   static bool ReadDirectory(std::vector<DirectoryEntryInfo>* entries,
                             const FilePath& source, bool show_links);
 
+  // Fills in the stat of |info|, an entry of |directory|.
+  static void StatEntry(const FilePath& directory, bool show_links,
+                        DirectoryEntryInfo* info);
+
+  static bool IsDirectoryEntryInfo(const DirectoryEntryInfo& info);
+
   // The files in the current directory
   std::vector<DirectoryEntryInfo> directory_entries_;
 
@@ -504,6 +528,45 @@ class BASE_API FileEnumerator {
   DISALLOW_COPY_AND_ASSIGN(FileEnumerator);
 };
 
+// Walks a directory tree on several threads.  Every directory is listed by
+// a single thread with a non-recursive FileEnumerator, and the
+// subdirectories it finds are handed out to whichever thread is idle, so
+// large trees are not limited by the latency of one directory at a time.
+// The order of the results is not guaranteed.
+//
+// DO NOT USE FROM THE MAIN THREAD of your application.  Run() blocks until
+// the whole tree has been walked.
+class BASE_API ParallelFileEnumerator {
+ public:
+  class Delegate {
+   public:
+    // Called for each entry under the root which matches the enumerator's
+    // file type.  |enumerator| is positioned on the entry, so
+    // GetFindInfo() and IsDirectoryEntry() may be used on it.  This is
+    // called concurrently from all of the enumerator's threads.
+    virtual void OnEntry(const FilePath& path, FileEnumerator* enumerator) = 0;
+
+   protected:
+    virtual ~Delegate() {}
+  };
+
+  // |file_type| works as for FileEnumerator, except that INCLUDE_DOT_DOT
+  // is not supported.  |num_threads| threads are used for the walk.
+  ParallelFileEnumerator(const FilePath& root_path,
+                         FileEnumerator::FILE_TYPE file_type,
+                         int num_threads);
+  ~ParallelFileEnumerator();
+
+  void Run(Delegate* delegate);
+
+ private:
+  FilePath root_path_;
+  FileEnumerator::FILE_TYPE file_type_;
+  int num_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelFileEnumerator);
+};
+
 class BASE_API MemoryMappedFile {
  public:
   // The default constructor sets all members to invalid/null values.
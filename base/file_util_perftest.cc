@@ -0,0 +1,78 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/file_util.h"
+
+#include "base/file_path.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// A tree of a million files: kNumDirectories directories of
+// kFilesPerDirectory files, spread over two levels.
+const int kNumTopLevelDirectories = 100;
+const int kNumDirectories = 1000;
+const int kFilesPerDirectory = 1000;
+const char kFileContents[] = "0123456789";
+
+class FileUtilPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    PerfTimeLogger timer("FileUtil_create_tree");
+    for (int i = 0; i < kNumDirectories; i++) {
+      FilePath dir = temp_dir_.path()
+          .AppendASCII(base::IntToString(i % kNumTopLevelDirectories))
+          .AppendASCII(base::IntToString(i));
+      ASSERT_TRUE(file_util::CreateDirectory(dir));
+      for (int j = 0; j < kFilesPerDirectory; j++) {
+        FilePath file = dir.AppendASCII(base::IntToString(j));
+        ASSERT_EQ(static_cast<int>(sizeof(kFileContents)),
+                  file_util::WriteFile(file, kFileContents,
+                                       sizeof(kFileContents)));
+      }
+    }
+    timer.Done();
+  }
+
+  ScopedTempDir temp_dir_;
+};
+
+const int64 kTreeSize = static_cast<int64>(kNumDirectories) *
+    kFilesPerDirectory * sizeof(kFileContents);
+
+}  // namespace
+
+TEST_F(FileUtilPerfTest, EnumerateTree) {
+  PerfTimeLogger timer("FileUtil_enumerate_tree");
+  file_util::FileEnumerator enumerator(temp_dir_.path(), true,
+                                       file_util::FileEnumerator::FILES);
+  int count = 0;
+  for (FilePath current = enumerator.Next(); !current.empty();
+       current = enumerator.Next())
+    count++;
+  timer.Done();
+  EXPECT_EQ(kNumDirectories * kFilesPerDirectory, count);
+}
+
+TEST_F(FileUtilPerfTest, ComputeDirectorySize) {
+  PerfTimeLogger timer("FileUtil_compute_directory_size");
+  EXPECT_EQ(kTreeSize, file_util::ComputeDirectorySize(temp_dir_.path()));
+  timer.Done();
+
+  PerfTimeLogger parallel_timer(
+      "FileUtil_compute_directory_size_in_parallel");
+  EXPECT_EQ(kTreeSize,
+            file_util::ComputeDirectorySizeInParallel(temp_dir_.path(), 8));
+  parallel_timer.Done();
+}
+
+TEST_F(FileUtilPerfTest, DeleteTree) {
+  PerfTimeLogger timer("FileUtil_delete_tree");
+  EXPECT_TRUE(file_util::Delete(temp_dir_.path(), true));
+  timer.Done();
+}
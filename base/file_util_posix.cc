@@ -31,6 +31,9 @@
 #include <fstream>
 
 #include "base/basictypes.h"
+#if defined(OS_LINUX)
+#include "base/dir_reader_posix.h"
+#endif
 #include "base/eintr_wrapper.h"
 #include "base/file_path.h"
 #include "base/logging.h"
@@ -166,10 +169,7 @@ bool Delete(const FilePath& path, bool recursive) {
         FileEnumerator::SHOW_SYM_LINKS));
   for (FilePath current = traversal.Next(); success && !current.empty();
        current = traversal.Next()) {
-    FileEnumerator::FindInfo info;
-    traversal.GetFindInfo(&info);
-
-    if (S_ISDIR(info.stat.st_mode))
+    if (traversal.IsDirectoryEntry())
       directories.push(current.value());
     else
       success = (unlink(current.value().c_str()) == 0);
@@ -676,11 +676,12 @@ FilePath FileEnumerator::Next() {
           fnmatch(pattern_.c_str(), full_path.value().c_str(), FNM_NOESCAPE))
         continue;
 
-      if (recursive_ && S_ISDIR(i->stat.st_mode))
+      bool is_directory = IsDirectoryEntryInfo(*i);
+      if (recursive_ && is_directory)
         pending_paths_.push(full_path);
 
-      if ((S_ISDIR(i->stat.st_mode) && (file_type_ & DIRECTORIES)) ||
-          (!S_ISDIR(i->stat.st_mode) && (file_type_ & FILES)))
+      if ((is_directory && (file_type_ & DIRECTORIES)) ||
+          (!is_directory && (file_type_ & FILES)))
         directory_entries_.push_back(*i);
     }
   }
@@ -696,10 +697,18 @@ void FileEnumerator::GetFindInfo(FindInfo* info) {
     return;
 
   DirectoryEntryInfo* cur_entry = &directory_entries_[current_directory_entry_];
+  if (!cur_entry->has_stat)
+    StatEntry(root_path_, file_type_ & SHOW_SYM_LINKS, cur_entry);
   memcpy(&(info->stat), &(cur_entry->stat), sizeof(info->stat));
   info->filename.assign(cur_entry->filename.value());
 }
 
+bool FileEnumerator::IsDirectoryEntry() const {
+  if (current_directory_entry_ >= directory_entries_.size())
+    return false;
+  return IsDirectoryEntryInfo(directory_entries_[current_directory_entry_]);
+}
+
 bool FileEnumerator::IsDirectory(const FindInfo& info) {
   return S_ISDIR(info.stat.st_mode);
 }
@@ -712,11 +721,28 @@ FilePath FileEnumerator::GetFilename(const FindInfo& find_info) {
 bool FileEnumerator::ReadDirectory(std::vector<DirectoryEntryInfo>* entries,
                                    const FilePath& source, bool show_links) {
   base::ThreadRestrictions::AssertIOAllowed();
+
+#if defined(OS_LINUX)
+  // Read the raw getdents64() records, which carry the entry type, rather
+  // than going through readdir().  A read error ends the listing early, the
+  // same as readdir_r() failing below.
+  base::DirReaderPosix reader(source.value().c_str());
+  if (!reader.IsValid())
+    return false;
+
+  while (reader.Next()) {
+    if (!reader.name())
+      continue;
+    DirectoryEntryInfo info;
+    info.filename = FilePath(reader.name());
+    info.type = reader.type();
+    info.has_stat = false;
+#else
   DIR* dir = opendir(source.value().c_str());
   if (!dir)
     return false;
 
-#if !defined(OS_LINUX) && !defined(OS_MACOSX) && !defined(OS_FREEBSD) && \
+#if !defined(OS_MACOSX) && !defined(OS_FREEBSD) && \
     !defined(OS_OPENBSD) && !defined(OS_SOLARIS)
   #error Port warning: depending on the definition of struct dirent, \
          additional space for pathname may be needed
@@ -727,29 +753,68 @@ bool FileEnumerator::ReadDirectory(std::vector<DirectoryEntryInfo>* entries,
   while (readdir_r(dir, &dent_buf, &dent) == 0 && dent) {
     DirectoryEntryInfo info;
     info.filename = FilePath(dent->d_name);
-
-    FilePath full_name = source.Append(dent->d_name);
-    int ret;
-    if (show_links)
-      ret = lstat(full_name.value().c_str(), &info.stat);
-    else
-      ret = stat(full_name.value().c_str(), &info.stat);
-    if (ret < 0) {
-      // Print the stat() error message unless it was ENOENT and we're
-      // following symlinks.
-      if (!(errno == ENOENT && !show_links)) {
-        PLOG(ERROR) << "Couldn't stat "
-                    << source.Append(dent->d_name).value();
-      }
-      memset(&info.stat, 0, sizeof(info.stat));
-    }
+#if defined(OS_SOLARIS)
+    // Solaris' struct dirent has no d_type.
+    info.type = 0;
+#else
+    info.type = dent->d_type;
+#endif
+    info.has_stat = false;
+#endif  // defined(OS_LINUX)
+
+    // We can only tell directories from other entries without a stat() if
+    // the file system reported the type, and, when following links, the
+    // entry isn't a link.
+#if defined(OS_SOLARIS)
+    bool type_known = false;
+#else
+    bool type_known = info.type != DT_UNKNOWN &&
+                      (show_links || info.type != DT_LNK);
+#endif
+    if (!type_known)
+      StatEntry(source, show_links, &info);
     entries->push_back(info);
   }
 
+#if !defined(OS_LINUX)
   closedir(dir);
+#endif
   return true;
 }
 
+// static
+void FileEnumerator::StatEntry(const FilePath& directory, bool show_links,
+                               DirectoryEntryInfo* info) {
+  base::ThreadRestrictions::AssertIOAllowed();
+  FilePath full_name = directory.Append(info->filename);
+  int ret;
+  if (show_links)
+    ret = lstat(full_name.value().c_str(), &info->stat);
+  else
+    ret = stat(full_name.value().c_str(), &info->stat);
+  if (ret < 0) {
+    // Print the stat() error message unless it was ENOENT and we're
+    // following symlinks.
+    if (!(errno == ENOENT && !show_links)) {
+      PLOG(ERROR) << "Couldn't stat " << full_name.value();
+    }
+    memset(&info->stat, 0, sizeof(info->stat));
+  }
+  info->has_stat = true;
+}
+
+// static
+bool FileEnumerator::IsDirectoryEntryInfo(const DirectoryEntryInfo& info) {
+  if (info.has_stat)
+    return S_ISDIR(info.stat.st_mode);
+#if defined(OS_SOLARIS)
+  NOTREACHED();
+  return false;
+#else
+  return info.type == DT_DIR;
+#endif
+}
+
 ///////////////////////////////////////////////
 // MemoryMappedFile
 
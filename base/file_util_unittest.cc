@@ -20,6 +20,7 @@
 #include "base/file_util.h"
 #include "base/memory/scoped_temp_dir.h"
 #include "base/path_service.h"
+#include "base/synchronization/lock.h"
 #include "base/threading/platform_thread.h"
 #include "base/time.h"
 #include "base/utf_string_conversions.h"
@@ -378,6 +379,10 @@ TEST_F(FileUtilTest, FileAndDirectorySize) {
   int64 computed_size = file_util::ComputeDirectorySize(temp_dir_.path());
   EXPECT_EQ(size_f1 + size_f2 + 3, computed_size);
 
+  computed_size =
+      file_util::ComputeDirectorySizeInParallel(temp_dir_.path(), 3);
+  EXPECT_EQ(size_f1 + size_f2 + 3, computed_size);
+
   computed_size =
       file_util::ComputeFilesSize(temp_dir_.path(), FPL("The file*"));
   EXPECT_EQ(size_f1, computed_size);
@@ -1718,6 +1723,76 @@ TEST_F(FileUtilTest, FileEnumeratorTest) {
                                             // (we don't care what).
 }
 
+// Collects the results of a ParallelFileEnumerator.
+class ParallelFindResultCollector
+    : public file_util::ParallelFileEnumerator::Delegate {
+ public:
+  virtual void OnEntry(const FilePath& path,
+                       file_util::FileEnumerator* enumerator) {
+    base::AutoLock lock(lock_);
+    EXPECT_TRUE(files_.end() == files_.find(path.value()))
+        << "Same file returned twice";
+    files_.insert(path.value());
+    if (enumerator->IsDirectoryEntry())
+      directories_.insert(path.value());
+  }
+
+  bool HasFile(const FilePath& file) const {
+    return files_.find(file.value()) != files_.end();
+  }
+
+  bool HasDirectory(const FilePath& file) const {
+    return directories_.find(file.value()) != directories_.end();
+  }
+
+  int size() {
+    return static_cast<int>(files_.size());
+  }
+
+ private:
+  base::Lock lock_;
+  std::set<FilePath::StringType> files_;
+  std::set<FilePath::StringType> directories_;
+};
+
+TEST_F(FileUtilTest, ParallelFileEnumeratorTest) {
+  FilePath dir1 = temp_dir_.path().Append(FILE_PATH_LITERAL("dir1"));
+  EXPECT_TRUE(file_util::CreateDirectory(dir1));
+  FilePath dir2 = temp_dir_.path().Append(FILE_PATH_LITERAL("dir2"));
+  EXPECT_TRUE(file_util::CreateDirectory(dir2));
+  FilePath dir2inner = dir2.Append(FILE_PATH_LITERAL("inner"));
+  EXPECT_TRUE(file_util::CreateDirectory(dir2inner));
+  FilePath dir2file = dir2.Append(FILE_PATH_LITERAL("dir2file.txt"));
+  CreateTextFile(dir2file, L"");
+  FilePath dir2innerfile = dir2inner.Append(FILE_PATH_LITERAL("innerfile.txt"));
+  CreateTextFile(dir2innerfile, L"");
+  FilePath file1 = temp_dir_.path().Append(FILE_PATH_LITERAL("file1.txt"));
+  CreateTextFile(file1, L"");
+
+  file_util::ParallelFileEnumerator f1(temp_dir_.path(), FILES_AND_DIRECTORIES,
+                                       4);
+  ParallelFindResultCollector c1;
+  f1.Run(&c1);
+  EXPECT_TRUE(c1.HasDirectory(dir1));
+  EXPECT_TRUE(c1.HasDirectory(dir2));
+  EXPECT_TRUE(c1.HasDirectory(dir2inner));
+  EXPECT_TRUE(c1.HasFile(dir2file));
+  EXPECT_FALSE(c1.HasDirectory(dir2file));
+  EXPECT_TRUE(c1.HasFile(dir2innerfile));
+  EXPECT_TRUE(c1.HasFile(file1));
+  EXPECT_EQ(c1.size(), 6);
+
+  // Only files, on a single thread.
+  file_util::ParallelFileEnumerator f2(temp_dir_.path(),
+                                       file_util::FileEnumerator::FILES, 1);
+  ParallelFindResultCollector c2;
+  f2.Run(&c2);
+  EXPECT_TRUE(c2.HasFile(dir2file));
+  EXPECT_TRUE(c2.HasFile(dir2innerfile));
+  EXPECT_TRUE(c2.HasFile(file1));
+  EXPECT_EQ(c2.size(), 3);
+}
+
 TEST_F(FileUtilTest, Contains) {
   FilePath data_dir =
       temp_dir_.path().Append(FILE_PATH_LITERAL("FilePathTest"));
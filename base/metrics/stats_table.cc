@@ -4,6 +4,7 @@
 
 #include "base/metrics/stats_table.h"
 
+#include "base/atomicops.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/process_util.h"
@@ -33,6 +34,8 @@ namespace base {
 // +-------------------------------------------+
 // | Counter names table                       |
 // +-------------------------------------------+
+// | Counter states table                      |
+// +-------------------------------------------+
 // | Data                                      |
 // +-------------------------------------------+
 //
@@ -44,6 +47,17 @@ namespace base {
 // If the first character of the counter_name is '\0', then that row is
 // empty.
 //
+// The counter names table doubles as an open-addressed hash table: a
+// counter lives in the first usable row at or after
+// HashCounterName(name) % max_counters (probing linearly).  Each row has
+// an entry in the counter states table which is either kRowEmpty,
+// kRowBusy (claimed, name being written) or a tag derived from the hash
+// of the name in that row.  Rows are claimed with an atomic
+// compare-and-swap and published with a release store, so neither
+// lookups nor registrations of counters take a lock.  External viewers
+// only need the header to compute the layout above; they can read the
+// names and data tables directly.
+//
 // About Locking:
 // This class is designed to be both multi-thread and multi-process safe.
 // Aside from initialization, this is done by partitioning the data which
@@ -52,17 +66,14 @@ namespace base {
 // required.
 //
 // At the shared-memory level, we have a lock.  This lock protects the
-// shared-memory table only, and is used when we create new counters (e.g.
-// use rows) or when we register new threads (e.g. use columns).  Reading
-// data from the table does not require any locking at the shared memory
-// level.
+// thread columns only, and is used when we register new threads (e.g. use
+// columns).  Creating new counters (e.g. using rows) is done with atomic
+// operations on the counter states table, and reading data from the table
+// does not require any locking at the shared memory level.
 //
-// Each process which accesses the table will create a StatsTable object.
-// The StatsTable maintains a hash table of the existing counters in the
-// table for faster lookup.  Since the hash table is process specific,
-// each process maintains its own cache.  We avoid complexity here by never
-// de-allocating from the hash table.  (Counters are dynamically added,
-// but not dynamically removed).
+// Counters are dynamically added, but not dynamically removed, so once a
+// row has been published its name never changes.  That is what makes it
+// safe to probe the table without holding a lock.
 
 // In order for external viewers to be able to read our shared memory,
 // we all need to use the same size ints.
@@ -72,7 +83,17 @@ namespace {
 
 // An internal version in case we ever change the format of this
 // file, and so that we can identify our table.
-const int kTableVersion = 0x13131313;
+const int kTableVersion = 0x13131314;
+
+// Values of a row in the counter states table.  Any other value is the tag
+// of a published row (see CounterTag()).
+const subtle::Atomic32 kRowEmpty = 0;
+const subtle::Atomic32 kRowBusy = 1;
+
+// How many times a lookup yields while a row is kRowBusy before it treats
+// the row as holding some other counter.  A process which dies between
+// claiming a row and publishing it leaves the row busy forever.
+const int kMaxBusyRowYields = 1000;
 
 // The name for un-named counters and threads in the table.
 const char kUnknownName[] = "<unknown>";
@@ -86,6 +107,34 @@ inline int AlignedSize(int size) {
   return size + AlignOffset(size);
 }
 
+// Hashes a counter name.  The result must be identical in every process
+// which maps the table, so this is a fixed FNV-1a rather than the
+// hash_map hasher.
+uint32 HashCounterName(const std::string& name) {
+  uint32 hash = 2166136261U;
+  for (size_t i = 0; i < name.size(); ++i) {
+    hash ^= static_cast<uint8>(name[i]);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+// Returns the value stored in the counter states table for a published
+// row holding a counter with the given hash.  Never collides with
+// kRowEmpty or kRowBusy.
+inline subtle::Atomic32 CounterTag(uint32 hash) {
+  return static_cast<subtle::Atomic32>(hash | 2);
+}
+
+// Returns |name| as it is stored in the counter names table.
+std::string StoredCounterName(const std::string& name) {
+  if (name.empty())
+    return kUnknownName;
+  if (name.size() >= static_cast<size_t>(StatsTable::kMaxCounterNameLength))
+    return name.substr(0, StatsTable::kMaxCounterNameLength - 1);
+  return name;
+}
+
 }  // namespace
 
 // The StatsTable::Private maintains convenience pointers into the
@@ -130,6 +179,9 @@ class StatsTable::Private {
     return &counter_names_table_[
       (counter_id-1) * (StatsTable::kMaxCounterNameLength)];
   }
+  subtle::Atomic32* counter_state(int counter_id) const {
+    return &(counter_state_table_[counter_id-1]);
+  }
   int* row(int counter_id) const {
     return &data_table_[(counter_id-1) * max_threads()];
   }
@@ -142,6 +194,7 @@ class StatsTable::Private {
         thread_tid_table_(NULL),
         thread_pid_table_(NULL),
         counter_names_table_(NULL),
+        counter_state_table_(NULL),
         data_table_(NULL) {
   }
 
@@ -159,6 +212,7 @@ class StatsTable::Private {
   PlatformThreadId* thread_tid_table_;
   int* thread_pid_table_;
   char* counter_names_table_;
+  subtle::Atomic32* counter_state_table_;
   int* data_table_;
 };
 
@@ -234,6 +288,10 @@ void StatsTable::Private::ComputeMappedPointers(void* memory) {
             max_counters() * StatsTable::kMaxCounterNameLength;
   offset += AlignOffset(offset);
 
+  counter_state_table_ = reinterpret_cast<subtle::Atomic32*>(data + offset);
+  offset += sizeof(subtle::Atomic32) * max_counters();
+  offset += AlignOffset(offset);
+
   data_table_ = reinterpret_cast<int*>(data + offset);
   offset += sizeof(int) * max_threads() * max_counters();
 
@@ -261,6 +319,7 @@ StatsTable::StatsTable(const std::string& name, int max_threads,
   int table_size =
     AlignedSize(sizeof(Private::TableHeader)) +
     AlignedSize((max_counters * sizeof(char) * kMaxCounterNameLength)) +
+    AlignedSize((max_counters * sizeof(subtle::Atomic32))) +
     AlignedSize((max_threads * sizeof(char) * kMaxThreadNameLength)) +
     AlignedSize(max_threads * sizeof(int)) +
     AlignedSize(max_threads * sizeof(int)) +
@@ -355,19 +414,12 @@ int StatsTable::FindCounter(const std::string& name) {
   if (!impl_)
     return 0;
 
-  // Create a scope for our auto-lock.
-  {
-    AutoLock scoped_lock(counters_lock_);
-
-    // Attempt to find the counter.
-    CountersMap::const_iterator iter;
-    iter = counters_.find(name);
-    if (iter != counters_.end())
-      return iter->second;
+  int counter_id = FindCounterOrEmptyRow(name);
+  if (counter_id < 0) {
+    // Counter does not exist, so add it.
+    return AddCounter(name, -counter_id);
   }
-
-  // Counter does not exist, so add it.
-  return AddCounter(name);
+  return counter_id;
 }
 
 int* StatsTable::GetLocation(int counter_id, int slot_id) const {
@@ -513,18 +565,35 @@ int StatsTable::FindCounterOrEmptyRow(const std::string& name) const {
   if (!impl_)
     return 0;
 
-  int free_slot = 0;
-  for (int index = 1; index <= impl_->max_counters(); index++) {
-    char* row_name = impl_->counter_name(index);
-    if (!*row_name && !free_slot)
-      free_slot = index;  // save that we found a free slot
-    else if (!strncmp(row_name, name.c_str(), kMaxCounterNameLength))
+  std::string stored_name = StoredCounterName(name);
+  uint32 hash = HashCounterName(stored_name);
+  subtle::Atomic32 tag = CounterTag(hash);
+  int max_counters = impl_->max_counters();
+  int start = static_cast<int>(hash % max_counters);
+  for (int probe = 0; probe < max_counters; probe++) {
+    int index = (start + probe) % max_counters + 1;
+    subtle::Atomic32 state = subtle::Acquire_Load(impl_->counter_state(index));
+    if (state == kRowEmpty)
+      return -index;
+
+    // Another thread or process is writing the name of this row.  We
+    // can't skip it, since it may be claiming the very counter we are
+    // looking for.  The window is only a strlcpy long, unless the writer
+    // died in it; then give up on the row and keep probing.
+    for (int yields = 0; state == kRowBusy && yields < kMaxBusyRowYields;
+         yields++) {
+      PlatformThread::YieldCurrentThread();
+      state = subtle::Acquire_Load(impl_->counter_state(index));
+    }
+    if (state == tag &&
+        !strncmp(impl_->counter_name(index), stored_name.c_str(),
+                 kMaxCounterNameLength))
       return index;
   }
-  return free_slot;
+  return 0;  // The table is full.
 }
 
-int StatsTable::AddCounter(const std::string& name) {
+int StatsTable::AddCounter(const std::string& name, int empty_row) {
 #ifdef ANDROID
   return 0;
 #else
@@ -532,30 +601,25 @@ int StatsTable::AddCounter(const std::string& name) {
   if (!impl_)
     return 0;
 
-  int counter_id = 0;
-  {
-    // To add a counter to the shared memory, we need the
-    // shared memory lock.
-    SharedMemoryAutoLock lock(impl_->shared_memory());
-
-    // We have space, so create a new counter.
-    counter_id = FindCounterOrEmptyRow(name);
-    if (!counter_id)
-      return 0;
-
-    std::string counter_name = name;
-    if (name.empty())
-      counter_name = kUnknownName;
-    strlcpy(impl_->counter_name(counter_id), counter_name.c_str(),
-            kMaxCounterNameLength);
+  std::string stored_name = StoredCounterName(name);
+  subtle::Atomic32 tag = CounterTag(HashCounterName(stored_name));
+  for (;;) {
+    // Claim the row.  If we lose the race, somebody else registered a
+    // counter in this row, which may well be ours, so look again.
+    subtle::Atomic32 previous = subtle::Acquire_CompareAndSwap(
+        impl_->counter_state(empty_row), kRowEmpty, kRowBusy);
+    if (previous == kRowEmpty)
+      break;
+    int counter_id = FindCounterOrEmptyRow(name);
+    if (counter_id >= 0)
+      return counter_id;
+    empty_row = -counter_id;
   }
 
-  // now add to our in-memory cache
-  {
-    AutoLock lock(counters_lock_);
-    counters_[name] = counter_id;
-  }
-  return counter_id;
+  strlcpy(impl_->counter_name(empty_row), stored_name.c_str(),
+          kMaxCounterNameLength);
+  subtle::Release_Store(impl_->counter_state(empty_row), tag);
+  return empty_row;
 #endif
 }
 
@@ -16,6 +16,10 @@
 // which governs the maximum number of counters and concurrent
 // threads/processes which can use it.
 //
+// Counters are located through a hash table kept in the shared memory
+// itself, so looking up or registering a counter is lock-free and every
+// process sees the same directory.
+//
 
 #ifndef BASE_METRICS_STATS_TABLE_H_
 #define BASE_METRICS_STATS_TABLE_H_
@@ -25,8 +29,6 @@
 
 #include "base/base_api.h"
 #include "base/basictypes.h"
-#include "base/hash_tables.h"
-#include "base/synchronization/lock.h"
 #include "base/threading/thread_local_storage.h"
 
 namespace base {
@@ -84,7 +86,8 @@ class BASE_API StatsTable {
   // Returns an id for the counter which can be used to call GetLocation().
   // If the counter does not exist, attempts to create a row for the new
   // counter.  If there is no space in the table for the new counter,
-  // returns 0.
+  // returns 0.  Safe to call concurrently from any thread or process
+  // without locking.
   int FindCounter(const std::string& name);
 
   // TODO(mbelshe): implement RemoveCounter.
@@ -133,7 +136,6 @@ class BASE_API StatsTable {
  private:
   class Private;
   struct TLSData;
-  typedef hash_map<std::string, int> CountersMap;
 
   // Returns the space occupied by a thread in the table.  Generally used
   // if a thread terminates but the process continues.  This function
@@ -154,20 +156,23 @@ class BASE_API StatsTable {
   // calling this function.
   int FindEmptyThread() const;
 
-  // Locates a counter in the table or finds an empty row.  Returns a
-  // number > 0 on success, or 0 on failure.  The caller must hold the
-  // shared_memory_lock when calling this function.
+  // Locates a counter in the table by probing from the row its name hashes
+  // to.  Returns the counter_id (> 0) if the counter exists, the negated
+  // id of the first empty row on the probe sequence if it does not, or 0
+  // if the table is full.  Does not require any lock.
   int FindCounterOrEmptyRow(const std::string& name) const;
 
   // Internal function to add a counter to the StatsTable.  Assumes that
-  // the counter does not already exist in the table.
+  // the counter was not found and that empty_row is the first empty row
+  // on its probe sequence, as returned by FindCounterOrEmptyRow().
   //
   // name is a unique identifier for this counter, and will be truncated
   // to kMaxCounterNameLength-1 characters.
   //
-  // On success, returns the counter_id for the newly added counter.
-  // On failure, returns 0.
-  int AddCounter(const std::string& name);
+  // On success, returns the counter_id for the counter, which may have
+  // been added concurrently by another thread or process.  On failure,
+  // returns 0.
+  int AddCounter(const std::string& name, int empty_row);
 
   // Get the TLS data for the calling thread.  Returns NULL if none is
   // initialized.
@@ -175,15 +180,6 @@ class BASE_API StatsTable {
 
   Private* impl_;
 
-  // The counters_lock_ protects the counters_ hash table.
-  base::Lock counters_lock_;
-
-  // The counters_ hash map is an in-memory hash of the counters.
-  // It is used for quick lookup of counters, but is cannot be used
-  // as a substitute for what is in the shared memory.  Even though
-  // we don't have a counter in our hash table, another process may
-  // have created it.
-  CountersMap counters_;
   ThreadLocalStorage::Slot tls_index_;
 
   static StatsTable* global_table_;
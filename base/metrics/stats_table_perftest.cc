@@ -0,0 +1,141 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/metrics/stats_counters.h"
+#include "base/metrics/stats_table.h"
+#include "base/perftimer.h"
+#include "base/shared_memory.h"
+#include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kMaxThreads = 16;
+const int kMaxCounters = 4096;
+const int kNumCounters = 3000;
+const int kIncrementsPerCounter = 100;
+
+class StatsTablePerfTest : public testing::Test {
+ protected:
+  void DeleteShmem(const std::string& name) {
+    SharedMemory mem;
+    mem.Delete(name);
+  }
+};
+
+// Registers (or looks up, if another thread got there first) every counter
+// in the shared table.
+class RegisterCountersThread : public SimpleThread {
+ public:
+  RegisterCountersThread(StatsTable* table, int first_counter)
+      : SimpleThread("RegisterCountersThread"),
+        table_(table),
+        first_counter_(first_counter) {}
+
+  virtual void Run() {
+    for (int i = 0; i < kNumCounters; ++i) {
+      int counter = (first_counter_ + i) % kNumCounters;
+      EXPECT_NE(0, table_->FindCounter(StringPrintf("c:counter%d", counter)));
+    }
+  }
+
+ private:
+  StatsTable* table_;
+  int first_counter_;
+};
+
+// Increments a spread of counters through StatsCounter.
+class IncrementCountersThread : public SimpleThread {
+ public:
+  IncrementCountersThread() : SimpleThread("IncrementCountersThread") {}
+
+  virtual void Run() {
+    for (int i = 0; i < kNumCounters; i += 10) {
+      StatsCounter counter(StringPrintf("counter%d", i));
+      for (int j = 0; j < kIncrementsPerCounter; ++j)
+        counter.Increment();
+    }
+  }
+};
+
+}  // namespace
+
+TEST_F(StatsTablePerfTest, RegisterCounters) {
+  const std::string kTableName = "RegisterCountersPerfStatTable";
+  DeleteShmem(kTableName);
+  StatsTable table(kTableName, kMaxThreads, kMaxCounters);
+
+  PerfTimeLogger timer("StatsTable_register_counters_single_thread");
+  for (int i = 0; i < kNumCounters; ++i)
+    EXPECT_NE(0, table.FindCounter(StringPrintf("c:single%d", i)));
+  timer.Done();
+
+  PerfTimeLogger lookup_timer("StatsTable_lookup_counters_single_thread");
+  for (int i = 0; i < kNumCounters; ++i)
+    EXPECT_NE(0, table.FindCounter(StringPrintf("c:single%d", i)));
+  lookup_timer.Done();
+
+  DeleteShmem(kTableName);
+}
+
+TEST_F(StatsTablePerfTest, RegisterCountersManyThreads) {
+  const std::string kTableName = "RegisterThreadsPerfStatTable";
+  DeleteShmem(kTableName);
+  StatsTable table(kTableName, kMaxThreads, kMaxCounters);
+
+  RegisterCountersThread* threads[kMaxThreads];
+  PerfTimeLogger timer("StatsTable_register_counters_many_threads");
+  for (int i = 0; i < kMaxThreads; ++i) {
+    threads[i] = new RegisterCountersThread(&table,
+                                            i * kNumCounters / kMaxThreads);
+    threads[i]->Start();
+  }
+  for (int i = 0; i < kMaxThreads; ++i) {
+    threads[i]->Join();
+    delete threads[i];
+  }
+  timer.Done();
+
+  // Racing registrations must not have produced duplicate rows.
+  int rows = 0;
+  for (int i = 1; i <= table.GetMaxCounters(); ++i) {
+    if (*table.GetRowName(i) != '\0')
+      ++rows;
+  }
+  EXPECT_EQ(kNumCounters, rows);
+
+  DeleteShmem(kTableName);
+}
+
+TEST_F(StatsTablePerfTest, IncrementCountersManyThreads) {
+  const std::string kTableName = "IncrementPerfStatTable";
+  DeleteShmem(kTableName);
+  StatsTable table(kTableName, kMaxThreads + 1, kMaxCounters);
+  StatsTable::set_current(&table);
+
+  IncrementCountersThread* threads[kMaxThreads];
+  PerfTimeLogger timer("StatsTable_increment_counters_many_threads");
+  for (int i = 0; i < kMaxThreads; ++i) {
+    threads[i] = new IncrementCountersThread();
+    threads[i]->Start();
+  }
+  for (int i = 0; i < kMaxThreads; ++i) {
+    threads[i]->Join();
+    delete threads[i];
+  }
+  timer.Done();
+
+  EXPECT_EQ(kMaxThreads * kIncrementsPerCounter,
+            table.GetCounterValue("c:counter0"));
+
+  StatsTable::set_current(NULL);
+  DeleteShmem(kTableName);
+}
+
+}  // namespace base
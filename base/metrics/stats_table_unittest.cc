@@ -58,6 +58,35 @@ TEST_F(StatsTableTest, VerifySlots) {
   DeleteShmem(kTableName);
 }
 
+// Verify that lookups find the row a counter was registered in, including
+// for names which get truncated in the shared memory.
+TEST_F(StatsTableTest, FindCounterReturnsSameRow) {
+  const std::string kTableName = "FindCounterStatTable";
+  const int kMaxThreads = 1;
+  const int kMaxCounter = 8;
+  DeleteShmem(kTableName);
+  StatsTable table(kTableName, kMaxThreads, kMaxCounter);
+
+  std::string long_name(StatsTable::kMaxCounterNameLength * 2, 'x');
+  int long_id = table.FindCounter(long_name);
+  EXPECT_GT(long_id, 0);
+  EXPECT_EQ(long_id, table.FindCounter(long_name));
+
+  int ids[kMaxCounter - 1];
+  for (int index = 0; index < kMaxCounter - 1; index++) {
+    ids[index] = table.FindCounter(StringPrintf("counter%d", index));
+    EXPECT_GT(ids[index], 0);
+    EXPECT_NE(long_id, ids[index]);
+  }
+  for (int index = 0; index < kMaxCounter - 1; index++)
+    EXPECT_EQ(ids[index], table.FindCounter(StringPrintf("counter%d", index)));
+
+  // The table is now full.
+  EXPECT_EQ(0, table.FindCounter("one too many"));
+
+  DeleteShmem(kTableName);
+}
+
 // CounterZero will continually be set to 0.
 const std::string kCounterZero = "CounterZero";
 // Counter1313 will continually be set to 1313.
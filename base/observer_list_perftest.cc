@@ -0,0 +1,91 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/observer_list_threadsafe.h"
+
+#include <string>
+
+#include "base/memory/ref_counted.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kNumNotifications = 200000;
+
+class Counter {
+ public:
+  Counter() : calls(0), last_value(0) {}
+  void Observe(int value) {
+    calls++;
+    last_value = value;
+  }
+  int calls;
+  int last_value;
+};
+
+// Fires a stream of notifications from another thread, then quits the
+// observers' loop.
+class NotifierThread : public base::SimpleThread {
+ public:
+  NotifierThread(ObserverListThreadSafe<Counter>* list,
+                 MessageLoop* observer_loop,
+                 bool coalesce)
+      : base::SimpleThread("NotifierThread"),
+        list_(list),
+        observer_loop_(observer_loop),
+        coalesce_(coalesce) {
+  }
+
+  virtual void Run() {
+    for (int i = 1; i <= kNumNotifications; i++) {
+      if (coalesce_)
+        list_->NotifyCoalesced(&Counter::Observe, i);
+      else
+        list_->Notify(&Counter::Observe, i);
+    }
+    observer_loop_->PostTask(FROM_HERE, new MessageLoop::QuitTask);
+  }
+
+ private:
+  scoped_refptr<ObserverListThreadSafe<Counter> > list_;
+  MessageLoop* observer_loop_;
+  bool coalesce_;
+};
+
+void RunNotificationBenchmark(bool coalesce, const char* name) {
+  MessageLoop loop;
+  scoped_refptr<ObserverListThreadSafe<Counter> > observer_list(
+      new ObserverListThreadSafe<Counter>);
+  Counter counter;
+  observer_list->AddObserver(&counter);
+
+  NotifierThread notifier(observer_list, &loop, coalesce);
+  PerfTimer timer;
+  notifier.Start();
+  loop.Run();
+  notifier.Join();
+  double seconds = timer.Elapsed().InSecondsF();
+
+  // Every notification task ends up calling the observer exactly once.
+  EXPECT_EQ(kNumNotifications, counter.last_value);
+  std::string test_name(name);
+  LogPerfResult((test_name + "_notifications").c_str(),
+                kNumNotifications / seconds, "notifications/s");
+  LogPerfResult((test_name + "_tasks").c_str(), counter.calls, "tasks");
+
+  observer_list->RemoveObserver(&counter);
+}
+
+}  // namespace
+
+TEST(ObserverListThreadSafePerfTest, Notify) {
+  RunNotificationBenchmark(false, "ObserverListThreadSafe_notify");
+}
+
+TEST(ObserverListThreadSafePerfTest, NotifyCoalesced) {
+  RunNotificationBenchmark(true, "ObserverListThreadSafe_notify_coalesced");
+}
@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <map>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/callback.h"
@@ -15,6 +16,7 @@
 #include "base/memory/ref_counted.h"
 #include "base/message_loop.h"
 #include "base/observer_list.h"
+#include "base/stl_util-inl.h"
 #include "base/task.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,6 +44,13 @@
 //   whereas with the non-thread-safe observer_list, notifications happen
 //   synchronously and immediately.
 //
+//   For high-frequency, idempotent events (progress, state changes) the
+//   NotifyCoalesced() variants can be used instead.  They keep at most one
+//   pending notification per method for each thread and deliver all of a
+//   thread's pending coalesced notifications from a single task, so a
+//   burst of notifications costs one task per thread and observers only
+//   see the latest arguments.
+//
 //   IMPLEMENTATION NOTES
 //   The ObserverListThreadSafe maintains an ObserverList for each thread
 //   which uses the ThreadSafeObserver.  When Notifying the observers,
@@ -54,6 +63,76 @@
 template <class ObserverType>
 class ObserverListThreadSafe;
 
+namespace base {
+namespace internal {
+
+// A notification queued by ObserverListThreadSafe::NotifyCoalesced() which
+// has not been delivered yet.
+template <class ObserverType>
+class PendingObserverNotification {
+ public:
+  virtual ~PendingObserverNotification() {}
+
+  // If |newer| calls the same method as this notification, takes over its
+  // arguments and returns true.  Otherwise returns false.
+  virtual bool Absorb(const PendingObserverNotification& newer) = 0;
+
+  virtual PendingObserverNotification* Clone() const = 0;
+
+  virtual void Run(ObserverType* obs) const = 0;
+
+  // Identifies the concrete subclass, since we can't rely on RTTI.
+  virtual const void* type_tag() const = 0;
+};
+
+template <class ObserverType, class Method, class Params>
+class PendingObserverNotificationImpl
+    : public PendingObserverNotification<ObserverType> {
+ public:
+  PendingObserverNotificationImpl(Method m, const Params& p)
+      : m_(m),
+        method_(m, p) {
+  }
+
+  virtual bool Absorb(const PendingObserverNotification<ObserverType>& newer) {
+    if (newer.type_tag() != type_tag())
+      return false;
+    const PendingObserverNotificationImpl& impl =
+        static_cast<const PendingObserverNotificationImpl&>(newer);
+    if (impl.m_ != m_)
+      return false;
+    method_ = impl.method_;
+    return true;
+  }
+
+  virtual PendingObserverNotification<ObserverType>* Clone() const {
+    return new PendingObserverNotificationImpl(*this);
+  }
+
+  virtual void Run(ObserverType* obs) const {
+    method_.Run(obs);
+  }
+
+  virtual const void* type_tag() const {
+    return &type_tag_;
+  }
+
+ private:
+  // Only the address of this is used.  It is deliberately not const so
+  // that the linker can't fold the tags of different instantiations.
+  static char type_tag_;
+
+  Method m_;
+  UnboundMethod<ObserverType, Method, Params> method_;
+};
+
+template <class ObserverType, class Method, class Params>
+char PendingObserverNotificationImpl<ObserverType, Method, Params>::type_tag_ =
+    0;
+
+}  // namespace internal
+}  // namespace base
+
 // This class is used to work around VS2005 not accepting:
 //
 // friend class
@@ -152,15 +231,48 @@ class ObserverListThreadSafe
 
   // TODO(mbelshe):  Add more wrappers for Notify() with more arguments.
 
+  // Coalescing notify methods.
+  // Like Notify(), except that while a thread still has a coalesced
+  // notification for |m| pending, a new one replaces its arguments instead
+  // of being queued behind it, and all of a thread's pending coalesced
+  // notifications are delivered from a single task, in the order their
+  // methods were first queued.  Only use these for idempotent events where
+  // observers just need the latest value: intermediate values are dropped.
+  template <class Method>
+  void NotifyCoalesced(Method m) {
+    base::internal::PendingObserverNotificationImpl<ObserverType, Method,
+                                                    Tuple0>
+        notification(m, MakeTuple());
+    QueueCoalescedNotification(notification);
+  }
+
+  template <class Method, class A>
+  void NotifyCoalesced(Method m, const A& a) {
+    base::internal::PendingObserverNotificationImpl<ObserverType, Method,
+                                                    Tuple1<A> >
+        notification(m, MakeTuple(a));
+    QueueCoalescedNotification(notification);
+  }
+
  private:
   // See comment above ObserverListThreadSafeTraits' definition.
   friend struct ObserverListThreadSafeTraits<ObserverType>;
 
+  typedef base::internal::PendingObserverNotification<ObserverType>
+      PendingNotification;
+  typedef std::vector<PendingNotification*> PendingNotifications;
+
   ~ObserverListThreadSafe() {
     typename ObserversListMap::const_iterator it;
     for (it = observer_lists_.begin(); it != observer_lists_.end(); ++it)
       delete (*it).second;
     observer_lists_.clear();
+
+    typename PendingNotificationsMap::iterator pending_it;
+    for (pending_it = pending_notifications_.begin();
+         pending_it != pending_notifications_.end(); ++pending_it)
+      STLDeleteElements(&pending_it->second);
+    pending_notifications_.clear();
   }
 
   template <class Method, class Params>
@@ -206,27 +318,103 @@ class ObserverListThreadSafe
         method.Run(obs);
     }
 
-    // If there are no more observers on the list, we can now delete it.
-    if (list->size() == 0) {
+    DeleteListIfEmpty(list);
+  }
+
+  // Queues a copy of |notification| for every thread with observers,
+  // posting a task to the threads which did not have one pending yet.
+  void QueueCoalescedNotification(const PendingNotification& notification) {
+    base::AutoLock lock(list_lock_);
+    typename ObserversListMap::iterator it;
+    for (it = observer_lists_.begin(); it != observer_lists_.end(); ++it) {
+      MessageLoop* loop = (*it).first;
+      PendingNotifications& pending = pending_notifications_[loop];
+      bool absorbed = false;
+      for (size_t i = 0; i < pending.size() && !absorbed; ++i)
+        absorbed = pending[i]->Absorb(notification);
+      if (absorbed)
+        continue;
+
+      // An empty queue means no flush task is in flight for |loop|.
+      bool post_task = pending.empty();
+      pending.push_back(notification.Clone());
+      if (post_task) {
+        loop->PostTask(
+            FROM_HERE,
+            NewRunnableMethod(this,
+                &ObserverListThreadSafe<ObserverType>::
+                    FlushCoalescedNotifications));
+      }
+    }
+  }
+
+  // Delivers the pending coalesced notifications of the current thread.
+  // This function MUST be called on the thread which owns the unsafe
+  // ObserverList.
+  void FlushCoalescedNotifications() {
+    MessageLoop* loop = MessageLoop::current();
+    PendingNotifications pending;
+    ObserverList<ObserverType>* list = NULL;
+    {
+      base::AutoLock lock(list_lock_);
+      typename PendingNotificationsMap::iterator pending_it =
+          pending_notifications_.find(loop);
+      if (pending_it == pending_notifications_.end())
+        return;
+      pending.swap(pending_it->second);
+      pending_notifications_.erase(pending_it);
+
+      // Deliver to whatever list the thread has now; the one it had when
+      // the task was posted may have been removed and re-added since.
+      typename ObserversListMap::iterator it = observer_lists_.find(loop);
+      if (it != observer_lists_.end())
+        list = it->second;
+    }
+
+    for (size_t i = 0; list && i < pending.size(); ++i) {
       {
-        base::AutoLock lock(list_lock_);
-        // Remove |list| if it's not already removed.
-        // This can happen if multiple observers got removed in a notification.
-        // See http://crbug.com/55725.
-        typename ObserversListMap::iterator it =
-            observer_lists_.find(MessageLoop::current());
-        if (it != observer_lists_.end() && it->second == list)
-          observer_lists_.erase(it);
+        typename ObserverList<ObserverType>::Iterator it(*list);
+        ObserverType* obs;
+        while ((obs = it.GetNext()) != NULL)
+          pending[i]->Run(obs);
       }
-      delete list;
+      if (DeleteListIfEmpty(list))
+        list = NULL;
+    }
+    STLDeleteElements(&pending);
+  }
+
+  // If there are no more observers on |list|, removes it from the map (if
+  // it is still there) and deletes it.  Returns true if |list| was deleted.
+  // This function MUST be called on the thread which owns |list|, outside
+  // of any iteration over it.
+  bool DeleteListIfEmpty(ObserverList<ObserverType>* list) {
+    if (list->size() != 0)
+      return false;
+    {
+      base::AutoLock lock(list_lock_);
+      // Remove |list| if it's not already removed.
+      // This can happen if multiple observers got removed in a notification.
+      // See http://crbug.com/55725.
+      typename ObserversListMap::iterator it =
+          observer_lists_.find(MessageLoop::current());
+      if (it != observer_lists_.end() && it->second == list)
+        observer_lists_.erase(it);
     }
+    delete list;
+    return true;
   }
 
   typedef std::map<MessageLoop*, ObserverList<ObserverType>*> ObserversListMap;
+  typedef std::map<MessageLoop*, PendingNotifications> PendingNotificationsMap;
 
   // These are marked mutable to facilitate having NotifyAll be const.
   base::Lock list_lock_;  // Protects the observer_lists_.
   ObserversListMap observer_lists_;
+  // Coalesced notifications waiting for delivery, per thread.  A thread
+  // has an entry exactly when a flush task is in flight for it.  Also
+  // protected by |list_lock_|.
+  PendingNotificationsMap pending_notifications_;
   const NotificationType type_;
 
   DISALLOW_COPY_AND_ASSIGN(ObserverListThreadSafe);
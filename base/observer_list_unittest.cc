@@ -266,6 +266,83 @@ TEST(ObserverListThreadSafeTest, RemoveMultipleObservers) {
   loop.RunAllPending();
 }
 
+// An observer which records every value it sees and a separate ping count.
+class Recorder : public Foo {
+ public:
+  Recorder() : pings(0) {}
+  virtual ~Recorder() {}
+  virtual void Observe(int x) {
+    values.push_back(x);
+  }
+  void Ping() {
+    pings++;
+  }
+  std::vector<int> values;
+  int pings;
+};
+
+TEST(ObserverListThreadSafeTest, CoalescedNotifications) {
+  MessageLoop loop;
+  scoped_refptr<ObserverListThreadSafe<Recorder> > observer_list(
+      new ObserverListThreadSafe<Recorder>);
+  Recorder a;
+  Recorder b;
+  observer_list->AddObserver(&a);
+  observer_list->AddObserver(&b);
+
+  // Only the latest value of each method is delivered.
+  for (int i = 1; i <= 10; i++) {
+    observer_list->NotifyCoalesced(&Recorder::Observe, i);
+    observer_list->NotifyCoalesced(&Recorder::Ping);
+  }
+  loop.RunAllPending();
+  ASSERT_EQ(1U, a.values.size());
+  EXPECT_EQ(10, a.values[0]);
+  EXPECT_EQ(1, a.pings);
+  ASSERT_EQ(1U, b.values.size());
+  EXPECT_EQ(10, b.values[0]);
+  EXPECT_EQ(1, b.pings);
+
+  // Once delivered, a new notification is queued again.
+  observer_list->NotifyCoalesced(&Recorder::Observe, 20);
+  loop.RunAllPending();
+  ASSERT_EQ(2U, a.values.size());
+  EXPECT_EQ(20, a.values[1]);
+
+  // Regular notifications are not coalesced.
+  observer_list->Notify(&Recorder::Observe, 30);
+  observer_list->Notify(&Recorder::Observe, 40);
+  loop.RunAllPending();
+  ASSERT_EQ(4U, a.values.size());
+  EXPECT_EQ(30, a.values[2]);
+  EXPECT_EQ(40, a.values[3]);
+}
+
+TEST(ObserverListThreadSafeTest, CoalescedNotificationRemovesObservers) {
+  MessageLoop loop;
+  scoped_refptr<ObserverListThreadSafe<Foo> > observer_list(
+      new ObserverListThreadSafe<Foo>);
+
+  FooRemover a(observer_list);
+  Adder b(1);
+
+  observer_list->AddObserver(&a);
+  observer_list->AddObserver(&b);
+
+  a.AddFooToRemove(&a);
+  a.AddFooToRemove(&b);
+
+  observer_list->NotifyCoalesced(&Foo::Observe, 1);
+  observer_list->NotifyCoalesced(&Foo::Observe, 2);
+  loop.RunAllPending();
+  EXPECT_EQ(0, b.total);
+
+  // There are no observers left, so this must not deliver anything.
+  observer_list->NotifyCoalesced(&Foo::Observe, 3);
+  loop.RunAllPending();
+  EXPECT_EQ(0, b.total);
+}
+
 // A test driver for a multi-threaded notification loop.  Runs a number
 // of observer threads, each of which constantly adds/removes itself
 // from the observer list.  Optionally, if cross_thread_notifies is set
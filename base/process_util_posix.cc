@@ -376,6 +376,7 @@ void CloseSuperfluousFds(const base::InjectiveMultimap& saved_mapping) {
       DPCHECK(ret == 0);
     }
   }
+  DLOG_IF(FATAL, fd_dir.failed()) << "Failed to read " << kFDDir;
 }
 
 char** AlterEnvironment(const environment_vector& changes,
@@ -8,6 +8,7 @@
 
 #include "base/basictypes.h"
 #include "base/command_line.h"
+#include "base/hash_tables.h"
 #include "base/i18n/number_formatting.h"
 #include "base/metrics/histogram.h"
 #include "base/string_number_conversions.h"
@@ -486,6 +487,9 @@ const size_t AutocompleteProvider::kMaxMatches = 3;
 AutocompleteProvider::ACProviderListener::~ACProviderListener() {
 }
 
+// static
+const int AutocompleteProvider::kDefaultLatencyBudgetMs = 1500;
+
 AutocompleteProvider::AutocompleteProvider(ACProviderListener* listener,
                                            Profile* profile,
                                            const char* name)
@@ -505,6 +509,10 @@ void AutocompleteProvider::Stop() {
   done_ = true;
 }
 
+base::TimeDelta AutocompleteProvider::GetLatencyBudget() const {
+  return base::TimeDelta::FromMilliseconds(kDefaultLatencyBudgetMs);
+}
+
 void AutocompleteProvider::DeleteMatch(const AutocompleteMatch& match) {
 }
 
@@ -642,12 +650,26 @@ void AutocompleteResult::AddMatch(const AutocompleteMatch& match) {
 }
 
 void AutocompleteResult::SortAndCull(const AutocompleteInput& input) {
-  // Remove duplicates.
-  std::sort(matches_.begin(), matches_.end(),
-            &AutocompleteMatch::DestinationSortFunc);
-  matches_.erase(std::unique(matches_.begin(), matches_.end(),
-                             &AutocompleteMatch::DestinationsEqual),
-                 matches_.end());
+  // Remove duplicates, keeping the most relevant match for each destination.
+  // Looking the destinations up in a hash map avoids sorting every match just
+  // to find them, as this runs on each provider update.
+  typedef base::hash_map<std::string, size_t> DestinationToIndex;
+  DestinationToIndex unique_destinations;
+  size_t num_unique = 0;
+  for (size_t i = 0; i < matches_.size(); ++i) {
+    std::pair<DestinationToIndex::iterator, bool> inserted =
+        unique_destinations.insert(std::make_pair(
+            matches_[i].destination_url.possibly_invalid_spec(), num_unique));
+    if (inserted.second) {
+      if (i != num_unique)
+        matches_[num_unique] = matches_[i];
+      ++num_unique;
+    } else if (AutocompleteMatch::MoreRelevant(
+                   matches_[i], matches_[inserted.first->second])) {
+      matches_[inserted.first->second] = matches_[i];
+    }
+  }
+  matches_.erase(matches_.begin() + num_unique, matches_.end());
 
   // Sort and trim to the most relevant kMaxMatches matches.
   const size_t num_matches = std::min(kMaxMatches, matches_.size());
@@ -780,6 +802,20 @@ const int AutocompleteController::kNoItemSelected = -1;
 // they initiate a query.
 static const int kExpireTimeMS = 500;
 
+namespace {
+
+// Logs the time |provider| took to finish a query.
+void LogProviderTime(const AutocompleteProvider* provider,
+                     base::TimeDelta time) {
+  base::Histogram* counter = base::Histogram::FactoryTimeGet(
+      std::string("Omnibox.ProviderTime.") + provider->name(),
+      base::TimeDelta::FromMilliseconds(1), base::TimeDelta::FromSeconds(5),
+      50, base::Histogram::kUmaTargetedHistogramFlag);
+  counter->AddTime(time);
+}
+
+}  // namespace
+
 AutocompleteController::AutocompleteController(
     Profile* profile,
     AutocompleteControllerDelegate* delegate)
@@ -854,15 +890,23 @@ void AutocompleteController::Start(
       (input_.matches_requested() == old_matches_requested);
 
   expire_timer_.Stop();
+  deadline_timer_.Stop();
+  running_providers_.clear();
 
   // Start the new query.
   in_start_ = true;
   base::TimeTicks start_time = base::TimeTicks::Now();
   for (ACProviders::iterator i(providers_.begin()); i != providers_.end();
        ++i) {
+    const base::TimeTicks provider_start_time = base::TimeTicks::Now();
     (*i)->Start(input_, minimal_changes);
-    if (matches_requested != AutocompleteInput::ALL_MATCHES)
+    if (matches_requested != AutocompleteInput::ALL_MATCHES) {
       DCHECK((*i)->done());
+    } else if ((*i)->done()) {
+      LogProviderTime(*i, base::TimeTicks::Now() - provider_start_time);
+    } else {
+      running_providers_[*i] = provider_start_time;
+    }
   }
   if (matches_requested == AutocompleteInput::ALL_MATCHES && text.size() < 6) {
     base::TimeTicks end_time = base::TimeTicks::Now();
@@ -873,10 +917,13 @@ void AutocompleteController::Start(
   }
   in_start_ = false;
   CheckIfDone();
+  LogProviderTimes();
   UpdateResult(true);
 
-  if (!done_)
+  if (!done_) {
     StartExpireTimer();
+    StartDeadlineTimer();
+  }
 }
 
 void AutocompleteController::Stop(bool clear_result) {
@@ -886,6 +933,8 @@ void AutocompleteController::Stop(bool clear_result) {
   }
 
   expire_timer_.Stop();
+  deadline_timer_.Stop();
+  running_providers_.clear();
   done_ = true;
   if (clear_result && !result_.empty()) {
     result_.Reset();
@@ -917,6 +966,13 @@ void AutocompleteController::ExpireCopiedEntries() {
 
 void AutocompleteController::OnProviderUpdate(bool updated_matches) {
   CheckIfDone();
+  LogProviderTimes();
+  // A provider's budget may change as it makes progress (e.g. once
+  // SearchProvider has its instant result), so recompute the deadline.
+  if (done_)
+    deadline_timer_.Stop();
+  else if (!in_start_)
+    StartDeadlineTimer();
   // Multiple providers may provide synchronous results, so we only update the
   // results if we're not in Start().
   if (!in_start_ && (updated_matches || done_))
@@ -992,3 +1048,57 @@ void AutocompleteController::StartExpireTimer() {
     expire_timer_.Start(base::TimeDelta::FromMilliseconds(kExpireTimeMS),
                         this, &AutocompleteController::ExpireCopiedEntries);
 }
+
+void AutocompleteController::LogProviderTimes() {
+  const base::TimeTicks now = base::TimeTicks::Now();
+  for (ProviderStartTimes::iterator i(running_providers_.begin());
+       i != running_providers_.end(); ) {
+    if (i->first->done()) {
+      LogProviderTime(i->first, now - i->second);
+      running_providers_.erase(i++);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void AutocompleteController::StartDeadlineTimer() {
+  deadline_timer_.Stop();
+  base::TimeTicks deadline;
+  for (ProviderStartTimes::const_iterator i(running_providers_.begin());
+       i != running_providers_.end(); ++i) {
+    const base::TimeDelta budget = i->first->GetLatencyBudget();
+    if (budget == base::TimeDelta())
+      continue;  // The provider may take as long as it needs.
+    if (deadline.is_null() || (i->second + budget < deadline))
+      deadline = i->second + budget;
+  }
+  if (deadline.is_null())
+    return;
+  deadline_timer_.Start(
+      std::max(deadline - base::TimeTicks::Now(), base::TimeDelta()),
+      this, &AutocompleteController::StopLateProviders);
+}
+
+void AutocompleteController::StopLateProviders() {
+  const base::TimeTicks now = base::TimeTicks::Now();
+  for (ProviderStartTimes::iterator i(running_providers_.begin());
+       i != running_providers_.end(); ) {
+    const base::TimeDelta budget = i->first->GetLatencyBudget();
+    if ((budget != base::TimeDelta()) && (now - i->second >= budget)) {
+      // A stopped provider didn't finish the query, so leave it out of the
+      // ProviderTime histograms, which would otherwise pile up at its budget.
+      i->first->Stop();
+      running_providers_.erase(i++);
+    } else {
+      ++i;
+    }
+  }
+  CheckIfDone();
+  LogProviderTimes();
+  // Notify observers of the matches the stopped providers leave, and of the
+  // query being done if it now is.
+  UpdateResult(false);
+  if (!done_)
+    StartDeadlineTimer();
+}
@@ -13,6 +13,7 @@
 #include "base/logging.h"
 #include "base/memory/ref_counted.h"
 #include "base/string16.h"
+#include "base/time.h"
 #include "base/timer.h"
 #include "googleurl/src/gurl.h"
 #include "googleurl/src/url_parse.h"
@@ -28,7 +29,9 @@
 //
 // The owner may also cancel the current query by calling Stop(), which the
 // controller will in turn communicate to all the providers.  No callbacks will
-// happen after a request has been stopped.
+// happen after a request has been stopped.  The controller also stops any
+// provider still running past its latency budget, so that one slow provider
+// can't hold back the final result.
 //
 // IMPORTANT: There is NO THREAD SAFETY built into this portion of the
 // autocomplete system.  All calls to and from the AutocompleteController should
@@ -408,6 +411,11 @@ class AutocompleteProvider
   // Returns the name of this provider.
   const char* name() const { return name_; }
 
+  // Returns how long the provider may run on a query before the controller
+  // stops it and finishes the query with the matches it has so far.  A zero
+  // budget lets the provider run until it is done or the query is stopped.
+  virtual base::TimeDelta GetLatencyBudget() const;
+
   // Called to delete a match and the backing data that produced it.  This
   // match should not appear again in this or future queries.  This can only be
   // called for matches the provider marks as deletable.  This should only be
@@ -421,6 +429,11 @@ class AutocompleteProvider
   // culling.
   static const size_t kMaxMatches;
 
+  // The latency budget of providers which don't override GetLatencyBudget().
+  // HistoryURLProvider and KeywordProvider opt out of it, and SearchProvider
+  // allows longer for its network round trip.
+  static const int kDefaultLatencyBudgetMs;
+
  protected:
   friend class base::RefCountedThreadSafe<AutocompleteProvider>;
 
@@ -696,6 +709,19 @@ class AutocompleteController : public ACProviderListener {
   // Starts the expire timer.
   void StartExpireTimer();
 
+  // Logs how long each provider in |running_providers_| which is now done
+  // took on the current query, and forgets it.
+  void LogProviderTimes();
+
+  // (Re)starts the deadline timer for the earliest latency budget of the
+  // providers in |running_providers_|.
+  void StartDeadlineTimer();
+
+  // Stops the providers which have run past their latency budget, and updates
+  // the result with the matches they have.  Stopped providers are not logged
+  // by LogProviderTimes().  Invoked by |deadline_timer_|.
+  void StopLateProviders();
+
   AutocompleteControllerDelegate* delegate_;
 
   // A list of all providers.
@@ -713,6 +739,15 @@ class AutocompleteController : public ACProviderListener {
   // invokes |ExpireCopiedEntries|.
   base::OneShotTimer<AutocompleteController> expire_timer_;
 
+  // Timer used to stop providers which run past their latency budget. When
+  // run invokes |StopLateProviders|.
+  base::OneShotTimer<AutocompleteController> deadline_timer_;
+
+  // The providers which didn't finish the current query synchronously and
+  // haven't finished it since, with the time each was started.
+  typedef std::map<AutocompleteProvider*, base::TimeTicks> ProviderStartTimes;
+  ProviderStartTimes running_providers_;
+
   // True if a query is not currently running.
   bool done_;
 
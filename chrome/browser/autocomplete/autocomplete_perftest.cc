@@ -0,0 +1,174 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Types a word into an AutocompleteController whose providers answer at
+// different speeds, and logs how long each keystroke takes to be done:
+//   $ ./perf_tests --gtest_filter=AutocompletePerfTest.*
+
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/autocomplete/autocomplete.h"
+#include "chrome/browser/autocomplete/autocomplete_match.h"
+#include "content/common/notification_observer.h"
+#include "content/common/notification_registrar.h"
+#include "content/common/notification_service.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const char kTypedText[] = "autocomplete";
+
+// Autocomplete provider that gives one result synchronously and the rest
+// |delay_ms| later.  A |delay_ms| of zero answers synchronously.
+class MockProvider : public AutocompleteProvider {
+ public:
+  MockProvider(const char* name, int delay_ms, int budget_ms)
+      : AutocompleteProvider(NULL, NULL, name),
+        delay_ms_(delay_ms),
+        budget_ms_(budget_ms),
+        query_id_(0) {
+  }
+
+  virtual void Start(const AutocompleteInput& input,
+                     bool minimal_changes) {
+    ++query_id_;
+    matches_.clear();
+    AddResults(input.text(), 0, 1);
+    done_ = (delay_ms_ == 0) ||
+        (input.matches_requested() != AutocompleteInput::ALL_MATCHES);
+    if (!done_) {
+      MessageLoop::current()->PostDelayedTask(FROM_HERE,
+          NewRunnableMethod(this, &MockProvider::Run, input.text(), query_id_),
+          delay_ms_);
+    }
+  }
+
+  virtual void Stop() {
+    // Drop the results of the running query.
+    ++query_id_;
+    done_ = true;
+  }
+
+  virtual base::TimeDelta GetLatencyBudget() const {
+    return base::TimeDelta::FromMilliseconds(budget_ms_);
+  }
+
+  void set_listener(ACProviderListener* listener) {
+    listener_ = listener;
+  }
+
+ private:
+  ~MockProvider() {}
+
+  void Run(const string16& text, int query_id) {
+    if (query_id != query_id_)
+      return;
+    AddResults(text, 1, 3);
+    done_ = true;
+    listener_->OnProviderUpdate(true);
+  }
+
+  void AddResults(const string16& text, int start_at, int num) {
+    for (int i = start_at; i < num; ++i) {
+      AutocompleteMatch match(this, 1000 - delay_ms_ - i, false,
+                              AutocompleteMatch::URL_WHAT_YOU_TYPED);
+      match.fill_into_edit = text + base::IntToString16(i);
+      match.destination_url = GURL(std::string("http://") + name() + "/" +
+                                   UTF16ToUTF8(match.fill_into_edit));
+      matches_.push_back(match);
+    }
+  }
+
+  const int delay_ms_;
+  const int budget_ms_;
+  int query_id_;
+};
+
+class AutocompletePerfTest : public testing::Test,
+                             public NotificationObserver {
+ protected:
+  virtual void SetUp() {
+    registrar_.Add(this, NotificationType::AUTOCOMPLETE_CONTROLLER_RESULT_READY,
+                   NotificationService::AllSources());
+  }
+
+  // Creates a controller with one synchronous provider and three of
+  // increasing delay.  The slowest is stopped after |slow_budget_ms|, or
+  // never if it is zero.
+  void ResetController(int slow_budget_ms) {
+    ACProviders providers;
+    MockProvider* sync_provider = new MockProvider("sync", 0, 0);
+    MockProvider* fast_provider = new MockProvider("fast", 5, 0);
+    MockProvider* medium_provider = new MockProvider("medium", 30, 0);
+    MockProvider* slow_provider =
+        new MockProvider("slow", 200, slow_budget_ms);
+    MockProvider* all_providers[] = {
+      sync_provider, fast_provider, medium_provider, slow_provider
+    };
+    for (size_t i = 0; i < arraysize(all_providers); ++i) {
+      all_providers[i]->AddRef();
+      providers.push_back(all_providers[i]);
+    }
+    controller_.reset(new AutocompleteController(providers));
+    for (size_t i = 0; i < arraysize(all_providers); ++i)
+      all_providers[i]->set_listener(controller_.get());
+  }
+
+  // Types kTypedText one character at a time, waiting for each keystroke's
+  // query to finish, and logs the average times to the first result and to
+  // the final one under |name|.
+  void TypeText(const std::string& name) {
+    base::TimeDelta first_result_time;
+    base::TimeDelta done_time;
+    const string16 text(ASCIIToUTF16(kTypedText));
+    for (size_t length = 1; length <= text.length(); ++length) {
+      const base::TimeTicks start = base::TimeTicks::Now();
+      controller_->Start(text.substr(0, length), string16(), true, false,
+                         true, AutocompleteInput::ALL_MATCHES);
+      first_result_time += base::TimeTicks::Now() - start;
+      EXPECT_FALSE(controller_->result().empty());
+      if (!controller_->done())
+        MessageLoop::current()->Run();
+      done_time += base::TimeTicks::Now() - start;
+      EXPECT_TRUE(controller_->done());
+    }
+    LogPerfResult((name + "_first_result").c_str(),
+                  first_result_time.InMillisecondsF() / text.length(), "ms");
+    LogPerfResult((name + "_done").c_str(),
+                  done_time.InMillisecondsF() / text.length(), "ms");
+  }
+
+ private:
+  // NotificationObserver
+  virtual void Observe(NotificationType type,
+                       const NotificationSource& source,
+                       const NotificationDetails& details) {
+    if (controller_->done())
+      MessageLoop::current()->Quit();
+  }
+
+  MessageLoopForUI message_loop_;
+  NotificationRegistrar registrar_;
+
+ protected:
+  scoped_ptr<AutocompleteController> controller_;
+};
+
+}  // namespace
+
+TEST_F(AutocompletePerfTest, Keystrokes) {
+  // Every keystroke waits for the slowest provider.
+  ResetController(0);
+  TypeText("Autocomplete_unlimited_budget");
+
+  // The slowest provider is stopped halfway through its query.
+  ResetController(100);
+  TypeText("Autocomplete_limited_budget");
+}
@@ -185,3 +185,54 @@ TEST_F(AutocompleteResultTest, CopyOldMatches2) {
                             current, ARRAYSIZE_UNSAFE(current),
                             result, ARRAYSIZE_UNSAFE(result)));
 }
+
+// Tests that SortAndCull keeps the most relevant match for each destination.
+TEST_F(AutocompleteResultTest, SortAndCullRemovesDuplicates) {
+  TestData data[] = {
+    { 0, 0, 1100 },
+    { 1, 0, 1000 },
+    { 0, 1, 1300 },
+    { 2, 0, 900 },
+    { 1, 1, 800 },
+    { 0, 2, 1200 },
+  };
+  TestData expected[] = {
+    { 0, 1, 1300 },
+    { 1, 0, 1000 },
+    { 2, 0, 900 },
+  };
+
+  ACMatches matches;
+  PopulateAutocompleteMatches(data, ARRAYSIZE_UNSAFE(data), &matches);
+  AutocompleteInput input(ASCIIToUTF16("a"), string16(), false, false, false,
+                          AutocompleteInput::ALL_MATCHES);
+  AutocompleteResult result;
+  result.AppendMatches(matches);
+  result.SortAndCull(input);
+
+  ASSERT_NO_FATAL_FAILURE(
+      AssertResultMatches(result, expected, ARRAYSIZE_UNSAFE(expected)));
+}
+
+// Tests that SortAndCull keeps only the kMaxMatches most relevant matches.
+TEST_F(AutocompleteResultTest, SortAndCullKeepsMostRelevant) {
+  ACMatches matches;
+  for (int i = 0; i < static_cast<int>(AutocompleteResult::kMaxMatches) * 2;
+       ++i) {
+    TestData data = { i, 0, 100 + i };
+    AutocompleteMatch match;
+    PopulateAutocompleteMatch(data, &match);
+    matches.push_back(match);
+  }
+  AutocompleteInput input(ASCIIToUTF16("a"), string16(), false, false, false,
+                          AutocompleteInput::ALL_MATCHES);
+  AutocompleteResult result;
+  result.AppendMatches(matches);
+  result.SortAndCull(input);
+
+  ASSERT_EQ(AutocompleteResult::kMaxMatches, result.size());
+  int relevance = 100 + static_cast<int>(AutocompleteResult::kMaxMatches) * 2;
+  for (AutocompleteResult::const_iterator i(result.begin()); i != result.end();
+       ++i)
+    EXPECT_EQ(--relevance, i->relevance);
+}
@@ -102,11 +102,39 @@ void TestProvider::AddResults(int start_at, int num) {
   }
 }
 
+// Autocomplete provider that gives one result synchronously and then never
+// finishes, unless the controller stops it when its latency budget runs out.
+class StalledProvider : public AutocompleteProvider {
+ public:
+  StalledProvider() : AutocompleteProvider(NULL, NULL, "Stalled") {}
+
+  virtual void Start(const AutocompleteInput& input,
+                     bool minimal_changes) {
+    matches_.clear();
+    AutocompleteMatch match(this, 1, false,
+                            AutocompleteMatch::URL_WHAT_YOU_TYPED);
+    match.destination_url = GURL("http://stalled/");
+    matches_.push_back(match);
+    done_ = (input.matches_requested() != AutocompleteInput::ALL_MATCHES);
+  }
+
+  virtual base::TimeDelta GetLatencyBudget() const {
+    return base::TimeDelta::FromMilliseconds(10);
+  }
+
+ private:
+  ~StalledProvider() {}
+};
+
 class AutocompleteProviderTest : public testing::Test,
                                  public NotificationObserver {
  protected:
   void ResetControllerWithTestProviders(bool same_destinations);
 
+  // Like ResetControllerWithTestProviders(false), but adds a StalledProvider
+  // after the two test providers.  The controller must stop it to finish.
+  void ResetControllerWithStalledProvider();
+
   // Runs a query on the input "a", and makes sure both providers' input is
   // properly collected.
   void RunTest();
@@ -162,6 +190,32 @@ void AutocompleteProviderTest::ResetControllerWithTestProviders(
                  NotificationService::AllSources());
 }
 
+void AutocompleteProviderTest::ResetControllerWithStalledProvider() {
+  providers_.clear();
+
+  TestProvider* providerA = new TestProvider(num_results_per_provider,
+                                             ASCIIToUTF16("http://a"));
+  providerA->AddRef();
+  providers_.push_back(providerA);
+
+  TestProvider* providerB = new TestProvider(num_results_per_provider * 2,
+                                             ASCIIToUTF16("http://b"));
+  providerB->AddRef();
+  providers_.push_back(providerB);
+
+  StalledProvider* stalled_provider = new StalledProvider;
+  stalled_provider->AddRef();
+  providers_.push_back(stalled_provider);
+
+  AutocompleteController* controller = new AutocompleteController(providers_);
+  controller_.reset(controller);
+  providerA->set_listener(controller);
+  providerB->set_listener(controller);
+
+  registrar_.Add(this, NotificationType::AUTOCOMPLETE_CONTROLLER_RESULT_READY,
+                 NotificationService::AllSources());
+}
+
 void AutocompleteProviderTest::
     ResetControllerWithTestProvidersWithKeywordAndSearchProviders() {
   profile_.CreateTemplateURLModel();
@@ -261,6 +315,17 @@ TEST_F(AutocompleteProviderTest, RemoveDuplicates) {
     EXPECT_EQ(providers_[1], i->provider);
 }
 
+// Tests that a provider which runs past its latency budget is stopped, so that
+// the query still finishes with every provider's matches.
+TEST_F(AutocompleteProviderTest, StopsProviderPastBudget) {
+  ResetControllerWithStalledProvider();
+  RunTest();
+
+  EXPECT_TRUE(providers_[2]->done());
+  EXPECT_EQ(num_results_per_provider * 2 + 1, result_.size());
+  EXPECT_EQ(providers_[2], (result_.end() - 1)->provider);
+}
+
 TEST_F(AutocompleteProviderTest, AllowExactKeywordMatch) {
   ResetControllerWithTestProvidersWithKeywordAndSearchProviders();
   RunExactKeymatchTest(true);
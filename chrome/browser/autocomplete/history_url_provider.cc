@@ -149,6 +149,14 @@ void HistoryURLProvider::Stop() {
     params_->cancel = true;
 }
 
+base::TimeDelta HistoryURLProvider::GetLatencyBudget() const {
+  // The history pass is what usually supplies the inline autocompletion, and
+  // it is slowest right after startup, while the history database is still
+  // loading.  Stopping it then would leave the user with only the
+  // what-you-typed match, so let it run until the next query cancels it.
+  return base::TimeDelta();
+}
+
 // Called on the history thread.
 void HistoryURLProvider::ExecuteWithDB(history::HistoryBackend* backend,
                                        history::URLDatabase* db,
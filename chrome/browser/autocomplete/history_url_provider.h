@@ -157,6 +157,7 @@ class HistoryURLProvider : public HistoryProvider {
   virtual void Start(const AutocompleteInput& input,
                      bool minimal_changes) OVERRIDE;
   virtual void Stop() OVERRIDE;
+  virtual base::TimeDelta GetLatencyBudget() const OVERRIDE;
 
   // Runs the history query on the history thread, called by the history
   // system. The history database MAY BE NULL in which case it is not
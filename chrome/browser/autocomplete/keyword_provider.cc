@@ -270,6 +270,12 @@ void KeywordProvider::Stop() {
   MaybeEndExtensionKeywordMode();
 }
 
+base::TimeDelta KeywordProvider::GetLatencyBudget() const {
+  // Stopping ends extension keyword mode, which the user is still in while an
+  // extension answers slowly, so never stop on a deadline.
+  return base::TimeDelta();
+}
+
 KeywordProvider::~KeywordProvider() {}
 
 // static
@@ -74,6 +74,7 @@ class KeywordProvider : public AutocompleteProvider,
   // AutocompleteProvider
   virtual void Start(const AutocompleteInput& input, bool minimal_changes);
   virtual void Stop();
+  virtual base::TimeDelta GetLatencyBudget() const;
 
  private:
   class ScopedEndExtensionKeywordMode;
@@ -230,6 +230,16 @@ void SearchProvider::Stop() {
   default_provider_suggest_text_.clear();
 }
 
+base::TimeDelta SearchProvider::GetLatencyBudget() const {
+  // Stopping the provider drops the instant suggestion, so never stop it
+  // while instant is pending.  Once instant is done (or disabled), only
+  // suggest requests remain; they go over the network after a short delay,
+  // so allow for a slow round trip.
+  if (!instant_finalized_ && InstantController::IsEnabled(profile_))
+    return base::TimeDelta();
+  return base::TimeDelta::FromMilliseconds(3000);
+}
+
 void SearchProvider::OnURLFetchComplete(const URLFetcher* source,
                                         const GURL& url,
                                         const net::URLRequestStatus& status,
@@ -66,6 +66,7 @@ class SearchProvider : public AutocompleteProvider,
   virtual void Start(const AutocompleteInput& input,
                      bool minimal_changes);
   virtual void Stop();
+  virtual base::TimeDelta GetLatencyBudget() const;
 
   // URLFetcher::Delegate
   virtual void OnURLFetchComplete(const URLFetcher* source,
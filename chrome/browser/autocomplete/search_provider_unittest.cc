@@ -359,14 +359,16 @@ TEST_F(SearchProviderTest, FinalizeInstantQuery) {
   ASSERT_NO_FATAL_FAILURE(FinishDefaultSuggestQuery());
 
   // When instant is enabled the provider isn't done until it hears from
-  // instant.
+  // instant, and the controller mustn't stop it on a deadline meanwhile.
   EXPECT_FALSE(provider_->done());
+  EXPECT_EQ(base::TimeDelta(), provider_->GetLatencyBudget());
 
   // Tell the provider instant is done.
   provider_->FinalizeInstantQuery(ASCIIToUTF16("foo"), ASCIIToUTF16("bar"));
 
-  // The provider should now be done.
+  // The provider should now be done, and bounded again.
   EXPECT_TRUE(provider_->done());
+  EXPECT_NE(base::TimeDelta(), provider_->GetLatencyBudget());
 
   // There should be two matches, one for what you typed, the other for
   // 'foobar'.
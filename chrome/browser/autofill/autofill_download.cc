@@ -11,16 +11,30 @@
 #ifdef ANDROID
 #include "android/jni/autofill_request_url.h"
 #endif
+#include "base/file_path.h"
+#include "base/file_util.h"
 #include "base/logging.h"
+#include "base/memory/linked_ptr.h"
+#include "base/memory/singleton.h"
 #include "base/rand_util.h"
 #include "base/stl_util-inl.h"
 #include "base/string_util.h"
 #include "chrome/browser/autofill/autofill_metrics.h"
+#include "chrome/browser/autofill/autofill_query_cache.h"
 #include "chrome/browser/autofill/autofill_xml_parser.h"
 #include "chrome/browser/autofill/form_structure.h"
 #include "chrome/browser/prefs/pref_service.h"
 #include "chrome/browser/profiles/profile.h"
+#ifndef ANDROID
+#include "chrome/common/chrome_constants.h"
+#include "chrome/common/important_file_writer.h"
+#endif
 #include "chrome/common/pref_names.h"
+#ifndef ANDROID
+#include "content/browser/browser_thread.h"
+#include "content/common/notification_registrar.h"
+#include "content/common/notification_service.h"
+#endif
 #include "googleurl/src/gurl.h"
 #include "net/http/http_response_headers.h"
 #include "third_party/libjingle/source/talk/xmllite/xmlparser.h"
@@ -35,9 +49,149 @@
 #endif
 
 namespace {
-const size_t kMaxFormCacheSize = 16;
+
+const size_t kMaxFormCacheSize = 256;
+
+// How long a query response is used before the server is asked again.
+const int kQueryCacheTimeToLiveDays = 7;
+
+#ifndef ANDROID
+// The query cache of a profile, shared by all its tabs and kept in the profile
+// directory across sessions.  Lives on the UI thread until shutdown.
+class QueryCacheStore : public ImportantFileWriter::DataSerializer {
+ public:
+  explicit QueryCacheStore(const FilePath& path)
+      : cache_(kMaxFormCacheSize,
+               base::TimeDelta::FromDays(kQueryCacheTimeToLiveDays)),
+        cleared_(false),
+        writer_(path,
+                BrowserThread::GetMessageLoopProxyForThread(
+                    BrowserThread::FILE)) {
+    BrowserThread::PostTask(
+        BrowserThread::FILE, FROM_HERE,
+        NewRunnableFunction(&QueryCacheStore::Load, this, path));
+  }
+
+  AutofillQueryCache* cache() { return &cache_; }
+
+  // Saves the cache after the writer's commit interval, with any other
+  // responses received meanwhile.
+  void ScheduleSave() {
+    writer_.ScheduleWrite(this);
+  }
+
+  // Saves the cache now if a save is scheduled.
+  void SaveIfScheduled() {
+    if (writer_.HasPendingWrite())
+      writer_.DoScheduledWrite();
+  }
+
+  // Drops the cached responses, including any still being loaded, and saves
+  // the empty cache right away.
+  void Clear() {
+    cache_.Clear();
+    cleared_ = true;
+    std::string data;
+    cache_.Serialize(&data);
+    writer_.WriteNow(data);
+  }
+
+  // ImportantFileWriter::DataSerializer implementation:
+  virtual bool SerializeData(std::string* data) {
+    cache_.Serialize(data);
+    return true;
+  }
+
+ private:
+  // Reads |path| on the FILE thread and hands its contents to |store|.
+  static void Load(QueryCacheStore* store, const FilePath& path) {
+    std::string data;
+    if (!file_util::ReadFileToString(path, &data))
+      return;
+    BrowserThread::PostTask(
+        BrowserThread::UI, FROM_HERE,
+        NewRunnableMethod(store, &QueryCacheStore::OnLoaded, data));
+  }
+
+  void OnLoaded(const std::string& data) {
+    if (cleared_)
+      return;
+    // Responses received since startup are kept in front of the loaded ones.
+    cache_.Deserialize(data, base::Time::Now());
+  }
+
+  AutofillQueryCache cache_;
+
+  // Set once the cache has been cleared, so that the file contents read from
+  // before are not loaded.
+  bool cleared_;
+
+  ImportantFileWriter writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueryCacheStore);
 };
 
+// The query caches of every profile, by profile directory.  Scheduled saves
+// are done when the browser starts shutting down, while the FILE thread still
+// runs; the stores are then leaked.
+class QueryCacheStores : public NotificationObserver {
+ public:
+  static QueryCacheStores* GetInstance() {
+    return Singleton<QueryCacheStores,
+                     LeakySingletonTraits<QueryCacheStores> >::get();
+  }
+
+  QueryCacheStore* GetForProfile(Profile* profile) {
+    const FilePath& profile_path = profile->GetPath();
+    linked_ptr<QueryCacheStore>& store = stores_[profile_path];
+    if (!store.get()) {
+      store.reset(new QueryCacheStore(
+          profile_path.Append(chrome::kAutofillQueryCacheFileName)));
+    }
+    return store.get();
+  }
+
+  // NotificationObserver implementation:
+  virtual void Observe(NotificationType type,
+                       const NotificationSource& source,
+                       const NotificationDetails& details) {
+    DCHECK(type == NotificationType::APP_TERMINATING);
+    for (StoreMap::iterator i = stores_.begin(); i != stores_.end(); ++i)
+      i->second->SaveIfScheduled();
+  }
+
+ private:
+  friend struct DefaultSingletonTraits<QueryCacheStores>;
+
+  typedef std::map<FilePath, linked_ptr<QueryCacheStore> > StoreMap;
+
+  QueryCacheStores() {
+    registrar_.Add(this, NotificationType::APP_TERMINATING,
+                   NotificationService::AllSources());
+  }
+
+  StoreMap stores_;
+  NotificationRegistrar registrar_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueryCacheStores);
+};
+
+// Returns true if the query cache of |profile| can be shared and saved.  The
+// cache of an off the record profile is not saved, and unit tests run without
+// a FILE thread.
+bool CanSaveQueryCache(Profile* profile) {
+  return profile && !profile->IsOffTheRecord() &&
+      BrowserThread::IsMessageLoopValid(BrowserThread::FILE);
+}
+#endif
+
+}  // namespace
+
+#ifndef ANDROID
+// The stores are leaked, so tasks need not hold a reference to them.
+DISABLE_RUNNABLE_METHOD_REFCOUNT(QueryCacheStore);
+#endif
+
 struct AutofillDownloadManager::FormRequestData {
   std::vector<std::string> form_signatures;
   AutofillRequestType request_type;
@@ -52,12 +206,24 @@ const double kAutoFillNegativeUploadRateDefaultValue = 0.01;
 AutofillDownloadManager::AutofillDownloadManager(Profile* profile)
     : profile_(profile),
       observer_(NULL),
-      max_form_cache_size_(kMaxFormCacheSize),
+      query_cache_(NULL),
       next_query_request_(base::Time::Now()),
       next_upload_request_(base::Time::Now()),
       positive_upload_rate_(0),
       negative_upload_rate_(0),
       fetcher_id_for_unittest_(0) {
+#ifndef ANDROID
+  if (CanSaveQueryCache(profile_))
+    query_cache_ = QueryCacheStores::GetInstance()->GetForProfile(profile_)->
+        cache();
+#endif
+  if (!query_cache_) {
+    own_query_cache_.reset(new AutofillQueryCache(
+        kMaxFormCacheSize,
+        base::TimeDelta::FromDays(kQueryCacheTimeToLiveDays)));
+    query_cache_ = own_query_cache_.get();
+  }
+
   // |profile_| could be NULL in some unit-tests.
 #ifdef ANDROID
   positive_upload_rate_ = kAutoFillPositiveUploadRateDefaultValue;
@@ -78,6 +244,15 @@ AutofillDownloadManager::~AutofillDownloadManager() {
                                       url_fetchers_.end());
 }
 
+// static
+void AutofillDownloadManager::ClearQueryCache(Profile* profile) {
+#ifndef ANDROID
+  // The store is created if need be, to clear the file of an earlier session.
+  if (CanSaveQueryCache(profile))
+    QueryCacheStores::GetInstance()->GetForProfile(profile)->Clear();
+#endif
+}
+
 void AutofillDownloadManager::SetObserver(
     AutofillDownloadManager::Observer *observer) {
   if (observer) {
@@ -247,41 +422,27 @@ bool AutofillDownloadManager::StartRequest(
   return true;
 }
 
+void AutofillDownloadManager::set_max_form_cache_size(
+    size_t max_form_cache_size) {
+  query_cache_->set_max_size(max_form_cache_size);
+}
+
 void AutofillDownloadManager::CacheQueryRequest(
     const std::vector<std::string>& forms_in_query,
     const std::string& query_data) {
-  std::string signature = GetCombinedSignature(forms_in_query);
-  for (QueryRequestCache::iterator it = cached_forms_.begin();
-       it != cached_forms_.end(); ++it) {
-    if (it->first == signature) {
-      // We hit the cache, move to the first position and return.
-      std::pair<std::string, std::string> data = *it;
-      cached_forms_.erase(it);
-      cached_forms_.push_front(data);
-      return;
-    }
-  }
-  std::pair<std::string, std::string> data;
-  data.first = signature;
-  data.second = query_data;
-  cached_forms_.push_front(data);
-  while (cached_forms_.size() > max_form_cache_size_)
-    cached_forms_.pop_back();
+  query_cache_->Put(GetCombinedSignature(forms_in_query), query_data,
+                    base::Time::Now());
+#ifndef ANDROID
+  if (!own_query_cache_.get())
+    QueryCacheStores::GetInstance()->GetForProfile(profile_)->ScheduleSave();
+#endif
 }
 
 bool AutofillDownloadManager::CheckCacheForQueryRequest(
     const std::vector<std::string>& forms_in_query,
     std::string* query_data) const {
-  std::string signature = GetCombinedSignature(forms_in_query);
-  for (QueryRequestCache::const_iterator it = cached_forms_.begin();
-       it != cached_forms_.end(); ++it) {
-    if (it->first == signature) {
-      // We hit the cache, fill the data and return.
-      *query_data = it->second;
-      return true;
-    }
-  }
-  return false;
+  return query_cache_->Get(GetCombinedSignature(forms_in_query),
+                           base::Time::Now(), query_data);
 }
 
 std::string AutofillDownloadManager::GetCombinedSignature(
@@ -7,12 +7,11 @@
 #pragma once
 
 #include <stddef.h>
-#include <list>
 #include <map>
 #include <string>
-#include <utility>
 #include <vector>
 
+#include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
 #include "base/time.h"
 #include "chrome/common/net/url_fetcher.h"
@@ -22,6 +21,7 @@
 #endif
 
 class AutofillMetrics;
+class AutofillQueryCache;
 class FormStructure;
 class GURL;
 class Profile;
@@ -66,6 +66,11 @@ class AutofillDownloadManager : public URLFetcher::Delegate {
   explicit AutofillDownloadManager(Profile* profile);
   virtual ~AutofillDownloadManager();
 
+  // Drops the query responses cached for |profile|, which tell what forms were
+  // seen, along with the copy kept on disk.  Managers created for the profile
+  // before this call share the cleared cache.
+  static void ClearQueryCache(Profile* profile);
+
   // |observer| - observer to notify on successful completion or error.
   void SetObserver(AutofillDownloadManager::Observer *observer);
 
@@ -107,7 +112,6 @@ class AutofillDownloadManager : public URLFetcher::Delegate {
   friend class AutofillDownloadTestHelper;  // unit-test.
 
   struct FormRequestData;
-  typedef std::list<std::pair<std::string, std::string> > QueryRequestCache;
 
   // Initiates request to Autofill servers to download/upload heuristics.
   // |form_xml| - form structure XML to upload/download.
@@ -119,11 +123,8 @@ class AutofillDownloadManager : public URLFetcher::Delegate {
                     const FormRequestData& request_data);
 
   // Each request is page visited. We store last |max_form_cache_size|
-  // request, to avoid going over the wire. Set to 16 in constructor. Warning:
-  // the search is linear (newest first), so do not make the constant very big.
-  void set_max_form_cache_size(size_t max_form_cache_size) {
-    max_form_cache_size_ = max_form_cache_size;
-  }
+  // request, to avoid going over the wire.
+  void set_max_form_cache_size(size_t max_form_cache_size);
 
   // Caches query request. |forms_in_query| is a vector of form signatures in
   // the query. |query_data| is the successful data returned over the wire.
@@ -154,9 +155,10 @@ class AutofillDownloadManager : public URLFetcher::Delegate {
   std::map<URLFetcher*, FormRequestData> url_fetchers_;
   AutofillDownloadManager::Observer *observer_;
 
-  // Cached QUERY requests.
-  QueryRequestCache cached_forms_;
-  size_t max_form_cache_size_;
+  // Cached QUERY requests.  Shared by the tabs of |profile_| and kept across
+  // sessions when possible, otherwise owned by |own_query_cache_|.
+  AutofillQueryCache* query_cache_;
+  scoped_ptr<AutofillQueryCache> own_query_cache_;
 
   // Time when next query/upload requests are allowed. If 50x HTTP received,
   // exponential back off is initiated, so this times will be in the future
@@ -72,3 +72,12 @@ std::string AutofillField::FieldSignature() const {
 bool AutofillField::IsFieldFillable() const {
   return type() != UNKNOWN_TYPE;
 }
+
+std::vector<uint8>* AutofillField::GetHeuristicMatches() {
+  if (label != matched_label_ || name != matched_name_) {
+    heuristic_matches_.clear();
+    matched_label_ = label;
+    matched_name_ = name;
+  }
+  return &heuristic_matches_;
+}
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/string16.h"
@@ -48,6 +49,11 @@ class AutofillField : public webkit_glue::FormField {
   // field).
   bool IsFieldFillable() const;
 
+  // Returns the results of matching the heuristic patterns against the label
+  // and name, which FormField keeps by pattern id.  Results from before the
+  // label or name last changed are dropped.
+  std::vector<uint8>* GetHeuristicMatches();
+
  private:
   // The unique name of this field, generated by Autofill.
   string16 unique_name_;
@@ -61,6 +67,12 @@ class AutofillField : public webkit_glue::FormField {
   // The set of possible types for this field.
   FieldTypeSet possible_types_;
 
+  // The results of matching the heuristic patterns, and the label and name
+  // they were matched against.
+  std::vector<uint8> heuristic_matches_;
+  string16 matched_label_;
+  string16 matched_name_;
+
   DISALLOW_COPY_AND_ASSIGN(AutofillField);
 };
 
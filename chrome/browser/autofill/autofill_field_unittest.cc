@@ -90,4 +90,18 @@ TEST(AutofillFieldTest, IsFieldFillable) {
   EXPECT_TRUE(field.IsFieldFillable());
 }
 
+TEST(AutofillFieldTest, GetHeuristicMatches) {
+  AutofillField field;
+  field.label = ASCIIToUTF16("Email");
+  field.GetHeuristicMatches()->push_back(1);
+  EXPECT_EQ(1U, field.GetHeuristicMatches()->size());
+
+  // Changing the label or the name drops the results.
+  field.label = ASCIIToUTF16("Phone");
+  EXPECT_TRUE(field.GetHeuristicMatches()->empty());
+  field.GetHeuristicMatches()->push_back(1);
+  field.name = ASCIIToUTF16("phone");
+  EXPECT_TRUE(field.GetHeuristicMatches()->empty());
+}
+
 }  // namespace
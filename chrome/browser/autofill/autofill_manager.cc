@@ -22,6 +22,7 @@
 #include "chrome/browser/autofill/autofill_field.h"
 #include "chrome/browser/autofill/autofill_metrics.h"
 #include "chrome/browser/autofill/autofill_profile.h"
+#include "chrome/browser/autofill/autofill_suggestion_index.h"
 #include "chrome/browser/autofill/autofill_type.h"
 #include "chrome/browser/autofill/credit_card.h"
 #include "chrome/browser/autofill/form_structure.h"
@@ -842,27 +843,29 @@ void AutofillManager::GetProfileSuggestions(FormStructure* form,
                                             std::vector<string16>* labels,
                                             std::vector<string16>* icons,
                                             std::vector<int>* unique_ids) {
+  // The index must be built from the same snapshot of the profiles, as getting
+  // them again may reload them.
   const std::vector<AutofillProfile*>& profiles = personal_data_->profiles();
+  const AutofillSuggestionIndex& index =
+      personal_data_->GetProfileIndex(profiles, type);
+  std::vector<AutofillSuggestionIndex::Location> locations;
   if (!field.is_autofilled) {
+    index.FindPrefix(field.value, &locations);
+
     std::vector<AutofillProfile*> matched_profiles;
-    for (std::vector<AutofillProfile*>::const_iterator iter = profiles.begin();
-         iter != profiles.end(); ++iter) {
-      AutofillProfile* profile = *iter;
+    std::vector<string16> multi_values;
+    for (size_t i = 0; i < locations.size(); ++i) {
+      // Suggest the first matching value of each profile.
+      if (i > 0 && locations[i].first == locations[i - 1].first)
+        continue;
 
-      // The value of the stored data for this field type in the |profile|.
-      std::vector<string16> multi_values;
+      AutofillProfile* profile = profiles[locations[i].first];
+      const size_t variant = locations[i].second;
       profile->GetMultiInfo(type, &multi_values);
-
-      for (size_t i = 0; i < multi_values.size(); ++i) {
-        if (!multi_values[i].empty() &&
-            StartsWith(multi_values[i], field.value, false)) {
-          matched_profiles.push_back(profile);
-          values->push_back(multi_values[i]);
-          unique_ids->push_back(PackGUIDs(GUIDPair(std::string(), 0),
-                                          GUIDPair(profile->guid(), i)));
-          break;
-        }
-      }
+      matched_profiles.push_back(profile);
+      values->push_back(multi_values[variant]);
+      unique_ids->push_back(PackGUIDs(GUIDPair(std::string(), 0),
+                                      GUIDPair(profile->guid(), variant)));
     }
 
     std::vector<AutofillFieldType> form_fields;
@@ -882,27 +885,21 @@ void AutofillManager::GetProfileSuggestions(FormStructure* form,
     // No icons for profile suggestions.
     icons->resize(values->size());
   } else {
-    for (std::vector<AutofillProfile*>::const_iterator iter = profiles.begin();
-         iter != profiles.end(); ++iter) {
-      AutofillProfile* profile = *iter;
+    index.FindEqual(field.value, &locations);
 
-      // The value of the stored data for this field type in the |profile|.
-      std::vector<string16> multi_values;
-      profile->GetMultiInfo(type, &multi_values);
+    std::vector<string16> multi_values;
+    for (size_t i = 0; i < locations.size(); ++i) {
+      // Add all the values of each matching profile once.
+      if (i > 0 && locations[i].first == locations[i - 1].first)
+        continue;
 
-      for (size_t i = 0; i < multi_values.size(); ++i) {
-        if (!multi_values[i].empty() &&
-            StringToLowerASCII(multi_values[i])
-                == StringToLowerASCII(field.value)) {
-          for (size_t j = 0; j < multi_values.size(); ++j) {
-            if (!multi_values[j].empty()) {
-              values->push_back(multi_values[j]);
-              unique_ids->push_back(PackGUIDs(GUIDPair(std::string(), 0),
-                                              GUIDPair(profile->guid(), j)));
-            }
-          }
-          // We've added all the values for this profile so move on to the next.
-          break;
+      AutofillProfile* profile = profiles[locations[i].first];
+      profile->GetMultiInfo(type, &multi_values);
+      for (size_t j = 0; j < multi_values.size(); ++j) {
+        if (!multi_values[j].empty()) {
+          values->push_back(multi_values[j]);
+          unique_ids->push_back(PackGUIDs(GUIDPair(std::string(), 0),
+                                          GUIDPair(profile->guid(), j)));
         }
       }
     }
@@ -922,33 +919,32 @@ void AutofillManager::GetCreditCardSuggestions(FormStructure* form,
                                                std::vector<string16>* labels,
                                                std::vector<string16>* icons,
                                                std::vector<int>* unique_ids) {
-  for (std::vector<CreditCard*>::const_iterator iter =
-           personal_data_->credit_cards().begin();
-       iter != personal_data_->credit_cards().end(); ++iter) {
-    CreditCard* credit_card = *iter;
+  std::vector<AutofillSuggestionIndex::Location> locations;
+  personal_data_->GetCreditCardIndex(type).FindPrefix(field.value, &locations);
+  const std::vector<CreditCard*>& credit_cards =
+      personal_data_->credit_cards();
+  for (size_t i = 0; i < locations.size(); ++i) {
+    CreditCard* credit_card = credit_cards[locations[i].first];
 
     // The value of the stored data for this field type in the |credit_card|.
     string16 creditcard_field_value = credit_card->GetInfo(type);
-    if (!creditcard_field_value.empty() &&
-        StartsWith(creditcard_field_value, field.value, false)) {
-      if (type == CREDIT_CARD_NUMBER)
-        creditcard_field_value = credit_card->ObfuscatedNumber();
-
-      string16 label;
-      if (credit_card->number().empty()) {
-        // If there is no CC number, return name to show something.
-        label = credit_card->GetInfo(CREDIT_CARD_NAME);
-      } else {
-        label = kCreditCardPrefix;
-        label.append(credit_card->LastFourDigits());
-      }
+    if (type == CREDIT_CARD_NUMBER)
+      creditcard_field_value = credit_card->ObfuscatedNumber();
 
-      values->push_back(creditcard_field_value);
-      labels->push_back(label);
-      icons->push_back(UTF8ToUTF16(credit_card->type()));
-      unique_ids->push_back(PackGUIDs(GUIDPair(credit_card->guid(), 0),
-                                      GUIDPair(std::string(), 0)));
+    string16 label;
+    if (credit_card->number().empty()) {
+      // If there is no CC number, return name to show something.
+      label = credit_card->GetInfo(CREDIT_CARD_NAME);
+    } else {
+      label = kCreditCardPrefix;
+      label.append(credit_card->LastFourDigits());
     }
+
+    values->push_back(creditcard_field_value);
+    labels->push_back(label);
+    icons->push_back(UTF8ToUTF16(credit_card->type()));
+    unique_ids->push_back(PackGUIDs(GUIDPair(credit_card->guid(), 0),
+                                    GUIDPair(std::string(), 0)));
   }
 }
 
@@ -70,18 +70,22 @@ class TestPersonalDataManager : public PersonalDataManager {
   }
 
   void AddProfile(AutofillProfile* profile) {
+    ClearSuggestionIndexes();
     web_profiles_->push_back(profile);
   }
 
   void AddCreditCard(CreditCard* credit_card) {
+    ClearSuggestionIndexes();
     credit_cards_->push_back(credit_card);
   }
 
   void ClearAutofillProfiles() {
+    ClearSuggestionIndexes();
     web_profiles_.reset();
   }
 
   void ClearCreditCards() {
+    ClearSuggestionIndexes();
     credit_cards_.reset();
   }
 
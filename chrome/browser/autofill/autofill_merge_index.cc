@@ -0,0 +1,184 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/autofill/autofill_merge_index.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "chrome/browser/autofill/autofill_profile.h"
+
+AutofillMergeIndex::AutofillMergeIndex() {
+}
+
+AutofillMergeIndex::~AutofillMergeIndex() {
+}
+
+void AutofillMergeIndex::AddProfile(const AutofillProfile& profile,
+                                    size_t position) {
+  FieldTypeSet types;
+  profile.GetAvailableFieldTypes(&types);
+  if (profile_types_.size() <= position)
+    profile_types_.resize(position + 1);
+  profile_types_[position] = types;
+  ++type_set_counts_[types];
+
+  // Keep the positions of each key in increasing order, as a merged profile
+  // is added back in the middle of the list.
+  for (FieldTypeSet::const_iterator iter = types.begin(); iter != types.end();
+       ++iter) {
+    std::vector<size_t>& positions =
+        values_[*iter][StringToLowerASCII(profile.GetInfo(*iter))];
+    positions.insert(
+        std::lower_bound(positions.begin(), positions.end(), position),
+        position);
+  }
+
+  const string16 primary_value = StringToLowerASCII(profile.PrimaryValue());
+  if (!primary_value.empty()) {
+    std::vector<size_t>& positions = primary_values_[primary_value];
+    positions.insert(
+        std::lower_bound(positions.begin(), positions.end(), position),
+        position);
+  }
+}
+
+void AutofillMergeIndex::RemoveProfile(const AutofillProfile& profile,
+                                       size_t position) {
+  FieldTypeSet types;
+  profile.GetAvailableFieldTypes(&types);
+  DCHECK_LT(position, profile_types_.size());
+  DCHECK(profile_types_[position] == types);
+  profile_types_[position].clear();
+  std::map<FieldTypeSet, int>::iterator count = type_set_counts_.find(types);
+  if (count != type_set_counts_.end() && --count->second == 0)
+    type_set_counts_.erase(count);
+
+  for (FieldTypeSet::const_iterator iter = types.begin(); iter != types.end();
+       ++iter) {
+    RemovePosition(StringToLowerASCII(profile.GetInfo(*iter)), position,
+                   &values_[*iter]);
+  }
+
+  const string16 primary_value = StringToLowerASCII(profile.PrimaryValue());
+  if (!primary_value.empty())
+    RemovePosition(primary_value, position, &primary_values_);
+}
+
+AutofillMergeIndex::MergeResult AutofillMergeIndex::MergeProfile(
+    const AutofillProfile& profile,
+    const std::vector<AutofillProfile*>& profiles,
+    size_t* position) {
+  DCHECK(position);
+
+  std::vector<size_t> candidates;
+  FindCandidates(profile, &candidates);
+  for (std::vector<size_t>::const_iterator iter = candidates.begin();
+       iter != candidates.end(); ++iter) {
+    DCHECK_LT(*iter, profiles.size());
+    AutofillProfile* existing = profiles[*iter];
+    if (profile.IsSubsetOf(*existing)) {
+      *position = *iter;
+      return CONTAINED;
+    }
+    if (existing->IntersectionOfTypesHasEqualValues(profile)) {
+      RemoveProfile(*existing, *iter);
+      existing->MergeWith(profile);
+      AddProfile(*existing, *iter);
+      *position = *iter;
+      return MERGED;
+    }
+  }
+
+  const string16 primary_value = StringToLowerASCII(profile.PrimaryValue());
+  if (!primary_value.empty()) {
+    ValueMap::const_iterator iter = primary_values_.find(primary_value);
+    if (iter != primary_values_.end() && !iter->second.empty()) {
+      *position = iter->second.front();
+      DCHECK_LT(*position, profiles.size());
+      AutofillProfile* existing = profiles[*position];
+      RemoveProfile(*existing, *position);
+      existing->OverwriteWithOrAddTo(profile);
+      AddProfile(*existing, *position);
+      return MERGED;
+    }
+  }
+
+  *position = profiles.size();
+  return ADDED;
+}
+
+void AutofillMergeIndex::FindCandidates(
+    const AutofillProfile& profile,
+    std::vector<size_t>* positions) const {
+  positions->clear();
+
+  // The positions of each value of |profile|, or NULL if no profile has it.
+  FieldTypeSet types;
+  profile.GetAvailableFieldTypes(&types);
+  std::map<AutofillFieldType, const std::vector<size_t>*> matches;
+  for (FieldTypeSet::const_iterator iter = types.begin(); iter != types.end();
+       ++iter) {
+    const std::vector<size_t>* type_matches = NULL;
+    TypeMap::const_iterator type_iter = values_.find(*iter);
+    if (type_iter != values_.end()) {
+      ValueMap::const_iterator value_iter =
+          type_iter->second.find(StringToLowerASCII(profile.GetInfo(*iter)));
+      if (value_iter != type_iter->second.end())
+        type_matches = &value_iter->second;
+    }
+    matches[*iter] = type_matches;
+  }
+
+  for (std::map<FieldTypeSet, int>::const_iterator set_iter =
+           type_set_counts_.begin();
+       set_iter != type_set_counts_.end(); ++set_iter) {
+    const FieldTypeSet& set_types = set_iter->first;
+
+    // Find the rarest value among the types |profile| shares with this set.
+    // A profile without one of these values can't be a candidate.
+    const std::vector<size_t>* rarest = NULL;
+    bool missing_value = false;
+    for (FieldTypeSet::const_iterator iter = types.begin();
+         iter != types.end(); ++iter) {
+      if (!set_types.count(*iter))
+        continue;
+      const std::vector<size_t>* type_matches = matches[*iter];
+      if (!type_matches) {
+        missing_value = true;
+        break;
+      }
+      if (!rarest || type_matches->size() < rarest->size())
+        rarest = type_matches;
+    }
+    if (missing_value || !rarest)
+      continue;
+
+    for (std::vector<size_t>::const_iterator iter = rarest->begin();
+         iter != rarest->end(); ++iter) {
+      if (profile_types_[*iter] == set_types)
+        positions->push_back(*iter);
+    }
+  }
+
+  std::sort(positions->begin(), positions->end());
+}
+
+// static
+void AutofillMergeIndex::RemovePosition(const string16& key,
+                                        size_t position,
+                                        ValueMap* values) {
+  ValueMap::iterator iter = values->find(key);
+  if (iter == values->end())
+    return;
+
+  std::vector<size_t>& positions = iter->second;
+  std::vector<size_t>::iterator found =
+      std::lower_bound(positions.begin(), positions.end(), position);
+  if (found != positions.end() && *found == position)
+    positions.erase(found);
+  if (positions.empty())
+    values->erase(iter);
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_AUTOFILL_AUTOFILL_MERGE_INDEX_H_
+#define CHROME_BROWSER_AUTOFILL_AUTOFILL_MERGE_INDEX_H_
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/string16.h"
+#include "chrome/browser/autofill/field_types.h"
+
+class AutofillProfile;
+
+// An index of the values of a list of profiles, for finding the profile an
+// imported profile merges into without comparing it with every profile.
+// Values are keyed by field type and lower-cased value, which is how
+// FormGroup::IsSubsetOf() and FormGroup::IntersectionOfTypesHasEqualValues()
+// compare them.
+class AutofillMergeIndex {
+ public:
+  enum MergeResult {
+    // The profile at the merge position already holds all of the data.
+    CONTAINED,
+    // The data was merged into the profile at the merge position.
+    MERGED,
+    // No profile can take the data.  The merge position is the end of the
+    // list, where the caller should append it and call AddProfile().
+    ADDED,
+  };
+
+  AutofillMergeIndex();
+  ~AutofillMergeIndex();
+
+  // Indexes the values of |profile|, at |position| in the list of profiles.
+  void AddProfile(const AutofillProfile& profile, size_t position);
+
+  // Removes the values of |profile| at |position|, which must be the values it
+  // had when it was added.
+  void RemoveProfile(const AutofillProfile& profile, size_t position);
+
+  // Merges |profile| into |profiles|, which must be the list the index was
+  // built from, with the same preferences as
+  // PersonalDataManager::MergeProfile(): first into the first profile that
+  // contains |profile| or has equal values for the types both have, then into
+  // the first profile with the same primary value.  The changed profile is
+  // re-indexed.  Sets |position| to the merge position.
+  MergeResult MergeProfile(const AutofillProfile& profile,
+                           const std::vector<AutofillProfile*>& profiles,
+                           size_t* position);
+
+ private:
+  typedef base::hash_map<string16, std::vector<size_t> > ValueMap;
+  typedef std::map<AutofillFieldType, ValueMap> TypeMap;
+
+  // Fills |positions| with the profiles that can contain |profile| or have
+  // equal values for the types both have, in increasing order.  Such a
+  // profile has the value of |profile| for every type of |profile| it has, so
+  // for each set of types in use only the profiles with the rarest of these
+  // values are looked at.
+  void FindCandidates(const AutofillProfile& profile,
+                      std::vector<size_t>* positions) const;
+
+  // Removes |position| from the positions of |key| in |values|.
+  static void RemovePosition(const string16& key, size_t position,
+                             ValueMap* values);
+
+  // The positions of each lower-cased value, by field type.
+  TypeMap values_;
+
+  // The available field types of each indexed profile, by position, and how
+  // many profiles have each set of types.
+  std::vector<FieldTypeSet> profile_types_;
+  std::map<FieldTypeSet, int> type_set_counts_;
+
+  // The positions of each non-empty, lower-cased primary value.
+  ValueMap primary_values_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutofillMergeIndex);
+};
+
+#endif  // CHROME_BROWSER_AUTOFILL_AUTOFILL_MERGE_INDEX_H_
@@ -0,0 +1,133 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/memory/scoped_vector.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/autofill/autofill_common_test.h"
+#include "chrome/browser/autofill/autofill_merge_index.h"
+#include "chrome/browser/autofill/autofill_profile.h"
+#include "chrome/browser/autofill/personal_data_manager.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+class AutofillMergeIndexTest : public testing::Test {
+ protected:
+  // Appends a profile to |profiles_| and indexes it.
+  void AddProfile(const char* first_name, const char* last_name,
+                  const char* email, const char* address1, const char* city) {
+    AutofillProfile* profile = new AutofillProfile;
+    autofill_test::SetProfileInfo(profile, first_name, "", last_name, email,
+                                  "", address1, "", city, "", "", "", "", "");
+    index_.AddProfile(*profile, profiles_.size());
+    profiles_.push_back(profile);
+  }
+
+  // Merges |profile| through the index, and checks that the result is the
+  // one PersonalDataManager::MergeProfile() gives.
+  AutofillMergeIndex::MergeResult Merge(const AutofillProfile& profile,
+                                        size_t* position) {
+    std::vector<AutofillProfile> expected;
+    ScopedVector<AutofillProfile> copies;
+    for (size_t i = 0; i < profiles_.size(); ++i)
+      copies.push_back(new AutofillProfile(*profiles_[i]));
+    PersonalDataManager::MergeProfile(profile, copies.get(), &expected);
+
+    AutofillMergeIndex::MergeResult result =
+        index_.MergeProfile(profile, profiles_.get(), position);
+    if (result == AutofillMergeIndex::ADDED)
+      profiles_.push_back(new AutofillProfile(profile));
+
+    EXPECT_EQ(expected.size(), profiles_.size());
+    for (size_t i = 0; i < expected.size() && i < profiles_.size(); ++i)
+      EXPECT_EQ(0, expected[i].CompareMulti(*profiles_[i])) << i;
+    return result;
+  }
+
+  AutofillMergeIndex index_;
+  ScopedVector<AutofillProfile> profiles_;
+};
+
+TEST_F(AutofillMergeIndexTest, Contained) {
+  AddProfile("Elvis", "Presley", "elvis@example.com", "3734 Elvis Presley Blvd",
+             "Memphis");
+  AddProfile("John", "Smith", "john@example.com", "1 Main St", "Springfield");
+
+  AutofillProfile profile;
+  autofill_test::SetProfileInfo(&profile, "JOHN", "", "Smith", NULL, NULL,
+                                "1 Main St", NULL, NULL, NULL, NULL, NULL,
+                                NULL, NULL);
+  size_t position = 0;
+  EXPECT_EQ(AutofillMergeIndex::CONTAINED, Merge(profile, &position));
+  EXPECT_EQ(1U, position);
+}
+
+TEST_F(AutofillMergeIndexTest, MergesIntoFirstWithEqualValues) {
+  // Shares the last name, but the first name conflicts.
+  AddProfile("Jane", "Smith", "", "1 Main St", "Springfield");
+  AddProfile("John", "Smith", "", "1 Main St", "Springfield");
+
+  AutofillProfile profile;
+  autofill_test::SetProfileInfo(&profile, "John", "", "Smith",
+                                "john@example.com", NULL, "1 Main St", NULL,
+                                "Springfield", NULL, NULL, NULL, NULL, NULL);
+  size_t position = 0;
+  EXPECT_EQ(AutofillMergeIndex::MERGED, Merge(profile, &position));
+  EXPECT_EQ(1U, position);
+
+  // The merged email address is indexed.
+  AutofillProfile email_only;
+  autofill_test::SetProfileInfo(&email_only, NULL, NULL, NULL,
+                                "JOHN@example.com", NULL, NULL, NULL, NULL,
+                                NULL, NULL, NULL, NULL, NULL);
+  EXPECT_EQ(AutofillMergeIndex::CONTAINED, Merge(email_only, &position));
+  EXPECT_EQ(1U, position);
+}
+
+TEST_F(AutofillMergeIndexTest, MergesIntoProfileWithFewerTypes) {
+  AddProfile("Jane", "Smith", "", "1 Main St", "Springfield");
+  AddProfile("John", "Smith", "john@example.com", "", "");
+
+  AutofillProfile profile;
+  autofill_test::SetProfileInfo(&profile, "John", "", "Smith",
+                                "john@example.com", NULL, "2 Oak Ave", NULL,
+                                "Springfield", NULL, NULL, NULL, NULL, NULL);
+  size_t position = 0;
+  EXPECT_EQ(AutofillMergeIndex::MERGED, Merge(profile, &position));
+  EXPECT_EQ(1U, position);
+}
+
+TEST_F(AutofillMergeIndexTest, MergesByPrimaryValue) {
+  AddProfile("Elvis", "Presley", "", "3734 Elvis Presley Blvd", "Memphis");
+
+  // Another name at the same address.
+  AutofillProfile profile;
+  autofill_test::SetProfileInfo(&profile, "Priscilla", "", "Presley", NULL,
+                                NULL, "3734 ELVIS PRESLEY BLVD", NULL,
+                                "Memphis", NULL, NULL, NULL, NULL, NULL);
+  size_t position = 0;
+  EXPECT_EQ(AutofillMergeIndex::MERGED, Merge(profile, &position));
+  EXPECT_EQ(0U, position);
+}
+
+TEST_F(AutofillMergeIndexTest, Added) {
+  AddProfile("Elvis", "Presley", "", "3734 Elvis Presley Blvd", "Memphis");
+
+  AutofillProfile profile;
+  autofill_test::SetProfileInfo(&profile, "John", "", "Smith", NULL, NULL,
+                                "1 Main St", NULL, "Springfield", NULL, NULL,
+                                NULL, NULL, NULL);
+  size_t position = 0;
+  EXPECT_EQ(AutofillMergeIndex::ADDED, Merge(profile, &position));
+  EXPECT_EQ(1U, position);
+
+  // The caller indexes the added profile.
+  index_.AddProfile(*profiles_[1], 1);
+  EXPECT_EQ(AutofillMergeIndex::CONTAINED, Merge(profile, &position));
+  EXPECT_EQ(1U, position);
+}
+
+}  // namespace
@@ -74,6 +74,7 @@ class TestPersonalDataManager : public PersonalDataManager {
   // Adds |profile| to |web_profiles_| and takes ownership of the profile's
   // memory.
   virtual void AddProfile(AutofillProfile* profile) {
+    ClearSuggestionIndexes();
     web_profiles_.push_back(profile);
   }
 
@@ -0,0 +1,127 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/autofill/autofill_query_cache.h"
+
+#include "base/logging.h"
+#include "base/pickle.h"
+
+namespace {
+
+// Bump when the serialization changes; older data is then ignored.
+const int kSerializationVersion = 1;
+
+// Returns true if a response received at |time| has expired at |now|.  A
+// response from the future is treated as expired, in case the clock was
+// turned back.
+bool IsExpired(base::Time time, base::Time now, base::TimeDelta time_to_live) {
+  return time > now || now - time >= time_to_live;
+}
+
+}  // namespace
+
+AutofillQueryCache::AutofillQueryCache(size_t max_size,
+                                       base::TimeDelta time_to_live)
+    : max_size_(max_size),
+      time_to_live_(time_to_live) {
+}
+
+AutofillQueryCache::~AutofillQueryCache() {
+}
+
+bool AutofillQueryCache::Get(const std::string& signature,
+                             base::Time now,
+                             std::string* response) {
+  EntryMap::iterator iter = index_.find(signature);
+  if (iter == index_.end())
+    return false;
+
+  if (IsExpired(iter->second->time, now, time_to_live_)) {
+    entries_.erase(iter->second);
+    index_.erase(iter);
+    return false;
+  }
+
+  entries_.splice(entries_.begin(), entries_, iter->second);
+  *response = iter->second->response;
+  return true;
+}
+
+void AutofillQueryCache::Put(const std::string& signature,
+                             const std::string& response,
+                             base::Time now) {
+  EntryMap::iterator iter = index_.find(signature);
+  if (iter != index_.end()) {
+    entries_.erase(iter->second);
+    index_.erase(iter);
+  }
+
+  Entry entry;
+  entry.signature = signature;
+  entry.response = response;
+  entry.time = now;
+  entries_.push_front(entry);
+  index_[signature] = entries_.begin();
+  Trim();
+}
+
+void AutofillQueryCache::Serialize(std::string* data) const {
+  Pickle pickle;
+  pickle.WriteInt(kSerializationVersion);
+  pickle.WriteSize(entries_.size());
+  for (EntryList::const_iterator iter = entries_.begin();
+       iter != entries_.end(); ++iter) {
+    pickle.WriteString(iter->signature);
+    pickle.WriteString(iter->response);
+    pickle.WriteInt64(iter->time.ToInternalValue());
+  }
+  data->assign(static_cast<const char*>(pickle.data()), pickle.size());
+}
+
+bool AutofillQueryCache::Deserialize(const std::string& data,
+                                     base::Time now) {
+  Pickle pickle(data.data(), static_cast<int>(data.size()));
+  void* iter = NULL;
+  int version = 0;
+  size_t count = 0;
+  if (!pickle.ReadInt(&iter, &version) ||
+      version != kSerializationVersion ||
+      !pickle.ReadSize(&iter, &count))
+    return false;
+
+  for (size_t i = 0; i < count && entries_.size() < max_size_; ++i) {
+    Entry entry;
+    int64 time = 0;
+    if (!pickle.ReadString(&iter, &entry.signature) ||
+        !pickle.ReadString(&iter, &entry.response) ||
+        !pickle.ReadInt64(&iter, &time))
+      return false;
+
+    entry.time = base::Time::FromInternalValue(time);
+    if (IsExpired(entry.time, now, time_to_live_) ||
+        index_.find(entry.signature) != index_.end())
+      continue;
+
+    entries_.push_back(entry);
+    index_[entry.signature] = --entries_.end();
+  }
+  return true;
+}
+
+void AutofillQueryCache::Clear() {
+  entries_.clear();
+  index_.clear();
+}
+
+void AutofillQueryCache::set_max_size(size_t max_size) {
+  max_size_ = max_size;
+  Trim();
+}
+
+void AutofillQueryCache::Trim() {
+  while (entries_.size() > max_size_) {
+    index_.erase(entries_.back().signature);
+    entries_.pop_back();
+  }
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_AUTOFILL_AUTOFILL_QUERY_CACHE_H_
+#define CHROME_BROWSER_AUTOFILL_AUTOFILL_QUERY_CACHE_H_
+#pragma once
+
+#include <list>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/time.h"
+
+// A cache of Autofill server query responses, keyed by the combined signature
+// of the forms in the query.  Holds at most |max_size| responses, dropping the
+// least recently used, and no response older than |time_to_live|.  Can be
+// serialized to be kept across sessions.
+class AutofillQueryCache {
+ public:
+  AutofillQueryCache(size_t max_size, base::TimeDelta time_to_live);
+  ~AutofillQueryCache();
+
+  // Returns true and fills |response| if a response for |signature| is cached
+  // and has not expired at |now|.  The response becomes the most recently
+  // used.
+  bool Get(const std::string& signature, base::Time now,
+           std::string* response);
+
+  // Caches |response|, received at |now|, for |signature|, replacing any
+  // earlier response.
+  void Put(const std::string& signature, const std::string& response,
+           base::Time now);
+
+  // Serializes the cached responses into |data|.
+  void Serialize(std::string* data) const;
+
+  // Adds the responses serialized in |data| that have not expired at |now|,
+  // as less recently used than the ones already cached.  Returns false if
+  // |data| is not a serialized cache.
+  bool Deserialize(const std::string& data, base::Time now);
+
+  // Drops every cached response.
+  void Clear();
+
+  size_t size() const { return entries_.size(); }
+
+  void set_max_size(size_t max_size);
+
+ private:
+  struct Entry {
+    std::string signature;
+    std::string response;
+    base::Time time;
+  };
+
+  // Most recently used first.
+  typedef std::list<Entry> EntryList;
+  typedef base::hash_map<std::string, EntryList::iterator> EntryMap;
+
+  // Drops the least recently used entries above |max_size_|.
+  void Trim();
+
+  size_t max_size_;
+  const base::TimeDelta time_to_live_;
+
+  EntryList entries_;
+  EntryMap index_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutofillQueryCache);
+};
+
+#endif  // CHROME_BROWSER_AUTOFILL_AUTOFILL_QUERY_CACHE_H_
@@ -0,0 +1,138 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/time.h"
+#include "chrome/browser/autofill/autofill_query_cache.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kTimeToLiveDays = 7;
+
+class AutofillQueryCacheTest : public testing::Test {
+ protected:
+  AutofillQueryCacheTest()
+      : now_(base::Time::Now()),
+        cache_(3, base::TimeDelta::FromDays(kTimeToLiveDays)) {
+  }
+
+  bool Has(AutofillQueryCache* cache, const std::string& signature) {
+    std::string response;
+    return cache->Get(signature, now_, &response);
+  }
+
+  base::Time now_;
+  AutofillQueryCache cache_;
+};
+
+TEST_F(AutofillQueryCacheTest, GetAndPut) {
+  std::string response;
+  EXPECT_FALSE(cache_.Get("1", now_, &response));
+
+  cache_.Put("1", "response 1", now_);
+  EXPECT_TRUE(cache_.Get("1", now_, &response));
+  EXPECT_EQ("response 1", response);
+
+  // A new response replaces the cached one.
+  cache_.Put("1", "response 1b", now_);
+  EXPECT_TRUE(cache_.Get("1", now_, &response));
+  EXPECT_EQ("response 1b", response);
+  EXPECT_EQ(1U, cache_.size());
+}
+
+TEST_F(AutofillQueryCacheTest, DropsLeastRecentlyUsed) {
+  cache_.Put("1", "response 1", now_);
+  cache_.Put("2", "response 2", now_);
+  cache_.Put("3", "response 3", now_);
+
+  // Using "1" makes "2" the least recently used.
+  EXPECT_TRUE(Has(&cache_, "1"));
+  cache_.Put("4", "response 4", now_);
+  EXPECT_EQ(3U, cache_.size());
+  EXPECT_FALSE(Has(&cache_, "2"));
+  EXPECT_TRUE(Has(&cache_, "1"));
+  EXPECT_TRUE(Has(&cache_, "3"));
+  EXPECT_TRUE(Has(&cache_, "4"));
+
+  // "1" is now the least recently used.
+  cache_.set_max_size(2);
+  EXPECT_FALSE(Has(&cache_, "1"));
+  EXPECT_TRUE(Has(&cache_, "3"));
+  EXPECT_TRUE(Has(&cache_, "4"));
+}
+
+TEST_F(AutofillQueryCacheTest, Expires) {
+  cache_.Put("1", "response 1", now_);
+  cache_.Put("2", "response 2", now_ + base::TimeDelta::FromDays(1));
+
+  std::string response;
+  base::Time later = now_ + base::TimeDelta::FromDays(kTimeToLiveDays);
+  EXPECT_FALSE(cache_.Get("1", later, &response));
+  EXPECT_TRUE(cache_.Get("2", later, &response));
+  EXPECT_EQ(1U, cache_.size());
+
+  // A response from the future, after the clock was turned back.
+  EXPECT_FALSE(cache_.Get("2", now_, &response));
+  EXPECT_EQ(0U, cache_.size());
+}
+
+TEST_F(AutofillQueryCacheTest, Serialize) {
+  cache_.Put("1", "response 1", now_ - base::TimeDelta::FromDays(8));
+  cache_.Put("2", "response 2", now_ - base::TimeDelta::FromDays(1));
+  cache_.Put("3", "response 3", now_);
+  std::string data;
+  cache_.Serialize(&data);
+
+  // Expired responses are not loaded, and responses received before loading
+  // are kept and stay the most recently used.
+  AutofillQueryCache loaded(3, base::TimeDelta::FromDays(kTimeToLiveDays));
+  loaded.Put("3", "response 3b", now_);
+  loaded.Put("4", "response 4", now_);
+  EXPECT_TRUE(loaded.Deserialize(data, now_));
+  EXPECT_EQ(3U, loaded.size());
+
+  std::string response;
+  EXPECT_FALSE(loaded.Get("1", now_, &response));
+  EXPECT_TRUE(loaded.Get("2", now_, &response));
+  EXPECT_EQ("response 2", response);
+  EXPECT_TRUE(loaded.Get("3", now_, &response));
+  EXPECT_EQ("response 3b", response);
+  EXPECT_TRUE(loaded.Get("4", now_, &response));
+  EXPECT_EQ("response 4", response);
+}
+
+TEST_F(AutofillQueryCacheTest, Clear) {
+  cache_.Put("1", "response 1", now_);
+  cache_.Put("2", "response 2", now_);
+  cache_.Clear();
+  EXPECT_EQ(0U, cache_.size());
+  EXPECT_FALSE(Has(&cache_, "1"));
+
+  // Nothing is left to serialize either.
+  std::string data;
+  cache_.Serialize(&data);
+  AutofillQueryCache loaded(3, base::TimeDelta::FromDays(kTimeToLiveDays));
+  EXPECT_TRUE(loaded.Deserialize(data, now_));
+  EXPECT_EQ(0U, loaded.size());
+
+  cache_.Put("3", "response 3", now_);
+  EXPECT_TRUE(Has(&cache_, "3"));
+}
+
+TEST_F(AutofillQueryCacheTest, DeserializeCorruptData) {
+  cache_.Put("1", "response 1", now_);
+  std::string data;
+  cache_.Serialize(&data);
+
+  AutofillQueryCache loaded(3, base::TimeDelta::FromDays(kTimeToLiveDays));
+  EXPECT_FALSE(loaded.Deserialize(std::string(), now_));
+  EXPECT_FALSE(loaded.Deserialize("not a cache", now_));
+  EXPECT_FALSE(loaded.Deserialize(data.substr(0, data.size() - 4), now_));
+  EXPECT_TRUE(loaded.Deserialize(data, now_));
+  EXPECT_TRUE(Has(&loaded, "1"));
+}
+
+}  // namespace
@@ -0,0 +1,58 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/autofill/autofill_suggestion_index.h"
+
+#include <algorithm>
+#include <ctype.h>
+
+#include "base/string_util.h"
+
+AutofillSuggestionIndex::AutofillSuggestionIndex() {
+}
+
+AutofillSuggestionIndex::~AutofillSuggestionIndex() {
+}
+
+void AutofillSuggestionIndex::AddValue(const string16& value,
+                                       const Location& location) {
+  if (value.empty())
+    return;
+
+  keys_[FoldCase(value)].push_back(location);
+}
+
+void AutofillSuggestionIndex::FindPrefix(
+    const string16& prefix,
+    std::vector<Location>* locations) const {
+  locations->clear();
+  const string16 key_prefix = FoldCase(prefix);
+  for (KeyMap::const_iterator iter = keys_.lower_bound(key_prefix);
+       iter != keys_.end() && StartsWith(iter->first, key_prefix, true);
+       ++iter) {
+    locations->insert(locations->end(), iter->second.begin(),
+                      iter->second.end());
+  }
+  std::sort(locations->begin(), locations->end());
+}
+
+void AutofillSuggestionIndex::FindEqual(
+    const string16& value,
+    std::vector<Location>* locations) const {
+  locations->clear();
+  KeyMap::const_iterator iter = keys_.find(FoldCase(value));
+  if (iter != keys_.end())
+    *locations = iter->second;
+  std::sort(locations->begin(), locations->end());
+}
+
+// static
+string16 AutofillSuggestionIndex::FoldCase(const string16& value) {
+  // The same folding as base::CaseInsensitiveCompare, so that a key starts
+  // with a folded prefix exactly when StartsWith(value, prefix, false).
+  string16 key(value);
+  for (string16::iterator iter = key.begin(); iter != key.end(); ++iter)
+    *iter = static_cast<char16>(tolower(*iter));
+  return key;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_AUTOFILL_AUTOFILL_SUGGESTION_INDEX_H_
+#define CHROME_BROWSER_AUTOFILL_AUTOFILL_SUGGESTION_INDEX_H_
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/string16.h"
+
+// An index of the values of one field type across a list of profiles or
+// credit cards, for finding those that start with what the user has typed.
+// Values are keyed case-folded, in sorted order, and each distinct key is
+// stored once with every place it occurs.
+class AutofillSuggestionIndex {
+ public:
+  // Where a value occurs: the position of its profile or credit card in the
+  // indexed list, and the position of the value among the variants of the
+  // field.
+  typedef std::pair<size_t, size_t> Location;
+
+  AutofillSuggestionIndex();
+  ~AutofillSuggestionIndex();
+
+  // Adds |value| at |location|.  Empty values are not indexed.
+  void AddValue(const string16& value, const Location& location);
+
+  // Fills |locations| with the location of every value that starts with
+  // |prefix|, ignoring case, in increasing order.
+  void FindPrefix(const string16& prefix,
+                  std::vector<Location>* locations) const;
+
+  // Fills |locations| with the location of every value that equals |value|,
+  // ignoring case, in increasing order.
+  void FindEqual(const string16& value,
+                 std::vector<Location>* locations) const;
+
+  // Returns the number of distinct keys.
+  size_t key_count() const { return keys_.size(); }
+
+  // Returns the key |value| is indexed under.  Case is folded the way
+  // StartsWith() folds it when ignoring case.
+  static string16 FoldCase(const string16& value);
+
+ private:
+  typedef std::map<string16, std::vector<Location> > KeyMap;
+
+  KeyMap keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutofillSuggestionIndex);
+};
+
+#endif  // CHROME_BROWSER_AUTOFILL_AUTOFILL_SUGGESTION_INDEX_H_
@@ -0,0 +1,63 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/autofill/autofill_suggestion_index.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+typedef AutofillSuggestionIndex::Location Location;
+
+TEST(AutofillSuggestionIndexTest, FindPrefix) {
+  AutofillSuggestionIndex index;
+  index.AddValue(ASCIIToUTF16("Elvis"), Location(2, 0));
+  index.AddValue(ASCIIToUTF16("Charles"), Location(0, 0));
+  index.AddValue(ASCIIToUTF16("elvis"), Location(0, 1));
+  index.AddValue(ASCIIToUTF16("Elton"), Location(1, 0));
+  index.AddValue(string16(), Location(3, 0));
+  // "Elvis" and "elvis" share a key.
+  EXPECT_EQ(3U, index.key_count());
+
+  std::vector<Location> locations;
+  index.FindPrefix(ASCIIToUTF16("EL"), &locations);
+  ASSERT_EQ(3U, locations.size());
+  EXPECT_EQ(Location(0, 1), locations[0]);
+  EXPECT_EQ(Location(1, 0), locations[1]);
+  EXPECT_EQ(Location(2, 0), locations[2]);
+
+  index.FindPrefix(ASCIIToUTF16("elv"), &locations);
+  ASSERT_EQ(2U, locations.size());
+  EXPECT_EQ(Location(0, 1), locations[0]);
+  EXPECT_EQ(Location(2, 0), locations[1]);
+
+  // An empty prefix finds every value, but not the empty one.
+  index.FindPrefix(string16(), &locations);
+  EXPECT_EQ(4U, locations.size());
+
+  index.FindPrefix(ASCIIToUTF16("Elvis Presley"), &locations);
+  EXPECT_TRUE(locations.empty());
+  index.FindPrefix(ASCIIToUTF16("Z"), &locations);
+  EXPECT_TRUE(locations.empty());
+}
+
+TEST(AutofillSuggestionIndexTest, FindEqual) {
+  AutofillSuggestionIndex index;
+  index.AddValue(ASCIIToUTF16("Memphis"), Location(0, 0));
+  index.AddValue(ASCIIToUTF16("MEMPHIS"), Location(1, 0));
+  index.AddValue(ASCIIToUTF16("Memphis, TN"), Location(2, 0));
+
+  std::vector<Location> locations;
+  index.FindEqual(ASCIIToUTF16("memphis"), &locations);
+  ASSERT_EQ(2U, locations.size());
+  EXPECT_EQ(Location(0, 0), locations[0]);
+  EXPECT_EQ(Location(1, 0), locations[1]);
+
+  index.FindEqual(ASCIIToUTF16("Memph"), &locations);
+  EXPECT_TRUE(locations.empty());
+}
+
+}  // namespace
@@ -5,12 +5,16 @@
 #include "chrome/browser/autofill/form_field.h"
 
 #include <stddef.h>
+#include <map>
 #include <string>
 #include <utility>
 
 #include "base/logging.h"
+#include "base/memory/singleton.h"
+#include "base/stl_util-inl.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
+#include "base/synchronization/lock.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/autofill/address_field.h"
 #include "chrome/browser/autofill/autofill_field.h"
@@ -70,21 +74,124 @@ const char kEcmlCardExpireDay[] = "ecom_payment_card_expdate_day";
 const char kEcmlCardExpireMonth[] = "ecom_payment_card_expdate_month";
 const char kEcmlCardExpireYear[] = "ecom_payment_card_expdate_year";
 
-namespace autofill {
+namespace {
+
+// A singleton class that holds the compiled form of each pattern the field
+// heuristics match against, so that parsing a form compiles every pattern at
+// most once rather than once per field.  Each pattern also gets a small id, by
+// which AutofillField keeps the results of matching it.
+class AutofillRegexes {
+ public:
+  static AutofillRegexes* GetInstance();
+
+  // Returns the id of |pattern|, compiling it on first use.  Ids count up from
+  // zero in the order patterns are first seen.
+  size_t GetPatternId(const string16& pattern);
+
+  // Returns true if the pattern with |pattern_id| is found in |input|, ignoring
+  // case.
+  bool Find(size_t pattern_id, const string16& input);
+
+ private:
+  AutofillRegexes();
+  ~AutofillRegexes();
+  friend struct DefaultSingletonTraits<AutofillRegexes>;
+
+  // Guards the members below, as MatchString() is a general utility which
+  // isn't tied to the UI thread.
+  base::Lock lock_;
+
+  // Maps patterns to their ids.
+  std::map<string16, size_t> pattern_ids_;
+
+  // The matcher for each pattern, indexed by id.
+  std::vector<icu::RegexMatcher*> matchers_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutofillRegexes);
+};
+
+// static
+AutofillRegexes* AutofillRegexes::GetInstance() {
+  return Singleton<AutofillRegexes>::get();
+}
+
+AutofillRegexes::AutofillRegexes() {
+}
+
+AutofillRegexes::~AutofillRegexes() {
+  STLDeleteElements(&matchers_);
+}
+
+size_t AutofillRegexes::GetPatternId(const string16& pattern) {
+  base::AutoLock lock(lock_);
+  std::map<string16, size_t>::iterator it = pattern_ids_.find(pattern);
+  if (it != pattern_ids_.end())
+    return it->second;
 
-bool MatchString(const string16& input, const string16& pattern) {
   UErrorCode status = U_ZERO_ERROR;
   icu::UnicodeString icu_pattern(pattern.data(), pattern.length());
-  icu::UnicodeString icu_input(input.data(), input.length());
-  icu::RegexMatcher matcher(icu_pattern, icu_input,
-                            UREGEX_CASE_INSENSITIVE, status);
+  matchers_.push_back(
+      new icu::RegexMatcher(icu_pattern, UREGEX_CASE_INSENSITIVE, status));
   DCHECK(U_SUCCESS(status));
+  const size_t pattern_id = matchers_.size() - 1;
+  pattern_ids_.insert(std::make_pair(pattern, pattern_id));
+  return pattern_id;
+}
+
+bool AutofillRegexes::Find(size_t pattern_id, const string16& input) {
+  base::AutoLock lock(lock_);
+  DCHECK_LT(pattern_id, matchers_.size());
+  icu::RegexMatcher* matcher = matchers_[pattern_id];
+  // Match the input in place rather than copying it.
+  icu::UnicodeString icu_input(FALSE, input.data(), input.length());
+  matcher->reset(icu_input);
 
-  UBool match = matcher.find(0, status);
+  UErrorCode status = U_ZERO_ERROR;
+  UBool match = matcher->find(0, status);
   DCHECK(U_SUCCESS(status));
   return !!match;
 }
 
+// The bits of AutofillField::GetHeuristicMatches() for one pattern.
+enum {
+  kLabelTried = 1 << 0,
+  kLabelMatched = 1 << 1,
+  kNameTried = 1 << 2,
+  kNameMatched = 1 << 3,
+};
+
+// Returns true if |pattern| is found in the label of |field|, or in its name
+// if |match_name| is true.  The parsers try the same fields against the same
+// patterns many times as they backtrack, so only the first try of each runs
+// the regular expression.
+bool MatchField(AutofillField* field, const string16& pattern,
+                bool match_name) {
+  AutofillRegexes* regexes = AutofillRegexes::GetInstance();
+  const size_t pattern_id = regexes->GetPatternId(pattern);
+  std::vector<uint8>* matches = field->GetHeuristicMatches();
+  if (pattern_id >= matches->size())
+    matches->resize(pattern_id + 1, 0);
+
+  const uint8 tried = match_name ? kNameTried : kLabelTried;
+  const uint8 matched = match_name ? kNameMatched : kLabelMatched;
+  uint8& result = (*matches)[pattern_id];
+  if (!(result & tried)) {
+    result |= tried;
+    if (regexes->Find(pattern_id, match_name ? field->name : field->label))
+      result |= matched;
+  }
+  return (result & matched) != 0;
+}
+
+}  // namespace
+
+namespace autofill {
+
+bool MatchString(const string16& input, const string16& pattern) {
+  AutofillRegexes* regexes = AutofillRegexes::GetInstance();
+  return regexes->Find(regexes->GetPatternId(pattern), input);
+}
+
 }  // namespace autofill
 
 class EmailField : public FormField {
@@ -126,15 +233,15 @@ bool FormField::Match(AutofillField* field,
                       const string16& pattern,
                       bool match_label_only) {
   if (match_label_only) {
-    if (autofill::MatchString(field->label, pattern)) {
+    if (MatchField(field, pattern, false)) {
       return true;
     }
   } else {
     // For now, we apply the same pattern to the field's label and the field's
     // name.  Matching the name is a bit of a long shot for many patterns, but
     // it generally doesn't hurt to try.
-    if (autofill::MatchString(field->label, pattern) ||
-        autofill::MatchString(field->name, pattern)) {
+    if (MatchField(field, pattern, false) ||
+        MatchField(field, pattern, true)) {
       return true;
     }
   }
@@ -224,8 +331,7 @@ bool FormField::ParseLabelAndName(
   if (!field)
     return false;
 
-  if (autofill::MatchString(field->label, pattern) &&
-      autofill::MatchString(field->name, pattern)) {
+  if (MatchField(field, pattern, false) && MatchField(field, pattern, true)) {
     if (dest)
       *dest = field;
     (*iter)++;
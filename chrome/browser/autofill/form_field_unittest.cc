@@ -81,4 +81,38 @@ TEST(FormFieldTest, Match) {
   EXPECT_TRUE(FormField::Match(&field, ASCIIToUTF16("head_tail"), true));
 }
 
+// Tests that reusing the compiled form of a pattern doesn't carry state from
+// one match to the next.
+TEST(FormFieldTest, MatchStringReusesPattern) {
+  const string16 pattern(ASCIIToUTF16("e.?mail"));
+  EXPECT_TRUE(autofill::MatchString(ASCIIToUTF16("Your E-mail"), pattern));
+  EXPECT_FALSE(autofill::MatchString(ASCIIToUTF16("Phone"), pattern));
+  EXPECT_TRUE(autofill::MatchString(ASCIIToUTF16("email"), pattern));
+  EXPECT_FALSE(autofill::MatchString(string16(), pattern));
+
+  // A pattern that differs only in case is a distinct pattern, and is still
+  // matched case-insensitively.
+  EXPECT_TRUE(autofill::MatchString(ASCIIToUTF16("EMAIL"),
+                                    ASCIIToUTF16("E.?MAIL")));
+}
+
+// Tests that the results FormField keeps for a field's label and name stay
+// apart, and follow changes to them.
+TEST(FormFieldTest, MatchKeepsLabelAndNameApart) {
+  AutofillField field;
+  field.label = ASCIIToUTF16("Email");
+  field.name = ASCIIToUTF16("field1");
+  const string16 pattern(ASCIIToUTF16("e.?mail"));
+  EXPECT_TRUE(FormField::Match(&field, pattern, true));
+  EXPECT_TRUE(FormField::Match(&field, pattern, false));
+
+  field.label = ASCIIToUTF16("Phone");
+  EXPECT_FALSE(FormField::Match(&field, pattern, true));
+  EXPECT_FALSE(FormField::Match(&field, pattern, false));
+
+  field.name = ASCIIToUTF16("email");
+  EXPECT_FALSE(FormField::Match(&field, pattern, true));
+  EXPECT_TRUE(FormField::Match(&field, pattern, false));
+}
+
 }  // namespace
@@ -0,0 +1,184 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Times the Autofill field heuristics on a corpus of forms modelled on real
+// checkout, shipping and sign up pages:
+//   $ ./perf_tests --gtest_filter=FormStructurePerfTest.*
+
+#include "base/basictypes.h"
+#include "base/perftimer.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/autofill/form_structure.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/glue/form_data.h"
+#include "webkit/glue/form_field.h"
+
+namespace {
+
+// How many times the corpus is parsed once every pattern is compiled.
+const int kIterations = 200;
+
+// How many copies of the corpus the large form has.
+const int kLargeFormCopies = 5;
+
+// How many times the large form is parsed.
+const int kLargeFormIterations = 20;
+
+struct Field {
+  const char* label;
+  const char* name;
+};
+
+// The label and name of each field of a form, ended by a field with no name.
+const Field kForms[][24] = {
+  // A checkout page with billing and shipping addresses.
+  { { "First Name", "billing_first_name" },
+    { "Last Name", "billing_last_name" },
+    { "Company", "billing_company" },
+    { "Address", "billing_address_1" },
+    { "", "billing_address_2" },
+    { "City", "billing_city" },
+    { "State", "billing_state" },
+    { "Zip Code", "billing_postcode" },
+    { "Country", "billing_country" },
+    { "Phone", "billing_phone" },
+    { "Email Address", "billing_email" },
+    { "First Name", "shipping_first_name" },
+    { "Last Name", "shipping_last_name" },
+    { "Street Address", "shipping_address_1" },
+    { "Apt/Suite", "shipping_address_2" },
+    { "City", "shipping_city" },
+    { "State/Province", "shipping_state" },
+    { "Postal Code", "shipping_postcode" },
+    { "Country", "shipping_country" },
+    { NULL, NULL } },
+  // A payment page.
+  { { "Name on Card", "cc_name" },
+    { "Card Type", "cc_type" },
+    { "Card Number", "cc_number" },
+    { "Expiration Date", "cc_exp_month" },
+    { "", "cc_exp_year" },
+    { "Security Code (CVV)", "cc_cvv" },
+    { "Billing Zip", "cc_zip" },
+    { NULL, NULL } },
+  // A registration page with a split phone number.
+  { { "Title", "title" },
+    { "First name", "fname" },
+    { "M.I.", "mi" },
+    { "Last name", "lname" },
+    { "E-mail", "email" },
+    { "Confirm e-mail", "email2" },
+    { "Password", "pwd" },
+    { "Address line 1", "addr1" },
+    { "Address line 2", "addr2" },
+    { "Town / City", "town" },
+    { "County", "county" },
+    { "Postcode", "postcode" },
+    { "Daytime phone", "phone_area" },
+    { "", "phone_prefix" },
+    { "", "phone_suffix" },
+    { "Ext.", "phone_ext" },
+    { "Fax", "fax" },
+    { "Promo code", "promo" },
+    { NULL, NULL } },
+  // A form with unhelpful labels, matched on names alone.
+  { { "", "ctl00$Main$txtFirstName" },
+    { "", "ctl00$Main$txtLastName" },
+    { "", "ctl00$Main$txtAddress1" },
+    { "", "ctl00$Main$txtAddress2" },
+    { "", "ctl00$Main$txtCity" },
+    { "", "ctl00$Main$ddlState" },
+    { "", "ctl00$Main$txtZip" },
+    { "", "ctl00$Main$txtPhone" },
+    { "", "ctl00$Main$txtEmail" },
+    { "", "ctl00$Main$txtComments" },
+    { NULL, NULL } },
+  // An ECML form.
+  { { "", "ecom_billto_postal_name_first" },
+    { "", "ecom_billto_postal_name_last" },
+    { "", "ecom_billto_postal_street_line1" },
+    { "", "ecom_billto_postal_city" },
+    { "", "ecom_billto_postal_stateprov" },
+    { "", "ecom_billto_postal_postalcode" },
+    { "", "ecom_billto_telecom_phone_number" },
+    { "", "ecom_billto_online_email" },
+    { "", "ecom_payment_card_number" },
+    { "", "ecom_payment_card_expdate_month" },
+    { "", "ecom_payment_card_expdate_year" },
+    { NULL, NULL } },
+};
+
+// Appends the fields of |fields| to |form|.
+void AppendFields(const Field* fields, webkit_glue::FormData* form) {
+  for (const Field* field = fields; field->name; ++field) {
+    form->fields.push_back(webkit_glue::FormField(ASCIIToUTF16(field->label),
+                                                  ASCIIToUTF16(field->name),
+                                                  string16(),
+                                                  ASCIIToUTF16("text"),
+                                                  0,
+                                                  false));
+  }
+}
+
+webkit_glue::FormData MakeForm(const Field* fields) {
+  webkit_glue::FormData form;
+  form.method = ASCIIToUTF16("post");
+  form.origin = GURL("https://www.example.com/checkout");
+  form.action = GURL("https://www.example.com/submit");
+  AppendFields(fields, &form);
+  return form;
+}
+
+// Runs the heuristics on every form of the corpus, and returns how many
+// fields they typed.
+size_t ParseCorpus() {
+  size_t autofill_count = 0;
+  for (size_t i = 0; i < arraysize(kForms); ++i) {
+    FormStructure form_structure(MakeForm(kForms[i]));
+    form_structure.DetermineHeuristicTypes();
+    autofill_count += form_structure.autofill_count();
+  }
+  return autofill_count;
+}
+
+}  // namespace
+
+TEST(FormStructurePerfTest, DetermineHeuristicTypes) {
+  // The first pass compiles the patterns.
+  PerfTimeLogger first_timer("FormStructure_heuristics_first_pass");
+  const size_t autofill_count = ParseCorpus();
+  first_timer.Done();
+  EXPECT_LT(0U, autofill_count);
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i)
+    EXPECT_EQ(autofill_count, ParseCorpus());
+  LogPerfResult("FormStructure_heuristics_cached",
+                (base::TimeTicks::Now() - start).InMillisecondsF() /
+                    kIterations, "ms");
+}
+
+// A page with hundreds of inputs, where the parsers backtrack the most.
+TEST(FormStructurePerfTest, LargeForm) {
+  webkit_glue::FormData form = MakeForm(kForms[0]);
+  for (int i = 0; i < kLargeFormCopies; ++i) {
+    // Leave out the ECML form, which would make the whole form ECML.
+    for (size_t j = 0; j < arraysize(kForms) - 1; ++j)
+      AppendFields(kForms[j], &form);
+  }
+  LogPerfResult("FormStructure_large_form_fields",
+                static_cast<double>(form.fields.size()), "fields");
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kLargeFormIterations; ++i) {
+    FormStructure form_structure(form);
+    form_structure.DetermineHeuristicTypes();
+    EXPECT_LT(0U, form_structure.autofill_count());
+  }
+  LogPerfResult("FormStructure_large_form",
+                (base::TimeTicks::Now() - start).InMillisecondsF() /
+                    kLargeFormIterations, "ms");
+}
@@ -8,6 +8,7 @@
 #include <iterator>
 
 #include "base/logging.h"
+#include "base/stl_util-inl.h"
 #include "base/string_number_conversions.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/autofill/autofill-inl.h"
@@ -100,6 +101,19 @@ bool IsMinimumAddress(const AutofillProfile& profile) {
          !profile.GetInfo(ADDRESS_HOME_ZIP).empty();
 }
 
+// Returns true if |a| and |b| hold the same profiles in the same order.
+bool SameProfiles(const std::vector<AutofillProfile*>& a,
+                  const std::vector<AutofillProfile*>& b) {
+  if (a.size() != b.size())
+    return false;
+
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i]->guid() != b[i]->guid() || a[i]->CompareMulti(*b[i]) != 0)
+      return false;
+  }
+  return true;
+}
+
 }  // namespace
 
 PersonalDataManager::~PersonalDataManager() {
@@ -396,6 +410,8 @@ void PersonalDataManager::SetProfiles(std::vector<AutofillProfile>* profiles) {
 #endif
 
   // Copy in the new profiles.
+  ClearSuggestionIndexes();
+  merge_index_.reset();
   web_profiles_.reset();
   for (std::vector<AutofillProfile>::iterator iter = profiles->begin();
        iter != profiles->end(); ++iter) {
@@ -450,6 +466,7 @@ void PersonalDataManager::SetCreditCards(
   }
 
   // Copy in the new credit cards.
+  ClearSuggestionIndexes();
   credit_cards_.reset();
   for (std::vector<CreditCard>::iterator iter = credit_cards->begin();
        iter != credit_cards->end(); ++iter) {
@@ -463,7 +480,6 @@ void PersonalDataManager::SetCreditCards(
 #endif
 }
 
-// TODO(jhawkins): Refactor SetProfiles so this isn't so hacky.
 void PersonalDataManager::AddProfile(const AutofillProfile& profile) {
   // Don't save a web profile if the data in the profile is a subset of an
   // auxiliary profile.
@@ -474,9 +490,47 @@ void PersonalDataManager::AddProfile(const AutofillProfile& profile) {
       return;
   }
 
-  std::vector<AutofillProfile> profiles;
-  MergeProfile(profile, web_profiles_.get(), &profiles);
-  SetProfiles(&profiles);
+#ifndef ANDROID
+  if (profile_->IsOffTheRecord() || profile.IsEmpty())
+    return;
+
+  WebDataService* wds = profile_->GetWebDataService(Profile::EXPLICIT_ACCESS);
+  if (!wds)
+    return;
+
+  if (!merge_index_.get()) {
+    merge_index_.reset(new AutofillMergeIndex);
+    for (size_t i = 0; i < web_profiles_.size(); ++i)
+      merge_index_->AddProfile(*web_profiles_[i], i);
+  }
+
+  size_t position = 0;
+  switch (merge_index_->MergeProfile(profile, web_profiles_.get(),
+                                     &position)) {
+    case AutofillMergeIndex::CONTAINED:
+      break;
+    case AutofillMergeIndex::MERGED:
+      wds->UpdateAutofillProfile(*web_profiles_[position]);
+      break;
+    case AutofillMergeIndex::ADDED:
+      web_profiles_.push_back(new AutofillProfile(profile));
+      merge_index_->AddProfile(profile, position);
+      wds->AddAutofillProfile(profile);
+      break;
+  }
+
+  // The merge index is up to date, but a merged profile changed in place.
+  profile_indexes_.clear();
+  indexed_profiles_.clear();
+
+  // Ensure that profile labels are up to date.
+  AutofillProfile::AdjustInferredLabels(&web_profiles_.get());
+
+  // Read our writes to ensure consistency with the database.
+  Refresh();
+
+  FOR_EACH_OBSERVER(Observer, observers_, OnPersonalDataChanged());
+#endif
 }
 
 void PersonalDataManager::UpdateProfile(const AutofillProfile& profile) {
@@ -486,6 +540,8 @@ void PersonalDataManager::UpdateProfile(const AutofillProfile& profile) {
     return;
 
   // Update the cached profile.
+  ClearSuggestionIndexes();
+  merge_index_.reset();
   for (std::vector<AutofillProfile*>::iterator iter = web_profiles_->begin();
        iter != web_profiles_->end(); ++iter) {
     if ((*iter)->guid() == profile.guid()) {
@@ -547,6 +603,7 @@ void PersonalDataManager::UpdateCreditCard(const CreditCard& credit_card) {
     return;
 
   // Update the cached credit card.
+  ClearSuggestionIndexes();
   for (std::vector<CreditCard*>::iterator iter = credit_cards_->begin();
        iter != credit_cards_->end(); ++iter) {
     if ((*iter)->guid() == credit_card.guid()) {
@@ -646,7 +703,9 @@ const std::vector<AutofillProfile*>& PersonalDataManager::profiles() {
 
   profiles_.clear();
 
-  // Populates |auxiliary_profiles_|.
+  // Populates |auxiliary_profiles_|.  This frees the previous auxiliary
+  // profiles, so the indexes built from them are dropped by GetProfileIndex,
+  // which sees different profiles.
   LoadAuxiliaryProfiles();
 
   profiles_.insert(profiles_.end(), web_profiles_.begin(), web_profiles_.end());
@@ -663,6 +722,44 @@ const std::vector<CreditCard*>& PersonalDataManager::credit_cards() {
   return credit_cards_.get();
 }
 
+const AutofillSuggestionIndex& PersonalDataManager::GetProfileIndex(
+    const std::vector<AutofillProfile*>& profiles,
+    AutofillFieldType type) {
+  if (profiles != indexed_profiles_) {
+    profile_indexes_.clear();
+    indexed_profiles_ = profiles;
+  }
+
+  linked_ptr<AutofillSuggestionIndex>& index = profile_indexes_[type];
+  if (!index.get()) {
+    index.reset(new AutofillSuggestionIndex);
+    std::vector<string16> values;
+    for (size_t i = 0; i < profiles.size(); ++i) {
+      profiles[i]->GetMultiInfo(type, &values);
+      for (size_t j = 0; j < values.size(); ++j)
+        index->AddValue(values[j], std::make_pair(i, j));
+    }
+  }
+  return *index;
+}
+
+const AutofillSuggestionIndex& PersonalDataManager::GetCreditCardIndex(
+    AutofillFieldType type) {
+  const std::vector<CreditCard*>& credit_cards = this->credit_cards();
+  if (credit_cards != indexed_credit_cards_) {
+    credit_card_indexes_.clear();
+    indexed_credit_cards_ = credit_cards;
+  }
+
+  linked_ptr<AutofillSuggestionIndex>& index = credit_card_indexes_[type];
+  if (!index.get()) {
+    index.reset(new AutofillSuggestionIndex);
+    for (size_t i = 0; i < credit_cards.size(); ++i)
+      index->AddValue(credit_cards[i]->GetInfo(type), std::make_pair(i, 0U));
+  }
+  return *index;
+}
+
 void PersonalDataManager::Refresh() {
   LoadProfiles();
   LoadCreditCards();
@@ -823,15 +920,23 @@ void PersonalDataManager::ReceiveLoadedProfiles(WebDataService::Handle h,
   DCHECK_EQ(pending_profiles_query_, h);
 
   pending_profiles_query_ = 0;
-  web_profiles_.reset();
 
   const WDResult<std::vector<AutofillProfile*> >* r =
       static_cast<const WDResult<std::vector<AutofillProfile*> >*>(result);
 
   std::vector<AutofillProfile*> profiles = r->GetValue();
-  for (std::vector<AutofillProfile*>::iterator iter = profiles.begin();
-       iter != profiles.end(); ++iter) {
-    web_profiles_.push_back(*iter);
+  if (SameProfiles(web_profiles_.get(), profiles)) {
+    // Reading back our own writes usually finds what is already loaded.  Keep
+    // the loaded profiles then, so that the indexes over them stay valid.
+    STLDeleteElements(&profiles);
+  } else {
+    ClearSuggestionIndexes();
+    merge_index_.reset();
+    web_profiles_.reset();
+    for (std::vector<AutofillProfile*>::iterator iter = profiles.begin();
+         iter != profiles.end(); ++iter) {
+      web_profiles_.push_back(*iter);
+    }
   }
 
   LogProfileCount();
@@ -843,6 +948,7 @@ void PersonalDataManager::ReceiveLoadedCreditCards(
   DCHECK_EQ(pending_creditcards_query_, h);
 
   pending_creditcards_query_ = 0;
+  ClearSuggestionIndexes();
   credit_cards_.reset();
 
   const WDResult<std::vector<CreditCard*> >* r =
@@ -855,6 +961,13 @@ void PersonalDataManager::ReceiveLoadedCreditCards(
   }
 }
 
+void PersonalDataManager::ClearSuggestionIndexes() {
+  profile_indexes_.clear();
+  indexed_profiles_.clear();
+  credit_card_indexes_.clear();
+  indexed_credit_cards_.clear();
+}
+
 void PersonalDataManager::CancelPendingQuery(WebDataService::Handle* handle) {
 #ifndef ANDROID
   // TODO: We need to come up with a web data service class for Android
@@ -893,6 +1006,9 @@ void PersonalDataManager::SaveImportedCreditCard(
   // Set to true if |imported_credit_card| is merged into the credit card list.
   bool merged = false;
 
+  // The credit cards may be merged in place.
+  ClearSuggestionIndexes();
+
   std::vector<CreditCard> creditcards;
   for (std::vector<CreditCard*>::const_iterator iter = credit_cards_.begin();
        iter != credit_cards_.end();
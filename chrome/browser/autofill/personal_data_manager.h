@@ -6,18 +6,22 @@
 #define CHROME_BROWSER_AUTOFILL_PERSONAL_DATA_MANAGER_H_
 #pragma once
 
+#include <map>
 #include <set>
 #include <vector>
 
 #ifdef ANDROID
 #include "base/base_api.h"
 #endif
+#include "base/memory/linked_ptr.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
 #include "base/observer_list.h"
 #include "base/string16.h"
+#include "chrome/browser/autofill/autofill_merge_index.h"
 #include "chrome/browser/autofill/autofill_profile.h"
+#include "chrome/browser/autofill/autofill_suggestion_index.h"
 #include "chrome/browser/autofill/credit_card.h"
 #include "chrome/browser/autofill/field_types.h"
 #include "chrome/browser/sync/profile_sync_service_observer.h"
@@ -102,7 +106,9 @@ BASE_API
   // database by adding, updating and removing credit cards.
   void SetCreditCards(std::vector<CreditCard>* credit_cards);
 
-  // Adds |profile| to the web database.
+  // Adds |profile| to the web database, or merges it into the web profile it
+  // matches as MergeProfile() would.  Only the added or changed profile is
+  // written.
   void AddProfile(const AutofillProfile& profile);
 
   // Updates |profile| which already exists in the web database.
@@ -147,6 +153,19 @@ BASE_API
   virtual const std::vector<AutofillProfile*>& web_profiles();
   virtual const std::vector<CreditCard*>& credit_cards();
 
+  // Returns an index of the values of |type| across |profiles|, as returned by
+  // the last call to |profiles()|, whose locations are positions in
+  // |profiles|.  The index is built on first use and kept until the profiles
+  // change.  It is only valid until the next call to |profiles()|, which may
+  // reload the profiles.
+  const AutofillSuggestionIndex& GetProfileIndex(
+      const std::vector<AutofillProfile*>& profiles,
+      AutofillFieldType type);
+
+  // Returns an index of the values of |type| across |credit_cards()|, whose
+  // locations are positions in |credit_cards()|.
+  const AutofillSuggestionIndex& GetCreditCardIndex(AutofillFieldType type);
+
   // Re-loads profiles and credit cards from the WebDatabase asynchronously.
   // In the general case, this is a no-op and will re-create the same
   // in-memory model as existed prior to the call.  If any change occurred to
@@ -222,6 +241,10 @@ BASE_API
   // Returns the value of the AutofillEnabled pref.
   virtual bool IsAutofillEnabled() const;
 
+  // Drops the suggestion indexes, to be rebuilt on next use.  Must be called
+  // whenever the profiles or credit cards change.
+  void ClearSuggestionIndexes();
+
   // For tests.
   const AutofillMetrics* metric_logger() const;
   void set_metric_logger(const AutofillMetrics* metric_logger);
@@ -235,6 +258,11 @@ BASE_API
   // The loaded web profiles.
   ScopedVector<AutofillProfile> web_profiles_;
 
+  // The index of |web_profiles_| that imported profiles are merged through.
+  // Built on the first import and kept up to date by AddProfile(); dropped
+  // whenever the web profiles change otherwise.
+  scoped_ptr<AutofillMergeIndex> merge_index_;
+
   // Auxiliary profiles.
   ScopedVector<AutofillProfile> auxiliary_profiles_;
 
@@ -260,6 +288,17 @@ BASE_API
   ObserverList<Observer> observers_;
 
  private:
+  typedef std::map<AutofillFieldType, linked_ptr<AutofillSuggestionIndex> >
+      SuggestionIndexMap;
+
+  // The suggestion indexes by field type, and the profiles and credit cards
+  // they were built from.  As a safeguard, the indexes are also dropped when
+  // |profiles()| or |credit_cards()| no longer hold the same objects.
+  SuggestionIndexMap profile_indexes_;
+  std::vector<AutofillProfile*> indexed_profiles_;
+  SuggestionIndexMap credit_card_indexes_;
+  std::vector<CreditCard*> indexed_credit_cards_;
+
   // For logging UMA metrics. Overridden by metrics tests.
   scoped_ptr<const AutofillMetrics> metric_logger_;
 
@@ -0,0 +1,239 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Types a first name one character at a time against 10,000 Autofill
+// profiles, and logs how long finding the suggestions for each keystroke
+// takes with and without the suggestion index.  Also logs how long merging
+// imported profiles takes with and without the merge index, against growing
+// numbers of profiles:
+//   $ ./perf_tests --gtest_filter=PersonalDataManagerPerfTest.*
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "base/string_util.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/autofill/autofill_common_test.h"
+#include "chrome/browser/autofill/autofill_merge_index.h"
+#include "chrome/browser/autofill/autofill_profile.h"
+#include "chrome/browser/autofill/autofill_suggestion_index.h"
+#include "chrome/browser/autofill/personal_data_manager.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const size_t kProfileCount = 10000;
+
+// How many times each keystroke is looked up.
+const int kIterations = 20;
+
+const char kTypedText[] = "Elvis";
+
+// The profile counts imports are timed against.
+const size_t kImportProfileCounts[] = { 100, 1000, 10000 };
+
+// How many profiles are imported into each.
+const size_t kImports = 90;
+
+const char* const kFirstNames[] = {
+  "Elvis", "Elizabeth", "Ella", "Emily", "Edward", "John", "Josephine",
+  "Marion", "Mary", "Michael", "Sarah", "Samuel", "Thomas", "Theresa",
+};
+
+const char* const kLastNames[] = {
+  "Presley", "Smith", "Jones", "Garcia", "Nguyen", "Miller", "Saenz",
+};
+
+// Returns the |i|th generated profile.
+AutofillProfile* MakeProfile(size_t i) {
+  // Most names are shared by many profiles, some are unique to one.
+  std::string first_name = kFirstNames[i % arraysize(kFirstNames)];
+  if (i % 3 == 0)
+    first_name += base::IntToString(i);
+  const std::string email = "user" + base::IntToString(i) + "@example.com";
+  const std::string address = base::IntToString(i) + " Main St.";
+  AutofillProfile* profile = new AutofillProfile;
+  autofill_test::SetProfileInfo(profile, first_name.c_str(), "",
+      kLastNames[i % arraysize(kLastNames)], email.c_str(), "",
+      address.c_str(), "", "Memphis", "Tennessee", "38116", "USA",
+      "12345678901", "");
+  return profile;
+}
+
+// Returns the |i|th profile imported into |profile_count| profiles.  A third
+// repeat a profile, a third add a company name to one, and the rest are new.
+AutofillProfile* MakeImportedProfile(size_t i, size_t profile_count) {
+  const size_t existing = i * 7919 % profile_count;
+  switch (i % 3) {
+    case 0:
+      return MakeProfile(existing);
+    case 1: {
+      AutofillProfile* profile = MakeProfile(existing);
+      profile->SetInfo(COMPANY_NAME, ASCIIToUTF16("Graceland"));
+      return profile;
+    }
+    default:
+      return MakeProfile(profile_count + i);
+  }
+}
+
+class TestPersonalDataManager : public PersonalDataManager {
+ public:
+  TestPersonalDataManager() {
+    for (size_t i = 0; i < kProfileCount; ++i)
+      web_profiles_->push_back(MakeProfile(i));
+  }
+
+ private:
+  virtual ~TestPersonalDataManager() {}
+};
+
+// Finds the profiles with a first name starting with |prefix| the way
+// AutofillManager did before the index, by looking at every profile.
+void LinearScan(PersonalDataManager* personal_data,
+                const string16& prefix,
+                std::vector<size_t>* profile_indexes) {
+  profile_indexes->clear();
+  const std::vector<AutofillProfile*>& profiles = personal_data->profiles();
+  std::vector<string16> values;
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    profiles[i]->GetMultiInfo(NAME_FIRST, &values);
+    if (!values.empty() && StartsWith(values[0], prefix, false))
+      profile_indexes->push_back(i);
+  }
+}
+
+// Finds the same profiles through the suggestion index.
+void IndexLookup(PersonalDataManager* personal_data,
+                 const string16& prefix,
+                 std::vector<size_t>* profile_indexes) {
+  profile_indexes->clear();
+  std::vector<AutofillSuggestionIndex::Location> locations;
+  const AutofillSuggestionIndex& index =
+      personal_data->GetProfileIndex(personal_data->profiles(), NAME_FIRST);
+  index.FindPrefix(prefix, &locations);
+  for (size_t i = 0; i < locations.size(); ++i) {
+    if (locations[i].second == 0)
+      profile_indexes->push_back(locations[i].first);
+  }
+}
+
+// Merges |profile| into |profiles| the way PersonalDataManager did before
+// the merge index: comparing it with every profile, then replacing every
+// profile with the merged copy.
+void ImportWithoutIndex(const AutofillProfile& profile,
+                        ScopedVector<AutofillProfile>* profiles) {
+  std::vector<AutofillProfile> merged_profiles;
+  PersonalDataManager::MergeProfile(profile, profiles->get(),
+                                    &merged_profiles);
+  profiles->reset();
+  for (size_t i = 0; i < merged_profiles.size(); ++i)
+    profiles->push_back(new AutofillProfile(merged_profiles[i]));
+}
+
+// Merges |profile| into |profiles| through |index|.
+void ImportWithIndex(const AutofillProfile& profile,
+                     AutofillMergeIndex* index,
+                     ScopedVector<AutofillProfile>* profiles) {
+  size_t position = 0;
+  if (index->MergeProfile(profile, profiles->get(), &position) ==
+          AutofillMergeIndex::ADDED) {
+    profiles->push_back(new AutofillProfile(profile));
+    index->AddProfile(profile, position);
+  }
+}
+
+}  // namespace
+
+TEST(PersonalDataManagerPerfTest, Keystrokes) {
+  scoped_refptr<TestPersonalDataManager> personal_data(
+      new TestPersonalDataManager);
+  ASSERT_EQ(kProfileCount, personal_data->profiles().size());
+
+  PerfTimeLogger build_timer("PersonalDataManager_build_index");
+  const AutofillSuggestionIndex& index =
+      personal_data->GetProfileIndex(personal_data->profiles(), NAME_FIRST);
+  build_timer.Done();
+  EXPECT_LT(0U, index.key_count());
+
+  const string16 text(ASCIIToUTF16(kTypedText));
+  base::TimeDelta scan_time;
+  base::TimeDelta index_time;
+  std::vector<size_t> scan_results;
+  std::vector<size_t> index_results;
+  for (size_t length = 1; length <= text.length(); ++length) {
+    const string16 prefix = text.substr(0, length);
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i)
+      LinearScan(personal_data.get(), prefix, &scan_results);
+    scan_time += base::TimeTicks::Now() - start;
+
+    start = base::TimeTicks::Now();
+    for (int i = 0; i < kIterations; ++i)
+      IndexLookup(personal_data.get(), prefix, &index_results);
+    index_time += base::TimeTicks::Now() - start;
+
+    EXPECT_FALSE(scan_results.empty());
+    EXPECT_EQ(scan_results, index_results);
+  }
+
+  const int lookups = kIterations * static_cast<int>(text.length());
+  LogPerfResult("PersonalDataManager_keystroke_linear_scan",
+                scan_time.InMillisecondsF() / lookups, "ms");
+  LogPerfResult("PersonalDataManager_keystroke_index",
+                index_time.InMillisecondsF() / lookups, "ms");
+}
+
+// The web database writes are not timed: before the merge index every profile
+// was written on each import, now only the added or merged one is.
+TEST(PersonalDataManagerPerfTest, Import) {
+  for (size_t i = 0; i < arraysize(kImportProfileCounts); ++i) {
+    const size_t profile_count = kImportProfileCounts[i];
+    const std::string count = base::IntToString(profile_count);
+    ScopedVector<AutofillProfile> scan_profiles;
+    ScopedVector<AutofillProfile> index_profiles;
+    for (size_t j = 0; j < profile_count; ++j) {
+      scan_profiles.push_back(MakeProfile(j));
+      index_profiles.push_back(MakeProfile(j));
+    }
+
+    ScopedVector<AutofillProfile> imported_profiles;
+    for (size_t j = 0; j < kImports; ++j)
+      imported_profiles.push_back(MakeImportedProfile(j, profile_count));
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t j = 0; j < kImports; ++j)
+      ImportWithoutIndex(*imported_profiles[j], &scan_profiles);
+    LogPerfResult(("PersonalDataManager_import_linear_scan_" + count).c_str(),
+                  (base::TimeTicks::Now() - start).InMillisecondsF() /
+                      kImports, "ms");
+
+    // The index is built once, on the first import of a session.
+    PerfTimeLogger build_timer(
+        ("PersonalDataManager_build_merge_index_" + count).c_str());
+    AutofillMergeIndex index;
+    for (size_t j = 0; j < index_profiles.size(); ++j)
+      index.AddProfile(*index_profiles[j], j);
+    build_timer.Done();
+
+    start = base::TimeTicks::Now();
+    for (size_t j = 0; j < kImports; ++j)
+      ImportWithIndex(*imported_profiles[j], &index, &index_profiles);
+    LogPerfResult(("PersonalDataManager_import_index_" + count).c_str(),
+                  (base::TimeTicks::Now() - start).InMillisecondsF() /
+                      kImports, "ms");
+
+    ASSERT_EQ(scan_profiles.size(), index_profiles.size());
+    EXPECT_EQ(profile_count + kImports / 3, index_profiles.size());
+    for (size_t j = 0; j < scan_profiles.size(); ++j)
+      EXPECT_EQ(0, scan_profiles[j]->CompareMulti(*index_profiles[j])) << j;
+  }
+}
@@ -8,6 +8,7 @@
 #include <set>
 
 #include "base/callback.h"
+#include "chrome/browser/autofill/autofill_download.h"
 #include "chrome/browser/autofill/personal_data_manager.h"
 #include "chrome/browser/browser_process.h"
 #include "chrome/browser/download/download_manager.h"
@@ -157,6 +158,10 @@ void BrowsingDataRemover::Remove(int remove_mask) {
     SessionService* session_service = profile_->GetSessionService();
     if (session_service)
       session_service->DeleteLastSession();
+
+    // The cached Autofill query responses tell which forms were seen. They
+    // expire within a week, so we can simply clear them all.
+    AutofillDownloadManager::ClearQueryCache(profile_);
   }
 
   if (remove_mask & REMOVE_DOWNLOADS) {
@@ -10,9 +10,20 @@
 #include <numeric>
 
 #include "base/file_util.h"
+#include "base/atomicops.h"
 #include "base/i18n/break_iterator.h"
+#include "base/lazy_instance.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
 #include "base/metrics/histogram.h"
 #include "base/string_util.h"
+#include "base/synchronization/cancellation_flag.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/sys_info.h"
+#include "base/task.h"
+#include "base/threading/simple_thread.h"
+#include "base/threading/thread_restrictions.h"
 #include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/autocomplete/autocomplete.h"
@@ -20,34 +31,17 @@
 #include "chrome/browser/history/url_database.h"
 #include "chrome/browser/profiles/profile.h"
 #include "chrome/common/url_constants.h"
+#include "content/browser/browser_thread.h"
 #include "googleurl/src/url_util.h"
 #include "net/base/escape.h"
 #include "net/base/net_util.h"
-#include "third_party/protobuf/src/google/protobuf/repeated_field.h"
 #include "ui/base/l10n/l10n_util.h"
 
-using google::protobuf::RepeatedField;
-using google::protobuf::RepeatedPtrField;
-using in_memory_url_index::InMemoryURLIndexCacheItem;
-
 namespace history {
 
-typedef imui::InMemoryURLIndexCacheItem_WordListItem WordListItem;
-typedef imui::InMemoryURLIndexCacheItem_WordMapItem_WordMapEntry WordMapEntry;
-typedef imui::InMemoryURLIndexCacheItem_WordMapItem WordMapItem;
-typedef imui::InMemoryURLIndexCacheItem_CharWordMapItem CharWordMapItem;
-typedef imui::InMemoryURLIndexCacheItem_CharWordMapItem_CharWordMapEntry
-    CharWordMapEntry;
-typedef imui::InMemoryURLIndexCacheItem_WordIDHistoryMapItem
-    WordIDHistoryMapItem;
-typedef imui::
-    InMemoryURLIndexCacheItem_WordIDHistoryMapItem_WordIDHistoryMapEntry
-    WordIDHistoryMapEntry;
-typedef imui::InMemoryURLIndexCacheItem_HistoryInfoMapItem HistoryInfoMapItem;
-typedef imui::InMemoryURLIndexCacheItem_HistoryInfoMapItem_HistoryInfoMapEntry
-    HistoryInfoMapEntry;
-
 const size_t InMemoryURLIndex::kNoCachedResultForTerm = -1;
+const size_t InMemoryURLIndex::kMaxChangedRowsBeforeMerge = 500;
+const size_t InMemoryURLIndex::kItemsToScoreLimit = 10000;
 
 // Score ranges used to get a 'base' score for each of the scoring factors
 // (such as recency of last visit, times visited, times the URL was typed,
@@ -76,12 +70,15 @@ struct InMemoryURLIndex::TermCharWordSet {
   TermCharWordSet()  // Required for STL resize().
       : char_(0),
         word_id_set_(),
+        file_word_id_set_(),
         used_(false) {}
   TermCharWordSet(const char16& uni_char,
                   const WordIDSet& word_id_set,
+                  const WordIDSet& file_word_id_set,
                   bool used)
       : char_(uni_char),
         word_id_set_(word_id_set),
+        file_word_id_set_(file_word_id_set),
         used_(used) {}
 
   // Predicate for STL algorithm use.
@@ -89,9 +86,129 @@ struct InMemoryURLIndex::TermCharWordSet {
 
   char16 char_;
   WordIDSet word_id_set_;
+  WordIDSet file_word_id_set_;
   bool used_;  // true if this set has been used for the current term search.
 };
 
+namespace {
+
+// Held while the cache file is written, so that a merge which was canceled
+// in the middle of its write finishes before a newer file is written.
+base::LazyInstance<base::Lock> g_cache_file_lock(base::LINKER_INITIALIZED);
+
+// Adds |index_file|, if any, but the history items in |changed| to |builder|,
+// writes the result to |file_path| and maps the new file. Returns NULL on
+// failure. |g_cache_file_lock| must be held.
+URLIndexFile* WriteCacheFile(const FilePath& file_path,
+                             URLIndexFile* index_file,
+                             const std::set<URLID>& changed,
+                             URLIndexFile::Builder* builder) {
+  base::TimeTicks beginning_time = base::TimeTicks::Now();
+  if (index_file)
+    index_file->AddToBuilder(changed, builder);
+  if (!builder->WriteToFile(file_path, base::Time::Now())) {
+    LOG(WARNING) << "Failed to write " << file_path.value();
+    return NULL;
+  }
+  scoped_refptr<URLIndexFile> new_file(new URLIndexFile);
+  if (!new_file->Open(file_path))
+    return NULL;
+  UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexSaveCacheTime",
+                      base::TimeTicks::Now() - beginning_time);
+  return new_file.release();
+}
+
+}  // namespace
+
+// Writes a new cache file on the file thread from the current one and a
+// snapshot of the in-memory index, then hands it back to the index on the
+// thread the merge was started on.
+class InMemoryURLIndex::CacheMerger
+    : public base::RefCountedThreadSafe<InMemoryURLIndex::CacheMerger> {
+ public:
+  CacheMerger(InMemoryURLIndex* index,
+              const FilePath& file_path,
+              URLIndexFile* index_file,
+              int change_sequence)
+      : index_(index),
+        file_path_(file_path),
+        index_file_(index_file),
+        change_sequence_(change_sequence) {
+  }
+
+  // The snapshot, to be filled in before Start().
+  URLIndexFile::Builder* builder() { return &builder_; }
+  std::set<HistoryID>* changed() { return &changed_; }
+
+  void Start() {
+    if (MessageLoop::current()) {
+      origin_loop_ = base::MessageLoopProxy::CreateForCurrentThread();
+      if (BrowserThread::PostTask(
+              BrowserThread::FILE, FROM_HERE,
+              NewRunnableMethod(this, &CacheMerger::WriteFileOnFileThread)))
+        return;
+    }
+    // There is no file thread or no loop to reply on, as in unit tests, so
+    // write the file here.
+    WriteFile();
+    OnFileWritten();
+  }
+
+  // Called when the index goes away or starts another merge. The file is
+  // not written if the merge hasn't got that far yet, and nobody is told.
+  void Cancel() {
+    canceled_.Set();
+    index_ = NULL;
+  }
+
+  // Like Cancel(), but also waits for a write in progress to finish and
+  // releases the file being merged, so that it can be replaced.
+  void CancelAndWait() {
+    base::AutoLock lock(g_cache_file_lock.Get());
+    Cancel();
+    index_file_ = NULL;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<CacheMerger>;
+
+  ~CacheMerger() {}
+
+  void WriteFileOnFileThread() {
+    WriteFile();
+    origin_loop_->PostTask(
+        FROM_HERE, NewRunnableMethod(this, &CacheMerger::OnFileWritten));
+  }
+
+  void WriteFile() {
+    base::AutoLock lock(g_cache_file_lock.Get());
+    if (canceled_.IsSet())
+      return;
+    // Drop our reference to the old file before it is replaced.
+    scoped_refptr<URLIndexFile> index_file(index_file_);
+    index_file_ = NULL;
+    new_file_ = WriteCacheFile(file_path_, index_file, changed_, &builder_);
+  }
+
+  void OnFileWritten() {
+    if (index_)
+      index_->OnCacheFileWritten(new_file_.get(), change_sequence_);
+  }
+
+  InMemoryURLIndex* index_;
+  base::CancellationFlag canceled_;
+  const FilePath file_path_;
+  // Guarded by |g_cache_file_lock| once the merge has started.
+  scoped_refptr<URLIndexFile> index_file_;
+  const int change_sequence_;
+  scoped_refptr<base::MessageLoopProxy> origin_loop_;
+  URLIndexFile::Builder builder_;
+  std::set<HistoryID> changed_;
+  scoped_refptr<URLIndexFile> new_file_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheMerger);
+};
+
 // Comparison function for sorting TermMatches by their offsets.
 bool MatchOffsetLess(const TermMatch& m1, const TermMatch& m2) {
   return m1.offset < m2.offset;
@@ -134,17 +251,187 @@ int ScoreForValue(int value, const int* value_ranks) {
   return score;
 }
 
+// Combines the score for how well the terms match with the scores for the
+// recency of last visit, the visit count and the typed count of |row|.
+int RawScoreForRow(int term_score, const URLRow& row) {
+  const int kDaysAgoLevel[] = { 0, 10, 20, 30 };
+  int score = ScoreForValue((base::Time::Now() -
+      row.last_visit()).InDays(), kDaysAgoLevel);
+  const int kVisitCountLevel[] = { 30, 10, 5, 3 };
+  int visit_count_value = ScoreForValue(row.visit_count(), kVisitCountLevel);
+  const int kTypedCountLevel[] = { 10, 5, 3, 1 };
+  int typed_count_value = ScoreForValue(row.typed_count(), kTypedCountLevel);
+
+  // Determine how many of the factors comprising the final score are
+  // significant by summing the relative factors for each and subtracting how
+  // many will be 'discarded' even if they are low.
+  const int kVisitCountMultiplier = 2;
+  const int kTypedCountMultiplier = 3;
+  const int kSignificantFactors =
+      kVisitCountMultiplier +  // Visit count factor plus
+      kTypedCountMultiplier +  // typed count factor plus
+      2 -                      // one each for string match and last visit
+      2;                       // minus 2 insignificant factors.
+  // The following, in effect, discards up to |kSignificantFactors| low scoring
+  // elements which contribute little to the score but which can inordinately
+  // drag down an otherwise good score.
+  return std::min(kScoreRank[0], (term_score + score +
+      (visit_count_value * kVisitCountMultiplier) + (typed_count_value *
+      kTypedCountMultiplier)) / kSignificantFactors);
+}
+
+// Orders matches best first, breaking ties by ID so that the same matches
+// are picked however the candidates are shared out.
+bool MatchBetter(const ScoredHistoryMatch& m1, const ScoredHistoryMatch& m2) {
+  if (m1.raw_score != m2.raw_score)
+    return m1.raw_score > m2.raw_score;
+  return m1.url_info.id() < m2.url_info.id();
+}
+
+// Keeps the best |max_matches| matches in |matches|, a heap with the worst
+// of them at the front.
+void AddToTopMatches(const ScoredHistoryMatch& match,
+                     size_t max_matches,
+                     ScoredHistoryMatches* matches) {
+  if (matches->size() < max_matches) {
+    matches->push_back(match);
+    std::push_heap(matches->begin(), matches->end(), MatchBetter);
+  } else if (MatchBetter(match, matches->front())) {
+    std::pop_heap(matches->begin(), matches->end(), MatchBetter);
+    matches->back() = match;
+    std::push_heap(matches->begin(), matches->end(), MatchBetter);
+  }
+}
+
+// Candidates are handed out to the scoring threads this many at a time.
+const size_t kScoringChunkSize = 128;
+
+// Smaller candidate sets are scored on the calling thread alone.
+const size_t kMinItemsToScoreInParallel = 1024;
+
+// The most threads helping the calling thread score candidates.
+const int kMaxScoringThreads = 3;
+
+// Scores the candidates for one query. The calling thread and any helping
+// threads each take chunks of candidates in turn, keep their own best matches
+// and merge them at the end.
+class InMemoryURLIndex::ScoringJob
+    : public base::DelegateSimpleThread::Delegate {
+ public:
+  ScoringJob(const InMemoryURLIndex& index,
+             const HistoryIDSet& history_ids,
+             const String16Vector& lower_terms)
+      : index_(index),
+        history_ids_(history_ids),
+        lower_terms_(lower_terms),
+        max_matches_(AutocompleteProvider::kMaxMatches),
+        next_chunk_(0),
+        running_helpers_(0),
+        helpers_done_(&lock_) {
+  }
+
+  // Scores the candidates with the help of |helpers| threads from |pool| and
+  // returns the best matches, best first.
+  ScoredHistoryMatches Score(base::DelegateSimpleThreadPool* pool,
+                             int helpers) {
+    if (helpers > 0) {
+      running_helpers_ = helpers;
+      pool->AddWork(this, helpers);
+    }
+    ScoreChunks();
+    {
+      // The helpers may not have started yet, but must be done with the job
+      // before it goes away.
+      base::AutoLock lock(lock_);
+      while (running_helpers_ > 0)
+        helpers_done_.Wait();
+    }
+    std::sort(matches_.begin(), matches_.end(), MatchBetter);
+    return matches_;
+  }
+
+  // base::DelegateSimpleThread::Delegate, run by the helping threads.
+  virtual void Run() {
+    ScoreChunks();
+    base::AutoLock lock(lock_);
+    if (--running_helpers_ == 0)
+      helpers_done_.Signal();
+  }
+
+ private:
+  void ScoreChunks() {
+    ScoredHistoryMatches top_matches;
+    URLRow file_row;
+    for (;;) {
+      size_t begin = kScoringChunkSize * static_cast<size_t>(
+          base::subtle::NoBarrier_AtomicIncrement(&next_chunk_, 1) - 1);
+      if (begin >= history_ids_.size())
+        break;
+      size_t end = std::min(begin + kScoringChunkSize, history_ids_.size());
+      for (size_t i = begin; i < end; ++i) {
+        const URLRow* row = index_.FindRow(history_ids_[i], &file_row);
+        // Deleted items are taken out of the word_id_history_map_ along with
+        // the history_info_map_, or hidden in the cache file, so this lookup
+        // should always succeed.
+        if (!row)
+          continue;
+        ScoredHistoryMatch match(ScoredMatchForURL(*row, lower_terms_));
+        if (match.raw_score > 0)
+          AddToTopMatches(match, max_matches_, &top_matches);
+      }
+    }
+    base::AutoLock lock(lock_);
+    for (ScoredHistoryMatches::const_iterator iter = top_matches.begin();
+         iter != top_matches.end(); ++iter)
+      AddToTopMatches(*iter, max_matches_, &matches_);
+  }
+
+  const InMemoryURLIndex& index_;
+  const HistoryIDSet& history_ids_;
+  const String16Vector& lower_terms_;
+  const size_t max_matches_;
+
+  // The next chunk of |history_ids_| to score.
+  base::subtle::Atomic32 next_chunk_;
+
+  // Protects the members below.
+  base::Lock lock_;
+  // The best matches of the threads which have finished.
+  ScoredHistoryMatches matches_;
+  int running_helpers_;
+  // Signalled when the last helping thread finishes.
+  base::ConditionVariable helpers_done_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScoringJob);
+};
+
 InMemoryURLIndex::InMemoryURLIndex(const FilePath& history_dir)
     : history_dir_(history_dir),
-      history_item_count_(0) {
+      history_item_count_(0),
+      change_sequence_(0),
+      merge_threshold_(kMaxChangedRowsBeforeMerge),
+      scoring_threads_(std::min(base::SysInfo::NumberOfProcessors() - 1,
+                                kMaxScoringThreads)) {
 }
 
 // Called only by unit tests.
 InMemoryURLIndex::InMemoryURLIndex()
-    : history_item_count_(0) {
+    : history_item_count_(0),
+      change_sequence_(0),
+      merge_threshold_(kMaxChangedRowsBeforeMerge),
+      scoring_threads_(std::min(base::SysInfo::NumberOfProcessors() - 1,
+                                kMaxScoringThreads)) {
 }
 
-InMemoryURLIndex::~InMemoryURLIndex() {}
+InMemoryURLIndex::~InMemoryURLIndex() {
+  if (cache_merger_)
+    cache_merger_->Cancel();
+  if (scoring_pool_.get()) {
+    // The scoring threads are idle, so they exit at once.
+    base::ThreadRestrictions::ScopedAllowIO allow_io;
+    scoring_pool_->JoinAll();
+  }
+}
 
 // Indexing
 
@@ -156,8 +443,35 @@ bool InMemoryURLIndex::Init(history::URLDatabase* history_db,
 }
 
 void InMemoryURLIndex::ShutDown() {
-  // Write our cache.
-  SaveToCacheFile();
+  // Write our cache now, as the file thread may not get to a merge before
+  // the browser exits.
+  FilePath file_path;
+  if (!GetCacheFilePath(&file_path))
+    return;
+  if (cache_merger_) {
+    cache_merger_->CancelAndWait();
+    cache_merger_ = NULL;
+  }
+  if (index_file_ && changed_rows_.empty() && history_info_map_.empty())
+    return;
+
+  base::ThreadRestrictions::ScopedAllowIO allow_io;
+  scoped_refptr<URLIndexFile> new_file;
+  {
+    base::AutoLock lock(g_cache_file_lock.Get());
+    URLIndexFile::Builder builder;
+    std::set<HistoryID> changed;
+    AddToBuilder(&builder, &changed);
+    if (index_file_)
+      index_file_->AddToBuilder(changed, &builder);
+    // Windows can't replace a file which is still mapped, so unmap the old
+    // one first. The index is going away, so losing its rows from the file
+    // if the write fails doesn't matter.
+    index_file_ = NULL;
+    new_file = WriteCacheFile(file_path, NULL, changed, &builder);
+  }
+  if (new_file)
+    OnCacheFileWritten(new_file.get(), change_sequence_);
 }
 
 bool InMemoryURLIndex::IndexRow(const URLRow& row) {
@@ -169,14 +483,13 @@ bool InMemoryURLIndex::IndexRow(const URLRow& row) {
 
   HistoryID history_id = static_cast<HistoryID>(row.id());
   DCHECK_LT(row.id(), std::numeric_limits<HistoryID>::max());
+  RemoveRowFromIndex(history_id);
 
-  // Add the row for quick lookup in the history info store.
   URLRow new_row(GURL(url), row.id());
   new_row.set_visit_count(row.visit_count());
   new_row.set_typed_count(row.typed_count());
   new_row.set_last_visit(row.last_visit());
   new_row.set_title(row.title());
-  history_info_map_[history_id] = new_row;
 
   // Split URL into individual, unique words then add in the title words.
   url = l10n_util::ToLower(url);
@@ -186,12 +499,79 @@ bool InMemoryURLIndex::IndexRow(const URLRow& row) {
   std::set_union(url_words.begin(), url_words.end(),
                  title_words.begin(), title_words.end(),
                  std::insert_iterator<String16Set>(words, words.begin()));
-  for (String16Set::iterator word_iter = words.begin();
+  AddRowToIndex(new_row, words);
+  return true;
+}
+
+void InMemoryURLIndex::AddRowToIndex(const URLRow& row,
+                                     const String16Set& words) {
+  // Add the row for quick lookup in the history info store.
+  HistoryID history_id = static_cast<HistoryID>(row.id());
+  history_info_map_[history_id] = row;
+
+  WordIDSet word_ids;
+  for (String16Set::const_iterator word_iter = words.begin();
        word_iter != words.end(); ++word_iter)
-    AddWordToIndex(*word_iter, history_id);
+    word_ids.push_back(AddWordToIndex(*word_iter, history_id));
+  std::sort(word_ids.begin(), word_ids.end());
+  PostingList& row_words(history_id_word_map_[history_id]);
+  for (WordIDSet::const_iterator iter = word_ids.begin();
+       iter != word_ids.end(); ++iter)
+    row_words.Add(*iter);
 
   ++history_item_count_;
-  return true;
+}
+
+void InMemoryURLIndex::RemoveRowFromIndex(HistoryID history_id) {
+  HistoryInfoMap::iterator info_pos = history_info_map_.find(history_id);
+  if (info_pos == history_info_map_.end())
+    return;
+  history_info_map_.erase(info_pos);
+  --history_item_count_;
+
+  HistoryIDWordMap::iterator row_pos = history_id_word_map_.find(history_id);
+  if (row_pos == history_id_word_map_.end())
+    return;
+  WordIDSet word_ids;
+  row_pos->second.AppendTo(&word_ids);
+  for (WordIDSet::const_iterator iter = word_ids.begin();
+       iter != word_ids.end(); ++iter)
+    word_id_history_map_[*iter].Remove(history_id);
+  history_id_word_map_.erase(row_pos);
+}
+
+bool InMemoryURLIndex::RowInFile(HistoryID history_id) const {
+  return index_file_ && !changed_rows_.count(history_id) &&
+      index_file_->HasRow(history_id);
+}
+
+void InMemoryURLIndex::NoteRowChanged(HistoryID history_id) {
+  if (RowInFile(history_id))
+    --history_item_count_;
+  changed_rows_[history_id] = ++change_sequence_;
+}
+
+const URLRow* InMemoryURLIndex::FindRow(HistoryID history_id,
+                                        URLRow* row) const {
+  HistoryInfoMap::const_iterator hist_pos = history_info_map_.find(history_id);
+  if (hist_pos != history_info_map_.end())
+    return &hist_pos->second;
+  if (index_file_ && !changed_rows_.count(history_id) &&
+      index_file_->GetRow(history_id, row))
+    return row;
+  return NULL;
+}
+
+void InMemoryURLIndex::ShrinkPostingLists() {
+  for (CharWordIDMap::iterator iter = char_word_map_.begin();
+       iter != char_word_map_.end(); ++iter)
+    iter->second.Shrink();
+  for (WordIDHistoryMap::iterator iter = word_id_history_map_.begin();
+       iter != word_id_history_map_.end(); ++iter)
+    iter->Shrink();
+  for (HistoryIDWordMap::iterator iter = history_id_word_map_.begin();
+       iter != history_id_word_map_.end(); ++iter)
+    iter->second.Shrink();
 }
 
 bool InMemoryURLIndex::ReloadFromHistory(history::URLDatabase* history_db,
@@ -207,11 +587,14 @@ bool InMemoryURLIndex::ReloadFromHistory(history::URLDatabase* history_db,
     URLDatabase::URLEnumerator history_enum;
     if (!history_db->InitURLEnumeratorForSignificant(&history_enum))
       return false;
+    // The rows come in the order of their IDs, so adding them to the
+    // posting lists only appends.
     URLRow row;
     while (history_enum.GetNextURL(&row)) {
       if (!IndexRow(row))
         return false;
     }
+    ShrinkPostingLists();
     UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexingTime",
                         base::TimeTicks::Now() - beginning_time);
     SaveToCacheFile();
@@ -225,8 +608,16 @@ void InMemoryURLIndex::ClearPrivateData() {
   word_map_.clear();
   char_word_map_.clear();
   word_id_history_map_.clear();
+  history_id_word_map_.clear();
   term_char_word_set_cache_.clear();
   history_info_map_.clear();
+  index_file_ = NULL;
+  changed_rows_.clear();
+  merge_threshold_ = kMaxChangedRowsBeforeMerge;
+  if (cache_merger_) {
+    cache_merger_->Cancel();
+    cache_merger_ = NULL;
+  }
 }
 
 bool InMemoryURLIndex::RestoreFromCacheFile() {
@@ -238,103 +629,175 @@ bool InMemoryURLIndex::RestoreFromCacheFile() {
   FilePath file_path;
   if (!GetCacheFilePath(&file_path) || !file_util::PathExists(file_path))
     return false;
-  std::string data;
-  if (!file_util::ReadFileToString(file_path, &data)) {
-    LOG(WARNING) << "Failed to read InMemoryURLIndex cache from "
-                 << file_path.value();
-    return false;
-  }
-
-  InMemoryURLIndexCacheItem index_cache;
-  if (!index_cache.ParseFromArray(data.c_str(), data.size())) {
-    LOG(WARNING) << "Failed to parse InMemoryURLIndex cache data read from "
+  scoped_refptr<URLIndexFile> index_file(new URLIndexFile);
+  if (!index_file->Open(file_path)) {
+    LOG(WARNING) << "Failed to map InMemoryURLIndex cache from "
                  << file_path.value();
     return false;
   }
 
-  if (!RestorePrivateData(index_cache)) {
-    ClearPrivateData();  // Back to square one -- must build from scratch.
-    return false;
-  }
+  // Nothing is read until the index is queried.
+  ClearPrivateData();
+  index_file_ = index_file;
+  last_saved_ = index_file_->timestamp();
+  history_item_count_ = index_file_->row_count();
 
   UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexRestoreCacheTime",
                       base::TimeTicks::Now() - beginning_time);
   UMA_HISTOGRAM_COUNTS("History.InMemoryURLHistoryItems", history_item_count_);
-  UMA_HISTOGRAM_COUNTS("History.InMemoryURLCacheSize", data.size());
-  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords", word_map_.size());
-  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLChars", char_word_map_.size());
+  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords",
+                             index_file_->word_count());
   return true;
 }
 
 bool InMemoryURLIndex::SaveToCacheFile() {
-  base::TimeTicks beginning_time = base::TimeTicks::Now();
-  InMemoryURLIndexCacheItem index_cache;
-  SavePrivateData(&index_cache);
-  std::string data;
-  if (!index_cache.SerializeToString(&data)) {
-    LOG(WARNING) << "Failed to serialize the InMemoryURLIndex cache.";
+  FilePath file_path;
+  if (!GetCacheFilePath(&file_path))
     return false;
-  }
+  // The file is already up to date.
+  if (index_file_ && changed_rows_.empty() && history_info_map_.empty())
+    return true;
+  StartMerge();
+  return true;
+}
 
-  // Write the cache to a file then swap it for the old cache, if any, and
-  // delete the old cache.
+void InMemoryURLIndex::StartMerge() {
   FilePath file_path;
   if (!GetCacheFilePath(&file_path))
-    return false;
-  file_util::ScopedFILE file(file_util::OpenFile(file_path, "w"));
-  if (!file.get())
-    return false;
+    return;
+  // A newer snapshot includes everything an older one would have merged.
+  if (cache_merger_)
+    cache_merger_->Cancel();
+  // Keep a reference of our own: without a file thread the merger finishes
+  // within Start() and releases |cache_merger_|.
+  scoped_refptr<CacheMerger> merger(
+      new CacheMerger(this, file_path, index_file_, change_sequence_));
+  cache_merger_ = merger;
+  AddToBuilder(merger->builder(), merger->changed());
+  merger->Start();
+}
 
-  int size = data.size();
-  if (file_util::WriteFile(file_path, data.c_str(), size) != size) {
-    LOG(WARNING) << "Failed to write " << file_path.value();
-    return false;
+void InMemoryURLIndex::AddToBuilder(URLIndexFile::Builder* builder,
+                                    std::set<HistoryID>* changed) const {
+  for (HistoryInfoMap::const_iterator iter = history_info_map_.begin();
+       iter != history_info_map_.end(); ++iter)
+    builder->AddRow(iter->second);
+  HistoryIDSet history_ids;
+  for (size_t word_id = 0; word_id < word_id_history_map_.size(); ++word_id) {
+    history_ids.clear();
+    word_id_history_map_[word_id].AppendTo(&history_ids);
+    builder->AddWord(word_list_[word_id], history_ids);
   }
-  UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexSaveCacheTime",
-                      base::TimeTicks::Now() - beginning_time);
-  return true;
+  for (ChangedRowMap::const_iterator iter = changed_rows_.begin();
+       iter != changed_rows_.end(); ++iter)
+    changed->insert(iter->first);
+}
+
+void InMemoryURLIndex::OnCacheFileWritten(URLIndexFile* index_file,
+                                          int change_sequence) {
+  cache_merger_ = NULL;
+  if (!index_file) {
+    // Carry on with the in-memory index. Wait for more changes before trying
+    // again, as the merge starts with a snapshot of the whole in-memory index.
+    merge_threshold_ = std::max(merge_threshold_, changed_rows_.size()) * 2;
+    return;
+  }
+  merge_threshold_ = kMaxChangedRowsBeforeMerge;
+  index_file_ = index_file;
+  last_saved_ = index_file_->timestamp();
+
+  // The file holds every history item in the snapshot; only those changed
+  // since it was taken stay in memory.
+  for (ChangedRowMap::iterator iter = changed_rows_.begin();
+       iter != changed_rows_.end();) {
+    if (iter->second <= change_sequence)
+      changed_rows_.erase(iter++);
+    else
+      ++iter;
+  }
+  // Usually most of the in-memory index has been merged, so rather than take
+  // those rows out one at a time, index the rest afresh.
+  std::vector<std::pair<URLRow, String16Set> > kept_rows;
+  WordIDSet word_ids;
+  for (HistoryInfoMap::const_iterator iter = history_info_map_.begin();
+       iter != history_info_map_.end(); ++iter) {
+    if (!changed_rows_.count(iter->first))
+      continue;
+    kept_rows.push_back(std::make_pair(iter->second, String16Set()));
+    word_ids.clear();
+    history_id_word_map_[iter->first].AppendTo(&word_ids);
+    for (WordIDSet::const_iterator word_iter = word_ids.begin();
+         word_iter != word_ids.end(); ++word_iter)
+      kept_rows.back().second.insert(word_list_[*word_iter]);
+  }
+  word_list_.clear();
+  word_map_.clear();
+  char_word_map_.clear();
+  word_id_history_map_.clear();
+  history_id_word_map_.clear();
+  history_info_map_.clear();
+  for (size_t i = 0; i < kept_rows.size(); ++i)
+    AddRowToIndex(kept_rows[i].first, kept_rows[i].second);
+
+  history_item_count_ = index_file_->row_count() + history_info_map_.size();
+  for (ChangedRowMap::const_iterator iter = changed_rows_.begin();
+       iter != changed_rows_.end(); ++iter) {
+    if (index_file_->HasRow(iter->first))
+      --history_item_count_;
+  }
+  term_char_word_set_cache_.clear();
 }
 
 void InMemoryURLIndex::UpdateURL(URLID row_id, const URLRow& row) {
   // The row may or may not already be in our index. If it is not already
   // indexed and it qualifies then it gets indexed. If it is already
   // indexed and still qualifies then it gets updated, otherwise it
-  // is deleted from the index.
+  // is deleted from the index. A row in the cache file is never changed
+  // there: its new version goes in the in-memory index and hides the old.
   HistoryInfoMap::iterator row_pos = history_info_map_.find(row_id);
-  if (row_pos == history_info_map_.end()) {
+  bool in_file = RowInFile(row_id);
+  if (row_pos == history_info_map_.end() && !in_file) {
     // This new row should be indexed if it qualifies.
-    if (RowQualifiesAsSignificant(row, base::Time()))
+    if (RowQualifiesAsSignificant(row, base::Time())) {
+      NoteRowChanged(row_id);
       IndexRow(row);
+    }
   } else if (RowQualifiesAsSignificant(row, base::Time())) {
     // This indexed row still qualifies and will be re-indexed.
     // The url won't have changed but the title, visit count, etc.
     // might have changed.
-    URLRow& old_row = row_pos->second;
-    old_row.set_visit_count(row.visit_count());
-    old_row.set_typed_count(row.typed_count());
-    old_row.set_last_visit(row.last_visit());
-    // TODO(mrossetti): When we start indexing the title the next line
-    // will need attention.
-    old_row.set_title(row.title());
+    NoteRowChanged(row_id);
+    if (in_file || row_pos->second.title() != row.title()) {
+      // The title's words are indexed, so index the row afresh.
+      IndexRow(row);
+    } else {
+      URLRow& old_row = row_pos->second;
+      old_row.set_visit_count(row.visit_count());
+      old_row.set_typed_count(row.typed_count());
+      old_row.set_last_visit(row.last_visit());
+    }
   } else {
     // This indexed row no longer qualifies and will be de-indexed.
-    history_info_map_.erase(row_id);
+    NoteRowChanged(row_id);
+    RemoveRowFromIndex(row_id);
   }
   // This invalidates the cache.
   term_char_word_set_cache_.clear();
-  // TODO(mrossetti): Record this transaction in the cache.
+  if (changed_rows_.size() >= merge_threshold_ && !cache_merger_)
+    StartMerge();
 }
 
 void InMemoryURLIndex::DeleteURL(URLID row_id) {
-  // Note that this does not remove any reference to this row from the
-  // word_id_history_map_. That map will continue to contain (and return)
-  // hits against this row until that map is rebuilt, but since the
-  // history_info_map_ no longer references the row no erroneous results
-  // will propagate to the user.
-  history_info_map_.erase(row_id);
+  // Words which no longer appear in any row stay in the word list, with
+  // empty posting lists, so that word_ids remain stable.
+  if (!RowInFile(row_id) && !history_info_map_.count(row_id))
+    return;
+  NoteRowChanged(row_id);
+  RemoveRowFromIndex(row_id);
   // This invalidates the word cache.
   term_char_word_set_cache_.clear();
-  // TODO(mrossetti): Record this transaction in the cache.
+  if (changed_rows_.size() >= merge_threshold_ && !cache_merger_)
+    StartMerge();
 }
 
 // Searching
@@ -359,25 +822,22 @@ ScoredHistoryMatches InMemoryURLIndex::HistoryItemsForTerms(
 
     // Don't perform any scoring (and don't return any matches) if the
     // candidate pool is large. (See comments in header.)
-    const size_t kItemsToScoreLimit = 500;
     if (history_id_set.size() <= kItemsToScoreLimit) {
       // Pass over all of the candidates filtering out any without a proper
-      // substring match, inserting those which pass in order by score.
-      scored_items = std::for_each(history_id_set.begin(), history_id_set.end(),
-          AddHistoryMatch(*this, lower_terms)).ScoredMatches();
-
-      // Select and sort only the top kMaxMatches results.
-      if (scored_items.size() > AutocompleteProvider::kMaxMatches) {
-        std::partial_sort(scored_items.begin(),
-                          scored_items.begin() +
-                              AutocompleteProvider::kMaxMatches,
-                          scored_items.end(),
-                          ScoredHistoryMatch::MatchScoreGreater);
-          scored_items.resize(AutocompleteProvider::kMaxMatches);
-      } else {
-        std::sort(scored_items.begin(), scored_items.end(),
-                  ScoredHistoryMatch::MatchScoreGreater);
+      // substring match, keeping only the top kMaxMatches results. Large
+      // pools are shared out among the scoring threads.
+      int helpers = 0;
+      if (history_id_set.size() >= kMinItemsToScoreInParallel &&
+          scoring_threads_ > 0) {
+        if (!scoring_pool_.get()) {
+          scoring_pool_.reset(new base::DelegateSimpleThreadPool(
+              "HistoryQuickScoring", scoring_threads_));
+          scoring_pool_->Start();
+        }
+        helpers = scoring_threads_;
       }
+      ScoringJob job(*this, history_id_set, lower_terms);
+      scored_items = job.Score(scoring_pool_.get(), helpers);
     }
   }
 
@@ -406,41 +866,73 @@ InMemoryURLIndex::HistoryIDSet InMemoryURLIndex::HistoryIDSetFromWords(
   // set for each term, and intersect each to get a final candidate list.
   // Note that a single 'term' from the user's perspective might be
   // a string like "http://www.somewebsite.com" which, from our perspective,
-  // is four words: 'http', 'www', 'somewebsite', and 'com'.
+  // is four words: 'http', 'www', 'somewebsite', and 'com'. The in-memory
+  // index and the cache file are intersected separately, as a history item
+  // is entirely in one or the other.
   HistoryIDSet history_id_set;
+  HistoryIDSet file_history_id_set;
   String16Set words = WordSetFromString16(uni_string);
   bool first_word = true;
   for (String16Set::iterator iter = words.begin();
        iter != words.end(); ++iter) {
     String16Set::value_type uni_word = *iter;
-    HistoryIDSet term_history_id_set =
-        InMemoryURLIndex::HistoryIDsForTerm(uni_word);
+    HistoryIDSet term_history_id_set;
+    HistoryIDSet term_file_history_id_set;
+    HistoryIDsForTerm(uni_word, &term_history_id_set,
+                      &term_file_history_id_set);
     if (first_word) {
       history_id_set.swap(term_history_id_set);
+      file_history_id_set.swap(term_file_history_id_set);
       first_word = false;
     } else {
-      HistoryIDSet old_history_id_set(history_id_set);
-      history_id_set.clear();
-      std::set_intersection(old_history_id_set.begin(),
-                            old_history_id_set.end(),
-                            term_history_id_set.begin(),
-                            term_history_id_set.end(),
-                            std::inserter(history_id_set,
-                                          history_id_set.begin()));
+      history_id_set.erase(
+          std::set_intersection(history_id_set.begin(),
+                                history_id_set.end(),
+                                term_history_id_set.begin(),
+                                term_history_id_set.end(),
+                                history_id_set.begin()),
+          history_id_set.end());
+      file_history_id_set.erase(
+          std::set_intersection(file_history_id_set.begin(),
+                                file_history_id_set.end(),
+                                term_file_history_id_set.begin(),
+                                term_file_history_id_set.end(),
+                                file_history_id_set.begin()),
+          file_history_id_set.end());
     }
+    if (history_id_set.empty() && file_history_id_set.empty())
+      break;
+  }
+  if (file_history_id_set.empty())
+    return history_id_set;
+
+  // Drop the file's copies of the history items changed since it was
+  // written, then add in the in-memory candidates.
+  HistoryIDSet::iterator out = file_history_id_set.begin();
+  for (HistoryIDSet::const_iterator iter = file_history_id_set.begin();
+       iter != file_history_id_set.end(); ++iter) {
+    if (!changed_rows_.count(*iter))
+      *out++ = *iter;
   }
-  return history_id_set;
+  file_history_id_set.erase(out, file_history_id_set.end());
+  HistoryIDSet merged_id_set;
+  merged_id_set.reserve(history_id_set.size() + file_history_id_set.size());
+  std::set_union(history_id_set.begin(), history_id_set.end(),
+                 file_history_id_set.begin(), file_history_id_set.end(),
+                 std::back_inserter(merged_id_set));
+  return merged_id_set;
 }
 
-InMemoryURLIndex::HistoryIDSet InMemoryURLIndex::HistoryIDsForTerm(
-    const string16& uni_word) {
-  InMemoryURLIndex::HistoryIDSet history_id_set;
-
+void InMemoryURLIndex::HistoryIDsForTerm(const string16& uni_word,
+                                         HistoryIDSet* history_id_set,
+                                         HistoryIDSet* file_history_id_set) {
   // For each unique character in the word, in order of first appearance, get
   // the char/word_id map entry and intersect with the set in an incremental
   // manner.
   Char16Vector uni_chars = Char16VectorFromString16(uni_word);
-  WordIDSet word_id_set(WordIDSetForTermChars(uni_chars));
+  WordIDSet word_id_set;
+  WordIDSet file_word_id_set;
+  WordIDSetForTermChars(uni_chars, &word_id_set, &file_word_id_set);
 
   // TODO(mrossetti): At this point, as a possible optimization, we could
   // scan through all candidate words and make sure the |uni_word| is a
@@ -451,20 +943,25 @@ InMemoryURLIndex::HistoryIDSet InMemoryURLIndex::HistoryIDsForTerm(
 
   // If any words resulted then we can compose a set of history IDs by unioning
   // the sets from each word.
-  if (!word_id_set.empty()) {
-    for (WordIDSet::iterator word_id_iter = word_id_set.begin();
-         word_id_iter != word_id_set.end(); ++word_id_iter) {
-      WordID word_id = *word_id_iter;
-      WordIDHistoryMap::iterator word_iter = word_id_history_map_.find(word_id);
-      if (word_iter != word_id_history_map_.end()) {
-        HistoryIDSet& word_history_id_set(word_iter->second);
-        history_id_set.insert(word_history_id_set.begin(),
-                              word_history_id_set.end());
-      }
-    }
+  for (WordIDSet::iterator word_id_iter = word_id_set.begin();
+       word_id_iter != word_id_set.end(); ++word_id_iter)
+    word_id_history_map_[*word_id_iter].AppendTo(history_id_set);
+  if (word_id_set.size() > 1) {
+    std::sort(history_id_set->begin(), history_id_set->end());
+    history_id_set->erase(
+        std::unique(history_id_set->begin(), history_id_set->end()),
+        history_id_set->end());
   }
 
-  return history_id_set;
+  for (WordIDSet::iterator word_id_iter = file_word_id_set.begin();
+       word_id_iter != file_word_id_set.end(); ++word_id_iter)
+    index_file_->HistoryIDsForWord(*word_id_iter).AppendTo(file_history_id_set);
+  if (file_word_id_set.size() > 1) {
+    std::sort(file_history_id_set->begin(), file_history_id_set->end());
+    file_history_id_set->erase(
+        std::unique(file_history_id_set->begin(), file_history_id_set->end()),
+        file_history_id_set->end());
+  }
 }
 
 // Utility Functions
@@ -526,106 +1023,93 @@ InMemoryURLIndex::Char16Set InMemoryURLIndex::Char16SetFromString16(
   return characters;
 }
 
-void InMemoryURLIndex::AddWordToIndex(const string16& uni_word,
-                                      HistoryID history_id) {
+InMemoryURLIndex::WordID InMemoryURLIndex::AddWordToIndex(
+    const string16& uni_word,
+    HistoryID history_id) {
   WordMap::iterator word_pos = word_map_.find(uni_word);
-  if (word_pos != word_map_.end())
-    UpdateWordHistory(word_pos->second, history_id);
-  else
-    AddWordHistory(uni_word, history_id);
+  if (word_pos == word_map_.end())
+    return AddWordHistory(uni_word, history_id);
+  UpdateWordHistory(word_pos->second, history_id);
+  return word_pos->second;
 }
 
 void InMemoryURLIndex::UpdateWordHistory(WordID word_id, HistoryID history_id) {
-    WordIDHistoryMap::iterator history_pos = word_id_history_map_.find(word_id);
-    DCHECK(history_pos != word_id_history_map_.end());
-    HistoryIDSet& history_id_set(history_pos->second);
-    history_id_set.insert(history_id);
+  DCHECK_LT(static_cast<size_t>(word_id), word_id_history_map_.size());
+  word_id_history_map_[word_id].Add(history_id);
 }
 
 // Add a new word to the word list and the word map, and then create a
 // new entry in the word/history map.
-void InMemoryURLIndex::AddWordHistory(const string16& uni_word,
-                                      HistoryID history_id) {
+InMemoryURLIndex::WordID InMemoryURLIndex::AddWordHistory(
+    const string16& uni_word,
+    HistoryID history_id) {
   word_list_.push_back(uni_word);
   WordID word_id = word_list_.size() - 1;
   word_map_[uni_word] = word_id;
-  HistoryIDSet history_id_set;
-  history_id_set.insert(history_id);
-  word_id_history_map_[word_id] = history_id_set;
+  word_id_history_map_.resize(word_list_.size());
+  word_id_history_map_[word_id].Add(history_id);
   // For each character in the newly added word (i.e. a word that is not
-  // already in the word index), add the word to the character index.
+  // already in the word index), add the word to the character index. The
+  // new word_id is the largest yet, so this only appends to the lists.
   Char16Set characters = Char16SetFromString16(uni_word);
   for (Char16Set::iterator uni_char_iter = characters.begin();
-       uni_char_iter != characters.end(); ++uni_char_iter) {
-    Char16Set::value_type uni_char = *uni_char_iter;
-    CharWordIDMap::iterator char_iter = char_word_map_.find(uni_char);
-    if (char_iter != char_word_map_.end()) {
-      // Update existing entry in the char/word index.
-      WordIDSet& word_id_set(char_iter->second);
-      word_id_set.insert(word_id);
-    } else {
-      // Create a new entry in the char/word index.
-      WordIDSet word_id_set;
-      word_id_set.insert(word_id);
-      char_word_map_[uni_char] = word_id_set;
-    }
-  }
+       uni_char_iter != characters.end(); ++uni_char_iter)
+    char_word_map_[*uni_char_iter].Add(word_id);
+  return word_id;
 }
 
-InMemoryURLIndex::WordIDSet InMemoryURLIndex::WordIDSetForTermChars(
-    const InMemoryURLIndex::Char16Vector& uni_chars) {
+void InMemoryURLIndex::WordIDSetForTermChars(
+    const InMemoryURLIndex::Char16Vector& uni_chars,
+    WordIDSet* word_id_set,
+    WordIDSet* file_word_id_set) {
   size_t index = CachedResultsIndexForTerm(uni_chars);
 
   // If there were no unprocessed characters in the search term |uni_chars|
   // then we can use the cached one as-is as the results with no further
   // filtering.
-  if (index != kNoCachedResultForTerm && index == uni_chars.size() - 1)
-    return term_char_word_set_cache_[index].word_id_set_;
+  if (index != kNoCachedResultForTerm && index == uni_chars.size() - 1) {
+    *word_id_set = term_char_word_set_cache_[index].word_id_set_;
+    *file_word_id_set = term_char_word_set_cache_[index].file_word_id_set_;
+    return;
+  }
 
   // Some or all of the characters remain to be indexed so trim the cache.
   if (index + 1 < term_char_word_set_cache_.size())
     term_char_word_set_cache_.resize(index + 1);
-  WordIDSet word_id_set;
   // Take advantage of our cached starting point, if any.
   Char16Vector::const_iterator c_iter = uni_chars.begin();
   if (index != kNoCachedResultForTerm) {
-    word_id_set = term_char_word_set_cache_[index].word_id_set_;
+    *word_id_set = term_char_word_set_cache_[index].word_id_set_;
+    *file_word_id_set = term_char_word_set_cache_[index].file_word_id_set_;
     c_iter += index + 1;
   }
   // Now process the remaining characters in the search term.
   for (; c_iter != uni_chars.end(); ++c_iter) {
     Char16Vector::value_type uni_char = *c_iter;
     CharWordIDMap::iterator char_iter = char_word_map_.find(uni_char);
-    if (char_iter == char_word_map_.end()) {
-      // A character was not found so there are no matching results: bail.
-      word_id_set.clear();
-      break;
-    }
-    WordIDSet& char_word_id_set(char_iter->second);
-    // It is possible for there to no longer be any words associated with
-    // a particular character. Give up in that case.
-    if (char_word_id_set.empty()) {
-      word_id_set.clear();
-      break;
+    if (char_iter == char_word_map_.end())
+      word_id_set->clear();
+    else if (c_iter == uni_chars.begin())
+      char_iter->second.AppendTo(word_id_set);
+    else
+      char_iter->second.IntersectWith(word_id_set);
+
+    if (index_file_) {
+      PostingListRef char_word_id_set(index_file_->WordsForChar(uni_char));
+      if (c_iter == uni_chars.begin())
+        char_word_id_set.AppendTo(file_word_id_set);
+      else
+        char_word_id_set.IntersectWith(file_word_id_set);
     }
 
-    if (word_id_set.empty()) {
-      word_id_set = char_word_id_set;
-    } else {
-      WordIDSet old_word_id_set(word_id_set);
-      word_id_set.clear();
-      std::set_intersection(old_word_id_set.begin(),
-                            old_word_id_set.end(),
-                            char_word_id_set.begin(),
-                            char_word_id_set.end(),
-                            std::inserter(word_id_set,
-                            word_id_set.begin()));
-    }
+    // No words have all the characters so far, so there are no matching
+    // results: bail.
+    if (word_id_set->empty() && file_word_id_set->empty())
+      break;
     // Add this new char/set instance to the cache.
     term_char_word_set_cache_.push_back(TermCharWordSet(
-        uni_char, word_id_set, true));
+        uni_char, *word_id_set, *file_word_id_set, true));
   }
-  return word_id_set;
 }
 
 size_t InMemoryURLIndex::CachedResultsIndexForTerm(
@@ -754,31 +1238,7 @@ ScoredHistoryMatch InMemoryURLIndex::ScoredMatchForURL(
 
   // Factor in recency of visit, visit count and typed count attributes of the
   // URLRow.
-  const int kDaysAgoLevel[] = { 0, 10, 20, 30 };
-  int score = ScoreForValue((base::Time::Now() -
-      row.last_visit()).InDays(), kDaysAgoLevel);
-  const int kVisitCountLevel[] = { 30, 10, 5, 3 };
-  int visit_count_value = ScoreForValue(row.visit_count(), kVisitCountLevel);
-  const int kTypedCountLevel[] = { 10, 5, 3, 1 };
-  int typed_count_value = ScoreForValue(row.typed_count(), kTypedCountLevel);
-
-  // Determine how many of the factors comprising the final score are
-  // significant by summing the relative factors for each and subtracting how
-  // many will be 'discarded' even if they are low.
-  const int kVisitCountMultiplier = 2;
-  const int kTypedCountMultiplier = 3;
-  const int kSignificantFactors =
-      kVisitCountMultiplier +  // Visit count factor plus
-      kTypedCountMultiplier +  // typed count factor plus
-      2 -                      // one each for string match and last visit
-      2;                       // minus 2 insignificant factors.
-  // The following, in effect, discards up to |kSignificantFactors| low scoring
-  // elements which contribute little to the score but which can inordinately
-  // drag down an otherwise good score.
-  match.raw_score = std::min(kScoreRank[0], (term_score + score +
-      (visit_count_value * kVisitCountMultiplier) + (typed_count_value *
-      kTypedCountMultiplier)) / kSignificantFactors);
-
+  match.raw_score = RawScoreForRow(term_score, row);
   return match;
 }
 
@@ -832,30 +1292,6 @@ int InMemoryURLIndex::ScoreComponentForMatches(const TermMatches& matches,
   return ScoreForValue(raw_score, kTermScoreLevel);
 }
 
-InMemoryURLIndex::AddHistoryMatch::AddHistoryMatch(
-    const InMemoryURLIndex& index,
-    const String16Vector& lower_terms)
-  : index_(index),
-    lower_terms_(lower_terms) {
-}
-
-InMemoryURLIndex::AddHistoryMatch::~AddHistoryMatch() {}
-
-void InMemoryURLIndex::AddHistoryMatch::operator()(
-    const InMemoryURLIndex::HistoryID history_id) {
-  HistoryInfoMap::const_iterator hist_pos =
-      index_.history_info_map_.find(history_id);
-  // Note that a history_id may be present in the word_id_history_map_ yet not
-  // be found in the history_info_map_. This occurs when an item has been
-  // deleted by the user or the item no longer qualifies as a quick result.
-  if (hist_pos != index_.history_info_map_.end()) {
-    const URLRow& hist_item = hist_pos->second;
-    ScoredHistoryMatch match(ScoredMatchForURL(hist_item, lower_terms_));
-    if (match.raw_score > 0)
-      scored_matches_.push_back(match);
-  }
-}
-
 bool InMemoryURLIndex::GetCacheFilePath(FilePath* file_path) {
   if (history_dir_.empty())
     return false;
@@ -863,220 +1299,4 @@ bool InMemoryURLIndex::GetCacheFilePath(FilePath* file_path) {
   return true;
 }
 
-void InMemoryURLIndex::SavePrivateData(InMemoryURLIndexCacheItem* cache) const {
-  DCHECK(cache);
-  cache->set_timestamp(base::Time::Now().ToInternalValue());
-  cache->set_history_item_count(history_item_count_);
-  SaveWordList(cache);
-  SaveWordMap(cache);
-  SaveCharWordMap(cache);
-  SaveWordIDHistoryMap(cache);
-  SaveHistoryInfoMap(cache);
-}
-
-bool InMemoryURLIndex::RestorePrivateData(
-    const InMemoryURLIndexCacheItem& cache) {
-  last_saved_ = base::Time::FromInternalValue(cache.timestamp());
-  history_item_count_ = cache.history_item_count();
-  return (history_item_count_ == 0) || (RestoreWordList(cache) &&
-      RestoreWordMap(cache) && RestoreCharWordMap(cache) &&
-      RestoreWordIDHistoryMap(cache) && RestoreHistoryInfoMap(cache));
-}
-
-
-void InMemoryURLIndex::SaveWordList(InMemoryURLIndexCacheItem* cache) const {
-  if (word_list_.empty())
-    return;
-  WordListItem* list_item = cache->mutable_word_list();
-  list_item->set_word_count(word_list_.size());
-  for (String16Vector::const_iterator iter = word_list_.begin();
-       iter != word_list_.end(); ++iter)
-    list_item->add_word(UTF16ToUTF8(*iter));
-}
-
-bool InMemoryURLIndex::RestoreWordList(const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_word_list())
-    return false;
-  const WordListItem& list_item(cache.word_list());
-  uint32 expected_item_count = list_item.word_count();
-  uint32 actual_item_count = list_item.word_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<std::string>& words(list_item.word());
-  for (RepeatedPtrField<std::string>::const_iterator iter = words.begin();
-       iter != words.end(); ++iter)
-    word_list_.push_back(UTF8ToUTF16(*iter));
-  return true;
-}
-
-void InMemoryURLIndex::SaveWordMap(InMemoryURLIndexCacheItem* cache) const {
-  if (word_map_.empty())
-    return;
-  WordMapItem* map_item = cache->mutable_word_map();
-  map_item->set_item_count(word_map_.size());
-  for (WordMap::const_iterator iter = word_map_.begin();
-       iter != word_map_.end(); ++iter) {
-    WordMapEntry* map_entry = map_item->add_word_map_entry();
-    map_entry->set_word(UTF16ToUTF8(iter->first));
-    map_entry->set_word_id(iter->second);
-  }
-}
-
-bool InMemoryURLIndex::RestoreWordMap(const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_word_map())
-    return false;
-  const WordMapItem& list_item(cache.word_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.word_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<WordMapEntry>& entries(list_item.word_map_entry());
-  for (RepeatedPtrField<WordMapEntry>::const_iterator iter = entries.begin();
-       iter != entries.end(); ++iter)
-    word_map_[UTF8ToUTF16(iter->word())] = iter->word_id();
-  return true;
-}
-
-void InMemoryURLIndex::SaveCharWordMap(InMemoryURLIndexCacheItem* cache) const {
-  if (char_word_map_.empty())
-    return;
-  CharWordMapItem* map_item = cache->mutable_char_word_map();
-  map_item->set_item_count(char_word_map_.size());
-  for (CharWordIDMap::const_iterator iter = char_word_map_.begin();
-       iter != char_word_map_.end(); ++iter) {
-    CharWordMapEntry* map_entry = map_item->add_char_word_map_entry();
-    map_entry->set_char_16(iter->first);
-    const WordIDSet& word_id_set(iter->second);
-    map_entry->set_item_count(word_id_set.size());
-    for (WordIDSet::const_iterator set_iter = word_id_set.begin();
-         set_iter != word_id_set.end(); ++set_iter)
-      map_entry->add_word_id(*set_iter);
-  }
-}
-
-bool InMemoryURLIndex::RestoreCharWordMap(
-    const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_char_word_map())
-    return false;
-  const CharWordMapItem& list_item(cache.char_word_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.char_word_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<CharWordMapEntry>&
-      entries(list_item.char_word_map_entry());
-  for (RepeatedPtrField<CharWordMapEntry>::const_iterator iter =
-       entries.begin(); iter != entries.end(); ++iter) {
-    expected_item_count = iter->item_count();
-    actual_item_count = iter->word_id_size();
-    if (actual_item_count == 0 || actual_item_count != expected_item_count)
-      return false;
-    char16 uni_char = static_cast<char16>(iter->char_16());
-    WordIDSet word_id_set;
-    const RepeatedField<int32>& word_ids(iter->word_id());
-    for (RepeatedField<int32>::const_iterator jiter = word_ids.begin();
-         jiter != word_ids.end(); ++jiter)
-      word_id_set.insert(*jiter);
-    char_word_map_[uni_char] = word_id_set;
-  }
-  return true;
-}
-
-void InMemoryURLIndex::SaveWordIDHistoryMap(InMemoryURLIndexCacheItem* cache)
-    const {
-  if (word_id_history_map_.empty())
-    return;
-  WordIDHistoryMapItem* map_item = cache->mutable_word_id_history_map();
-  map_item->set_item_count(word_id_history_map_.size());
-  for (WordIDHistoryMap::const_iterator iter = word_id_history_map_.begin();
-       iter != word_id_history_map_.end(); ++iter) {
-    WordIDHistoryMapEntry* map_entry =
-        map_item->add_word_id_history_map_entry();
-    map_entry->set_word_id(iter->first);
-    const HistoryIDSet& history_id_set(iter->second);
-    map_entry->set_item_count(history_id_set.size());
-    for (HistoryIDSet::const_iterator set_iter = history_id_set.begin();
-         set_iter != history_id_set.end(); ++set_iter)
-      map_entry->add_history_id(*set_iter);
-  }
-}
-
-bool InMemoryURLIndex::RestoreWordIDHistoryMap(
-    const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_word_id_history_map())
-    return false;
-  const WordIDHistoryMapItem& list_item(cache.word_id_history_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.word_id_history_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<WordIDHistoryMapEntry>&
-      entries(list_item.word_id_history_map_entry());
-  for (RepeatedPtrField<WordIDHistoryMapEntry>::const_iterator iter =
-       entries.begin(); iter != entries.end(); ++iter) {
-    expected_item_count = iter->item_count();
-    actual_item_count = iter->history_id_size();
-    if (actual_item_count == 0 || actual_item_count != expected_item_count)
-      return false;
-    WordID word_id = iter->word_id();
-    HistoryIDSet history_id_set;
-    const RepeatedField<int64>& history_ids(iter->history_id());
-    for (RepeatedField<int64>::const_iterator jiter = history_ids.begin();
-         jiter != history_ids.end(); ++jiter)
-      history_id_set.insert(*jiter);
-    word_id_history_map_[word_id] = history_id_set;
-  }
-  return true;
-}
-
-void InMemoryURLIndex::SaveHistoryInfoMap(
-    InMemoryURLIndexCacheItem* cache) const {
-  if (history_info_map_.empty())
-    return;
-  HistoryInfoMapItem* map_item = cache->mutable_history_info_map();
-  map_item->set_item_count(history_info_map_.size());
-  for (HistoryInfoMap::const_iterator iter = history_info_map_.begin();
-       iter != history_info_map_.end(); ++iter) {
-    HistoryInfoMapEntry* map_entry = map_item->add_history_info_map_entry();
-    map_entry->set_history_id(iter->first);
-    const URLRow& url_row(iter->second);
-    // Note: We only save information that contributes to the index so there
-    // is no need to save term_char_word_set_cache_ (not persistent),
-    // languages_, etc.
-    map_entry->set_visit_count(url_row.visit_count());
-    map_entry->set_typed_count(url_row.typed_count());
-    map_entry->set_last_visit(url_row.last_visit().ToInternalValue());
-    map_entry->set_url(url_row.url().spec());
-    map_entry->set_title(UTF16ToUTF8(url_row.title()));
-  }
-}
-
-bool InMemoryURLIndex::RestoreHistoryInfoMap(
-    const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_history_info_map())
-    return false;
-  const HistoryInfoMapItem& list_item(cache.history_info_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.history_info_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<HistoryInfoMapEntry>&
-      entries(list_item.history_info_map_entry());
-  for (RepeatedPtrField<HistoryInfoMapEntry>::const_iterator iter =
-       entries.begin(); iter != entries.end(); ++iter) {
-    HistoryID history_id = iter->history_id();
-    GURL url(iter->url());
-    URLRow url_row(url, history_id);
-    url_row.set_visit_count(iter->visit_count());
-    url_row.set_typed_count(iter->typed_count());
-    url_row.set_last_visit(base::Time::FromInternalValue(iter->last_visit()));
-    if (iter->has_title()) {
-      string16 title(UTF8ToUTF16(iter->title()));
-      url_row.set_title(title);
-    }
-    history_info_map_[history_id] = url_row;
-  }
-  return true;
-}
-
 }  // namespace history
@@ -6,7 +6,6 @@
 #define CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_H_
 #pragma once
 
-#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -17,28 +16,25 @@
 #include "base/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/linked_ptr.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/string16.h"
 #include "chrome/browser/autocomplete/autocomplete_match.h"
 #include "chrome/browser/autocomplete/history_provider_util.h"
 #include "chrome/browser/history/history_types.h"
-#include "chrome/browser/history/in_memory_url_index_cache.pb.h"
+#include "chrome/browser/history/posting_list.h"
+#include "chrome/browser/history/url_index_file.h"
 #include "testing/gtest/include/gtest/gtest_prod.h"
 
 class Profile;
 
 namespace base {
+class DelegateSimpleThreadPool;
 class Time;
 }
 
-namespace in_memory_url_index {
-class InMemoryURLIndexCacheItem;
-}
-
 namespace history {
 
-namespace imui = in_memory_url_index;
-
 class URLDatabase;
 
 // Specifies where an omnibox term occurs within a string. Used for specifying
@@ -93,6 +89,11 @@ typedef std::vector<ScoredHistoryMatch> ScoredHistoryMatches;
 // will eliminate such words except in the case where a single character
 // is being searched on and which character occurs as the second char16 of a
 // multi-char16 instance.
+//
+// Once the index has been saved, it is queried in place in the saved file,
+// which is mapped into memory. The structures described above then hold only
+// the history items added or changed since, and are merged into a new file
+// on the file thread once they grow.
 class InMemoryURLIndex {
  public:
   // |history_dir| is a path to the directory containing the history database
@@ -116,15 +117,15 @@ class InMemoryURLIndex {
   bool ReloadFromHistory(URLDatabase* history_db, bool clear_cache);
 
   // Signals that any outstanding initialization should be canceled and
-  // flushes the cache to disk.
+  // flushes the cache to disk before returning.
   void ShutDown();
 
-  // Restores the index's private data from the cache file stored in the
-  // profile directory and returns true if successful.
+  // Maps the cache file stored in the profile directory and returns true if
+  // successful. The file is then used in place.
   bool RestoreFromCacheFile();
 
-  // Caches the index private data and writes the cache file to the profile
-  // directory.
+  // Writes the whole index to the cache file in the profile directory and
+  // switches to using that file once it is written on the file thread.
   bool SaveToCacheFile();
 
   // Given a vector containing one or more words as string16s, scans the
@@ -139,6 +140,7 @@ class InMemoryURLIndex {
   // of such a large number of candidates may cause perceptible typing response
   // delays in the omnibox. This is likely to occur for short omnibox terms
   // such as 'h' and 'w' which will be found in nearly all history candidates.
+  // Large candidate sets are scored on a few threads at once.
   ScoredHistoryMatches HistoryItemsForTerms(const String16Vector& terms);
 
   // Updates or adds an history item to the index if it meets the minimum
@@ -150,6 +152,13 @@ class InMemoryURLIndex {
   // 'quick' criteria).
   void DeleteURL(URLID row_id);
 
+  // The number of added, changed or deleted history items which prompts
+  // merging them into the cache file.
+  static const size_t kMaxChangedRowsBeforeMerge;
+
+  // The most candidate items a search request will score.
+  static const size_t kItemsToScoreLimit;
+
   // Breaks the |uni_string| string down into individual words and return
   // a vector with the individual words in their original order. If
   // |break_on_space| is false then the resulting list will contain only words
@@ -175,11 +184,17 @@ class InMemoryURLIndex {
       const std::vector<size_t>& offsets);
 
  private:
-  friend class AddHistoryMatch;
+  class CacheMerger;
+  friend class CacheMerger;
+  class ScoringJob;
+  friend class ScoringJob;
+  friend class InMemoryURLIndexPerfTest;
   FRIEND_TEST_ALL_PREFIXES(LimitedInMemoryURLIndexTest, Initialization);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheFilePath);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheSaveRestore);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Char16Utilities);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, DeleteRows);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, MergeChanges);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Scoring);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, StaticFunctions);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, TitleSearch);
@@ -202,16 +217,25 @@ class InMemoryURLIndex {
   // A map allowing a WordID to be determined given a word.
   typedef std::map<string16, WordID> WordMap;
 
-  // A map from character to word_ids.
-  typedef std::set<WordID> WordIDSet;  // An index into the WordList.
-  typedef std::map<char16, WordIDSet> CharWordIDMap;
+  // A sorted vector of indexes into the WordList.
+  typedef std::vector<WordID> WordIDSet;
 
-  // A map from word_id to history item.
-  // TODO(mrossetti): URLID is 64 bit: a memory bloat and performance hit.
-  // Consider using a smaller type.
+  // A map from character to the words containing it. Characters which appear
+  // in most words end up with a bitmap of word_ids.
+  typedef std::map<char16, PostingList> CharWordIDMap;
+
+  // A sorted vector of history items.
   typedef URLID HistoryID;
-  typedef std::set<HistoryID> HistoryIDSet;
-  typedef std::map<WordID, HistoryIDSet> WordIDHistoryMap;
+  typedef std::vector<HistoryID> HistoryIDSet;
+
+  // The history items containing each word, indexed by word_id. The posting
+  // lists are delta-encoded so that a history item costs a byte or two per
+  // word rather than a tree node.
+  typedef std::vector<PostingList> WordIDHistoryMap;
+
+  // The words in each history item, used to take the item out of the index
+  // when it is deleted or updated.
+  typedef std::map<HistoryID, PostingList> HistoryIDWordMap;
 
   // Support caching of term character results so that we can optimize
   // searches which build upon a previous search. Each entry in this vector
@@ -232,25 +256,6 @@ class InMemoryURLIndex {
   // A map from history_id to the history's URL and title.
   typedef std::map<HistoryID, URLRow> HistoryInfoMap;
 
-  // A helper class which performs the final filter on each candidate
-  // history URL match, inserting accepted matches into |scored_matches_|
-  // and trimming the maximum number of matches to 10.
-  class AddHistoryMatch : public std::unary_function<HistoryID, void> {
-   public:
-    AddHistoryMatch(const InMemoryURLIndex& index,
-                    const String16Vector& lower_terms);
-    ~AddHistoryMatch();
-
-    void operator()(const HistoryID history_id);
-
-    ScoredHistoryMatches ScoredMatches() const { return scored_matches_; }
-
-   private:
-    const InMemoryURLIndex& index_;
-    ScoredHistoryMatches scored_matches_;
-    const String16Vector& lower_terms_;
-  };
-
   // Initializes all index data members in preparation for restoring the index
   // from the cache or a complete rebuild from the history database.
   void ClearPrivateData();
@@ -259,10 +264,13 @@ class InMemoryURLIndex {
   static String16Set WordSetFromString16(const string16& uni_string);
 
   // Given a vector of Char16s, representing the characters the user has typed
-  // into the omnibox, finds words containing those characters. If any
-  // existing, cached set is a proper subset then starts with that cached
-  // set. Updates the previously-typed-character cache.
-  WordIDSet WordIDSetForTermChars(const Char16Vector& uni_chars);
+  // into the omnibox, finds words containing those characters: in the
+  // in-memory index in |word_id_set| and in the cache file in
+  // |file_word_id_set|. If any existing, cached set is a proper subset then
+  // starts with that cached set. Updates the previously-typed-character cache.
+  void WordIDSetForTermChars(const Char16Vector& uni_chars,
+                             WordIDSet* word_id_set,
+                             WordIDSet* file_word_id_set);
 
   // Given a vector of Char16s in |uni_chars|, compare those characters, in
   // order, with the previously searched term, returning the index of the
@@ -282,9 +290,33 @@ class InMemoryURLIndex {
 
   // URL History indexing support functions.
 
-  // Indexes one URL history item.
+  // Indexes one URL history item, replacing any previous indexing of it.
   bool IndexRow(const URLRow& row);
 
+  // Adds |row|, whose URL is already formatted, to the index under |words|.
+  void AddRowToIndex(const URLRow& row, const String16Set& words);
+
+  // Takes the history item identified by |history_id| out of the index, if
+  // it is there.
+  void RemoveRowFromIndex(HistoryID history_id);
+
+  // Returns true if |history_id| is in the cache file and hasn't changed
+  // since.
+  bool RowInFile(HistoryID history_id) const;
+
+  // Records that the history item |history_id| has been added, changed or
+  // deleted, which hides any copy of it in the cache file.
+  void NoteRowChanged(HistoryID history_id);
+
+  // Returns the history item |history_id| from the in-memory index or the
+  // cache file, or NULL if there is no such item. |row| holds the item if it
+  // comes from the file.
+  const URLRow* FindRow(HistoryID history_id, URLRow* row) const;
+
+  // Releases the room held by the posting lists for growth; called once the
+  // index has been built in bulk.
+  void ShrinkPostingLists();
+
   // Breaks a string down into unique, individual characters in the order
   // in which the characters are first encountered in the |uni_word| string.
   static Char16Vector Char16VectorFromString16(const string16& uni_word);
@@ -300,16 +332,18 @@ class InMemoryURLIndex {
   static Char16Set Char16SetFromString16(const string16& uni_word);
 
   // Given a single word in |uni_word|, adds a reference for the containing
-  // history item identified by |history_id| to the index.
-  void AddWordToIndex(const string16& uni_word, HistoryID history_id);
+  // history item identified by |history_id| to the index and returns the
+  // word's ID.
+  WordID AddWordToIndex(const string16& uni_word, HistoryID history_id);
 
   // Updates an existing entry in the word/history index by adding the
   // |history_id| to set for |word_id| in the word_id_history_map_.
   void UpdateWordHistory(WordID word_id, HistoryID history_id);
 
   // Creates a new entry in the word/history map for |word_id| and add
-  // |history_id| as the initial element of the word's set.
-  void AddWordHistory(const string16& uni_word, HistoryID history_id);
+  // |history_id| as the initial element of the word's set. Returns the new
+  // word's ID.
+  WordID AddWordHistory(const string16& uni_word, HistoryID history_id);
 
   // Clears the search term cache. This cache holds on to the intermediate
   // word results for each previously typed character to eliminate the need
@@ -320,9 +354,13 @@ class InMemoryURLIndex {
   // in |uni_string|.
   HistoryIDSet HistoryIDSetFromWords(const string16& uni_string);
 
-  // Helper function to HistoryIDSetFromWords which composes a set of history
-  // ids for the given term given in |uni_word|.
-  HistoryIDSet HistoryIDsForTerm(const string16& uni_word);
+  // Helper function to HistoryIDSetFromWords which composes the sets of
+  // history ids for the given term given in |uni_word|: those from the
+  // in-memory index in |history_id_set| and those from the cache file in
+  // |file_history_id_set|.
+  void HistoryIDsForTerm(const string16& uni_word,
+                         HistoryIDSet* history_id_set,
+                         HistoryIDSet* file_history_id_set);
 
   // Calculates a raw score for this history item by first determining
   // if all of the terms in |terms_vector| occur in |row| and, if so,
@@ -356,22 +394,19 @@ class InMemoryURLIndex {
   // provided as a hook for unit testing.)
   bool GetCacheFilePath(FilePath* file_path);
 
-  // Encode a data structure into the protobuf |cache|.
-  void SavePrivateData(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordList(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveCharWordMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordIDHistoryMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveHistoryInfoMap(imui::InMemoryURLIndexCacheItem* cache) const;
-
-  // Decode a data structure from the protobuf |cache|. Return false if there
-  // is any kind of failure.
-  bool RestorePrivateData(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreWordList(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreWordMap(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreCharWordMap(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreWordIDHistoryMap(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreHistoryInfoMap(const imui::InMemoryURLIndexCacheItem& cache);
+  // Adds the history items in the in-memory index to |builder|, and the IDs
+  // of the items changed since the cache file was written to |changed|.
+  void AddToBuilder(URLIndexFile::Builder* builder,
+                    std::set<HistoryID>* changed) const;
+
+  // Merges the in-memory index into a new cache file on the file thread.
+  void StartMerge();
+
+  // Switches to the newly written cache file |index_file|, which holds the
+  // changes up to |change_sequence|, and drops those from the in-memory
+  // index. The remaining rows are indexed afresh, so every in-memory word ID
+  // is reassigned.
+  void OnCacheFileWritten(URLIndexFile* index_file, int change_sequence);
 
   // Directory where cache file resides. This is, except when unit testing,
   // the same directory in which the profile's history database is found. It
@@ -384,24 +419,55 @@ class InMemoryURLIndex {
   // the InMemoryURLIndex was last populated.
   base::Time last_saved_;
 
-  // A list of all of indexed words. The index of a word in this list is the
-  // ID of the word in the word_map_. It reduces the memory overhead by
-  // replacing a potentially long and repeated string with a simple index.
-  // NOTE: A word will _never_ be removed from this vector thus insuring
-  // the immutability of the word_id throughout the session, reducing
-  // maintenance complexity.
+  // A list of all of the words in the in-memory index. The index of a word
+  // in this list is the ID of the word in the word_map_. It reduces the
+  // memory overhead by replacing a potentially long and repeated string with
+  // a simple index.
+  // NOTE: Between cache file writes a word is never removed from this
+  // vector, so a word_id stays valid even after the last history item using
+  // the word is gone. OnCacheFileWritten() clears this list and re-indexes
+  // the rows still held in memory, which compacts the list and assigns new
+  // IDs; IDs must not be kept across that call. The cache file numbers its
+  // words independently.
   // TODO(mrossetti): Profile the vector allocation and determine if judicious
   // 'reserve' calls are called for.
   String16Vector word_list_;
 
   int history_item_count_;
+  // Maps each word in word_list_ to its ID. Rebuilt along with word_list_ by
+  // OnCacheFileWritten().
   WordMap word_map_;
   CharWordIDMap char_word_map_;
   WordIDHistoryMap word_id_history_map_;
+  HistoryIDWordMap history_id_word_map_;
   TermCharWordSetVector term_char_word_set_cache_;
   HistoryInfoMap history_info_map_;
   std::string languages_;
 
+  // The saved index, used in place; NULL until the index is first saved or
+  // restored.
+  scoped_refptr<URLIndexFile> index_file_;
+
+  // The history items added, changed or deleted since |index_file_| was
+  // written, each with the value of |change_sequence_| when it last changed.
+  // The in-memory index holds the current version of those which still
+  // qualify; the copies in the file are ignored.
+  typedef std::map<HistoryID, int> ChangedRowMap;
+  ChangedRowMap changed_rows_;
+  int change_sequence_;
+
+  // How many rows must have changed before a merge is started. Raised after
+  // a merge fails.
+  size_t merge_threshold_;
+
+  // The merge in progress, if any.
+  scoped_refptr<CacheMerger> cache_merger_;
+
+  // The threads which help score large candidate sets, started on first use,
+  // and how many there are.
+  scoped_ptr<base::DelegateSimpleThreadPool> scoring_pool_;
+  int scoring_threads_;
+
   DISALLOW_COPY_AND_ASSIGN(InMemoryURLIndex);
 };
 
@@ -0,0 +1,257 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/process_util.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/in_memory_url_index.h"
+#include "content/browser/browser_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+namespace {
+
+const int kNumURLs = 500000;
+const int kNumHosts = 20000;
+const int kVocabularySize = 50000;
+
+// What the user types, one character at a time, for each query.
+const char* kQueries[] = {
+  "ba",
+  "kolu",
+  "mipakane",
+  "www tesu",
+  "kanomi ropa",
+};
+
+// A deterministic source of numbers, so that every run indexes the same
+// history.
+class Generator {
+ public:
+  Generator() : state_(12345) {}
+
+  int Next(int range) {
+    state_ = state_ * 1103515245 + 12345;
+    return static_cast<int>((state_ >> 16) % range);
+  }
+
+ private:
+  uint32 state_;
+};
+
+// Makes up a pronounceable word, so that words share characters the way
+// real ones do.
+std::string MakeWord(Generator* generator) {
+  static const char kConsonants[] = "bdgklmnprstvz";
+  static const char kVowels[] = "aeiou";
+  std::string word;
+  int syllables = 2 + generator->Next(3);
+  for (int i = 0; i < syllables; ++i) {
+    word.push_back(kConsonants[generator->Next(arraysize(kConsonants) - 1)]);
+    word.push_back(kVowels[generator->Next(arraysize(kVowels) - 1)]);
+  }
+  return word;
+}
+
+size_t WorkingSetSize() {
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+  return metrics->GetWorkingSetSize();
+}
+
+}  // namespace
+
+class InMemoryURLIndexPerfTest : public testing::Test {
+ protected:
+  // Cache files are merged on the "file thread" once the loop is run, so
+  // the tests can time it apart from the changes.
+  InMemoryURLIndexPerfTest()
+      : file_thread_(BrowserThread::FILE, &message_loop_) {
+  }
+
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    url_index_.reset(new InMemoryURLIndex(temp_dir_.path()));
+
+    Generator generator;
+    std::vector<std::string> words;
+    for (int i = 0; i < kVocabularySize; ++i)
+      words.push_back(MakeWord(&generator));
+    // Give the query words a few dozen to a few hundred history items each.
+    words[3000] = "kanomi";
+    words[4000] = "ropa";
+    words[20000] = "kolumbo";
+    words[20001] = "mipakane";
+    words[30000] = "tesuka";
+
+    base::Time now = base::Time::Now();
+    size_t working_set_before = WorkingSetSize();
+    PerfTimeLogger timer("InMemoryURLIndex_build_500k");
+    // Word popularity is skewed, as in real pages: square the pick.
+    for (int i = 0; i < kNumURLs; ++i) {
+      int host = generator.Next(kNumHosts);
+      int r1 = generator.Next(kVocabularySize);
+      int r2 = generator.Next(kVocabularySize);
+      std::string url = "http://www." + words[host % kVocabularySize] +
+          base::IntToString(host) + ".com/" +
+          words[static_cast<int64>(r1) * r1 / kVocabularySize] + "/" +
+          words[static_cast<int64>(r2) * r2 / kVocabularySize] +
+          "?id=" + base::IntToString(i);
+      std::string title;
+      for (int j = 0; j < 4; ++j) {
+        int r = generator.Next(kVocabularySize);
+        title += words[static_cast<int64>(r) * r / kVocabularySize] + " ";
+      }
+      URLRow row(GURL(url), i + 1);
+      row.set_title(UTF8ToUTF16(title));
+      row.set_visit_count(1 + generator.Next(10));
+      row.set_typed_count(generator.Next(2));
+      row.set_last_visit(now - base::TimeDelta::FromHours(generator.Next(48)));
+      // As when the index is rebuilt from the history database.
+      url_index_->IndexRow(row);
+    }
+    url_index_->ShrinkPostingLists();
+    timer.Done();
+    size_t working_set_after = WorkingSetSize();
+    LogPerfResult("InMemoryURLIndex_memory_500k",
+                  static_cast<double>(working_set_after - working_set_before) /
+                      1024, "kb");
+  }
+
+  // Types each query one character at a time, as the omnibox would ask, and
+  // times the whole query.
+  void TypeQueries(InMemoryURLIndex* url_index, const std::string& prefix) {
+    for (size_t i = 0; i < arraysize(kQueries); ++i) {
+      std::string query(kQueries[i]);
+      std::string name(prefix + query);
+      for (size_t j = 0; j < name.size(); ++j) {
+        if (name[j] == ' ')
+          name[j] = '_';
+      }
+      size_t matches = 0;
+      PerfTimeLogger timer(name.c_str());
+      for (size_t length = 1; length <= query.size(); ++length) {
+        InMemoryURLIndex::String16Vector terms =
+            InMemoryURLIndex::WordVectorFromString16(
+                UTF8ToUTF16(query.substr(0, length)), true);
+        matches = url_index->HistoryItemsForTerms(terms).size();
+      }
+      timer.Done();
+      LogPerfResult((name + "_matches").c_str(),
+                    static_cast<double>(matches), "matches");
+    }
+  }
+
+  void SetScoringThreads(int threads) {
+    url_index_->scoring_threads_ = threads;
+  }
+
+  MessageLoop message_loop_;
+  BrowserThread file_thread_;
+  ScopedTempDir temp_dir_;
+  scoped_ptr<InMemoryURLIndex> url_index_;
+};
+
+TEST_F(InMemoryURLIndexPerfTest, TypeQueries) {
+  TypeQueries(url_index_.get(), "InMemoryURLIndex_type_");
+}
+
+// Times each keystroke of each query, scoring on the calling thread alone and
+// then with three helping threads, which must pick the same matches.
+TEST_F(InMemoryURLIndexPerfTest, KeystrokeLatency) {
+  for (size_t i = 0; i < arraysize(kQueries); ++i) {
+    std::string query(kQueries[i]);
+    for (size_t length = 1; length <= query.size(); ++length) {
+      InMemoryURLIndex::String16Vector terms =
+          InMemoryURLIndex::WordVectorFromString16(
+              UTF8ToUTF16(query.substr(0, length)), true);
+      std::string name("InMemoryURLIndex_keystroke_" +
+                       base::IntToString(i) + "_" +
+                       base::IntToString(length));
+
+      // Run each query once first so that the character and word caches are
+      // in the same state for both timings.
+      url_index_->HistoryItemsForTerms(terms);
+
+      SetScoringThreads(0);
+      base::TimeTicks start = base::TimeTicks::Now();
+      ScoredHistoryMatches sequential = url_index_->HistoryItemsForTerms(terms);
+      LogPerfResult((name + "_sequential").c_str(),
+                    (base::TimeTicks::Now() - start).InMillisecondsF(), "ms");
+
+      SetScoringThreads(3);
+      start = base::TimeTicks::Now();
+      ScoredHistoryMatches parallel = url_index_->HistoryItemsForTerms(terms);
+      LogPerfResult((name + "_parallel").c_str(),
+                    (base::TimeTicks::Now() - start).InMillisecondsF(), "ms");
+
+      ASSERT_EQ(sequential.size(), parallel.size());
+      for (size_t j = 0; j < sequential.size(); ++j) {
+        EXPECT_EQ(sequential[j].url_info.id(), parallel[j].url_info.id());
+        EXPECT_EQ(sequential[j].raw_score, parallel[j].raw_score);
+      }
+    }
+  }
+}
+
+// Deleting rows now takes them out of the posting lists.
+TEST_F(InMemoryURLIndexPerfTest, DeleteURLs) {
+  PerfTimeLogger timer("InMemoryURLIndex_delete_10k");
+  for (int i = 0; i < 10000; ++i)
+    url_index_->DeleteURL(1 + i * (kNumURLs / 10000));
+  timer.Done();
+  PerfTimeLogger merge_timer("InMemoryURLIndex_merge_500k");
+  message_loop_.RunAllPending();
+  merge_timer.Done();
+}
+
+// Saves the index, then times how long a new index takes to map the file and
+// answer its first query, as at browser startup. The file is likely still in
+// the page cache, so this doesn't count disk reads.
+TEST_F(InMemoryURLIndexPerfTest, ColdStart) {
+  InMemoryURLIndex::String16Vector terms =
+      InMemoryURLIndex::WordVectorFromString16(ASCIIToUTF16("kanomi ropa"),
+                                               true);
+  size_t expected_matches = url_index_->HistoryItemsForTerms(terms).size();
+
+  PerfTimeLogger save_timer("InMemoryURLIndex_save_500k");
+  ASSERT_TRUE(url_index_->SaveToCacheFile());
+  message_loop_.RunAllPending();
+  save_timer.Done();
+  url_index_.reset();
+
+  size_t working_set_before = WorkingSetSize();
+  InMemoryURLIndex restored_index(temp_dir_.path());
+  PerfTimeLogger timer("InMemoryURLIndex_first_query_500k");
+  ASSERT_TRUE(restored_index.RestoreFromCacheFile());
+  size_t matches = restored_index.HistoryItemsForTerms(terms).size();
+  timer.Done();
+  EXPECT_EQ(expected_matches, matches);
+
+  TypeQueries(&restored_index, "InMemoryURLIndex_mapped_type_");
+  LogPerfResult("InMemoryURLIndex_mapped_memory_500k",
+                static_cast<double>(WorkingSetSize() - working_set_before) /
+                    1024, "kb");
+
+  // Changes go to memory and are merged into the file in the background.
+  PerfTimeLogger delete_timer("InMemoryURLIndex_mapped_delete_10k");
+  for (int i = 0; i < 10000; ++i)
+    restored_index.DeleteURL(1 + i * (kNumURLs / 10000));
+  delete_timer.Done();
+  PerfTimeLogger merge_timer("InMemoryURLIndex_mapped_merge");
+  message_loop_.RunAllPending();
+  merge_timer.Done();
+}
+
+}  // namespace history
@@ -14,10 +14,12 @@
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_temp_dir.h"
 #include "base/path_service.h"
 #include "base/string_util.h"
 #include "base/time.h"
 #include "base/utf_string_conversions.h"
+#include "chrome/browser/autocomplete/autocomplete.h"
 #include "chrome/browser/history/in_memory_url_index.h"
 #include "chrome/browser/history/in_memory_database.h"
 #include "chrome/common/chrome_paths.h"
@@ -145,14 +147,14 @@ class ExpandedInMemoryURLIndexTest : public InMemoryURLIndexTest {
  protected:
   virtual void SetUp() {
     InMemoryURLIndexTest::SetUp();
-    // Add 600 more history items.
+    // Add more history items than will be scored.
     // NOTE: Keep the string length constant at least the length of the format
-    // string plus 5 to account for a 3 digit number and terminator.
+    // string plus 5 to account for a 5 digit number and terminator.
     char url_format[] = "http://www.google.com/%d";
     const size_t kMaxLen = arraysize(url_format) + 5;
     char url_string[kMaxLen + 1];
-    for (int i = 0; i < 600; ++i) {
-      base::snprintf(url_string, kMaxLen, url_format, i);
+    for (size_t i = 0; i < InMemoryURLIndex::kItemsToScoreLimit + 100; ++i) {
+      base::snprintf(url_string, kMaxLen, url_format, static_cast<int>(i));
       URLRow row(MakeURLRow(url_string, "Google Search", 20, 0, 20));
       AddURL(row);
     }
@@ -475,6 +477,41 @@ TEST_F(InMemoryURLIndexTest, Scoring) {
   EXPECT_GT(scored_h.raw_score, scored_a.raw_score);
 }
 
+TEST_F(InMemoryURLIndexTest, RepeatedTermsOutscoreVisits) {
+  url_index_.reset(new InMemoryURLIndex(FilePath(FILE_PATH_LITERAL("/dummy"))));
+  url_index_->Init(this, "en,ja,hi,zh");
+
+  // More than a chunk of candidates which are visited often but match each
+  // term once...
+  char url_string[64];
+  for (int i = 0; i < 200; ++i) {
+    base::snprintf(url_string, arraysize(url_string),
+                   "http://www.frequent%d.com/zorp/quux", i);
+    URLRow row(GURL(url_string), 1000 + i);
+    row.set_visit_count(5);
+    row.set_typed_count(1);
+    row.set_last_visit(base::Time::Now());
+    url_index_->UpdateURL(row.id(), row);
+  }
+  // ... and one, scored after them, which is hardly visited but matches
+  // both terms over and over. Term matches can make up for more than the
+  // visits can.
+  URLID repeated_row_id = 5000;
+  URLRow repeated_row(
+      GURL("http://zorpquuxzorpquuxzorpquuxzorpquuxzorpquuxzorpquux.com/"),
+      repeated_row_id);
+  repeated_row.set_visit_count(4);
+  repeated_row.set_last_visit(base::Time::Now() -
+                              base::TimeDelta::FromDays(60));
+  url_index_->UpdateURL(repeated_row_id, repeated_row);
+
+  ScoredHistoryMatches matches =
+      url_index_->HistoryItemsForTerms(Make2Terms("zorp", "quux"));
+  ASSERT_EQ(AutocompleteProvider::kMaxMatches, matches.size());
+  EXPECT_EQ(repeated_row_id, matches[0].url_info.id());
+  EXPECT_GT(matches[0].raw_score, matches[1].raw_score);
+}
+
 TEST_F(InMemoryURLIndexTest, AddNewRows) {
   url_index_.reset(new InMemoryURLIndex(FilePath(FILE_PATH_LITERAL("/dummy"))));
   url_index_->Init(this, "en,ja,hi,zh");
@@ -498,6 +535,17 @@ TEST_F(InMemoryURLIndexTest, AddNewRows) {
   // Add it again just to be sure that is harmless.
   url_index_->UpdateURL(new_row_id, new_row);
   EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(terms).size());
+
+  // Retitle it: the new title's words are found and the old ones aren't.
+  new_row.set_title(ASCIIToUTF16("Saskatchewanderer"));
+  url_index_->UpdateURL(new_row_id, new_row);
+  InMemoryURLIndex::String16Vector title_terms;
+  title_terms.push_back(ASCIIToUTF16("saskatchewanderer"));
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(title_terms).size());
+  new_row.set_title(ASCIIToUTF16("Manitobasaurus"));
+  url_index_->UpdateURL(new_row_id, new_row);
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(title_terms).empty());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(terms).size());
 }
 
 TEST_F(InMemoryURLIndexTest, DeleteRows) {
@@ -511,8 +559,24 @@ TEST_F(InMemoryURLIndexTest, DeleteRows) {
   ASSERT_EQ(1U, matches.size());
 
   // Determine the row id for that result, delete that id, then search again.
-  url_index_->DeleteURL(matches[0].url_info.id());
+  int history_item_count = url_index_->history_item_count_;
+  URLID row_id = matches[0].url_info.id();
+  url_index_->DeleteURL(row_id);
   EXPECT_TRUE(url_index_->HistoryItemsForTerms(terms).empty());
+
+  // The row is gone from the word index too, not just hidden.
+  EXPECT_EQ(history_item_count - 1, url_index_->history_item_count_);
+  EXPECT_TRUE(url_index_->history_id_word_map_.end() ==
+              url_index_->history_id_word_map_.find(row_id));
+  InMemoryURLIndex::WordMap::const_iterator word_pos =
+      url_index_->word_map_.find(ASCIIToUTF16("drudgereport"));
+  ASSERT_TRUE(url_index_->word_map_.end() != word_pos);
+  EXPECT_FALSE(
+      url_index_->word_id_history_map_[word_pos->second].Contains(row_id));
+
+  // Deleting it again is harmless.
+  url_index_->DeleteURL(row_id);
+  EXPECT_EQ(history_item_count - 1, url_index_->history_item_count_);
 }
 
 TEST_F(InMemoryURLIndexTest, CacheFilePath) {
@@ -532,92 +596,155 @@ TEST_F(InMemoryURLIndexTest, CacheFilePath) {
 }
 
 TEST_F(InMemoryURLIndexTest, CacheSaveRestore) {
-  // Save the cache to a protobuf, restore it, and compare the results.
+  // Build an index in memory only, for comparison.
   url_index_.reset(new InMemoryURLIndex(FilePath(FILE_PATH_LITERAL("/dummy"))));
-  InMemoryURLIndex& url_index(*(url_index_.get()));
-  url_index.Init(this, "en,ja,hi,zh");
-  in_memory_url_index::InMemoryURLIndexCacheItem index_cache;
-  url_index.SavePrivateData(&index_cache);
-
-  // Capture our private data so we can later compare for equality.
-  int history_item_count(url_index.history_item_count_);
-  InMemoryURLIndex::String16Vector word_list(url_index.word_list_);
-  InMemoryURLIndex::WordMap word_map(url_index.word_map_);
-  InMemoryURLIndex::CharWordIDMap char_word_map(url_index.char_word_map_);
-  InMemoryURLIndex::WordIDHistoryMap word_id_history_map(
-      url_index.word_id_history_map_);
+  url_index_->Init(this, "en,ja,hi,zh");
   InMemoryURLIndex::HistoryInfoMap history_info_map(
-      url_index.history_info_map_);
-
-  // Prove that there is really something there.
-  EXPECT_GT(url_index.history_item_count_, 0);
-  EXPECT_FALSE(url_index.word_list_.empty());
-  EXPECT_FALSE(url_index.word_map_.empty());
-  EXPECT_FALSE(url_index.char_word_map_.empty());
-  EXPECT_FALSE(url_index.word_id_history_map_.empty());
-  EXPECT_FALSE(url_index.history_info_map_.empty());
-
-  // Clear and then prove it's clear.
-  url_index.ClearPrivateData();
-  EXPECT_EQ(0, url_index.history_item_count_);
-  EXPECT_TRUE(url_index.word_list_.empty());
-  EXPECT_TRUE(url_index.word_map_.empty());
-  EXPECT_TRUE(url_index.char_word_map_.empty());
-  EXPECT_TRUE(url_index.word_id_history_map_.empty());
-  EXPECT_TRUE(url_index.history_info_map_.empty());
-
-  // Restore the cache.
-  EXPECT_TRUE(url_index.RestorePrivateData(index_cache));
-
-  // Compare the restored and captured for equality.
-  EXPECT_EQ(history_item_count, url_index.history_item_count_);
-  EXPECT_EQ(word_list.size(), url_index.word_list_.size());
-  EXPECT_EQ(word_map.size(), url_index.word_map_.size());
-  EXPECT_EQ(char_word_map.size(), url_index.char_word_map_.size());
-  EXPECT_EQ(word_id_history_map.size(), url_index.word_id_history_map_.size());
-  EXPECT_EQ(history_info_map.size(), url_index.history_info_map_.size());
-  // WordList must be index-by-index equal.
-  size_t count = word_list.size();
-  for (size_t i = 0; i < count; ++i)
-    EXPECT_EQ(word_list[i], url_index.word_list_[i]);
-  for (InMemoryURLIndex::CharWordIDMap::const_iterator expected =
-        char_word_map.begin(); expected != char_word_map.end(); ++expected) {
-    InMemoryURLIndex::CharWordIDMap::const_iterator actual =
-        url_index.char_word_map_.find(expected->first);
-    ASSERT_TRUE(url_index.char_word_map_.end() != actual);
-    const InMemoryURLIndex::WordIDSet& expected_set(expected->second);
-    const InMemoryURLIndex::WordIDSet& actual_set(actual->second);
-    ASSERT_EQ(expected_set.size(), actual_set.size());
-    for (InMemoryURLIndex::WordIDSet::const_iterator set_iter =
-        expected_set.begin(); set_iter != expected_set.end(); ++set_iter)
-      EXPECT_GT(actual_set.count(*set_iter), 0U);
-  }
-  for (InMemoryURLIndex::WordIDHistoryMap::const_iterator expected =
-      word_id_history_map.begin(); expected != word_id_history_map.end();
-      ++expected) {
-    InMemoryURLIndex::WordIDHistoryMap::const_iterator actual =
-        url_index.word_id_history_map_.find(expected->first);
-    ASSERT_TRUE(url_index.word_id_history_map_.end() != actual);
-    const InMemoryURLIndex::HistoryIDSet& expected_set(expected->second);
-    const InMemoryURLIndex::HistoryIDSet& actual_set(actual->second);
-    ASSERT_EQ(expected_set.size(), actual_set.size());
-    for (InMemoryURLIndex::HistoryIDSet::const_iterator set_iter =
-        expected_set.begin(); set_iter != expected_set.end(); ++set_iter)
-      EXPECT_GT(actual_set.count(*set_iter), 0U);
-  }
+      url_index_->history_info_map_);
+  EXPECT_FALSE(history_info_map.empty());
+  EXPECT_TRUE(url_index_->index_file_.get() == NULL);
+
+  // Building the index where it can be saved switches it to the cache file.
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  InMemoryURLIndex saved_index(temp_dir.path());
+  saved_index.Init(this, "en,ja,hi,zh");
+  ASSERT_TRUE(saved_index.index_file_.get() != NULL);
+  EXPECT_TRUE(saved_index.history_info_map_.empty());
+  EXPECT_TRUE(saved_index.word_list_.empty());
+  EXPECT_EQ(url_index_->history_item_count_, saved_index.history_item_count_);
+
+  // Map the file from another index and compare it with the original.
+  InMemoryURLIndex restored_index(temp_dir.path());
+  ASSERT_TRUE(restored_index.RestoreFromCacheFile());
+  ASSERT_TRUE(restored_index.index_file_.get() != NULL);
+  EXPECT_EQ(url_index_->history_item_count_,
+            restored_index.history_item_count_);
+  EXPECT_EQ(history_info_map.size(), restored_index.index_file_->row_count());
   for (InMemoryURLIndex::HistoryInfoMap::const_iterator expected =
       history_info_map.begin(); expected != history_info_map.end();
       ++expected) {
-    InMemoryURLIndex::HistoryInfoMap::const_iterator actual =
-        url_index.history_info_map_.find(expected->first);
-    ASSERT_FALSE(url_index.history_info_map_.end() == actual);
+    URLRow actual_row;
+    ASSERT_TRUE(restored_index.index_file_->GetRow(expected->first,
+                                                   &actual_row));
     const URLRow& expected_row(expected->second);
-    const URLRow& actual_row(actual->second);
+    EXPECT_EQ(expected_row.id(), actual_row.id());
     EXPECT_EQ(expected_row.visit_count(), actual_row.visit_count());
     EXPECT_EQ(expected_row.typed_count(), actual_row.typed_count());
     EXPECT_EQ(expected_row.last_visit(), actual_row.last_visit());
     EXPECT_EQ(expected_row.url(), actual_row.url());
+    EXPECT_EQ(expected_row.title(), actual_row.title());
+  }
+
+  // Queries give the same answers from the file as from memory.
+  const char* kQueries[] = { "drudgereport", "drudge", "nearlyperfectresult",
+                             "ice", "w", "z", "mortgage" };
+  for (size_t i = 0; i < arraysize(kQueries); ++i) {
+    InMemoryURLIndex::String16Vector terms;
+    terms.push_back(ASCIIToUTF16(kQueries[i]));
+    ScoredHistoryMatches expected = url_index_->HistoryItemsForTerms(terms);
+    ScoredHistoryMatches actual = restored_index.HistoryItemsForTerms(terms);
+    ASSERT_EQ(expected.size(), actual.size()) << kQueries[i];
+    for (size_t j = 0; j < expected.size(); ++j) {
+      EXPECT_EQ(expected[j].url_info.id(), actual[j].url_info.id());
+      EXPECT_EQ(expected[j].raw_score, actual[j].raw_score);
+    }
   }
+
+  // A file which isn't an index is rejected.
+  FilePath cache_path;
+  ASSERT_TRUE(restored_index.GetCacheFilePath(&cache_path));
+  ASSERT_EQ(4, file_util::WriteFile(cache_path, "junk", 4));
+  InMemoryURLIndex junk_index(temp_dir.path());
+  EXPECT_FALSE(junk_index.RestoreFromCacheFile());
+}
+
+TEST_F(InMemoryURLIndexTest, MergeChanges) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  url_index_.reset(new InMemoryURLIndex(temp_dir.path()));
+  url_index_->Init(this, "en,ja,hi,zh");
+  ASSERT_TRUE(url_index_->index_file_.get() != NULL);
+  int history_item_count = url_index_->history_item_count_;
+
+  InMemoryURLIndex::String16Vector terms;
+  terms.push_back(ASCIIToUTF16("drudgereport"));
+  ScoredHistoryMatches matches = url_index_->HistoryItemsForTerms(terms);
+  ASSERT_EQ(1U, matches.size());
+  URLRow file_row(matches[0].url_info);
+  URLID file_row_id = file_row.id();
+
+  // Retitle a row from the file: the new version hides the old one.
+  file_row.set_title(ASCIIToUTF16("Saskatchewanderer"));
+  file_row.set_last_visit(base::Time::Now());
+  url_index_->UpdateURL(file_row_id, file_row);
+  InMemoryURLIndex::String16Vector title_terms;
+  title_terms.push_back(ASCIIToUTF16("saskatchewanderer"));
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(title_terms).size());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(terms).size());
+  EXPECT_EQ(history_item_count, url_index_->history_item_count_);
+
+  // Add a new row.
+  URLID new_row_id = 87654321;
+  URLRow new_row(GURL("http://www.brokeandaloneinmanitoba.com/"), new_row_id);
+  new_row.set_last_visit(base::Time::Now());
+  url_index_->UpdateURL(new_row_id, new_row);
+  InMemoryURLIndex::String16Vector new_terms;
+  new_terms.push_back(ASCIIToUTF16("brokeandalone"));
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(new_terms).size());
+  EXPECT_EQ(history_item_count + 1, url_index_->history_item_count_);
+
+  // Delete another row which is only in the file.
+  InMemoryURLIndex::String16Vector deleted_terms;
+  deleted_terms.push_back(ASCIIToUTF16("drudge"));
+  matches = url_index_->HistoryItemsForTerms(deleted_terms);
+  ASSERT_EQ(2U, matches.size());
+  URLID deleted_row_id = matches[0].url_info.id() == file_row_id ?
+      matches[1].url_info.id() : matches[0].url_info.id();
+  url_index_->DeleteURL(deleted_row_id);
+  matches = url_index_->HistoryItemsForTerms(deleted_terms);
+  ASSERT_EQ(1U, matches.size());
+  EXPECT_EQ(file_row_id, matches[0].url_info.id());
+  EXPECT_EQ(history_item_count, url_index_->history_item_count_);
+  EXPECT_EQ(3U, url_index_->changed_rows_.size());
+
+  // Merge the changes into a new file; the answers stay the same.
+  ASSERT_TRUE(url_index_->SaveToCacheFile());
+  EXPECT_TRUE(url_index_->changed_rows_.empty());
+  EXPECT_TRUE(url_index_->history_info_map_.empty());
+  EXPECT_EQ(history_item_count, url_index_->history_item_count_);
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(title_terms).size());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(new_terms).size());
+  EXPECT_EQ(1U, url_index_->HistoryItemsForTerms(deleted_terms).size());
+
+  // And so does the new file when mapped afresh.
+  InMemoryURLIndex restored_index(temp_dir.path());
+  ASSERT_TRUE(restored_index.RestoreFromCacheFile());
+  EXPECT_EQ(history_item_count, restored_index.history_item_count_);
+  EXPECT_EQ(1U, restored_index.HistoryItemsForTerms(title_terms).size());
+  EXPECT_EQ(1U, restored_index.HistoryItemsForTerms(new_terms).size());
+  EXPECT_EQ(1U, restored_index.HistoryItemsForTerms(deleted_terms).size());
+}
+
+TEST_F(InMemoryURLIndexTest, ShutDownWritesCache) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  url_index_.reset(new InMemoryURLIndex(temp_dir.path()));
+  url_index_->Init(this, "en,ja,hi,zh");
+
+  // A change made just before shutting down is in the cache afterwards.
+  URLID new_row_id = 87654321;
+  URLRow new_row(GURL("http://www.brokeandaloneinmanitoba.com/"), new_row_id);
+  new_row.set_last_visit(base::Time::Now());
+  url_index_->UpdateURL(new_row_id, new_row);
+  url_index_->ShutDown();
+  url_index_.reset();
+
+  InMemoryURLIndex restored_index(temp_dir.path());
+  ASSERT_TRUE(restored_index.RestoreFromCacheFile());
+  InMemoryURLIndex::String16Vector terms;
+  terms.push_back(ASCIIToUTF16("brokeandalone"));
+  EXPECT_EQ(1U, restored_index.HistoryItemsForTerms(terms).size());
 }
 
 }  // namespace history
@@ -0,0 +1,184 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/posting_list.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+// Short lists aren't worth turning into bitmaps.
+const uint32 kMinBitmapListSize = 64;
+
+// A bitmap isn't extended past this many bytes per ID in the list; sparser
+// lists go back to being encoded.
+const size_t kMaxBitmapBytesPerID = 2;
+
+}  // namespace
+
+namespace history {
+
+PostingListRef::PostingListRef()
+    : data_(NULL),
+      length_(0),
+      size_(0),
+      last_(0),
+      is_bitmap_(false) {
+}
+
+PostingListRef::PostingListRef(const uint8* data,
+                               size_t length,
+                               uint32 size,
+                               uint64 last,
+                               bool is_bitmap)
+    : data_(data),
+      length_(length),
+      size_(size),
+      last_(last),
+      is_bitmap_(is_bitmap) {
+}
+
+bool PostingListRef::Contains(uint64 id) const {
+  if (is_bitmap_)
+    return id / 8 < length_ && (data_[id / 8] & (1 << (id % 8)));
+
+  if (size_ == 0 || id > last_)
+    return false;
+  const uint8* pos = data_;
+  const uint8* end = data_ + length_;
+  uint64 current = 0;
+  for (uint32 i = 0; i < size_ && pos < end; ++i) {
+    current += ReadVarint(&pos, end);
+    if (current >= id)
+      return current == id;
+  }
+  return false;
+}
+
+PostingList::PostingList()
+    : last_(0),
+      size_(0),
+      is_bitmap_(false) {
+}
+
+PostingList::~PostingList() {
+}
+
+void PostingList::Add(uint64 id) {
+  if (is_bitmap_) {
+    if (id >= data_.size() * 8) {
+      size_t bitmap_size = static_cast<size_t>(id / 8) + 1;
+      if (bitmap_size > (size_ + 1) * kMaxBitmapBytesPerID) {
+        std::vector<uint64> ids;
+        AppendTo(&ids);
+        ids.push_back(id);
+        is_bitmap_ = false;
+        Assign(ids);
+        return;
+      }
+      data_.resize(bitmap_size);
+    }
+    uint8& byte = data_[id / 8];
+    uint8 mask = 1 << (id % 8);
+    if (!(byte & mask)) {
+      byte |= mask;
+      ++size_;
+      last_ = std::max(last_, id);
+    }
+    return;
+  }
+
+  if (size_ && id == last_)
+    return;
+  if (size_ == 0 || id > last_) {
+    AppendVarint(size_ ? id - last_ : id);
+    last_ = id;
+    ++size_;
+    if (size_ >= kMinBitmapListSize && data_.size() > BitmapSize())
+      ConvertToBitmap();
+    return;
+  }
+
+  std::vector<uint64> ids;
+  AppendTo(&ids);
+  std::vector<uint64>::iterator it =
+      std::lower_bound(ids.begin(), ids.end(), id);
+  if (it != ids.end() && *it == id)
+    return;
+  ids.insert(it, id);
+  Assign(ids);
+}
+
+void PostingList::Remove(uint64 id) {
+  if (is_bitmap_) {
+    if (id >= data_.size() * 8)
+      return;
+    uint8& byte = data_[id / 8];
+    uint8 mask = 1 << (id % 8);
+    if (byte & mask) {
+      byte &= ~mask;
+      --size_;
+    }
+    return;
+  }
+
+  if (size_ == 0 || id > last_)
+    return;
+  std::vector<uint64> ids;
+  AppendTo(&ids);
+  std::vector<uint64>::iterator it =
+      std::lower_bound(ids.begin(), ids.end(), id);
+  if (it == ids.end() || *it != id)
+    return;
+  ids.erase(it);
+  Assign(ids);
+}
+
+PostingListRef PostingList::ref() const {
+  return PostingListRef(data_.empty() ? NULL : &data_[0], data_.size(), size_,
+                        last_, is_bitmap_);
+}
+
+void PostingList::Shrink() {
+  std::vector<uint8>(data_).swap(data_);
+}
+
+void PostingList::AppendVarint(uint64 value) {
+  while (value >= 0x80) {
+    data_.push_back(static_cast<uint8>(value) | 0x80);
+    value >>= 7;
+  }
+  data_.push_back(static_cast<uint8>(value));
+}
+
+void PostingList::Assign(const std::vector<uint64>& ids) {
+  DCHECK(!is_bitmap_);
+  data_.clear();
+  size_ = 0;
+  last_ = 0;
+  for (std::vector<uint64>::const_iterator it = ids.begin();
+       it != ids.end(); ++it) {
+    DCHECK(size_ == 0 || *it > last_);
+    AppendVarint(size_ ? *it - last_ : *it);
+    last_ = *it;
+    ++size_;
+  }
+  if (size_ >= kMinBitmapListSize && data_.size() > BitmapSize())
+    ConvertToBitmap();
+}
+
+void PostingList::ConvertToBitmap() {
+  std::vector<uint64> ids;
+  AppendTo(&ids);
+  std::vector<uint8> bitmap(BitmapSize());
+  for (std::vector<uint64>::const_iterator it = ids.begin();
+       it != ids.end(); ++it)
+    bitmap[*it / 8] |= 1 << (*it % 8);
+  data_.swap(bitmap);
+  is_bitmap_ = true;
+}
+
+}  // namespace history
@@ -0,0 +1,204 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_POSTING_LIST_H_
+#define CHROME_BROWSER_HISTORY_POSTING_LIST_H_
+#pragma once
+
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace history {
+
+// A read-only view of a posting list's encoded IDs: those of a PostingList
+// or those saved in a file, which are used in place. Reads never go past
+// |length| bytes, so a view of a corrupt file gives wrong IDs but is safe.
+class PostingListRef {
+ public:
+  PostingListRef();
+  PostingListRef(const uint8* data,
+                 size_t length,
+                 uint32 size,
+                 uint64 last,
+                 bool is_bitmap);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  bool Contains(uint64 id) const;
+
+  // Appends the IDs in the list, in ascending order, to |ids|.
+  template <typename T>
+  void AppendTo(std::vector<T>* ids) const;
+
+  // Removes the IDs which aren't in the list from |ids|, which must be
+  // sorted.
+  template <typename T>
+  void IntersectWith(std::vector<T>* ids) const;
+
+  // The encoding, for saving the list.
+  const uint8* data() const { return data_; }
+  size_t length() const { return length_; }
+  uint64 last() const { return last_; }
+  bool is_bitmap() const { return is_bitmap_; }
+
+ private:
+  friend class PostingList;
+
+  // Decodes the varint at |*pos| and advances |*pos| past it, stopping at
+  // |end|.
+  static uint64 ReadVarint(const uint8** pos, const uint8* end) {
+    uint64 value = 0;
+    int shift = 0;
+    while (*pos < end && shift < 64) {
+      uint8 byte = **pos;
+      ++*pos;
+      value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        break;
+      shift += 7;
+    }
+    return value;
+  }
+
+  const uint8* data_;
+  size_t length_;
+  uint32 size_;
+  uint64 last_;
+  bool is_bitmap_;
+};
+
+// A set of non-negative IDs, as used by the InMemoryURLIndex to map a word to
+// the history items containing it or a character to the words containing it.
+//
+// The IDs are kept sorted and stored as the varint-encoded differences
+// between consecutive IDs, which takes a byte or two per ID for the typical
+// list. Once that would take more room than a bitmap of all IDs up to the
+// largest one, as happens for characters which appear in most words, the
+// list switches to the bitmap, and back if it gets sparse again.
+//
+// Adding an ID larger than any in the list only appends to it; other updates
+// re-encode the list, which is fine as long as they are rare.
+class PostingList {
+ public:
+  PostingList();
+  ~PostingList();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Adds |id| to the list, if it isn't there already.
+  void Add(uint64 id);
+
+  // Removes |id| from the list, if it is there.
+  void Remove(uint64 id);
+
+  bool Contains(uint64 id) const { return ref().Contains(id); }
+
+  // Appends the IDs in the list, in ascending order, to |ids|.
+  template <typename T>
+  void AppendTo(std::vector<T>* ids) const { ref().AppendTo(ids); }
+
+  // Removes the IDs which aren't in the list from |ids|, which must be
+  // sorted.
+  template <typename T>
+  void IntersectWith(std::vector<T>* ids) const { ref().IntersectWith(ids); }
+
+  // Returns a view of the list, valid until the list is next changed.
+  PostingListRef ref() const;
+
+  // Releases the room reserved for IDs yet to be added.
+  void Shrink();
+
+  // Returns the number of bytes the list has allocated.
+  size_t allocated_bytes() const { return data_.capacity(); }
+
+  bool is_bitmap() const { return is_bitmap_; }
+
+ private:
+  // Returns the number of bytes the list would take as a bitmap.
+  size_t BitmapSize() const {
+    return size_ ? static_cast<size_t>(last_ / 8) + 1 : 0;
+  }
+
+  void AppendVarint(uint64 value);
+
+  // Replaces the contents of the list with |ids|, which must be sorted and
+  // without duplicates.
+  void Assign(const std::vector<uint64>& ids);
+
+  void ConvertToBitmap();
+
+  // The encoded differences between consecutive IDs (the first one is
+  // relative to zero), or the bitmap.
+  std::vector<uint8> data_;
+  // The largest ID in the list, which the next difference is relative to.
+  uint64 last_;
+  uint32 size_;
+  bool is_bitmap_;
+};
+
+template <typename T>
+void PostingListRef::AppendTo(std::vector<T>* ids) const {
+  // Reserving room when |ids| already holds some would defeat the vector's
+  // geometric growth when many lists are appended in turn.
+  if (ids->empty())
+    ids->reserve(size_);
+  if (is_bitmap_) {
+    for (size_t i = 0; i < length_; ++i) {
+      uint8 byte = data_[i];
+      for (int bit = 0; byte; ++bit, byte >>= 1) {
+        if (byte & 1)
+          ids->push_back(static_cast<T>(i * 8 + bit));
+      }
+    }
+    return;
+  }
+  const uint8* pos = data_;
+  const uint8* end = data_ + length_;
+  uint64 id = 0;
+  for (uint32 i = 0; i < size_ && pos < end; ++i) {
+    id += ReadVarint(&pos, end);
+    ids->push_back(static_cast<T>(id));
+  }
+}
+
+template <typename T>
+void PostingListRef::IntersectWith(std::vector<T>* ids) const {
+  typename std::vector<T>::iterator out = ids->begin();
+  if (is_bitmap_) {
+    for (typename std::vector<T>::const_iterator it = ids->begin();
+         it != ids->end(); ++it) {
+      uint64 id = static_cast<uint64>(*it);
+      if (id / 8 < length_ && (data_[id / 8] & (1 << (id % 8))))
+        *out++ = *it;
+    }
+  } else {
+    // Both lists are sorted, so merge them.
+    const uint8* pos = data_;
+    const uint8* end = data_ + length_;
+    uint64 id = 0;
+    uint32 remaining = size_;
+    bool have_id = false;
+    for (typename std::vector<T>::const_iterator it = ids->begin();
+         it != ids->end(); ++it) {
+      uint64 wanted = static_cast<uint64>(*it);
+      while (remaining && pos < end && (!have_id || id < wanted)) {
+        id += ReadVarint(&pos, end);
+        --remaining;
+        have_id = true;
+      }
+      if (!have_id || id < wanted)
+        break;  // The list has run out.
+      if (id == wanted)
+        *out++ = *it;
+    }
+  }
+  ids->erase(out, ids->end());
+}
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_POSTING_LIST_H_
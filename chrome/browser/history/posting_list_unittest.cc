@@ -0,0 +1,138 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "chrome/browser/history/posting_list.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+TEST(PostingListTest, AddInOrder) {
+  PostingList list;
+  EXPECT_TRUE(list.empty());
+  list.Add(0);
+  list.Add(3);
+  list.Add(300);
+  list.Add(70000);
+  list.Add(70000);
+  EXPECT_EQ(4U, list.size());
+  EXPECT_FALSE(list.is_bitmap());
+
+  std::vector<int> ids;
+  list.AppendTo(&ids);
+  ASSERT_EQ(4U, ids.size());
+  EXPECT_EQ(0, ids[0]);
+  EXPECT_EQ(3, ids[1]);
+  EXPECT_EQ(300, ids[2]);
+  EXPECT_EQ(70000, ids[3]);
+
+  EXPECT_TRUE(list.Contains(300));
+  EXPECT_FALSE(list.Contains(301));
+  EXPECT_FALSE(list.Contains(70001));
+}
+
+TEST(PostingListTest, AddOutOfOrderAndRemove) {
+  PostingList list;
+  list.Add(500);
+  list.Add(10);
+  list.Add(200);
+  list.Add(10);
+  EXPECT_EQ(3U, list.size());
+
+  list.Remove(200);
+  list.Remove(201);
+  EXPECT_EQ(2U, list.size());
+  std::vector<int64> ids;
+  list.AppendTo(&ids);
+  ASSERT_EQ(2U, ids.size());
+  EXPECT_EQ(10, ids[0]);
+  EXPECT_EQ(500, ids[1]);
+
+  // Appending after a removal of the largest ID is relative to the new one.
+  list.Remove(500);
+  list.Add(20);
+  ids.clear();
+  list.AppendTo(&ids);
+  ASSERT_EQ(2U, ids.size());
+  EXPECT_EQ(10, ids[0]);
+  EXPECT_EQ(20, ids[1]);
+}
+
+TEST(PostingListTest, DenseListBecomesBitmap) {
+  PostingList list;
+  for (int i = 0; i < 1000; i += 2)
+    list.Add(i);
+  EXPECT_TRUE(list.is_bitmap());
+  EXPECT_EQ(500U, list.size());
+  EXPECT_GE(1000U / 8 + 1, list.allocated_bytes() / 2);
+
+  list.Add(3);
+  list.Remove(4);
+  list.Add(5000);
+  EXPECT_TRUE(list.Contains(3));
+  EXPECT_FALSE(list.Contains(4));
+  EXPECT_TRUE(list.Contains(5000));
+
+  std::vector<int> ids;
+  list.AppendTo(&ids);
+  ASSERT_EQ(501U, ids.size());
+  EXPECT_EQ(0, ids[0]);
+  EXPECT_EQ(2, ids[1]);
+  EXPECT_EQ(3, ids[2]);
+  EXPECT_EQ(6, ids[3]);
+  EXPECT_EQ(5000, ids.back());
+}
+
+TEST(PostingListTest, SparseBitmapBecomesList) {
+  PostingList list;
+  for (int i = 0; i < 100; ++i)
+    list.Add(i);
+  EXPECT_TRUE(list.is_bitmap());
+
+  // Growing the bitmap to hold this ID would waste a lot of room.
+  list.Add(1000000);
+  EXPECT_FALSE(list.is_bitmap());
+  EXPECT_EQ(101U, list.size());
+  EXPECT_TRUE(list.Contains(99));
+  EXPECT_TRUE(list.Contains(1000000));
+}
+
+TEST(PostingListTest, IntersectWith) {
+  PostingList sparse;
+  sparse.Add(2);
+  sparse.Add(40);
+  sparse.Add(1000);
+  PostingList dense;
+  for (int i = 0; i < 2000; i += 2)
+    dense.Add(i);
+  ASSERT_FALSE(sparse.is_bitmap());
+  ASSERT_TRUE(dense.is_bitmap());
+
+  std::vector<int> ids;
+  ids.push_back(1);
+  ids.push_back(2);
+  ids.push_back(40);
+  ids.push_back(41);
+  ids.push_back(1000);
+  ids.push_back(3000);
+  std::vector<int> sparse_ids(ids);
+  sparse.IntersectWith(&sparse_ids);
+  ASSERT_EQ(3U, sparse_ids.size());
+  EXPECT_EQ(2, sparse_ids[0]);
+  EXPECT_EQ(40, sparse_ids[1]);
+  EXPECT_EQ(1000, sparse_ids[2]);
+
+  dense.IntersectWith(&ids);
+  ASSERT_EQ(3U, ids.size());
+  EXPECT_EQ(2, ids[0]);
+  EXPECT_EQ(40, ids[1]);
+  EXPECT_EQ(1000, ids[2]);
+
+  PostingList empty;
+  empty.IntersectWith(&ids);
+  EXPECT_TRUE(ids.empty());
+}
+
+}  // namespace history
@@ -1,15 +1,22 @@
-// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
 #include "chrome/browser/history/text_database_manager.h"
 
+#include <algorithm>
+
+#include "base/atomicops.h"
 #include "base/compiler_specific.h"
 #include "base/file_util.h"
 #include "base/metrics/histogram.h"
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/string_util.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/sys_info.h"
+#include "base/threading/simple_thread.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/history/history_publisher.h"
 #include "chrome/browser/history/visit_database.h"
@@ -35,8 +42,97 @@ std::string ConvertStringForIndexer(const string16& input) {
 // haven't gotten a title and/or body.
 const int kExpirationSec = 20;
 
+// Pages whose title and body have both come in are committed together this
+// long after the first of them.
+const int kCommitDelayMs = 1000;
+
+// The most threads helping the calling thread query databases. Each database
+// queried at once must fit in the cache.
+const int kMaxQueryThreads = 3;
+COMPILE_ASSERT(kMaxQueryThreads < kCacheDBSize, query_databases_must_be_cached);
+
 }  // namespace
 
+// TextDatabaseManager::QueryJob -----------------------------------------------
+
+// Queries a set of databases, sharing them out among the calling thread and
+// any helping threads. Each database has its own connection, so they can be
+// searched at once.
+class TextDatabaseManager::QueryJob
+    : public base::DelegateSimpleThread::Delegate {
+ public:
+  // One database to search, and what was found in it.
+  struct Shard {
+    Shard() : db(NULL) {}
+
+    TextDatabase* db;
+    std::vector<TextDatabase::Match> results;
+    Time first_time_searched;
+  };
+
+  QueryJob(const std::string& fts_query,
+           const QueryOptions& options,
+           std::vector<Shard>* shards)
+      : fts_query_(fts_query),
+        options_(options),
+        shards_(shards),
+        next_shard_(0),
+        running_helpers_(0),
+        helpers_done_(&lock_) {
+  }
+
+  // Searches every shard, with the help of |helpers| threads from |pool|.
+  void Query(base::DelegateSimpleThreadPool* pool, int helpers) {
+    if (helpers > 0) {
+      running_helpers_ = helpers;
+      pool->AddWork(this, helpers);
+    }
+    QueryShards();
+    // The helpers may not have started yet, but must be done with the job
+    // before it goes away.
+    base::AutoLock lock(lock_);
+    while (running_helpers_ > 0)
+      helpers_done_.Wait();
+  }
+
+  // base::DelegateSimpleThread::Delegate, run by the helping threads.
+  virtual void Run() {
+    QueryShards();
+    base::AutoLock lock(lock_);
+    if (--running_helpers_ == 0)
+      helpers_done_.Signal();
+  }
+
+ private:
+  void QueryShards() {
+    while (true) {
+      size_t index = static_cast<size_t>(
+          base::subtle::NoBarrier_AtomicIncrement(&next_shard_, 1) - 1);
+      if (index >= shards_->size())
+        break;
+      Shard& shard = (*shards_)[index];
+      TextDatabase::URLSet found_urls;
+      shard.db->GetTextMatches(fts_query_, options_, &shard.results,
+                               &found_urls, &shard.first_time_searched);
+    }
+  }
+
+  const std::string& fts_query_;
+  const QueryOptions& options_;
+  std::vector<Shard>* shards_;
+
+  // The next shard to search.
+  base::subtle::Atomic32 next_shard_;
+
+  // Protects the members below.
+  base::Lock lock_;
+  int running_helpers_;
+  // Signalled when the last helping thread finishes.
+  base::ConditionVariable helpers_done_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueryJob);
+};
+
 // TextDatabaseManager::ChangeSet ----------------------------------------------
 
 TextDatabaseManager::ChangeSet::ChangeSet() {}
@@ -87,12 +183,24 @@ TextDatabaseManager::TextDatabaseManager(const FilePath& dir,
       db_cache_(DBCache::NO_AUTO_EVICT),
       present_databases_loaded_(false),
       ALLOW_THIS_IN_INITIALIZER_LIST(factory_(this)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(commit_factory_(this)),
+      query_threads_(std::min(base::SysInfo::NumberOfProcessors() - 1,
+                              kMaxQueryThreads)),
       history_publisher_(NULL) {
 }
 
 TextDatabaseManager::~TextDatabaseManager() {
   if (transaction_nesting_)
     CommitTransaction();
+  // The query threads are idle, so they exit at once.
+  if (query_pool_.get())
+    query_pool_->JoinAll();
+}
+
+// static
+bool TextDatabaseManager::RecentChangeOlder(const RecentChange& a,
+                                            const RecentChange& b) {
+  return a.second.visit_time() < b.second.visit_time();
 }
 
 // static
@@ -172,10 +280,17 @@ void TextDatabaseManager::AddPageURL(const GURL& url,
                                      URLID url_id,
                                      VisitID visit_id,
                                      Time time) {
-  // Delete any existing page info.
+  // Delete any existing page info, committing it first if it was waiting
+  // to be committed with other complete pages.
   RecentChangeList::iterator found = recent_changes_.Peek(url);
-  if (found != recent_changes_.end())
+  if (found != recent_changes_.end()) {
+    const PageInfo& info = found->second;
+    if (info.complete()) {
+      AddPageData(url, info.url_id(), info.visit_id(), info.visit_time(),
+                  info.title(), info.body());
+    }
     recent_changes_.Erase(found);
+  }
 
   // Just save this info for later. We will save it when it expires or when all
   // the data is complete.
@@ -219,15 +334,12 @@ void TextDatabaseManager::AddPageTitle(const GURL& url,
   }
 
   PageInfo& info = found->second;
-  if (info.has_body()) {
-    // This info is complete, write to the database.
-    AddPageData(url, info.url_id(), info.visit_id(), info.visit_time(),
-                title, info.body());
-    recent_changes_.Erase(found);
-    return;
-  }
-
   info.set_title(title);
+  if (info.complete()) {
+    // This info is complete, write it to the database with any other pages
+    // completed around the same time.
+    ScheduleCommitCompleteChanges();
+  }
 }
 
 void TextDatabaseManager::AddPageContents(const GURL& url,
@@ -255,15 +367,12 @@ void TextDatabaseManager::AddPageContents(const GURL& url,
   }
 
   PageInfo& info = found->second;
-  if (info.has_title()) {
-    // This info is complete, write to the database.
-    AddPageData(url, info.url_id(), info.visit_id(), info.visit_time(),
-                info.title(), body);
-    recent_changes_.Erase(found);
-    return;
-  }
-
   info.set_body(body);
+  if (info.complete()) {
+    // This info is complete, write it to the database with any other pages
+    // completed around the same time.
+    ScheduleCommitCompleteChanges();
+  }
 }
 
 bool TextDatabaseManager::AddPageData(const GURL& url,
@@ -416,6 +525,9 @@ void TextDatabaseManager::GetTextMatches(
     Time* first_time_searched) {
   results->clear();
 
+  // Complete pages waiting to be committed should be found.
+  CommitCompleteChanges();
+
   InitDBList();
   if (present_databases_.empty()) {
     // Nothing to search.
@@ -428,10 +540,6 @@ void TextDatabaseManager::GetTextMatches(
   query_parser_.ParseQuery(query, &fts_query16);
   std::string fts_query = UTF16ToUTF8(fts_query16);
 
-  // Need a copy of the options so we can modify the max count for each call
-  // to the individual databases.
-  QueryOptions cur_options(options);
-
   // Compute the minimum and maximum values for the identifiers that could
   // encompass the input time range.
   TextDatabase::DBIdent min_ident = options.begin_time.is_null() ?
@@ -441,46 +549,79 @@ void TextDatabaseManager::GetTextMatches(
       *present_databases_.rbegin() :
       TimeToID(options.end_time);
 
-  // Iterate over the databases from the most recent backwards.
-  bool checked_one = false;
-  TextDatabase::URLSet found_urls;
+  // List the databases in the time range, from the most recent backwards.
+  std::vector<TextDatabase::DBIdent> idents;
   for (DBIdentSet::reverse_iterator i = present_databases_.rbegin();
        i != present_databases_.rend();
        ++i) {
-    // TODO(brettw) allow canceling the query in the middle.
-    // if (canceled_or_something)
-    //   break;
-
-    // This code is stupid, we just loop until we find the correct starting
-    // time range rather than search in an intelligent way. Users will have a
-    // few dozen files at most, so this should not be an issue.
     if (*i > max_ident)
       continue;  // Haven't gotten to the time range yet.
     if (*i < min_ident)
       break;  // Covered all the time range.
+    idents.push_back(*i);
+  }
 
-    TextDatabase* cur_db = GetDB(*i, false);
-    if (!cur_db)
-      continue;
+  // Search the databases a few at a time. Each database in a group is asked
+  // for as many results as the query still lacks after the newer groups, so
+  // the results of each group can be taken in order until there are enough,
+  // at which point the older databases need not be searched at all. Only the
+  // databases searched at once can return more rows (and compute more
+  // snippets) than are kept.
+  const size_t group_size = static_cast<size_t>(query_threads_) + 1;
+  bool checked_one = false;
+  bool got_max_count = false;
+  for (size_t group = 0; group < idents.size() && !got_max_count;
+       group += group_size) {
+    // TODO(brettw) allow canceling the query in the middle.
+    // if (canceled_or_something)
+    //   break;
 
-    // Adjust the max count according to how many results we've already got.
-    if (options.max_count) {
-      cur_options.max_count = options.max_count -
-          static_cast<int>(results->size());
+    std::vector<QueryJob::Shard> shards;
+    for (size_t i = group; i < idents.size() && i < group + group_size; ++i) {
+      TextDatabase* cur_db = GetDB(idents[i], false);
+      if (!cur_db)
+        continue;
+      shards.push_back(QueryJob::Shard());
+      shards.back().db = cur_db;
     }
+    if (shards.empty())
+      continue;
 
-    // Since we are going backwards in time, it is always OK to pass the
-    // current first_time_searched, since it will always be smaller than
-    // any previous set.
-    cur_db->GetTextMatches(fts_query, cur_options,
-                           results, &found_urls, first_time_searched);
+    int helpers = std::min(query_threads_, static_cast<int>(shards.size()) - 1);
+    if (helpers > 0 && !query_pool_.get()) {
+      query_pool_.reset(new base::DelegateSimpleThreadPool(
+          "HistoryTextQuery", query_threads_));
+      query_pool_->Start();
+    }
+    QueryOptions group_options = options;
+    if (options.max_count)
+      group_options.max_count = options.max_count -
+                                static_cast<int>(results->size());
+    QueryJob job(fts_query, group_options, &shards);
+    job.Query(query_pool_.get(), helpers);
     checked_one = true;
 
-    DCHECK(options.max_count == 0 ||
-           static_cast<int>(results->size()) <= options.max_count);
-    if (options.max_count &&
-        static_cast<int>(results->size()) >= options.max_count)
-      break;  // Got the max number of results.
+    for (std::vector<QueryJob::Shard>::const_iterator shard = shards.begin();
+         shard != shards.end(); ++shard) {
+      size_t wanted = options.max_count ?
+          options.max_count - results->size() : shard->results.size();
+      if (shard->results.size() >= wanted && options.max_count) {
+        // Got the max number of results. The last one is the last time
+        // we considered.
+        results->insert(results->end(), shard->results.begin(),
+                        shard->results.begin() + wanted);
+        *first_time_searched = results->back().time;
+        got_max_count = true;
+        break;
+      }
+
+      // Since we are going backwards in time, it is always OK to take the
+      // shard's first_time_searched, since it will always be smaller than
+      // any previous one.
+      results->insert(results->end(), shard->results.begin(),
+                      shard->results.end());
+      *first_time_searched = shard->first_time_searched;
+    }
   }
 
   // When there were no databases in the range, we need to fix up the min time.
@@ -543,16 +684,50 @@ void TextDatabaseManager::FlushOldChanges() {
 }
 
 void TextDatabaseManager::FlushOldChangesForTime(TimeTicks now) {
-  // The end of the list is the oldest, so we just start from there committing
-  // things until we get something too new.
+  CommitRecentChanges(now);
+  ScheduleFlushOldChanges();
+}
+
+void TextDatabaseManager::ScheduleCommitCompleteChanges() {
+  if (!commit_factory_.empty())
+    return;  // Already scheduled.
+  MessageLoop::current()->PostDelayedTask(FROM_HERE,
+      commit_factory_.NewRunnableMethod(
+          &TextDatabaseManager::CommitCompleteChanges),
+      kCommitDelayMs);
+}
+
+void TextDatabaseManager::CommitCompleteChanges() {
+  CommitRecentChanges(TimeTicks());
+}
+
+void TextDatabaseManager::CommitRecentChanges(TimeTicks now) {
+  // Take out the pages to commit, starting from the end of the list, which is
+  // the oldest.
+  std::vector<RecentChange> pages;
   RecentChangeList::reverse_iterator i = recent_changes_.rbegin();
-  while (i != recent_changes_.rend() && i->second.Expired(now)) {
-    AddPageData(i->first, i->second.url_id(), i->second.visit_id(),
-                i->second.visit_time(), i->second.title(), i->second.body());
-    i = recent_changes_.Erase(i);
+  while (i != recent_changes_.rend()) {
+    if (i->second.complete() || (!now.is_null() && i->second.Expired(now))) {
+      pages.push_back(*i);
+      i = recent_changes_.Erase(i);
+    } else {
+      ++i;
+    }
   }
+  if (pages.empty())
+    return;
 
-  ScheduleFlushOldChanges();
+  // Adding the pages in order of their visits groups them by database, so
+  // each database is opened and committed once.
+  std::stable_sort(pages.begin(), pages.end(), RecentChangeOlder);
+  BeginTransaction();
+  for (std::vector<RecentChange>::const_iterator page = pages.begin();
+       page != pages.end(); ++page) {
+    const PageInfo& info = page->second;
+    AddPageData(page->first, info.url_id(), info.visit_id(),
+                info.visit_time(), info.title(), info.body());
+  }
+  CommitTransaction();
 }
 
 }  // namespace history
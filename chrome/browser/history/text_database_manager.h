@@ -7,11 +7,13 @@
 #pragma once
 
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "base/basictypes.h"
 #include "base/file_path.h"
 #include "base/gtest_prod_util.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/string16.h"
 #include "base/task.h"
 #include "chrome/browser/history/history_types.h"
@@ -20,6 +22,10 @@
 #include "chrome/browser/history/url_database.h"
 #include "content/common/mru_cache.h"
 
+namespace base {
+class DelegateSimpleThreadPool;
+}
+
 namespace history {
 
 class HistoryPublisher;
@@ -36,6 +42,8 @@ class VisitDatabase;
 //
 // This allows us to minimize inserts and modifications, which are slow for the
 // full text database, since each page's information is added exactly once.
+// Complete pages are also held for a moment, so that pages loaded together are
+// indexed together, in one transaction per database.
 //
 // Note: be careful to delete the relevant entries from this uncommitted list
 // when clearing history or this information may get added to the database soon
@@ -153,6 +161,10 @@ class TextDatabaseManager {
   //
   // This function will return more than one match per URL if there is more than
   // one entry for that URL in the database.
+  //
+  // The databases are searched a few at a time, newest first, each on a thread
+  // of its own, and the search stops once the newest |max_count| matches are
+  // known.
   void GetTextMatches(const string16& query,
                       const QueryOptions& options,
                       std::vector<TextDatabase::Match>* results,
@@ -166,6 +178,11 @@ class TextDatabaseManager {
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, FlushRecentURLsUnstarred);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest,
                            FlushRecentURLsUnstarredRestricted);
+  FRIEND_TEST_ALL_PREFIXES(TextDatabaseManagerTest, CompletePagesBatched);
+  FRIEND_TEST_ALL_PREFIXES(TextDatabaseManagerTest, QueryThreads);
+  friend class TextDatabaseManagerPerfTest;
+
+  class QueryJob;
 
   // Stores "recent stuff" that has happened with the page, since the page
   // visit, title, and body all come in at different times.
@@ -189,7 +206,8 @@ class TextDatabaseManager {
     // both the title and body setters will "fix" empty strings to be a space,
     // these indicate if the setter was ever called.
     bool has_title() const { return !title_.empty(); }
-    bool has_body() { return !body_.empty(); }
+    bool has_body() const { return !body_.empty(); }
+    bool complete() const { return has_title() && has_body(); }
 
     // Returns true if this entry was added too long ago and we should give up
     // waiting for more data. The current time is passed in as an argument so we
@@ -213,6 +231,12 @@ class TextDatabaseManager {
     string16 body_;
   };
 
+  // A page taken out of the recent changes to be committed.
+  typedef std::pair<GURL, PageInfo> RecentChange;
+
+  // Orders changes by their visit time, oldest first.
+  static bool RecentChangeOlder(const RecentChange& a, const RecentChange& b);
+
   // Converts the given time to a database identifier or vice-versa.
   static TextDatabase::DBIdent TimeToID(base::Time time);
   static base::Time IDToTime(TextDatabase::DBIdent id);
@@ -247,6 +271,18 @@ class TextDatabaseManager {
   // by the unit tests with fake times.
   void FlushOldChangesForTime(base::TimeTicks now);
 
+  // Schedules a call to CommitCompleteChanges in a moment, unless one is
+  // already pending.
+  void ScheduleCommitCompleteChanges();
+
+  // Commits the pages in recent_changes_ which have both a title and a body.
+  void CommitCompleteChanges();
+
+  // Commits the pages in recent_changes_ which are complete or, unless |now|
+  // is null, have expired by |now|. The pages are added in one transaction,
+  // grouped by database.
+  void CommitRecentChanges(base::TimeTicks now);
+
   // Directory holding our index files.
   const FilePath dir_;
 
@@ -298,6 +334,15 @@ class TextDatabaseManager {
   // Generates tasks for our periodic checking of expired "recent changes".
   ScopedRunnableMethodFactory<TextDatabaseManager> factory_;
 
+  // Generates the task committing complete "recent changes", when one is
+  // pending.
+  ScopedRunnableMethodFactory<TextDatabaseManager> commit_factory_;
+
+  // The threads which help query several databases at once, started on first
+  // use, and how many there are.
+  scoped_ptr<base::DelegateSimpleThreadPool> query_pool_;
+  int query_threads_;
+
   // This object is created and managed by the history backend. We maintain an
   // opaque pointer to the object for our use.
   // This can be NULL if there are no indexers registered to receive indexing
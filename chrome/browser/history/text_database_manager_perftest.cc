@@ -0,0 +1,160 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Times full text searches over several years of synthetic history:
+//   $ ./perf_tests --gtest_filter=TextDatabaseManagerPerfTest.*
+
+#include <string>
+#include <vector>
+
+#include "app/sql/connection.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/text_database_manager.h"
+#include "chrome/browser/history/visit_database.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::Time;
+
+namespace history {
+
+namespace {
+
+const int kYears = 4;
+const int kPagesPerMonth = 250;
+const int kWordsPerBody = 60;
+
+// Every page has some of these words, the first ones most often.
+const char* kWords[] = {
+  "news", "weather", "mail", "search", "video", "music", "sports", "travel",
+  "recipe", "forecast", "review", "camera", "garden", "history", "finance",
+  "movie", "school", "health", "market", "science",
+};
+
+// One page in this many mentions a word no other page has.
+const int kRarePageInterval = 997;
+
+// A URL and visit database in memory, which the text database manager keeps
+// in sync with its index.
+class InMemDB : public URLDatabase, public VisitDatabase {
+ public:
+  InMemDB() {
+    EXPECT_TRUE(db_.OpenInMemory());
+    CreateURLTable(false);
+    InitVisitTable();
+  }
+
+ private:
+  virtual sql::Connection& GetDB() { return db_; }
+
+  sql::Connection db_;
+
+  DISALLOW_COPY_AND_ASSIGN(InMemDB);
+};
+
+}  // namespace
+
+class TextDatabaseManagerPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    manager_.reset(new TextDatabaseManager(temp_dir_.path(), &visit_db_,
+                                           &visit_db_));
+    ASSERT_TRUE(manager_->Init(NULL));
+  }
+
+  // Indexes kPagesPerMonth pages for every month of kYears years, with a
+  // deterministic mix of words.
+  void AddHistory() {
+    PerfTimeLogger timer("TextDatabaseManager_index");
+    uint32 seed = 1;
+    int page = 0;
+    Time::Exploded exploded;
+    memset(&exploded, 0, sizeof(Time::Exploded));
+    for (int year = 2008; year < 2008 + kYears; ++year) {
+      for (int month = 1; month <= 12; ++month) {
+        manager_->BeginTransaction();
+        for (int i = 0; i < kPagesPerMonth; ++i, ++page) {
+          exploded.year = year;
+          exploded.month = month;
+          exploded.day_of_month = 1 + i % 28;
+          exploded.hour = i % 24;
+          exploded.minute = i % 60;
+          std::string body;
+          for (int word = 0; word < kWordsPerBody; ++word) {
+            seed = seed * 1103515245 + 12345;
+            // Squaring favors the first words.
+            size_t index = ((seed >> 16) % 100) * ((seed >> 16) % 100) *
+                arraysize(kWords) / 10000;
+            body.append(kWords[index]).append(" ");
+          }
+          if (page % kRarePageInterval == 0)
+            body.append("zanzibar");
+          GURL url(base::StringPrintf("http://www.example.com/%d", page));
+          manager_->AddPageData(url, 0, 0, Time::FromUTCExploded(exploded),
+                                ASCIIToUTF16(base::StringPrintf("Page %d",
+                                                                page)),
+                                ASCIIToUTF16(body));
+        }
+        manager_->CommitTransaction();
+      }
+    }
+    timer.Done();
+  }
+
+  // Searches for |query| with the given limit, on the calling thread alone
+  // and then with three helping threads, logging both times under |name|.
+  // Both searches must find the same matches.
+  void TimeQuery(const std::string& name,
+                 const std::string& query,
+                 int max_count) {
+    QueryOptions options;
+    options.max_count = max_count;
+
+    manager_->query_threads_ = 0;
+    std::vector<TextDatabase::Match> sequential;
+    Time sequential_first_time;
+    base::TimeTicks start = base::TimeTicks::Now();
+    manager_->GetTextMatches(ASCIIToUTF16(query), options, &sequential,
+                             &sequential_first_time);
+    LogPerfResult(("TextDatabaseManager_" + name + "_sequential").c_str(),
+                  (base::TimeTicks::Now() - start).InMillisecondsF(), "ms");
+
+    manager_->query_threads_ = 3;
+    std::vector<TextDatabase::Match> parallel;
+    Time parallel_first_time;
+    start = base::TimeTicks::Now();
+    manager_->GetTextMatches(ASCIIToUTF16(query), options, &parallel,
+                             &parallel_first_time);
+    LogPerfResult(("TextDatabaseManager_" + name + "_parallel").c_str(),
+                  (base::TimeTicks::Now() - start).InMillisecondsF(), "ms");
+
+    ASSERT_EQ(sequential.size(), parallel.size());
+    for (size_t i = 0; i < sequential.size(); ++i)
+      EXPECT_EQ(sequential[i].url, parallel[i].url);
+    EXPECT_TRUE(sequential_first_time == parallel_first_time);
+  }
+
+  MessageLoop message_loop_;
+  ScopedTempDir temp_dir_;
+  InMemDB visit_db_;
+  scoped_ptr<TextDatabaseManager> manager_;
+};
+
+TEST_F(TextDatabaseManagerPerfTest, Search) {
+  AddHistory();
+
+  // The first page of the history page, which the newest month fills.
+  TimeQuery("common_page", "news", 100);
+  // A word on few pages, which needs every month searched.
+  TimeQuery("rare_page", "zanzibar", 100);
+  // Every match of a word, as when searching with no limit.
+  TimeQuery("common_all", "science", 0);
+}
+
+}  // namespace history
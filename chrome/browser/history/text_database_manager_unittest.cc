@@ -6,6 +6,7 @@
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/message_loop.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/history/text_database_manager.h"
 #include "chrome/browser/history/visit_database.h"
@@ -534,4 +535,99 @@ TEST_F(TextDatabaseManagerTest, QueryBackwards) {
   EXPECT_EQ(0U, results.size());
 }
 
+// Tests that complete pages wait to be committed together, and are committed
+// before any query.
+TEST_F(TextDatabaseManagerTest, CompletePagesBatched) {
+  ASSERT_TRUE(Init());
+  InMemDB visit_db;
+  TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+  ASSERT_TRUE(manager.Init(NULL));
+
+  GURL url1(kURL1);
+  manager.AddPageURL(url1, 0, 0, Time::Now());
+  manager.AddPageTitle(url1, UTF8ToUTF16(kTitle1));
+  manager.AddPageContents(url1, UTF8ToUTF16(kBody1));
+  GURL url2(kURL2);
+  manager.AddPageURL(url2, 0, 0, Time::Now());
+  manager.AddPageContents(url2, UTF8ToUTF16(kBody2));
+  manager.AddPageTitle(url2, UTF8ToUTF16(kTitle2));
+  EXPECT_EQ(2U, manager.recent_changes_.size());
+
+  // A new visit to a complete page commits the old one first.
+  manager.AddPageURL(url1, 0, 0, Time::Now());
+  EXPECT_EQ(2U, manager.recent_changes_.size());
+
+  QueryOptions options;
+  std::vector<TextDatabase::Match> results;
+  Time first_time_searched;
+  manager.GetTextMatches(UTF8ToUTF16("FOO"), options,
+                         &results, &first_time_searched);
+  EXPECT_EQ(2U, results.size());
+  EXPECT_TRUE(ResultsHaveURL(results, kURL1));
+  EXPECT_TRUE(ResultsHaveURL(results, kURL2));
+
+  // The new visit to |url1| is still waiting for its title and body.
+  EXPECT_EQ(1U, manager.recent_changes_.size());
+}
+
+// Tests that querying the databases on several threads finds the same results
+// as querying them one after another.
+TEST_F(TextDatabaseManagerTest, QueryThreads) {
+  ASSERT_TRUE(Init());
+  InMemDB visit_db;
+  TextDatabaseManager manager(dir_, &visit_db, &visit_db);
+  ASSERT_TRUE(manager.Init(NULL));
+
+  // Two pages a month for a year and a half.
+  Time::Exploded exploded;
+  memset(&exploded, 0, sizeof(Time::Exploded));
+  exploded.year = 2009;
+  exploded.month = 1;
+  exploded.day_of_month = 1;
+  manager.BeginTransaction();
+  for (int month = 0; month < 18; ++month) {
+    for (int day = 1; day <= 2; ++day) {
+      exploded.day_of_month = day;
+      GURL url(StringPrintf("http://www.google.com/%d/%d", month, day));
+      manager.AddPageData(url, 0, 0, Time::FromUTCExploded(exploded),
+                          UTF8ToUTF16(kTitle1), UTF8ToUTF16(kBody1));
+    }
+    if (++exploded.month > 12) {
+      exploded.month = 1;
+      exploded.year++;
+    }
+  }
+  manager.CommitTransaction();
+
+  const int kMaxCounts[] = { 0, 1, 5, 8, 35 };
+  for (size_t i = 0; i < arraysize(kMaxCounts); ++i) {
+    QueryOptions options;
+    options.max_count = kMaxCounts[i];
+
+    manager.query_threads_ = 0;
+    std::vector<TextDatabase::Match> sequential;
+    Time sequential_first_time;
+    manager.GetTextMatches(UTF8ToUTF16("FOO"), options,
+                           &sequential, &sequential_first_time);
+
+    manager.query_threads_ = 3;
+    std::vector<TextDatabase::Match> parallel;
+    Time parallel_first_time;
+    manager.GetTextMatches(UTF8ToUTF16("FOO"), options,
+                           &parallel, &parallel_first_time);
+
+    EXPECT_EQ(kMaxCounts[i] ? static_cast<size_t>(kMaxCounts[i]) : 36U,
+              sequential.size());
+    ASSERT_EQ(sequential.size(), parallel.size());
+    for (size_t j = 0; j < sequential.size(); ++j) {
+      EXPECT_EQ(sequential[j].url, parallel[j].url);
+      EXPECT_TRUE(sequential[j].time == parallel[j].time);
+      // Newest first.
+      if (j > 0)
+        EXPECT_TRUE(parallel[j - 1].time > parallel[j].time);
+    }
+    EXPECT_TRUE(sequential_first_time == parallel_first_time);
+  }
+}
+
 }  // namespace history
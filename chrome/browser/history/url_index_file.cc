@@ -0,0 +1,465 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/url_index_file.h"
+
+#include <algorithm>
+
+#include "base/file_path.h"
+#include "base/logging.h"
+#include "base/utf_string_conversions.h"
+
+namespace history {
+
+namespace {
+
+const uint32 kFileMagic = 0x494d5549;  // "IMUI"
+const uint32 kFileVersion = 1;
+
+// The tables are read in place, so each section starts on this boundary.
+const size_t kSectionAlignment = 8;
+
+const uint32 kPostingsAreBitmap = 1 << 0;
+
+}  // namespace
+
+struct URLIndexFile::Header {
+  uint32 magic;
+  uint32 version;
+  int64 timestamp;
+  uint32 word_count;
+  uint32 char_count;
+  uint32 row_count;
+  uint32 padding;
+  uint64 words_offset;
+  uint64 chars_offset;
+  uint64 rows_offset;
+  uint64 postings_offset;
+  uint64 postings_length;
+  uint64 strings_offset;
+  uint64 strings_length;
+};
+
+struct URLIndexFile::PostingEntry {
+  uint32 offset;  // In the postings section.
+  uint32 length;
+  uint32 size;
+  uint32 flags;
+  uint64 last;
+};
+
+struct URLIndexFile::WordEntry {
+  uint32 text_offset;  // In the strings section, as UTF-16.
+  uint32 text_length;  // In characters.
+  PostingEntry history_ids;
+};
+
+struct URLIndexFile::CharEntry {
+  uint32 uni_char;
+  uint32 padding;
+  PostingEntry word_ids;
+};
+
+struct URLIndexFile::RowEntry {
+  int64 history_id;
+  int64 last_visit;
+  int32 visit_count;
+  int32 typed_count;
+  uint32 url_offset;  // In the strings section, as UTF-8.
+  uint32 url_length;
+  uint32 title_offset;  // In the strings section, as UTF-16.
+  uint32 title_length;  // In characters.
+};
+
+namespace {
+
+// Appends |bytes| to |section|, returning their offset, or kuint32max if the
+// section would outgrow the 32 bit offsets.
+uint32 AppendToSection(const void* bytes,
+                       size_t length,
+                       std::vector<uint8>* section) {
+  size_t offset = section->size();
+  if (offset + length > kuint32max)
+    return kuint32max;
+  const uint8* begin = static_cast<const uint8*>(bytes);
+  section->insert(section->end(), begin, begin + length);
+  return static_cast<uint32>(offset);
+}
+
+// Pads |data| to the section alignment.
+void AlignSection(std::vector<uint8>* data) {
+  data->resize((data->size() + kSectionAlignment - 1) /
+               kSectionAlignment * kSectionAlignment);
+}
+
+}  // namespace
+
+URLIndexFile::Builder::Row::Row()
+    : last_visit(0),
+      visit_count(0),
+      typed_count(0) {
+}
+
+URLIndexFile::Builder::Row::~Row() {
+}
+
+URLIndexFile::Builder::Builder() {
+}
+
+URLIndexFile::Builder::~Builder() {
+}
+
+void URLIndexFile::Builder::AddRow(const URLRow& row) {
+  Row& entry(rows_[row.id()]);
+  entry.last_visit = row.last_visit().ToInternalValue();
+  entry.visit_count = row.visit_count();
+  entry.typed_count = row.typed_count();
+  entry.url = row.url().spec();
+  entry.title = row.title();
+}
+
+void URLIndexFile::Builder::AddWord(
+    const string16& word,
+    const std::vector<HistoryID>& history_ids) {
+  if (history_ids.empty())
+    return;
+  std::vector<HistoryID>& word_history_ids(words_[word]);
+  word_history_ids.insert(word_history_ids.end(), history_ids.begin(),
+                          history_ids.end());
+}
+
+bool URLIndexFile::Builder::WriteToFile(const FilePath& file_path,
+                                        base::Time timestamp) const {
+  std::vector<uint8> postings;
+  std::vector<uint8> strings;
+  bool overflow = false;
+
+  // Word IDs follow the order of the words, and the characters' posting
+  // lists are built as they go.
+  std::vector<WordEntry> words;
+  words.reserve(words_.size());
+  std::map<char16, PostingList> char_words;
+  for (WordHistoryMap::const_iterator iter = words_.begin();
+       iter != words_.end(); ++iter) {
+    WordID word_id = words.size();
+    WordEntry entry;
+    const string16& word(iter->first);
+    entry.text_offset = AppendToSection(word.data(),
+                                        word.size() * sizeof(char16),
+                                        &strings);
+    entry.text_length = word.size();
+
+    std::vector<HistoryID> history_ids(iter->second);
+    std::sort(history_ids.begin(), history_ids.end());
+    // Postings are added in order, so this only appends.
+    PostingList list;
+    for (std::vector<HistoryID>::const_iterator id_iter = history_ids.begin();
+         id_iter != history_ids.end(); ++id_iter)
+      list.Add(*id_iter);
+    PostingListRef ref(list.ref());
+    entry.history_ids.offset = AppendToSection(ref.data(), ref.length(),
+                                               &postings);
+    entry.history_ids.length = ref.length();
+    entry.history_ids.size = ref.size();
+    entry.history_ids.flags = ref.is_bitmap() ? kPostingsAreBitmap : 0;
+    entry.history_ids.last = ref.last();
+    overflow |= entry.text_offset == kuint32max ||
+        entry.history_ids.offset == kuint32max;
+    words.push_back(entry);
+
+    string16 chars(word);
+    std::sort(chars.begin(), chars.end());
+    chars.erase(std::unique(chars.begin(), chars.end()), chars.end());
+    for (string16::const_iterator char_iter = chars.begin();
+         char_iter != chars.end(); ++char_iter)
+      char_words[*char_iter].Add(word_id);
+  }
+
+  std::vector<CharEntry> chars;
+  chars.reserve(char_words.size());
+  for (std::map<char16, PostingList>::const_iterator iter = char_words.begin();
+       iter != char_words.end(); ++iter) {
+    CharEntry entry;
+    entry.uni_char = iter->first;
+    entry.padding = 0;
+    PostingListRef ref(iter->second.ref());
+    entry.word_ids.offset = AppendToSection(ref.data(), ref.length(),
+                                            &postings);
+    entry.word_ids.length = ref.length();
+    entry.word_ids.size = ref.size();
+    entry.word_ids.flags = ref.is_bitmap() ? kPostingsAreBitmap : 0;
+    entry.word_ids.last = ref.last();
+    overflow |= entry.word_ids.offset == kuint32max;
+    chars.push_back(entry);
+  }
+
+  std::vector<RowEntry> rows;
+  rows.reserve(rows_.size());
+  for (RowMap::const_iterator iter = rows_.begin(); iter != rows_.end();
+       ++iter) {
+    const Row& row(iter->second);
+    RowEntry entry;
+    entry.history_id = iter->first;
+    entry.last_visit = row.last_visit;
+    entry.visit_count = row.visit_count;
+    entry.typed_count = row.typed_count;
+    const std::string& url(row.url);
+    entry.url_offset = AppendToSection(url.data(), url.size(), &strings);
+    entry.url_length = url.size();
+    const string16& title(row.title);
+    entry.title_offset = AppendToSection(title.data(),
+                                         title.size() * sizeof(char16),
+                                         &strings);
+    entry.title_length = title.size();
+    overflow |= entry.url_offset == kuint32max ||
+        entry.title_offset == kuint32max;
+    rows.push_back(entry);
+  }
+
+  if (overflow) {
+    LOG(WARNING) << "The InMemoryURLIndex is too large to save.";
+    return false;
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kFileMagic;
+  header.version = kFileVersion;
+  header.timestamp = timestamp.ToInternalValue();
+  header.word_count = words.size();
+  header.char_count = chars.size();
+  header.row_count = rows.size();
+
+  std::vector<uint8> data(sizeof(header));
+  AlignSection(&data);
+  header.words_offset = data.size();
+  if (!words.empty())
+    AppendToSection(&words[0], words.size() * sizeof(WordEntry), &data);
+  AlignSection(&data);
+  header.chars_offset = data.size();
+  if (!chars.empty())
+    AppendToSection(&chars[0], chars.size() * sizeof(CharEntry), &data);
+  AlignSection(&data);
+  header.rows_offset = data.size();
+  if (!rows.empty())
+    AppendToSection(&rows[0], rows.size() * sizeof(RowEntry), &data);
+  AlignSection(&data);
+  header.postings_offset = data.size();
+  header.postings_length = postings.size();
+  data.insert(data.end(), postings.begin(), postings.end());
+  AlignSection(&data);
+  header.strings_offset = data.size();
+  header.strings_length = strings.size();
+  data.insert(data.end(), strings.begin(), strings.end());
+  memcpy(&data[0], &header, sizeof(header));
+
+  // Write a new file and swap it in, so that maps of the old one keep their
+  // copy. Windows refuses to replace a file which is still mapped, though.
+  FilePath temp_path(file_path.value() + FILE_PATH_LITERAL(".tmp"));
+  int size = data.size();
+  if (file_util::WriteFile(temp_path, reinterpret_cast<const char*>(&data[0]),
+                           size) != size) {
+    LOG(WARNING) << "Failed to write " << temp_path.value();
+    file_util::Delete(temp_path, false);
+    return false;
+  }
+  if (!file_util::ReplaceFile(temp_path, file_path)) {
+    LOG(WARNING) << "Failed to replace " << file_path.value();
+    file_util::Delete(temp_path, false);
+    return false;
+  }
+  return true;
+}
+
+URLIndexFile::URLIndexFile()
+    : header_(NULL),
+      words_(NULL),
+      chars_(NULL),
+      rows_(NULL) {
+}
+
+URLIndexFile::~URLIndexFile() {
+}
+
+bool URLIndexFile::Open(const FilePath& file_path) {
+  DCHECK(!header_);
+  if (!file_.Initialize(file_path))
+    return false;
+  const uint8* data = file_.data();
+  uint64 length = file_.length();
+  if (length < sizeof(Header))
+    return false;
+  const Header* header = reinterpret_cast<const Header*>(data);
+  if (header->magic != kFileMagic || header->version != kFileVersion)
+    return false;
+
+  struct Section {
+    uint64 offset;
+    uint64 length;
+  } sections[] = {
+    { header->words_offset,
+      static_cast<uint64>(header->word_count) * sizeof(WordEntry) },
+    { header->chars_offset,
+      static_cast<uint64>(header->char_count) * sizeof(CharEntry) },
+    { header->rows_offset,
+      static_cast<uint64>(header->row_count) * sizeof(RowEntry) },
+    { header->postings_offset, header->postings_length },
+    { header->strings_offset, header->strings_length },
+  };
+  for (size_t i = 0; i < arraysize(sections); ++i) {
+    if (sections[i].offset % kSectionAlignment != 0 ||
+        sections[i].offset > length ||
+        sections[i].length > length - sections[i].offset)
+      return false;
+  }
+
+  header_ = header;
+  words_ = reinterpret_cast<const WordEntry*>(data + header->words_offset);
+  chars_ = reinterpret_cast<const CharEntry*>(data + header->chars_offset);
+  rows_ = reinterpret_cast<const RowEntry*>(data + header->rows_offset);
+  return true;
+}
+
+base::Time URLIndexFile::timestamp() const {
+  return base::Time::FromInternalValue(header_ ? header_->timestamp : 0);
+}
+
+size_t URLIndexFile::word_count() const {
+  return header_ ? header_->word_count : 0;
+}
+
+size_t URLIndexFile::row_count() const {
+  return header_ ? header_->row_count : 0;
+}
+
+PostingListRef URLIndexFile::WordsForChar(char16 uni_char) const {
+  if (!header_)
+    return PostingListRef();
+  const CharEntry* end = chars_ + header_->char_count;
+  const CharEntry* entry = std::lower_bound(chars_, end, uni_char,
+                                            CharEntryLess);
+  if (entry == end || entry->uni_char != uni_char)
+    return PostingListRef();
+  return Postings(entry->word_ids);
+}
+
+PostingListRef URLIndexFile::HistoryIDsForWord(WordID word_id) const {
+  if (word_id < 0 || static_cast<size_t>(word_id) >= word_count())
+    return PostingListRef();
+  return Postings(words_[word_id].history_ids);
+}
+
+string16 URLIndexFile::Word(WordID word_id) const {
+  if (word_id < 0 || static_cast<size_t>(word_id) >= word_count())
+    return string16();
+  return String16At(words_[word_id].text_offset, words_[word_id].text_length);
+}
+
+bool URLIndexFile::HasRow(HistoryID history_id) const {
+  return FindRow(history_id) != NULL;
+}
+
+bool URLIndexFile::GetRow(HistoryID history_id, URLRow* row) const {
+  const RowEntry* entry = FindRow(history_id);
+  if (!entry)
+    return false;
+  FillRow(*entry, row);
+  return true;
+}
+
+void URLIndexFile::AddToBuilder(const std::set<HistoryID>& excluded,
+                                Builder* builder) const {
+  // The rows and postings are copied as they are, which is the bulk of a
+  // merge, so nothing is parsed on the way.
+  for (size_t i = 0; i < row_count(); ++i) {
+    const RowEntry& entry(rows_[i]);
+    if (excluded.count(entry.history_id))
+      continue;
+    const uint8* url = Strings(entry.url_offset, entry.url_length);
+    if (!url)
+      continue;
+    Builder::Row& row(builder->rows_[entry.history_id]);
+    row.last_visit = entry.last_visit;
+    row.visit_count = entry.visit_count;
+    row.typed_count = entry.typed_count;
+    row.url.assign(reinterpret_cast<const char*>(url), entry.url_length);
+    row.title = String16At(entry.title_offset, entry.title_length);
+  }
+  std::vector<HistoryID> history_ids;
+  for (size_t word_id = 0; word_id < word_count(); ++word_id) {
+    history_ids.clear();
+    HistoryIDsForWord(word_id).AppendTo(&history_ids);
+    if (!excluded.empty()) {
+      std::vector<HistoryID>::iterator out = history_ids.begin();
+      for (std::vector<HistoryID>::const_iterator iter = history_ids.begin();
+           iter != history_ids.end(); ++iter) {
+        if (!excluded.count(*iter))
+          *out++ = *iter;
+      }
+      history_ids.erase(out, history_ids.end());
+    }
+    builder->AddWord(Word(word_id), history_ids);
+  }
+}
+
+PostingListRef URLIndexFile::Postings(const PostingEntry& entry) const {
+  if (entry.offset > header_->postings_length ||
+      entry.length > header_->postings_length - entry.offset)
+    return PostingListRef();
+  return PostingListRef(
+      file_.data() + header_->postings_offset + entry.offset, entry.length,
+      entry.size, entry.last, (entry.flags & kPostingsAreBitmap) != 0);
+}
+
+// static
+bool URLIndexFile::CharEntryLess(const CharEntry& entry, uint32 uni_char) {
+  return entry.uni_char < uni_char;
+}
+
+// static
+bool URLIndexFile::RowEntryLess(const RowEntry& entry, HistoryID history_id) {
+  return entry.history_id < history_id;
+}
+
+const URLIndexFile::RowEntry* URLIndexFile::FindRow(
+    HistoryID history_id) const {
+  if (!header_)
+    return NULL;
+  const RowEntry* end = rows_ + header_->row_count;
+  const RowEntry* entry = std::lower_bound(rows_, end, history_id,
+                                           RowEntryLess);
+  if (entry == end || entry->history_id != history_id)
+    return NULL;
+  return entry;
+}
+
+void URLIndexFile::FillRow(const RowEntry& entry, URLRow* row) const {
+  const uint8* url = Strings(entry.url_offset, entry.url_length);
+  *row = URLRow(GURL(url ? std::string(reinterpret_cast<const char*>(url),
+                                       entry.url_length) : std::string()),
+                entry.history_id);
+  row->set_visit_count(entry.visit_count);
+  row->set_typed_count(entry.typed_count);
+  row->set_last_visit(base::Time::FromInternalValue(entry.last_visit));
+  row->set_title(String16At(entry.title_offset, entry.title_length));
+}
+
+const uint8* URLIndexFile::Strings(uint32 offset, size_t length) const {
+  if (offset > header_->strings_length ||
+      length > header_->strings_length - offset)
+    return NULL;
+  return file_.data() + header_->strings_offset + offset;
+}
+
+string16 URLIndexFile::String16At(uint32 offset, uint32 length) const {
+  const uint8* text = Strings(offset, length * sizeof(char16));
+  if (!text || !length)
+    return string16();
+  // The text may not be aligned for char16, so copy it byte by byte.
+  string16 result(length, 0);
+  memcpy(&result[0], text, length * sizeof(char16));
+  return result;
+}
+
+}  // namespace history
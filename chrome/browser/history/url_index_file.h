@@ -0,0 +1,157 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_URL_INDEX_FILE_H_
+#define CHROME_BROWSER_HISTORY_URL_INDEX_FILE_H_
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/string16.h"
+#include "base/time.h"
+#include "chrome/browser/history/history_types.h"
+#include "chrome/browser/history/posting_list.h"
+
+class FilePath;
+
+namespace history {
+
+// The InMemoryURLIndex as saved to disk, in a layout which is used in place
+// once the file is mapped into memory: restoring the index at startup costs
+// some page faults as it is queried rather than parsing the whole file.
+//
+// After a header giving the offset of each section, the file holds:
+//   - the words, sorted, each with the posting list of the history items
+//     containing it. A word's ID is its index in this table.
+//   - the characters, sorted, each with the posting list of the words
+//     containing it.
+//   - the history items, sorted by ID.
+//   - the encoded posting lists, and the strings, which the tables above
+//     point into.
+// Only the header is checked when the file is opened; every other access
+// checks its own bounds. The file is in the machine's byte order, as it is
+// only a cache.
+//
+// A file is never changed once written. The object is ref counted so that a
+// newer file can be merged on another thread while this one is in use.
+class URLIndexFile : public base::RefCountedThreadSafe<URLIndexFile> {
+ public:
+  typedef URLID HistoryID;
+  typedef int WordID;
+
+  // Collects an index, then writes it out as a file.
+  class Builder {
+   public:
+    Builder();
+    ~Builder();
+
+    // Adds the history item |row|, whose URL should be the formatted one
+    // the item was indexed under.
+    void AddRow(const URLRow& row);
+
+    // Records that the history items |history_ids| contain |word|.
+    void AddWord(const string16& word,
+                 const std::vector<HistoryID>& history_ids);
+
+    size_t row_count() const { return rows_.size(); }
+
+    // Writes the index to |file_path|, replacing any previous file. Fails on
+    // Windows if the previous file is still mapped.
+    bool WriteToFile(const FilePath& file_path, base::Time timestamp) const;
+
+   private:
+    friend class URLIndexFile;
+
+    // A history item as saved, which a file can copy over without parsing
+    // its URL.
+    struct Row {
+      Row();
+      ~Row();
+
+      int64 last_visit;
+      int visit_count;
+      int typed_count;
+      std::string url;
+      string16 title;
+    };
+
+    typedef std::map<HistoryID, Row> RowMap;
+    typedef std::map<string16, std::vector<HistoryID> > WordHistoryMap;
+
+    RowMap rows_;
+    WordHistoryMap words_;
+
+    DISALLOW_COPY_AND_ASSIGN(Builder);
+  };
+
+  URLIndexFile();
+
+  // Maps the file at |file_path|. Returns false if it can't be mapped or is
+  // not an index file of the current version.
+  bool Open(const FilePath& file_path);
+
+  base::Time timestamp() const;
+  size_t word_count() const;
+  size_t row_count() const;
+
+  // Returns the words containing |uni_char|.
+  PostingListRef WordsForChar(char16 uni_char) const;
+
+  // Returns the history items containing the word |word_id|.
+  PostingListRef HistoryIDsForWord(WordID word_id) const;
+
+  string16 Word(WordID word_id) const;
+
+  bool HasRow(HistoryID history_id) const;
+
+  // Fills in |row| with the history item |history_id|. Returns false if the
+  // file has no such item.
+  bool GetRow(HistoryID history_id, URLRow* row) const;
+
+  // Adds the whole index but the history items in |excluded| to |builder|.
+  void AddToBuilder(const std::set<HistoryID>& excluded,
+                    Builder* builder) const;
+
+ private:
+  friend class base::RefCountedThreadSafe<URLIndexFile>;
+
+  struct Header;
+  struct PostingEntry;
+  struct WordEntry;
+  struct CharEntry;
+  struct RowEntry;
+
+  ~URLIndexFile();
+
+  // Orderings for searching the tables.
+  static bool CharEntryLess(const CharEntry& entry, uint32 uni_char);
+  static bool RowEntryLess(const RowEntry& entry, HistoryID history_id);
+
+  PostingListRef Postings(const PostingEntry& entry) const;
+  const RowEntry* FindRow(HistoryID history_id) const;
+  void FillRow(const RowEntry& entry, URLRow* row) const;
+
+  // Returns |length| bytes of the strings section from |offset|, or NULL if
+  // they are out of bounds.
+  const uint8* Strings(uint32 offset, size_t length) const;
+  string16 String16At(uint32 offset, uint32 length) const;
+
+  file_util::MemoryMappedFile file_;
+  const Header* header_;
+  const WordEntry* words_;
+  const CharEntry* chars_;
+  const RowEntry* rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(URLIndexFile);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_URL_INDEX_FILE_H_
@@ -0,0 +1,160 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <set>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/url_index_file.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+namespace {
+
+URLRow MakeRow(URLID id, const char* url, const char* title) {
+  URLRow row(GURL(url), id);
+  row.set_title(ASCIIToUTF16(title));
+  row.set_visit_count(static_cast<int>(id) + 1);
+  row.set_typed_count(static_cast<int>(id) % 2);
+  row.set_last_visit(base::Time::FromInternalValue(1000 * id));
+  return row;
+}
+
+std::vector<URLIndexFile::HistoryID> IDs(URLID a, URLID b) {
+  std::vector<URLIndexFile::HistoryID> ids;
+  ids.push_back(a);
+  if (b)
+    ids.push_back(b);
+  return ids;
+}
+
+class URLIndexFileTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    file_path_ = temp_dir_.path().AppendASCII("index");
+  }
+
+  // Writes an index of two history items.
+  void WriteIndex() {
+    URLIndexFile::Builder builder;
+    builder.AddRow(MakeRow(7, "http://www.google.com/", "Google Search"));
+    builder.AddRow(MakeRow(3, "http://news.example.com/", "Example News"));
+    builder.AddWord(ASCIIToUTF16("google"), IDs(7, 0));
+    builder.AddWord(ASCIIToUTF16("search"), IDs(7, 0));
+    builder.AddWord(ASCIIToUTF16("example"), IDs(3, 0));
+    builder.AddWord(ASCIIToUTF16("news"), IDs(3, 0));
+    builder.AddWord(ASCIIToUTF16("com"), IDs(7, 3));
+    EXPECT_EQ(2U, builder.row_count());
+    ASSERT_TRUE(builder.WriteToFile(file_path_,
+                                    base::Time::FromInternalValue(42)));
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath file_path_;
+};
+
+}  // namespace
+
+TEST_F(URLIndexFileTest, WriteAndOpen) {
+  WriteIndex();
+  scoped_refptr<URLIndexFile> index_file(new URLIndexFile);
+  ASSERT_TRUE(index_file->Open(file_path_));
+  EXPECT_EQ(42, index_file->timestamp().ToInternalValue());
+  EXPECT_EQ(5U, index_file->word_count());
+  EXPECT_EQ(2U, index_file->row_count());
+
+  // Word IDs follow the order of the words.
+  EXPECT_EQ(ASCIIToUTF16("com"), index_file->Word(0));
+  EXPECT_EQ(ASCIIToUTF16("search"), index_file->Word(4));
+  EXPECT_EQ(string16(), index_file->Word(5));
+  std::vector<URLIndexFile::HistoryID> history_ids;
+  index_file->HistoryIDsForWord(0).AppendTo(&history_ids);
+  ASSERT_EQ(2U, history_ids.size());
+  EXPECT_EQ(3, history_ids[0]);
+  EXPECT_EQ(7, history_ids[1]);
+
+  // 'o' is in "com" and "google".
+  std::vector<URLIndexFile::WordID> word_ids;
+  index_file->WordsForChar('o').AppendTo(&word_ids);
+  ASSERT_EQ(2U, word_ids.size());
+  EXPECT_EQ(ASCIIToUTF16("com"), index_file->Word(word_ids[0]));
+  EXPECT_EQ(ASCIIToUTF16("google"), index_file->Word(word_ids[1]));
+  EXPECT_TRUE(index_file->WordsForChar('z').empty());
+
+  URLRow row;
+  EXPECT_FALSE(index_file->HasRow(5));
+  EXPECT_FALSE(index_file->GetRow(5, &row));
+  ASSERT_TRUE(index_file->GetRow(7, &row));
+  EXPECT_EQ(7, row.id());
+  EXPECT_EQ("http://www.google.com/", row.url().spec());
+  EXPECT_EQ(ASCIIToUTF16("Google Search"), row.title());
+  EXPECT_EQ(8, row.visit_count());
+  EXPECT_EQ(1, row.typed_count());
+  EXPECT_EQ(7000, row.last_visit().ToInternalValue());
+}
+
+TEST_F(URLIndexFileTest, AddToBuilder) {
+  WriteIndex();
+  scoped_refptr<URLIndexFile> index_file(new URLIndexFile);
+  ASSERT_TRUE(index_file->Open(file_path_));
+
+  // Copy the index without item 7, adding a new item, over the file in use.
+  URLIndexFile::Builder builder;
+  std::set<URLIndexFile::HistoryID> excluded;
+  excluded.insert(7);
+  index_file->AddToBuilder(excluded, &builder);
+  builder.AddRow(MakeRow(9, "http://www.google.com/maps", "Maps"));
+  builder.AddWord(ASCIIToUTF16("maps"), IDs(9, 0));
+  builder.AddWord(ASCIIToUTF16("com"), IDs(9, 0));
+  ASSERT_TRUE(builder.WriteToFile(file_path_, base::Time()));
+
+  scoped_refptr<URLIndexFile> new_file(new URLIndexFile);
+  ASSERT_TRUE(new_file->Open(file_path_));
+  EXPECT_EQ(2U, new_file->row_count());
+  EXPECT_TRUE(new_file->HasRow(3));
+  EXPECT_FALSE(new_file->HasRow(7));
+  EXPECT_TRUE(new_file->HasRow(9));
+  // "google" and "search" have no items left and are dropped.
+  EXPECT_EQ(4U, new_file->word_count());
+  std::vector<URLIndexFile::HistoryID> history_ids;
+  new_file->HistoryIDsForWord(0).AppendTo(&history_ids);
+  ASSERT_EQ(2U, history_ids.size());
+  EXPECT_EQ(3, history_ids[0]);
+  EXPECT_EQ(9, history_ids[1]);
+
+  // The old file stays usable while mapped.
+  EXPECT_TRUE(index_file->HasRow(7));
+}
+
+TEST_F(URLIndexFileTest, RejectsBadFiles) {
+  scoped_refptr<URLIndexFile> missing_file(new URLIndexFile);
+  EXPECT_FALSE(missing_file->Open(file_path_));
+
+  const char kJunk[] = "not an index";
+  ASSERT_EQ(static_cast<int>(sizeof(kJunk)),
+            file_util::WriteFile(file_path_, kJunk, sizeof(kJunk)));
+  scoped_refptr<URLIndexFile> junk_file(new URLIndexFile);
+  EXPECT_FALSE(junk_file->Open(file_path_));
+
+  // A file cut short fails its section checks.
+  WriteIndex();
+  int64 size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(file_path_, &size));
+  std::string data;
+  ASSERT_TRUE(file_util::ReadFileToString(file_path_, &data));
+  data.resize(static_cast<size_t>(size) - 8);
+  ASSERT_EQ(static_cast<int>(data.size()),
+            file_util::WriteFile(file_path_, data.data(), data.size()));
+  scoped_refptr<URLIndexFile> short_file(new URLIndexFile);
+  EXPECT_FALSE(short_file->Open(file_path_));
+}
+
+}  // namespace history
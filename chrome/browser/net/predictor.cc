@@ -44,6 +44,10 @@ const double Predictor::kDiscardableExpectedValue = 0.05;
 // system that uses a higher trim ratio when the list is large.
 // static
 const double Predictor::kReferrerTrimRatio = 0.97153;
+// static
+const int64 Predictor::kMinSpeculationsForHitRate = 4;
+// static
+const double Predictor::kMinPreconnectHitRate = 0.5;
 
 // static
 const TimeDelta Predictor::kDurationBetweenTrimmings = TimeDelta::FromHours(1);
@@ -133,7 +137,7 @@ void Predictor::ResolveList(const UrlList& urls,
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
   for (UrlList::const_iterator it = urls.begin(); it < urls.end(); ++it) {
-    AppendToResolutionQueue(*it, motivation);
+    AppendToResolutionQueue(*it, motivation, 0);
   }
 }
 
@@ -144,7 +148,7 @@ void Predictor::Resolve(const GURL& url,
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   if (!url.has_host())
     return;
-  AppendToResolutionQueue(url, motivation);
+  AppendToResolutionQueue(url, motivation, 0);
 }
 
 void Predictor::LearnFromNavigation(const GURL& referring_url,
@@ -283,7 +287,8 @@ void Predictor::PrepareFrameSubresources(const GURL& url) {
                                 10, 5000, 50);
     future_url->second.ReferrerWasObserved();
     if (preconnect_enabled_ &&
-        connection_expectation > kPreconnectWorthyExpectedValue) {
+        connection_expectation > kPreconnectWorthyExpectedValue &&
+        IsPreconnectionConfident(future_url->second)) {
       evalution = PRECONNECTION;
       future_url->second.IncrementPreconnectionCount();
       int count = static_cast<int>(std::ceil(connection_expectation));
@@ -294,7 +299,8 @@ void Predictor::PrepareFrameSubresources(const GURL& url) {
       evalution = PRERESOLUTION;
       future_url->second.preresolution_increment();
       UrlInfo* queued_info = AppendToResolutionQueue(future_url->first,
-                                                     motivation);
+                                                     motivation,
+                                                     connection_expectation);
       if (queued_info)
         queued_info->SetReferringHostname(url);
     }
@@ -303,6 +309,14 @@ void Predictor::PrepareFrameSubresources(const GURL& url) {
   }
 }
 
+// static
+bool Predictor::IsPreconnectionConfident(const ReferrerValue& value) {
+  const int64 speculations = value.hit_count() + value.waste_count();
+  if (speculations < kMinSpeculationsForHitRate)
+    return true;  // Too little history to second-guess the expected value.
+  return value.hit_count() >= kMinPreconnectHitRate * speculations;
+}
+
 // Provide sort order so all .com's are together, etc.
 struct RightToLeftStringSorter {
   bool operator()(const GURL& left,
@@ -387,6 +401,8 @@ void Predictor::GetHtmlReferrerLists(std::string* output) {
       "<th>Subresource<br>Navigations</th>"
       "<th>Subresource<br>PreConnects</th>"
       "<th>Subresource<br>PreResolves</th>"
+      "<th>Speculation<br>Hits</th>"
+      "<th>Speculation<br>Waste</th>"
       "<th>Expected<br>Connects</th>"
       "<th>Subresource Spec</th></tr>");
 
@@ -407,10 +423,13 @@ void Predictor::GetHtmlReferrerLists(std::string* output) {
       }
       first_set_of_futures = false;
       base::StringAppendF(output,
-          "<td>%d</td><td>%d</td><td>%d</td><td>%2.3f</td><td>%s</td></tr>",
+          "<td>%d</td><td>%d</td><td>%d</td><td>%d</td><td>%d</td>"
+          "<td>%2.3f</td><td>%s</td></tr>",
           static_cast<int>(future_url->second.navigation_count()),
           static_cast<int>(future_url->second.preconnection_count()),
           static_cast<int>(future_url->second.preresolution_count()),
+          static_cast<int>(future_url->second.hit_count()),
+          static_cast<int>(future_url->second.waste_count()),
           static_cast<double>(future_url->second.subresource_use_rate()),
           future_url->first.spec().c_str());
     }
@@ -457,7 +476,8 @@ void Predictor::GetHtmlInfo(std::string* output) {
 
 UrlInfo* Predictor::AppendToResolutionQueue(
     const GURL& url,
-    UrlInfo::ResolutionMotivation motivation) {
+    UrlInfo::ResolutionMotivation motivation,
+    double expected_benefit) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   DCHECK(url.has_host());
 
@@ -477,7 +497,7 @@ UrlInfo* Predictor::AppendToResolutionQueue(
   }
 
   info->SetQueuedState(motivation);
-  work_queue_.Push(url, motivation);
+  work_queue_.Push(url, motivation, expected_benefit);
   StartSomeQueuedResolutions();
   return info;
 }
@@ -702,7 +722,28 @@ void Predictor::IncrementalTrimReferrers(bool trim_all_now) {
 
 //------------------------------------------------------------------------------
 
-Predictor::HostNameQueue::HostNameQueue() {
+Predictor::HostNameQueue::Entry::Entry(const GURL& url,
+                                       bool rush,
+                                       double expected_benefit,
+                                       int64 sequence_number)
+    : url(url),
+      rush(rush),
+      expected_benefit(expected_benefit),
+      sequence_number(sequence_number) {
+}
+
+Predictor::HostNameQueue::Entry::~Entry() {
+}
+
+bool Predictor::HostNameQueue::Entry::operator<(const Entry& other) const {
+  if (rush != other.rush)
+    return other.rush;
+  if (expected_benefit != other.expected_benefit)
+    return expected_benefit < other.expected_benefit;
+  return sequence_number > other.sequence_number;
+}
+
+Predictor::HostNameQueue::HostNameQueue() : push_count_(0) {
 }
 
 Predictor::HostNameQueue::~HostNameQueue() {
@@ -710,29 +751,34 @@ Predictor::HostNameQueue::~HostNameQueue() {
 
 void Predictor::HostNameQueue::Push(const GURL& url,
     UrlInfo::ResolutionMotivation motivation) {
+  Push(url, motivation, 0);
+}
+
+void Predictor::HostNameQueue::Push(const GURL& url,
+    UrlInfo::ResolutionMotivation motivation,
+    double expected_benefit) {
+  bool rush = false;
   switch (motivation) {
     case UrlInfo::STATIC_REFERAL_MOTIVATED:
     case UrlInfo::LEARNED_REFERAL_MOTIVATED:
     case UrlInfo::MOUSE_OVER_MOTIVATED:
-      rush_queue_.push(url);
+      rush = true;
       break;
 
     default:
-      background_queue_.push(url);
       break;
   }
+  queue_.push(Entry(url, rush, expected_benefit, push_count_++));
 }
 
 bool Predictor::HostNameQueue::IsEmpty() const {
-  return rush_queue_.empty() && background_queue_.empty();
+  return queue_.empty();
 }
 
 GURL Predictor::HostNameQueue::Pop() {
   DCHECK(!IsEmpty());
-  std::queue<GURL> *queue(rush_queue_.empty() ? &background_queue_
-                                              : &rush_queue_);
-  GURL url(queue->front());
-  queue->pop();
+  GURL url(queue_.top().url);
+  queue_.pop();
   return url;
 }
 
@@ -144,34 +144,59 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, MassiveConcurrentLookupTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueuePushPopTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueueReorderTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, PriorityQueueBenefitTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, SubresourceHitWasteTest);
+  FRIEND_TEST_ALL_PREFIXES(PredictorTest, PreconnectionConfidenceTest);
   FRIEND_TEST_ALL_PREFIXES(PredictorTest, ReferrerSerializationTrimTest);
   friend class WaitForResolutionHelper;  // For testing.
+  friend class PredictorPerfTest;
 
   class LookupRequest;
 
-  // A simple priority queue for handling host names.
+  // A priority queue for handling host names.
   // Some names that are queued up have |motivation| that requires very rapid
   // handling.  For example, a sub-resource name lookup MUST be done before the
   // actual sub-resource is fetched.  In contrast, a name that was speculatively
   // noted in a page has to be resolved before the user "gets around to"
   // clicking on a link.  By tagging (with a motivation) each push we make into
-  // this FIFO queue, the queue can re-order the more important names to service
+  // this queue, the queue can re-order the more important names to service
   // them sooner (relative to some low priority background resolutions).
+  // Within each of those two classes, names with a larger expected benefit
+  // (such as the expected number of connections to a learned subresource) are
+  // serviced first, and names of equal benefit in FIFO order.
   class HostNameQueue {
    public:
     HostNameQueue();
     ~HostNameQueue();
     void Push(const GURL& url,
               UrlInfo::ResolutionMotivation motivation);
+    void Push(const GURL& url,
+              UrlInfo::ResolutionMotivation motivation,
+              double expected_benefit);
     bool IsEmpty() const;
     GURL Pop();
 
    private:
-    // The names in the queue that should be serviced (popped) ASAP.
-    std::queue<GURL> rush_queue_;
-    // The names in the queue that should only be serviced when rush_queue is
-    // empty.
-    std::queue<GURL> background_queue_;
+    struct Entry {
+      Entry(const GURL& url, bool rush, double expected_benefit,
+            int64 sequence_number);
+      ~Entry();
+
+      // Orders the entry that should be serviced first last, as the top of a
+      // std::priority_queue is its largest element.
+      bool operator<(const Entry& other) const;
+
+      GURL url;
+      // True if the name should be serviced (popped) ASAP, before any name
+      // that should only be serviced when there is nothing more urgent.
+      bool rush;
+      double expected_benefit;
+      int64 sequence_number;
+    };
+
+    std::priority_queue<Entry> queue_;
+    // Counts pushes, to keep FIFO order among equal entries.
+    int64 push_count_;
 
   DISALLOW_COPY_AND_ASSIGN(HostNameQueue);
   };
@@ -194,6 +219,10 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
   // following ratio until that value is less than kDiscardableExpectedValue.
   // This number should always be less than 1, an more than 0.
   static const double kReferrerTrimRatio;
+  // Once a subresource has been speculated on this many times, it is only
+  // preconnected while at least this fraction of the speculations were hits.
+  static const int64 kMinSpeculationsForHitRate;
+  static const double kMinPreconnectHitRate;
 
   // Interval between periodic trimming of our whole referrer list.
   // We only do a major trimming about once an hour, and then only when the user
@@ -211,6 +240,10 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
   // PredictFrameSubresources().
   void PrepareFrameSubresources(const GURL& url);
 
+  // Returns true if the past hits and waste of speculations on |value| give
+  // enough confidence to preconnect to it, rather than only pre-resolve it.
+  static bool IsPreconnectionConfident(const ReferrerValue& value);
+
   // Only for testing. Returns true if hostname has been successfully resolved
   // (name found).
   bool WasFound(const GURL& url) const {
@@ -238,9 +271,10 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
                       const GURL& url, bool found);
 
   // Queue hostname for resolution.  If queueing was done, return the pointer
-  // to the queued instance, otherwise return NULL.
+  // to the queued instance, otherwise return NULL.  |expected_benefit| orders
+  // the name among others of a similar motivation.
   UrlInfo* AppendToResolutionQueue(const GURL& url,
-      UrlInfo::ResolutionMotivation motivation);
+      UrlInfo::ResolutionMotivation motivation, double expected_benefit);
 
   // Check to see if too much queuing delay has been noted for the given info,
   // which indicates that there is "congestion" or growing delay in handling the
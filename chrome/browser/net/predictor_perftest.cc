@@ -0,0 +1,185 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Replays a browsing trace through the Predictor against a mock resolver, and
+// logs how often its speculations were used:
+//   $ ./perf_tests --gtest_filter=PredictorPerfTest.*
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/time.h"
+#include "base/values.h"
+#include "chrome/browser/net/predictor_api.h"
+#include "content/browser/browser_thread.h"
+#include "net/base/mock_host_resolver.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace chrome_browser_net {
+
+namespace {
+
+// The hosts a page loads subresources from, and the percentage of visits
+// that need each of them.  Ad and analytics hosts vary the most.
+struct Subresource {
+  const char* host;
+  int percent_needed;
+};
+
+struct Page {
+  const char* host;
+  Subresource subresources[4];
+};
+
+// A trace of the sites in a browsing session, the most visited first.
+const Page kTrace[] = {
+  { "http://www.google.com:80",
+    { { "http://ssl.gstatic.com:80", 100 },
+      { "http://www.gstatic.com:80", 90 },
+      { "http://clients1.google.com:80", 60 },
+      { NULL, 0 } } },
+  { "http://news.example.com:80",
+    { { "http://static.example.com:80", 100 },
+      { "http://ads.example.net:80", 40 },
+      { "http://stats.example.org:80", 70 },
+      { "http://img.example.com:80", 95 } } },
+  { "http://mail.example.com:80",
+    { { "http://static.example.com:80", 100 },
+      { "http://chat.example.com:80", 30 },
+      { NULL, 0 },
+      { NULL, 0 } } },
+  { "http://video.example.tv:80",
+    { { "http://cdn1.example.tv:80", 85 },
+      { "http://cdn2.example.tv:80", 45 },
+      { "http://ads.example.net:80", 55 },
+      { NULL, 0 } } },
+  { "http://shop.example.biz:80",
+    { { "http://images.example.biz:80", 100 },
+      { "http://stats.example.org:80", 20 },
+      { "http://reviews.example.biz:80", 35 },
+      { NULL, 0 } } },
+  { "http://blog.example.org:80",
+    { { "http://comments.example.org:80", 50 },
+      { "http://ads.example.net:80", 10 },
+      { NULL, 0 },
+      { NULL, 0 } } },
+};
+
+const int kNavigations = 5000;
+
+// A deterministic source of choices, so that every run replays the same
+// navigations.
+class Generator {
+ public:
+  Generator() : state_(12345) {}
+
+  int Next(int range) {
+    state_ = state_ * 1103515245 + 12345;
+    return static_cast<int>((state_ >> 16) % range);
+  }
+
+ private:
+  uint32 state_;
+};
+
+}  // namespace
+
+class PredictorPerfTest : public testing::Test {
+ protected:
+  PredictorPerfTest()
+      : io_thread_(BrowserThread::IO, &loop_),
+        host_resolver_(new net::MockCachingHostResolver()) {
+    host_resolver_->set_synchronous_mode(true);
+  }
+
+  virtual void SetUp() {
+    predictor_ = new Predictor(
+        host_resolver_.get(),
+        base::TimeDelta::FromMilliseconds(
+            PredictorInit::kMaxSpeculativeResolveQueueDelayMs),
+        PredictorInit::kMaxSpeculativeParallelResolves,
+        false);
+  }
+
+  virtual void TearDown() {
+    predictor_->Shutdown();
+    MessageLoop::current()->RunAllPending();
+  }
+
+  // Visits the pages of the trace, favoring the first ones, and learns the
+  // subresources each visit needs.
+  void Replay() {
+    Generator generator;
+    for (int i = 0; i < kNavigations; ++i) {
+      // Squaring favors the first pages.
+      int choice = generator.Next(100);
+      const Page& page = kTrace[choice * choice * arraysize(kTrace) / 10000];
+      const GURL page_url(page.host);
+      predictor_->PrepareFrameSubresources(page_url);
+      for (size_t j = 0; j < arraysize(page.subresources); ++j) {
+        const Subresource& subresource = page.subresources[j];
+        if (subresource.host &&
+            generator.Next(100) < subresource.percent_needed)
+          predictor_->LearnFromNavigation(page_url, GURL(subresource.host));
+      }
+    }
+  }
+
+  // Logs the hits and waste of all speculations under |name|.
+  void LogSpeculations(const std::string& name) {
+    int64 hits = 0;
+    int64 waste = 0;
+    for (Predictor::Referrers::const_iterator it =
+             predictor_->referrers_.begin();
+         it != predictor_->referrers_.end(); ++it) {
+      for (Referrer::const_iterator future_url = it->second.begin();
+           future_url != it->second.end(); ++future_url) {
+        hits += future_url->second.hit_count();
+        waste += future_url->second.waste_count();
+      }
+    }
+    LogPerfResult((name + "_hits").c_str(), static_cast<double>(hits), "");
+    LogPerfResult((name + "_waste").c_str(), static_cast<double>(waste), "");
+    ASSERT_LT(0, hits + waste);
+    LogPerfResult((name + "_hit_rate").c_str(),
+                  100.0 * hits / (hits + waste), "%");
+  }
+
+ private:
+  // The host resolver must not outlive the message loop.
+  MessageLoop loop_;
+  BrowserThread io_thread_;
+
+ protected:
+  scoped_ptr<net::MockCachingHostResolver> host_resolver_;
+  scoped_refptr<Predictor> predictor_;
+};
+
+TEST_F(PredictorPerfTest, Replay) {
+  PerfTimeLogger timer("Predictor_replay");
+  Replay();
+  timer.Done();
+  LogSpeculations("Predictor_replay");
+
+  // Restoring the learned graph in a new session keeps the predictions, but
+  // not the counts of earlier hits and waste.
+  ListValue referral_list;
+  predictor_->SerializeReferrers(&referral_list);
+  predictor_->Shutdown();
+  predictor_ = new Predictor(
+      host_resolver_.get(),
+      base::TimeDelta::FromMilliseconds(
+          PredictorInit::kMaxSpeculativeResolveQueueDelayMs),
+      PredictorInit::kMaxSpeculativeParallelResolves,
+      false);
+  predictor_->DeserializeReferrers(referral_list);
+  Replay();
+  LogSpeculations("Predictor_restored_replay");
+}
+
+}  // namespace chrome_browser_net
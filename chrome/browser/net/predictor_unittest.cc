@@ -561,6 +561,87 @@ TEST_F(PredictorTest, PriorityQueueReorderTest) {
   EXPECT_TRUE(queue.IsEmpty());
 }
 
+TEST_F(PredictorTest, PriorityQueueBenefitTest) {
+  Predictor::HostNameQueue queue;
+
+  GURL low("http://low:80"),
+      unlikely("http://unlikely:80"),
+      likely1("http://likely1:80"),
+      likely2("http://likely2:80");
+
+  queue.Push(low, UrlInfo::PAGE_SCAN_MOTIVATED, 10.0);
+  queue.Push(unlikely, UrlInfo::LEARNED_REFERAL_MOTIVATED, 0.2);
+  queue.Push(likely1, UrlInfo::LEARNED_REFERAL_MOTIVATED, 3.0);
+  queue.Push(likely2, UrlInfo::LEARNED_REFERAL_MOTIVATED, 3.0);
+
+  // The most beneficial high priority names come out first, in FIFO order when
+  // equally beneficial...
+  EXPECT_EQ(queue.Pop(), likely1);
+  EXPECT_EQ(queue.Pop(), likely2);
+  EXPECT_EQ(queue.Pop(), unlikely);
+
+  // ...and low priority names only after them, whatever their benefit.
+  EXPECT_EQ(queue.Pop(), low);
+
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST_F(PredictorTest, SubresourceHitWasteTest) {
+  scoped_refptr<Predictor> predictor(
+      new Predictor(host_resolver_.get(),
+                    default_max_queueing_delay_,
+                    PredictorInit::kMaxSpeculativeParallelResolves,
+                    false));
+  GURL page("http://www.google.com:80");
+  GURL icons("http://icons.google.com:80");
+
+  predictor->LearnFromNavigation(page, icons);
+  const ReferrerValue& value = predictor->referrers_[page][icons];
+
+  // The next visit to the page pre-resolves the subresource, which it needs.
+  predictor->PrepareFrameSubresources(page);
+  EXPECT_EQ(1, value.preresolution_count());
+  predictor->LearnFromNavigation(page, icons);
+  EXPECT_EQ(1, value.hit_count());
+  EXPECT_EQ(0, value.waste_count());
+
+  // A second connection during the same visit is not another hit.
+  predictor->LearnFromNavigation(page, icons);
+  EXPECT_EQ(1, value.hit_count());
+
+  // A visit that doesn't need the subresource is counted as waste when the
+  // page is visited again.
+  predictor->PrepareFrameSubresources(page);
+  EXPECT_EQ(0, value.waste_count());
+  predictor->PrepareFrameSubresources(page);
+  EXPECT_EQ(1, value.hit_count());
+  EXPECT_EQ(1, value.waste_count());
+
+  predictor->Shutdown();
+}
+
+TEST_F(PredictorTest, PreconnectionConfidenceTest) {
+  ReferrerValue value;
+  EXPECT_TRUE(Predictor::IsPreconnectionConfident(value));
+
+  // Waste is tolerated until there have been enough speculations to judge.
+  for (int64 i = 1; i < Predictor::kMinSpeculationsForHitRate; ++i) {
+    value.IncrementPreconnectionCount();
+    value.ReferrerWasObserved();
+  }
+  EXPECT_TRUE(Predictor::IsPreconnectionConfident(value));
+  value.IncrementPreconnectionCount();
+  value.ReferrerWasObserved();
+  EXPECT_FALSE(Predictor::IsPreconnectionConfident(value));
+
+  // As many hits as waste restore confidence.
+  for (int64 i = 0; i < Predictor::kMinSpeculationsForHitRate; ++i) {
+    value.preresolution_increment();
+    value.SubresourceIsNeeded();
+  }
+  EXPECT_TRUE(Predictor::IsPreconnectionConfident(value));
+}
+
 TEST_F(PredictorTest, CanonicalizeUrl) {
   // Base case, only handles HTTP and HTTPS.
   EXPECT_EQ(GURL(), Predictor::CanonicalizeUrl(GURL("ftp://anything")));
@@ -164,6 +164,9 @@ ReferrerValue::ReferrerValue()
       navigation_count_(0),
       preconnection_count_(0),
       preresolution_count_(0),
+      hit_count_(0),
+      waste_count_(0),
+      speculated_(false),
       subresource_use_rate_(kInitialConnectsExpectedValue) {
 }
 
@@ -171,10 +174,19 @@ void ReferrerValue::SubresourceIsNeeded() {
   DCHECK_GE(kWeightingForOldConnectsExpectedValue, 0);
   DCHECK_LE(kWeightingForOldConnectsExpectedValue, 1.0);
   ++navigation_count_;
+  if (speculated_) {
+    ++hit_count_;
+    speculated_ = false;
+  }
   subresource_use_rate_ += 1 - kWeightingForOldConnectsExpectedValue;
 }
 
 void ReferrerValue::ReferrerWasObserved() {
+  // A speculation from the last observation that was never needed was wasted.
+  if (speculated_) {
+    ++waste_count_;
+    speculated_ = false;
+  }
   subresource_use_rate_ *= kWeightingForOldConnectsExpectedValue;
   // Note: the use rate is temporarilly possibly incorect, as we need to find
   // out if we really end up connecting.  This will happen in a few hundred
@@ -55,10 +55,22 @@ class ReferrerValue {
   double subresource_use_rate() const { return subresource_use_rate_; }
 
   int64 preconnection_count() const { return preconnection_count_; }
-  void IncrementPreconnectionCount() { ++preconnection_count_; }
+  void IncrementPreconnectionCount() {
+    ++preconnection_count_;
+    speculated_ = true;
+  }
 
   int64 preresolution_count() const { return preresolution_count_; }
-  void preresolution_increment() { ++preresolution_count_; }
+  void preresolution_increment() {
+    ++preresolution_count_;
+    speculated_ = true;
+  }
+
+  // The number of preconnections or pre-resolutions of this item that were
+  // followed by a navigation to it (hits), and that were not before the
+  // referrer was next observed (waste).
+  int64 hit_count() const { return hit_count_; }
+  int64 waste_count() const { return waste_count_; }
 
   // Reduce the subresource_use_rate_ by the supplied factor, and return true
   // if the result is still greater than the given threshold.
@@ -78,6 +90,13 @@ class ReferrerValue {
   // of its referrer.
   int64 preresolution_count_;
 
+  int64 hit_count_;
+  int64 waste_count_;
+
+  // True from a preconnection or pre-resolution until it is counted as a hit
+  // or as waste.
+  bool speculated_;
+
   // A smoothed estimate of the expected number of connections that will be made
   // to this subresource.
   double subresource_use_rate_;
@@ -42,6 +42,14 @@
 //  --filter-num-checks: The number of hash look ups to perform on the bloom
 //                       filter. The default is 10 million.
 //
+//
+// Prefix set lookup time usage:
+//   $ ./perf_tests.exe --gtest_filter=SafeBrowsingPrefixSet.LookupTime
+//                      --filter-num-checks=<integer>
+//
+//  Compares the memory use and look up time of the bloom filter with those of
+//  a prefix set built in memory and one mapped from its file.
+//
 // Data files:
 //    chrome/test/data/safe_browsing/filter/database
 //    chrome/test/data/safe_browsing/filter/urls
@@ -61,7 +69,9 @@
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_temp_dir.h"
 #include "base/path_service.h"
 #include "base/rand_util.h"
 #include "base/string_number_conversions.h"
@@ -69,6 +79,7 @@
 #include "base/time.h"
 #include "crypto/sha2.h"
 #include "chrome/browser/safe_browsing/bloom_filter.h"
+#include "chrome/browser/safe_browsing/prefix_set.h"
 #include "chrome/browser/safe_browsing/safe_browsing_util.h"
 #include "chrome/common/chrome_paths.h"
 #include "googleurl/src/gurl.h"
@@ -89,6 +100,10 @@ const char kFilterNumChecks[] = "filter-num-checks";
 // Number of hash checks to make during performance testing.
 const int kNumHashChecks = 10000000;
 
+// Number of random prefixes to cycle through for prefix set checks, so that
+// generating them isn't part of the time.
+const size_t kNumCheckPrefixes = 65536;
+
 // Returns the path to the data used in this test, relative to the top of the
 // source directory.
 FilePath GetFullDataPath() {
@@ -285,6 +300,22 @@ void CalculateBloomFilterFalsePositives(
   std::cout << std::endl;
 }
 
+// Returns the time taken to check |num_checks| prefixes from |prefixes|
+// against |set|, and the number found in |hits|.
+template <class T>
+TimeDelta TimeChecks(const T& set,
+                     const std::vector<SBPrefix>& prefixes,
+                     int num_checks,
+                     int* hits) {
+  *hits = 0;
+  Time check_before = Time::Now();
+  for (int i = 0; i < num_checks; ++i) {
+    if (set.Exists(prefixes[i % prefixes.size()]))
+      ++*hits;
+  }
+  return Time::Now() - check_before;
+}
+
 }  // namespace
 
 // This test can take several minutes to perform its calculations, so it should
@@ -361,3 +392,75 @@ TEST(SafeBrowsingBloomFilter, HashTime) {
             << ", per-check (us): "        << time_per_check
             << std::endl;
 }
+
+// Compares the memory use and time of look ups in the bloom filter with those
+// of a prefix set of the same prefixes, both as built in memory and as mapped
+// from its file.
+TEST(SafeBrowsingPrefixSet, LookupTime) {
+  // Read the data from the database.
+  std::vector<SBPrefix> prefix_list;
+  FilePath data_dir = GetFullDataPath();
+  ASSERT_TRUE(ReadDatabase(data_dir, &prefix_list));
+
+  const CommandLine& cmd_line = *CommandLine::ForCurrentProcess();
+
+  int num_checks = kNumHashChecks;
+  if (cmd_line.HasSwitch(kFilterNumChecks)) {
+    ASSERT_TRUE(
+        base::StringToInt(cmd_line.GetSwitchValueASCII(kFilterNumChecks),
+                          &num_checks));
+  }
+
+  BloomFilter* bloom_filter = NULL;
+  BuildBloomFilter(BloomFilter::kBloomFilterSizeRatio,
+                   prefix_list, &bloom_filter);
+  scoped_refptr<BloomFilter> bloom_filter_ref(bloom_filter);
+
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(prefix_list));
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath prefix_set_file = temp_dir.path().AppendASCII("PrefixSet");
+  ASSERT_TRUE(prefix_set->WriteFile(prefix_set_file));
+  scoped_refptr<safe_browsing::PrefixSet>
+      mapped_prefix_set(safe_browsing::PrefixSet::LoadFile(prefix_set_file));
+  ASSERT_TRUE(mapped_prefix_set.get());
+
+  // Half of the checks are for prefixes in the set, which walk the deltas
+  // all the way to their prefix.
+  std::vector<SBPrefix> check_prefixes;
+  for (size_t i = 0; i < kNumCheckPrefixes; ++i) {
+    if (i % 2) {
+      check_prefixes.push_back(static_cast<SBPrefix>(base::RandUint64()));
+    } else {
+      check_prefixes.push_back(
+          prefix_list[base::RandGenerator(prefix_list.size())]);
+    }
+  }
+
+  int bloom_hits = 0;
+  const TimeDelta bloom_check =
+      TimeChecks(*bloom_filter, check_prefixes, num_checks, &bloom_hits);
+  int prefix_set_hits = 0;
+  const TimeDelta prefix_set_check =
+      TimeChecks(*prefix_set, check_prefixes, num_checks, &prefix_set_hits);
+  int mapped_hits = 0;
+  const TimeDelta mapped_check =
+      TimeChecks(*mapped_prefix_set, check_prefixes, num_checks, &mapped_hits);
+  EXPECT_EQ(prefix_set_hits, mapped_hits);
+  EXPECT_LE(prefix_set_hits, bloom_hits);
+
+  std::cout << "Prefix set results for checks: "  << num_checks
+            << ", prefixes: "                     << prefix_list.size()
+            << ", bloom filter size (bytes): "    << bloom_filter->size()
+            << ", prefix set size (bytes): "      << prefix_set->GetDataSize()
+            << ", bloom filter check time (ms): "
+            << bloom_check.InMilliseconds()
+            << ", prefix set check time (ms): "
+            << prefix_set_check.InMilliseconds()
+            << ", mapped prefix set check time (ms): "
+            << mapped_check.InMilliseconds()
+            << ", bloom filter hits: "            << bloom_hits
+            << ", prefix set hits: "              << prefix_set_hits
+            << std::endl;
+}
@@ -11,6 +11,15 @@
 #include "base/logging.h"
 #include "base/md5.h"
 #include "base/metrics/histogram.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY) && (defined(__SSE2__) || defined(_M_X64))
+#define PREFIX_SET_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(ARCH_CPU_ARM_FAMILY) && defined(__ARM_NEON__)
+#define PREFIX_SET_USE_NEON 1
+#include <arm_neon.h>
+#endif
 
 namespace {
 
@@ -19,8 +28,9 @@ namespace {
 // md5 -qs chrome/browser/safe_browsing/prefix_set.cc | colrm 9
 static uint32 kMagic = 0x864088dd;
 
-// Current version the code writes out.
-static uint32 kVersion = 0x1;
+// Current version the code writes out.  Version 1 saved index
+// entries with a |size_t| offset, so its layout varied by platform.
+static uint32 kVersion = 0x2;
 
 typedef struct {
   uint32 magic;
@@ -29,29 +39,58 @@ typedef struct {
   uint32 deltas_size;
 } FileHeader;
 
-// For |std::upper_bound()| to find a prefix w/in a vector of pairs.
-bool PrefixLess(const std::pair<SBPrefix,size_t>& a,
-                const std::pair<SBPrefix,size_t>& b) {
-  return a.first < b.first;
+// The number of deltas |ScanDeltas()| sums at once.
+const int kDeltaBlockSize = 8;
+
+// Returns the sum of the |kDeltaBlockSize| deltas at |deltas|.
+inline uint32 SumDeltaBlock(const uint16* deltas) {
+#if defined(PREFIX_SET_USE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas));
+  __m128i sums = _mm_add_epi32(_mm_unpacklo_epi16(block, zero),
+                               _mm_unpackhi_epi16(block, zero));
+  sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+  sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+  return static_cast<uint32>(_mm_cvtsi128_si32(sums));
+#elif defined(PREFIX_SET_USE_NEON)
+  const uint32x4_t pairs = vpaddlq_u16(vld1q_u16(deltas));
+  const uint64x2_t quads = vpaddlq_u32(pairs);
+  return static_cast<uint32>(vgetq_lane_u64(quads, 0) +
+                             vgetq_lane_u64(quads, 1));
+#else
+  uint32 sum = 0;
+  for (int i = 0; i < kDeltaBlockSize; ++i)
+    sum += deltas[i];
+  return sum;
+#endif
 }
 
 }  // namespace
 
 namespace safe_browsing {
 
-PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
+PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes)
+    : index_(NULL),
+      index_size_(0),
+      deltas_(NULL),
+      deltas_size_(0),
+      checksum_(0) {
   if (sorted_prefixes.size()) {
     // Lead with the first prefix.
     SBPrefix prev_prefix = sorted_prefixes[0];
     size_t run_length = 0;
-    index_.push_back(std::make_pair(prev_prefix, deltas_.size()));
+    IndexEntry entry;
+    entry.prefix = prev_prefix;
+    entry.offset = 0;
+    index_vector_.push_back(entry);
 
     // Used to build a checksum from the data used to construct the
     // structures.  Since the data is a bunch of uniform hashes, it
     // seems reasonable to just xor most of it in, rather than trying
     // to use a more complicated algorithm.
     uint32 checksum = static_cast<uint32>(sorted_prefixes[0]);
-    checksum ^= static_cast<uint32>(deltas_.size());
+    checksum ^= static_cast<uint32>(deltas_vector_.size());
 
     for (size_t i = 1; i < sorted_prefixes.size(); ++i) {
       // Skip duplicates.
@@ -68,27 +107,33 @@ PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
       // consecutive deltas have been encoded.
       if (delta != static_cast<unsigned>(delta16) || run_length >= kMaxRun) {
         checksum ^= static_cast<uint32>(sorted_prefixes[i]);
-        checksum ^= static_cast<uint32>(deltas_.size());
-        index_.push_back(std::make_pair(sorted_prefixes[i], deltas_.size()));
+        checksum ^= static_cast<uint32>(deltas_vector_.size());
+        entry.prefix = sorted_prefixes[i];
+        entry.offset = static_cast<uint32>(deltas_vector_.size());
+        index_vector_.push_back(entry);
         run_length = 0;
       } else {
         checksum ^= static_cast<uint32>(delta16);
         // Continue the run of deltas.
-        deltas_.push_back(delta16);
-        DCHECK_EQ(static_cast<unsigned>(deltas_.back()), delta);
+        deltas_vector_.push_back(delta16);
+        DCHECK_EQ(static_cast<unsigned>(deltas_vector_.back()), delta);
         ++run_length;
       }
 
       prev_prefix = sorted_prefixes[i];
     }
     checksum_ = checksum;
+
+    index_ = &index_vector_[0];
+    index_size_ = index_vector_.size();
+    deltas_ = deltas_vector_.empty() ? NULL : &deltas_vector_[0];
+    deltas_size_ = deltas_vector_.size();
     DCHECK(CheckChecksum());
 
     // Send up some memory-usage stats.  Bits because fractional bytes
     // are weird.
-    const size_t bits_used = index_.size() * sizeof(index_[0]) * CHAR_BIT +
-        deltas_.size() * sizeof(deltas_[0]) * CHAR_BIT;
-    const size_t unique_prefixes = index_.size() + deltas_.size();
+    const size_t bits_used = GetDataSize() * CHAR_BIT;
+    const size_t unique_prefixes = GetSize();
     static const size_t kMaxBitsPerPrefix = sizeof(SBPrefix) * CHAR_BIT;
     UMA_HISTOGRAM_ENUMERATION("SB2.PrefixSetBitsPerPrefix",
                               bits_used / unique_prefixes,
@@ -96,58 +141,89 @@ PrefixSet::PrefixSet(const std::vector<SBPrefix>& sorted_prefixes) {
   }
 }
 
-PrefixSet::PrefixSet(std::vector<std::pair<SBPrefix,size_t> > *index,
-                     std::vector<uint16> *deltas) {
-  DCHECK(index && deltas);
-  index_.swap(*index);
-  deltas_.swap(*deltas);
+PrefixSet::PrefixSet(file_util::MemoryMappedFile* file,
+                     const IndexEntry* index, size_t index_size,
+                     const uint16* deltas, size_t deltas_size)
+    : file_(file),
+      index_(index),
+      index_size_(index_size),
+      deltas_(deltas),
+      deltas_size_(deltas_size),
+      checksum_(0) {
+  DCHECK(file);
+  checksum_ = ComputeChecksum();
 }
 
 PrefixSet::~PrefixSet() {}
 
+// static
+bool PrefixSet::PrefixLess(SBPrefix prefix, const IndexEntry& entry) {
+  return prefix < entry.prefix;
+}
+
 bool PrefixSet::Exists(SBPrefix prefix) const {
-  if (index_.empty())
+  if (!index_size_)
     return false;
 
   // Find the first position after |prefix| in |index_|.
-  std::vector<std::pair<SBPrefix,size_t> >::const_iterator
-      iter = std::upper_bound(index_.begin(), index_.end(),
-                              std::pair<SBPrefix,size_t>(prefix, 0),
-                              PrefixLess);
+  const IndexEntry* const index_end = index_ + index_size_;
+  const IndexEntry* iter =
+      std::upper_bound(index_, index_end, prefix, PrefixLess);
 
   // |prefix| comes before anything that's in the set.
-  if (iter == index_.begin())
+  if (iter == index_)
     return false;
 
   // Capture the upper bound of our target entry's deltas.
-  const size_t bound = (iter == index_.end() ? deltas_.size() : iter->second);
+  const size_t bound = (iter == index_end ? deltas_size_ : iter->offset);
 
   // Back up to the entry our target is in.
   --iter;
 
   // All prefixes in |index_| are in the set.
-  SBPrefix current = iter->first;
-  if (current == prefix)
+  if (iter->prefix == prefix)
     return true;
 
-  // Scan forward accumulating deltas while a match is possible.
-  for (size_t di = iter->second; di < bound && current < prefix; ++di) {
-    current += deltas_[di];
+  return ScanDeltas(iter->prefix, prefix,
+                    deltas_ + iter->offset, deltas_ + bound);
+}
+
+// static
+bool PrefixSet::ScanDeltas(SBPrefix current, SBPrefix prefix,
+                           const uint16* begin, const uint16* end) {
+  // The distance left to |prefix|.  |unsigned| for the same reason
+  // as in the constructor.
+  uint32 remaining = static_cast<uint32>(prefix) - static_cast<uint32>(current);
+
+  // Every delta is at least 1, so a block of deltas which sums to
+  // less than the distance left can't reach |prefix|.
+  const uint16* pos = begin;
+  while (end - pos >= kDeltaBlockSize) {
+    const uint32 sum = SumDeltaBlock(pos);
+    if (sum >= remaining)
+      break;
+    remaining -= sum;
+    pos += kDeltaBlockSize;
   }
 
-  return current == prefix;
+  for (; pos < end && remaining > 0; ++pos) {
+    if (*pos > remaining)
+      return false;
+    remaining -= *pos;
+  }
+  return remaining == 0;
 }
 
 void PrefixSet::GetPrefixes(std::vector<SBPrefix>* prefixes) const {
-  for (size_t ii = 0; ii < index_.size(); ++ii) {
+  for (size_t ii = 0; ii < index_size_; ++ii) {
     // The deltas for this |index_| entry run to the next index entry,
     // or the end of the deltas.
     const size_t deltas_end =
-        (ii + 1 < index_.size()) ? index_[ii + 1].second : deltas_.size();
+        (ii + 1 < index_size_) ? index_[ii + 1].offset : deltas_size_;
 
-    SBPrefix current = index_[ii].first;
+    SBPrefix current = index_[ii].prefix;
     prefixes->push_back(current);
-    for (size_t di = index_[ii].second; di < deltas_end; ++di) {
+    for (size_t di = index_[ii].offset; di < deltas_end; ++di) {
       current += deltas_[di];
       prefixes->push_back(current);
     }
@@ -156,87 +232,93 @@ void PrefixSet::GetPrefixes(std::vector<SBPrefix>* prefixes) const {
 
 // static
 PrefixSet* PrefixSet::LoadFile(const FilePath& filter_name) {
-  int64 size_64;
-  if (!file_util::GetFileSize(filter_name, &size_64))
+  scoped_ptr<file_util::MemoryMappedFile> file(
+      new file_util::MemoryMappedFile);
+  if (!file->Initialize(filter_name))
     return NULL;
-  if (size_64 < static_cast<int64>(sizeof(FileHeader) + sizeof(MD5Digest)))
-    return NULL;
-
-  file_util::ScopedFILE file(file_util::OpenFile(filter_name, "rb"));
-  if (!file.get())
+  const uint8* data = file->data();
+  const size_t size = file->length();
+  if (size < sizeof(FileHeader) + sizeof(MD5Digest))
     return NULL;
 
   FileHeader header;
-  size_t read = fread(&header, sizeof(header), 1, file.get());
-  if (read != 1)
-    return NULL;
-
+  memcpy(&header, data, sizeof(header));
   if (header.magic != kMagic || header.version != kVersion)
     return NULL;
 
-  std::vector<std::pair<SBPrefix,size_t> > index;
-  const size_t index_bytes = sizeof(index[0]) * header.index_size;
-
-  std::vector<uint16> deltas;
-  const size_t deltas_bytes = sizeof(deltas[0]) * header.deltas_size;
-
-  // Check for bogus sizes before allocating any space.
-  const size_t expected_bytes =
+  // Check for bogus sizes before looking at any of the data.  The
+  // sizes are 64-bit so that a corrupt header can't overflow them.
+  const uint64 index_bytes =
+      static_cast<uint64>(sizeof(IndexEntry)) * header.index_size;
+  const uint64 deltas_bytes =
+      static_cast<uint64>(sizeof(uint16)) * header.deltas_size;
+  const uint64 expected_bytes =
       sizeof(header) + index_bytes + deltas_bytes + sizeof(MD5Digest);
-  if (static_cast<int64>(expected_bytes) != size_64)
-    return NULL;
-
-  // The file looks valid, start building the digest.
-  MD5Context context;
-  MD5Init(&context);
-  MD5Update(&context, &header, sizeof(header));
-
-  // Read the index vector.  Herb Sutter indicates that vectors are
-  // guaranteed to be contiuguous, so reading to where element 0 lives
-  // is valid.
-  index.resize(header.index_size);
-  read = fread(&(index[0]), sizeof(index[0]), index.size(), file.get());
-  if (read != index.size())
-    return NULL;
-  MD5Update(&context, &(index[0]), index_bytes);
-
-  // Read vector of deltas.
-  deltas.resize(header.deltas_size);
-  read = fread(&(deltas[0]), sizeof(deltas[0]), deltas.size(), file.get());
-  if (read != deltas.size())
+  if (expected_bytes != static_cast<uint64>(size))
     return NULL;
-  MD5Update(&context, &(deltas[0]), deltas_bytes);
 
+  // The digest covers everything before it.
+  const size_t digested_bytes = size - sizeof(MD5Digest);
   MD5Digest calculated_digest;
-  MD5Final(&calculated_digest, &context);
-
-  MD5Digest file_digest;
-  read = fread(&file_digest, sizeof(file_digest), 1, file.get());
-  if (read != 1)
+  MD5Sum(data, digested_bytes, &calculated_digest);
+  if (0 != memcmp(data + digested_bytes, &calculated_digest,
+                  sizeof(calculated_digest))) {
     return NULL;
+  }
 
-  if (0 != memcmp(&file_digest, &calculated_digest, sizeof(file_digest)))
-    return NULL;
+  // The index entries follow the 16 byte header, and the deltas
+  // follow the 8 byte index entries, so both are aligned in the
+  // page-aligned mapping.
+  const IndexEntry* index =
+      reinterpret_cast<const IndexEntry*>(data + sizeof(header));
+  const uint16* deltas = reinterpret_cast<const uint16*>(
+      data + sizeof(header) + static_cast<size_t>(index_bytes));
+
+  // |Exists()| trusts the offsets, so make sure they can't lead it
+  // out of |deltas|.
+  for (size_t i = 0; i < header.index_size; ++i) {
+    if (index[i].offset > header.deltas_size ||
+        (i > 0 && index[i].offset < index[i - 1].offset)) {
+      return NULL;
+    }
+  }
 
-  // Steals contents of |index| and |deltas| via swap().
-  return new PrefixSet(&index, &deltas);
+  return new PrefixSet(file.release(), index, header.index_size,
+                       deltas, header.deltas_size);
 }
 
 bool PrefixSet::WriteFile(const FilePath& filter_name) const {
+  // A loaded set may be in use from |filter_name|, so write the new
+  // file beside it and move it into place.  On failure the partial file
+  // is removed so that it is not picked up by a later write.
+  const FilePath new_filename(filter_name.value() + FILE_PATH_LITERAL("_new"));
+  if (!WriteToFile(new_filename)) {
+    file_util::Delete(new_filename, false);
+    return false;
+  }
+
+  if (!file_util::Move(new_filename, filter_name)) {
+    file_util::Delete(new_filename, false);
+    return false;
+  }
+  return true;
+}
+
+bool PrefixSet::WriteToFile(const FilePath& filename) const {
   FileHeader header;
   header.magic = kMagic;
   header.version = kVersion;
-  header.index_size = static_cast<uint32>(index_.size());
-  header.deltas_size = static_cast<uint32>(deltas_.size());
+  header.index_size = static_cast<uint32>(index_size_);
+  header.deltas_size = static_cast<uint32>(deltas_size_);
 
   // Sanity check that the 32-bit values never mess things up.
-  if (static_cast<size_t>(header.index_size) != index_.size() ||
-      static_cast<size_t>(header.deltas_size) != deltas_.size()) {
+  if (static_cast<size_t>(header.index_size) != index_size_ ||
+      static_cast<size_t>(header.deltas_size) != deltas_size_) {
     NOTREACHED();
     return false;
   }
 
-  file_util::ScopedFILE file(file_util::OpenFile(filter_name, "wb"));
+  file_util::ScopedFILE file(file_util::OpenFile(filename, "wb"));
   if (!file.get())
     return false;
 
@@ -250,20 +332,17 @@ bool PrefixSet::WriteFile(const FilePath& filter_name) const {
     return false;
   MD5Update(&context, &header, sizeof(header));
 
-  // As for reads, the standard guarantees the ability to access the
-  // contents of the vector by a pointer to an element.
-  const size_t index_bytes = sizeof(index_[0]) * index_.size();
-  written = fwrite(&(index_[0]), sizeof(index_[0]), index_.size(), file.get());
-  if (written != index_.size())
+  const size_t index_bytes = sizeof(index_[0]) * index_size_;
+  written = fwrite(index_, sizeof(index_[0]), index_size_, file.get());
+  if (written != index_size_)
     return false;
-  MD5Update(&context, &(index_[0]), index_bytes);
+  MD5Update(&context, index_, index_bytes);
 
-  const size_t deltas_bytes = sizeof(deltas_[0]) * deltas_.size();
-  written = fwrite(&(deltas_[0]), sizeof(deltas_[0]), deltas_.size(),
-                   file.get());
-  if (written != deltas_.size())
+  const size_t deltas_bytes = sizeof(deltas_[0]) * deltas_size_;
+  written = fwrite(deltas_, sizeof(deltas_[0]), deltas_size_, file.get());
+  if (written != deltas_size_)
     return false;
-  MD5Update(&context, &(deltas_[0]), deltas_bytes);
+  MD5Update(&context, deltas_, deltas_bytes);
 
   MD5Digest digest;
   MD5Final(&digest, &context);
@@ -272,18 +351,20 @@ bool PrefixSet::WriteFile(const FilePath& filter_name) const {
     return false;
 
   // TODO(shess): Can this code check that the close was successful?
-  file.reset();
-
   return true;
 }
 
+size_t PrefixSet::GetDataSize() const {
+  return index_size_ * sizeof(index_[0]) + deltas_size_ * sizeof(deltas_[0]);
+}
+
 size_t PrefixSet::IndexBinFor(size_t target_index) const {
   // The items in |index_| have the logical index of each previous
   // item in |index_| plus the count of deltas between the items.
   // Since the indices into |deltas_| are absolute, the logical index
   // is then the sum of the two indices.
   size_t lo = 0;
-  size_t hi = index_.size();
+  size_t hi = index_size_;
 
   // Binary search because linear search was too slow (really, the
   // unit test sucked).  Inline because the elements can't be compared
@@ -291,7 +372,7 @@ size_t PrefixSet::IndexBinFor(size_t target_index) const {
   while (hi - lo > 1) {
     const size_t i = (lo + hi) / 2;
 
-    if (target_index < i + index_[i].second) {
+    if (target_index < i + index_[i].offset) {
       DCHECK_LT(i, hi);  // Always making progress.
       hi = i;
     } else {
@@ -303,14 +384,14 @@ size_t PrefixSet::IndexBinFor(size_t target_index) const {
 }
 
 size_t PrefixSet::GetSize() const {
-  return index_.size() + deltas_.size();
+  return index_size_ + deltas_size_;
 }
 
 bool PrefixSet::IsDeltaAt(size_t target_index) const {
   CHECK_LT(target_index, GetSize());
 
   const size_t i = IndexBinFor(target_index);
-  return target_index > i + index_[i].second;
+  return target_index > i + index_[i].offset;
 }
 
 uint16 PrefixSet::DeltaAt(size_t target_index) const {
@@ -320,27 +401,31 @@ uint16 PrefixSet::DeltaAt(size_t target_index) const {
   const size_t i = IndexBinFor(target_index);
 
   // Exactly on the |index_| entry means no delta.
-  CHECK_GT(target_index, i + index_[i].second);
+  CHECK_GT(target_index, i + index_[i].offset);
 
   // -i backs out the |index_| entries, -1 gets the delta that lead to
   // the value at |target_index|.
-  CHECK_LT(target_index - i - 1, deltas_.size());
+  CHECK_LT(target_index - i - 1, deltas_size_);
   return deltas_[target_index - i - 1];
 }
 
 bool PrefixSet::CheckChecksum() const {
+  return ComputeChecksum() == checksum_;
+}
+
+uint32 PrefixSet::ComputeChecksum() const {
   uint32 checksum = 0;
 
-  for (size_t ii = 0; ii < index_.size(); ++ii) {
-    checksum ^= static_cast<uint32>(index_[ii].first);
-    checksum ^= static_cast<uint32>(index_[ii].second);
+  for (size_t ii = 0; ii < index_size_; ++ii) {
+    checksum ^= static_cast<uint32>(index_[ii].prefix);
+    checksum ^= static_cast<uint32>(index_[ii].offset);
   }
 
-  for (size_t di = 0; di < deltas_.size(); ++di) {
+  for (size_t di = 0; di < deltas_size_; ++di) {
     checksum ^= static_cast<uint32>(deltas_[di]);
   }
 
-  return checksum == checksum_;
+  return checksum;
 }
 
 }  // namespace safe_browsing
@@ -40,11 +40,21 @@
 // The on-disk format looks like:
 //         4 byte magic number
 //         4 byte version number
-//         4 byte |index_.size()|
-//         4 byte |deltas_.size()|
+//         4 byte |index_size_|
+//         4 byte |deltas_size_|
 //     n * 8 byte |&index_[0]..&index_[n]|
 //     m * 2 byte |&deltas_[0]..&deltas_[m]|
 //        16 byte digest
+//
+// Each index entry is a 4 byte prefix and the 4 byte offset of its
+// deltas, and the file is in the machine's byte order, so a loaded
+// set is used in place from the mapped file rather than copied to
+// the heap.  Only the pages which lookups touch need to stay in
+// memory.
+//
+// A set never changes once constructed, so any number of threads may
+// call |Exists()| at once.  The set is ref counted so that a reader
+// can keep using a set while it is replaced by a newer one.
 
 #ifndef CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
 #define CHROME_BROWSER_SAFE_BROWSING_PREFIX_SET_H_
@@ -52,24 +62,36 @@
 
 #include <vector>
 
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
 #include "chrome/browser/safe_browsing/safe_browsing_util.h"
 
 class FilePath;
 
+namespace file_util {
+class MemoryMappedFile;
+}
+
 namespace safe_browsing {
 
-class PrefixSet {
+class PrefixSet : public base::RefCountedThreadSafe<PrefixSet> {
  public:
   explicit PrefixSet(const std::vector<SBPrefix>& sorted_prefixes);
-  ~PrefixSet();
 
   // |true| if |prefix| was in |prefixes| passed to the constructor.
   bool Exists(SBPrefix prefix) const;
 
-  // Persist the set on disk.
+  // Persist the set on disk.  |LoadFile()| maps the file, which must
+  // not be changed in place while the set is alive; |WriteFile()|
+  // writes a new file and moves it over the old one.
   static PrefixSet* LoadFile(const FilePath& filter_name);
   bool WriteFile(const FilePath& filter_name) const;
 
+  // The number of bytes of index and deltas, which are on the heap
+  // unless the set was loaded from a file.
+  size_t GetDataSize() const;
+  bool IsMapped() const { return file_.get() != NULL; }
+
   // Regenerate the vector of prefixes passed to the constructor into
   // |prefixes|.  Prefixes will be added in sorted order.
   void GetPrefixes(std::vector<SBPrefix>* prefixes) const;
@@ -95,26 +117,64 @@ class PrefixSet {
   bool CheckChecksum() const;
 
  private:
+  friend class base::RefCountedThreadSafe<PrefixSet>;
+
+  // An entry of |index_|: a prefix in the set, and where the deltas
+  // from that prefix begin in |deltas_|.  The deltas for an entry end
+  // at the next entry's offset.
+  struct IndexEntry {
+    SBPrefix prefix;
+    uint32 offset;
+  };
+
   // Maximum number of consecutive deltas to encode before generating
   // a new index entry.  This helps keep the worst-case performance
   // for |Exists()| under control.
   static const size_t kMaxRun = 100;
 
-  // Helper for |LoadFile()|.  Steals the contents of |index| and
-  // |deltas| using |swap()|.
-  PrefixSet(std::vector<std::pair<SBPrefix,size_t> > *index,
-            std::vector<uint16> *deltas);
+  // Helper for |LoadFile()|.  Uses the index and deltas in place in
+  // |file|, which the set takes.
+  PrefixSet(file_util::MemoryMappedFile* file,
+            const IndexEntry* index, size_t index_size,
+            const uint16* deltas, size_t deltas_size);
+
+  ~PrefixSet();
+
+  // For |std::upper_bound()| to find a prefix in |index_|.
+  static bool PrefixLess(SBPrefix prefix, const IndexEntry& entry);
+
+  // The checksum of |index_| and |deltas_| as |CheckChecksum()|
+  // expects it.
+  uint32 ComputeChecksum() const;
+
+  // Helper for |WriteFile()|.  Writes the set and its digest to
+  // |filename|, returning false on any error.
+  bool WriteToFile(const FilePath& filename) const;
+
+  // Returns |true| if adding the deltas in [|begin|, |end|) one at a
+  // time to |current| reaches |prefix|.  Sums blocks of deltas at once
+  // to skip past those which stay below |prefix|.
+  static bool ScanDeltas(SBPrefix current, SBPrefix prefix,
+                         const uint16* begin, const uint16* end);
+
+  // Storage for a set built in memory.  Empty for a set loaded from
+  // a file.
+  std::vector<IndexEntry> index_vector_;
+  std::vector<uint16> deltas_vector_;
+
+  // The mapped file of a set loaded from a file.
+  scoped_ptr<file_util::MemoryMappedFile> file_;
 
-  // Top-level index of prefix to offset in |deltas_|.  Each pair
-  // indicates a base prefix and where the deltas from that prefix
-  // begin in |deltas_|.  The deltas for a pair end at the next pair's
-  // index into |deltas_|.
-  std::vector<std::pair<SBPrefix,size_t> > index_;
+  // Top-level index of prefix to offset in |deltas_|, sorted by
+  // prefix.
+  const IndexEntry* index_;
+  size_t index_size_;
 
   // Deltas which are added to the prefix in |index_| to generate
   // prefixes.  Deltas are only valid between consecutive items from
-  // |index_|, or the end of |deltas_| for the last |index_| pair.
-  std::vector<uint16> deltas_;
+  // |index_|, or the end of |deltas_| for the last |index_| entry.
+  const uint16* deltas_;
+  size_t deltas_size_;
 
   // For debugging, used to verify that |index_| and |deltas| were not
   // changed after generation during construction.  |checksum_| is
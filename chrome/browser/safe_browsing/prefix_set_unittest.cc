@@ -9,7 +9,7 @@
 #include "base/file_util.h"
 #include "base/logging.h"
 #include "base/md5.h"
-#include "base/memory/scoped_ptr.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_temp_dir.h"
 #include "base/rand_util.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -19,7 +19,7 @@ namespace {
 
 class PrefixSetTest : public PlatformTest {
  protected:
-  // Constants for the v1 format.
+  // Constants for the v2 format.
   static const size_t kMagicOffset = 0 * sizeof(uint32);
   static const size_t kVersionOffset = 1 * sizeof(uint32);
   static const size_t kIndexSizeOffset = 2 * sizeof(uint32);
@@ -73,8 +73,9 @@ class PrefixSetTest : public PlatformTest {
 
     FilePath filename = temp_dir_.path().AppendASCII("PrefixSetTest");
 
-    safe_browsing::PrefixSet prefix_set(shared_prefixes_);
-    if (!prefix_set.WriteFile(filename))
+    scoped_refptr<safe_browsing::PrefixSet>
+        prefix_set(new safe_browsing::PrefixSet(shared_prefixes_));
+    if (!prefix_set->WriteFile(filename))
       return false;
 
     *filenamep = filename;
@@ -151,31 +152,34 @@ std::vector<SBPrefix> PrefixSetTest::shared_prefixes_;
 
 // Test that a small sparse random input works.
 TEST_F(PrefixSetTest, Baseline) {
-  safe_browsing::PrefixSet prefix_set(shared_prefixes_);
-  CheckPrefixes(&prefix_set, shared_prefixes_);
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(shared_prefixes_));
+  CheckPrefixes(prefix_set.get(), shared_prefixes_);
 }
 
 // Test that the empty set doesn't appear to have anything in it.
 TEST_F(PrefixSetTest, Empty) {
   const std::vector<SBPrefix> empty;
-  safe_browsing::PrefixSet prefix_set(empty);
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(empty));
   for (size_t i = 0; i < shared_prefixes_.size(); ++i) {
-    EXPECT_FALSE(prefix_set.Exists(shared_prefixes_[i]));
+    EXPECT_FALSE(prefix_set->Exists(shared_prefixes_[i]));
   }
 }
 
 // Single-element set should work fine.
 TEST_F(PrefixSetTest, OneElement) {
   const std::vector<SBPrefix> prefixes(100, 0);
-  safe_browsing::PrefixSet prefix_set(prefixes);
-  EXPECT_FALSE(prefix_set.Exists(-1));
-  EXPECT_TRUE(prefix_set.Exists(prefixes[0]));
-  EXPECT_FALSE(prefix_set.Exists(1));
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(prefixes));
+  EXPECT_FALSE(prefix_set->Exists(-1));
+  EXPECT_TRUE(prefix_set->Exists(prefixes[0]));
+  EXPECT_FALSE(prefix_set->Exists(1));
 
   // Check that |GetPrefixes()| returns the same set of prefixes as
   // was passed in.
   std::vector<SBPrefix> prefixes_copy;
-  prefix_set.GetPrefixes(&prefixes_copy);
+  prefix_set->GetPrefixes(&prefixes_copy);
   EXPECT_EQ(1U, prefixes_copy.size());
   EXPECT_EQ(prefixes[0], prefixes_copy[0]);
 }
@@ -196,12 +200,13 @@ TEST_F(PrefixSetTest, IntMinMax) {
   prefixes.push_back(0xFFFFFFFF);
 
   std::sort(prefixes.begin(), prefixes.end());
-  safe_browsing::PrefixSet prefix_set(prefixes);
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(prefixes));
 
   // Check that |GetPrefixes()| returns the same set of prefixes as
   // was passed in.
   std::vector<SBPrefix> prefixes_copy;
-  prefix_set.GetPrefixes(&prefixes_copy);
+  prefix_set->GetPrefixes(&prefixes_copy);
   ASSERT_EQ(prefixes_copy.size(), prefixes.size());
   EXPECT_TRUE(std::equal(prefixes.begin(), prefixes.end(),
                          prefixes_copy.begin()));
@@ -221,12 +226,13 @@ TEST_F(PrefixSetTest, AllBig) {
   }
 
   std::sort(prefixes.begin(), prefixes.end());
-  safe_browsing::PrefixSet prefix_set(prefixes);
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(prefixes));
 
   // Check that |GetPrefixes()| returns the same set of prefixes as
   // was passed in.
   std::vector<SBPrefix> prefixes_copy;
-  prefix_set.GetPrefixes(&prefixes_copy);
+  prefix_set->GetPrefixes(&prefixes_copy);
   prefixes.erase(std::unique(prefixes.begin(), prefixes.end()), prefixes.end());
   EXPECT_EQ(prefixes_copy.size(), prefixes.size());
   EXPECT_TRUE(std::equal(prefixes.begin(), prefixes.end(),
@@ -278,43 +284,90 @@ TEST_F(PrefixSetTest, EdgeCases) {
   }
 
   std::sort(prefixes.begin(), prefixes.end());
-  safe_browsing::PrefixSet prefix_set(prefixes);
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(prefixes));
 
   // Check that |GetPrefixes()| returns the same set of prefixes as
   // was passed in.
   std::vector<SBPrefix> prefixes_copy;
-  prefix_set.GetPrefixes(&prefixes_copy);
+  prefix_set->GetPrefixes(&prefixes_copy);
   prefixes.erase(std::unique(prefixes.begin(), prefixes.end()), prefixes.end());
   EXPECT_EQ(prefixes_copy.size(), prefixes.size());
   EXPECT_TRUE(std::equal(prefixes.begin(), prefixes.end(),
                          prefixes_copy.begin()));
 
   // Items before and after the set are not present, and don't crash.
-  EXPECT_FALSE(prefix_set.Exists(kVeryNegative - 100));
-  EXPECT_FALSE(prefix_set.Exists(kVeryPositive + 100));
+  EXPECT_FALSE(prefix_set->Exists(kVeryNegative - 100));
+  EXPECT_FALSE(prefix_set->Exists(kVeryPositive + 100));
 
   // Check that the set correctly flags all of the inputs, and also
   // check items just above and below the inputs to make sure they
   // aren't present.
   for (size_t i = 0; i < prefixes.size(); ++i) {
-    EXPECT_TRUE(prefix_set.Exists(prefixes[i]));
+    EXPECT_TRUE(prefix_set->Exists(prefixes[i]));
 
-    EXPECT_FALSE(prefix_set.Exists(prefixes[i] - 1));
-    EXPECT_FALSE(prefix_set.Exists(prefixes[i] + 1));
+    EXPECT_FALSE(prefix_set->Exists(prefixes[i] - 1));
+    EXPECT_FALSE(prefix_set->Exists(prefixes[i] + 1));
   }
 }
 
+// Test a dense set, where |Exists()| skips through blocks of deltas
+// within runs of |kMaxRun| deltas.  Delta sizes vary so that prefixes
+// land at every position within a block.
+TEST_F(PrefixSetTest, DenseRuns) {
+  std::vector<SBPrefix> prefixes;
+  SBPrefix prefix = -5000000;
+  for (int i = 0; i < 20000; ++i) {
+    prefix += 1 + (i * 7919) % 300;
+    prefixes.push_back(prefix);
+  }
+  // Some deltas as large as fit.
+  for (int i = 0; i < 100; ++i) {
+    prefix += 0xFFFF;
+    prefixes.push_back(prefix);
+  }
+
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(prefixes));
+  CheckPrefixes(prefix_set.get(), prefixes);
+}
+
 // Similar to Baseline test, but write the set out to a file and read
 // it back in before testing.
 TEST_F(PrefixSetTest, ReadWrite) {
   FilePath filename;
   ASSERT_TRUE(GetPrefixSetFile(&filename));
 
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
+  ASSERT_TRUE(prefix_set.get());
+
+  EXPECT_TRUE(prefix_set->IsMapped());
+  EXPECT_TRUE(prefix_set->CheckChecksum());
+
+  CheckPrefixes(prefix_set.get(), shared_prefixes_);
+}
+
+// A set loaded from a file keeps working when the file is replaced.
+TEST_F(PrefixSetTest, ReplaceLoadedFile) {
+  FilePath filename;
+  ASSERT_TRUE(GetPrefixSetFile(&filename));
+
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_TRUE(prefix_set.get());
 
+  std::vector<SBPrefix> prefixes(shared_prefixes_.begin(),
+                                 shared_prefixes_.begin() + 100);
+  scoped_refptr<safe_browsing::PrefixSet>
+      new_prefix_set(new safe_browsing::PrefixSet(prefixes));
+  ASSERT_TRUE(new_prefix_set->WriteFile(filename));
+
   CheckPrefixes(prefix_set.get(), shared_prefixes_);
+
+  prefix_set = safe_browsing::PrefixSet::LoadFile(filename);
+  ASSERT_TRUE(prefix_set.get());
+  CheckPrefixes(prefix_set.get(), prefixes);
 }
 
 // Check that |CleanChecksum()| makes an acceptable checksum.
@@ -326,7 +379,7 @@ TEST_F(PrefixSetTest, CorruptionHelpers) {
   file_util::ScopedFILE file(file_util::OpenFile(filename, "r+b"));
   IncrementIntAt(file.get(), kPayloadOffset, 1);
   file.reset();
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 
@@ -335,7 +388,7 @@ TEST_F(PrefixSetTest, CorruptionHelpers) {
   file.reset(file_util::OpenFile(filename, "r+b"));
   CleanChecksum(file.get());
   file.reset();
-  prefix_set.reset(safe_browsing::PrefixSet::LoadFile(filename));
+  prefix_set = safe_browsing::PrefixSet::LoadFile(filename);
   ASSERT_TRUE(prefix_set.get());
 }
 
@@ -346,7 +399,7 @@ TEST_F(PrefixSetTest, CorruptionMagic) {
 
   ASSERT_NO_FATAL_FAILURE(
       ModifyAndCleanChecksum(filename, kMagicOffset, 1));
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 }
@@ -358,7 +411,7 @@ TEST_F(PrefixSetTest, CorruptionVersion) {
 
   ASSERT_NO_FATAL_FAILURE(
       ModifyAndCleanChecksum(filename, kVersionOffset, 1));
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 }
@@ -370,7 +423,7 @@ TEST_F(PrefixSetTest, CorruptionIndexSize) {
 
   ASSERT_NO_FATAL_FAILURE(
       ModifyAndCleanChecksum(filename, kIndexSizeOffset, 1));
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 }
@@ -382,7 +435,7 @@ TEST_F(PrefixSetTest, CorruptionDeltasSize) {
 
   ASSERT_NO_FATAL_FAILURE(
       ModifyAndCleanChecksum(filename, kDeltasSizeOffset, 1));
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 }
@@ -396,7 +449,7 @@ TEST_F(PrefixSetTest, CorruptionPayload) {
   file_util::ScopedFILE file(file_util::OpenFile(filename, "r+b"));
   ASSERT_NO_FATAL_FAILURE(IncrementIntAt(file.get(), 666, 1));
   file.reset();
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 }
@@ -412,7 +465,7 @@ TEST_F(PrefixSetTest, CorruptionDigest) {
   long digest_offset = static_cast<long>(size_64 - sizeof(MD5Digest));
   ASSERT_NO_FATAL_FAILURE(IncrementIntAt(file.get(), digest_offset, 1));
   file.reset();
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 }
@@ -427,7 +480,7 @@ TEST_F(PrefixSetTest, CorruptionExcess) {
   const char buf[] = "im in ur base, killing ur d00dz.";
   ASSERT_EQ(strlen(buf), fwrite(buf, 1, strlen(buf), file.get()));
   file.reset();
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(safe_browsing::PrefixSet::LoadFile(filename));
   ASSERT_FALSE(prefix_set.get());
 }
@@ -438,17 +491,18 @@ TEST_F(PrefixSetTest, DebuggingAccessors) {
   std::vector<SBPrefix> prefixes;
   std::unique_copy(shared_prefixes_.begin(), shared_prefixes_.end(),
                    std::back_inserter(prefixes));
-  safe_browsing::PrefixSet prefix_set(prefixes);
+  scoped_refptr<safe_browsing::PrefixSet>
+      prefix_set(new safe_browsing::PrefixSet(prefixes));
 
-  EXPECT_EQ(prefixes.size(), prefix_set.GetSize());
-  EXPECT_FALSE(prefix_set.IsDeltaAt(0));
+  EXPECT_EQ(prefixes.size(), prefix_set->GetSize());
+  EXPECT_FALSE(prefix_set->IsDeltaAt(0));
   for (size_t i = 1; i < prefixes.size(); ++i) {
     const int delta = prefixes[i] - prefixes[i - 1];
     if (delta > 0xFFFF) {
-      EXPECT_FALSE(prefix_set.IsDeltaAt(i));
+      EXPECT_FALSE(prefix_set->IsDeltaAt(i));
     } else {
-      ASSERT_TRUE(prefix_set.IsDeltaAt(i));
-      EXPECT_EQ(delta, prefix_set.DeltaAt(i));
+      ASSERT_TRUE(prefix_set->IsDeltaAt(i));
+      EXPECT_EQ(delta, prefix_set->DeltaAt(i));
     }
   }
 }
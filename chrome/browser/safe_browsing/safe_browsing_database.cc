@@ -24,6 +24,8 @@ namespace {
 
 // Filename suffix for the bloom filter.
 const FilePath::CharType kBloomFilterFile[] = FILE_PATH_LITERAL(" Filter 2");
+// Filename suffix for the prefix set.
+const FilePath::CharType kPrefixSetFile[] = FILE_PATH_LITERAL(" Prefix Set");
 // Filename suffix for download store.
 const FilePath::CharType kDownloadDBFile[] = FILE_PATH_LITERAL(" Download");
 // Filename suffix for client-side phishing detection whitelist store.
@@ -255,7 +257,7 @@ void RecordPrefixSetInfo(PrefixSetEvent event_type) {
 // that the resulting prefix set is valid, so that the
 // PREFIX_SET_EVENT_BLOOM_MISS_PREFIX_HIT_INVALID histogram in
 // ContainsBrowseUrl() can be trustworthy.
-safe_browsing::PrefixSet* PrefixSetFromAddPrefixes(
+scoped_refptr<safe_browsing::PrefixSet> PrefixSetFromAddPrefixes(
     const std::vector<SBAddPrefix>& add_prefixes) {
   // TODO(shess): If |add_prefixes| were sorted by the prefix, it
   // could be passed directly to |PrefixSet()|, removing the need for
@@ -270,7 +272,7 @@ safe_browsing::PrefixSet* PrefixSetFromAddPrefixes(
   prefixes.erase(std::unique(prefixes.begin(), prefixes.end()),
                  prefixes.end());
 
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(new safe_browsing::PrefixSet(prefixes));
 
   std::vector<SBPrefix> restored;
@@ -279,7 +281,7 @@ safe_browsing::PrefixSet* PrefixSetFromAddPrefixes(
   // Expect them to be equal.
   if (restored.size() == prefixes.size() &&
       std::equal(prefixes.begin(), prefixes.end(), restored.begin()))
-    return prefix_set.release();
+    return prefix_set;
 
   // Log BROKEN for continuity with previous release, and SIZE to
   // distinguish which test failed.
@@ -381,7 +383,7 @@ safe_browsing::PrefixSet* PrefixSetFromAddPrefixes(
     UMA_HISTOGRAM_COUNTS_100("SB2.PrefixSetRestoredShortfall",
                              difference.size());
 
-  return prefix_set.release();
+  return prefix_set;
 }
 
 }  // namespace
@@ -442,6 +444,12 @@ FilePath SafeBrowsingDatabase::BloomFilterForFilename(
   return FilePath(db_filename.value() + kBloomFilterFile);
 }
 
+// static
+FilePath SafeBrowsingDatabase::PrefixSetForFilename(
+    const FilePath& db_filename) {
+  return FilePath(db_filename.value() + kPrefixSetFile);
+}
+
 // static
 FilePath SafeBrowsingDatabase::CsdWhitelistDBFilename(
     const FilePath& db_filename) {
@@ -505,6 +513,7 @@ void SafeBrowsingDatabaseNew::Init(const FilePath& filename_base) {
 
   browse_filename_ = BrowseDBFilename(filename_base);
   bloom_filter_filename_ = BloomFilterForFilename(browse_filename_);
+  prefix_set_filename_ = PrefixSetForFilename(browse_filename_);
 
   browse_store_->Init(
       browse_filename_,
@@ -520,6 +529,7 @@ void SafeBrowsingDatabaseNew::Init(const FilePath& filename_base) {
     full_browse_hashes_.clear();
     pending_browse_hashes_.clear();
     LoadBloomFilter();
+    LoadPrefixSet();
   }
 
   if (download_store_.get()) {
@@ -567,7 +577,7 @@ bool SafeBrowsingDatabaseNew::ResetDatabase() {
                                            BloomFilter::kBloomFilterSizeRatio);
     // TODO(shess): It is simpler for the code to assume that presence
     // of a bloom filter always implies presence of a prefix set.
-    prefix_set_.reset(new safe_browsing::PrefixSet(std::vector<SBPrefix>()));
+    prefix_set_ = new safe_browsing::PrefixSet(std::vector<SBPrefix>());
   }
   // Wants to acquire the lock itself.
   CsdWhitelistAllUrls();
@@ -592,28 +602,32 @@ bool SafeBrowsingDatabaseNew::ContainsBrowseUrl(
   if (full_hashes.empty())
     return false;
 
-  // This function is called on the I/O thread, prevent changes to
-  // bloom filter and caches.
-  base::AutoLock locked(lookup_lock_);
+  // This function is called on the I/O thread.  Updates swap in a new
+  // bloom filter and prefix set rather than changing them, so they can be
+  // checked without holding the lock.
+  scoped_refptr<BloomFilter> bloom_filter;
+  scoped_refptr<safe_browsing::PrefixSet> prefix_set;
+  {
+    base::AutoLock locked(lookup_lock_);
+    bloom_filter = browse_bloom_filter_;
+    prefix_set = prefix_set_;
+  }
 
-  if (!browse_bloom_filter_.get())
+  if (!bloom_filter.get())
     return false;
-  DCHECK(prefix_set_.get());
+  DCHECK(prefix_set.get());
 
   // Used to double-check in case of a hit mis-match.
   std::vector<SBPrefix> restored;
 
-  size_t miss_count = 0;
   for (size_t i = 0; i < full_hashes.size(); ++i) {
-    bool found = prefix_set_->Exists(full_hashes[i].prefix);
+    bool found = prefix_set->Exists(full_hashes[i].prefix);
 
-    if (browse_bloom_filter_->Exists(full_hashes[i].prefix)) {
+    if (bloom_filter->Exists(full_hashes[i].prefix)) {
       RecordPrefixSetInfo(PREFIX_SET_EVENT_BLOOM_HIT);
       if (found)
         RecordPrefixSetInfo(PREFIX_SET_EVENT_HIT);
       prefix_hits->push_back(full_hashes[i].prefix);
-      if (prefix_miss_cache_.count(full_hashes[i].prefix) > 0)
-        ++miss_count;
     } else {
       // Bloom filter misses should never be in prefix set.  Re-create
       // the original prefixes and manually search for it, to check if
@@ -624,7 +638,7 @@ bool SafeBrowsingDatabaseNew::ContainsBrowseUrl(
       DCHECK(!found);
       if (found) {
         if (restored.empty())
-          prefix_set_->GetPrefixes(&restored);
+          prefix_set->GetPrefixes(&restored);
 
         // If the item is not in the re-created list, then there is an
         // error in |PrefixSet::Exists()|.  If the item is in the
@@ -639,6 +653,19 @@ bool SafeBrowsingDatabaseNew::ContainsBrowseUrl(
     }
   }
 
+  // Most lookups end here, without touching the caches.
+  if (prefix_hits->empty())
+    return false;
+
+  // Prevent changes to the caches.
+  base::AutoLock locked(lookup_lock_);
+
+  size_t miss_count = 0;
+  for (size_t i = 0; i < prefix_hits->size(); ++i) {
+    if (prefix_miss_cache_.count((*prefix_hits)[i]) > 0)
+      ++miss_count;
+  }
+
   // If all the prefixes are cached as 'misses', don't issue a GetHash.
   if (miss_count == prefix_hits->size())
     return false;
@@ -1132,7 +1159,7 @@ void SafeBrowsingDatabaseNew::UpdateBrowseStore() {
     filter->Insert(add_prefixes[i].prefix);
   }
 
-  scoped_ptr<safe_browsing::PrefixSet>
+  scoped_refptr<safe_browsing::PrefixSet>
       prefix_set(PrefixSetFromAddPrefixes(add_prefixes));
 
   // This needs to be in sorted order by prefix for efficient access.
@@ -1155,11 +1182,17 @@ void SafeBrowsingDatabaseNew::UpdateBrowseStore() {
     prefix_set_.swap(prefix_set);
   }
 
+  // |prefix_set| now holds the previous set, which may be mapped from
+  // |prefix_set_filename_|.  Release it so the file can be replaced.
+  prefix_set = NULL;
+
   const base::TimeDelta bloom_gen = base::Time::Now() - before;
 
-  // Persist the bloom filter to disk.  Since only this thread changes
-  // |browse_bloom_filter_|, there is no need to lock.
+  // Persist the bloom filter and prefix set to disk.  Since only this
+  // thread changes |browse_bloom_filter_| and |prefix_set_|, there is no
+  // need to lock.
   WriteBloomFilter();
+  WritePrefixSet();
 
   // Gather statistics.
   if (got_counters && metric->GetIOCounters(&io_after)) {
@@ -1236,12 +1269,33 @@ void SafeBrowsingDatabaseNew::LoadBloomFilter() {
 
   if (!browse_bloom_filter_.get())
     RecordFailure(FAILURE_DATABASE_FILTER_READ);
+}
+
+void SafeBrowsingDatabaseNew::LoadPrefixSet() {
+  DCHECK_EQ(creation_loop_, MessageLoop::current());
+  DCHECK(!prefix_set_filename_.empty());
+
+  // As for the bloom filter, there is nothing to check until the next
+  // update if the database is missing.
+  int64 size_64;
+  if (!file_util::GetFileSize(browse_filename_, &size_64) || size_64 == 0)
+    return;
 
-  // Manually re-generate the prefix set from the main database.
-  // TODO(shess): Write/read for prefix set.
+  const base::TimeTicks before = base::TimeTicks::Now();
+  prefix_set_ = safe_browsing::PrefixSet::LoadFile(prefix_set_filename_);
+  DVLOG(1) << "SafeBrowsingDatabaseNew read prefix set in "
+           << (base::TimeTicks::Now() - before).InMilliseconds() << " ms";
+  if (prefix_set_.get())
+    return;
+
+  // Manually re-generate the prefix set from the main database, and save it
+  // for the next time.
+  if (file_util::PathExists(prefix_set_filename_))
+    RecordFailure(FAILURE_DATABASE_PREFIX_SET_READ);
   std::vector<SBAddPrefix> add_prefixes;
   browse_store_->GetAddPrefixes(&add_prefixes);
-  prefix_set_.reset(PrefixSetFromAddPrefixes(add_prefixes));
+  prefix_set_ = PrefixSetFromAddPrefixes(add_prefixes);
+  WritePrefixSet();
 }
 
 bool SafeBrowsingDatabaseNew::Delete() {
@@ -1263,7 +1317,11 @@ bool SafeBrowsingDatabaseNew::Delete() {
   const bool r4 = file_util::Delete(bloom_filter_filename_, false);
   if (!r4)
     RecordFailure(FAILURE_DATABASE_FILTER_DELETE);
-  return r1 && r2 && r3 && r4;
+
+  const bool r5 = file_util::Delete(prefix_set_filename_, false);
+  if (!r5)
+    RecordFailure(FAILURE_DATABASE_PREFIX_SET_DELETE);
+  return r1 && r2 && r3 && r4 && r5;
 }
 
 void SafeBrowsingDatabaseNew::WriteBloomFilter() {
@@ -1281,6 +1339,26 @@ void SafeBrowsingDatabaseNew::WriteBloomFilter() {
     RecordFailure(FAILURE_DATABASE_FILTER_WRITE);
 }
 
+void SafeBrowsingDatabaseNew::WritePrefixSet() {
+  DCHECK_EQ(creation_loop_, MessageLoop::current());
+
+  if (!prefix_set_.get())
+    return;
+
+  const base::TimeTicks before = base::TimeTicks::Now();
+  const bool write_ok = prefix_set_->WriteFile(prefix_set_filename_);
+  DVLOG(1) << "SafeBrowsingDatabaseNew wrote prefix set in "
+           << (base::TimeTicks::Now() - before).InMilliseconds() << " ms";
+
+  // A file left over from an earlier update still passes its digest
+  // check, but no longer matches the store.  Remove it so that the next
+  // load rebuilds the set from the store instead.
+  if (!write_ok) {
+    RecordFailure(FAILURE_DATABASE_PREFIX_SET_WRITE);
+    file_util::Delete(prefix_set_filename_, false);
+  }
+}
+
 void SafeBrowsingDatabaseNew::CsdWhitelistAllUrls() {
   base::AutoLock locked(lookup_lock_);
   csd_whitelist_all_urls_ = true;
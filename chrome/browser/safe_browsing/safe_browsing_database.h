@@ -144,6 +144,9 @@ class SafeBrowsingDatabase {
   // The name of the bloom-filter file for the given database file.
   static FilePath BloomFilterForFilename(const FilePath& db_filename);
 
+  // The name of the prefix-set file for the given database file.
+  static FilePath PrefixSetForFilename(const FilePath& db_filename);
+
   // Filename for malware and phishing URL database.
   static FilePath BrowseDBFilename(const FilePath& db_base_filename);
 
@@ -171,6 +174,9 @@ class SafeBrowsingDatabase {
     FAILURE_DOWNLOAD_DATABASE_UPDATE_FINISH,
     FAILURE_CSD_WHITELIST_DATABASE_UPDATE_BEGIN,
     FAILURE_CSD_WHITELIST_DATABASE_UPDATE_FINISH,
+    FAILURE_DATABASE_PREFIX_SET_READ,
+    FAILURE_DATABASE_PREFIX_SET_WRITE,
+    FAILURE_DATABASE_PREFIX_SET_DELETE,
 
     // Memory space for histograms is determined by the max.  ALWAYS
     // ADD NEW VALUES BEFORE THIS ONE.
@@ -226,6 +232,7 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
  private:
   friend class SafeBrowsingDatabaseTest;
   FRIEND_TEST(SafeBrowsingDatabaseTest, HashCaching);
+  FRIEND_TEST(SafeBrowsingDatabaseTest, PrefixSetFile);
 
   // Return the browse_store_, download_store_ or csd_whitelist_store_
   // based on list_id.
@@ -240,6 +247,13 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
   // Writes the current bloom filter to disk.
   void WriteBloomFilter();
 
+  // Maps the prefix set from disk, or generates one from |browse_store_|
+  // if it can't be loaded.
+  void LoadPrefixSet();
+
+  // Writes the current prefix set to disk.
+  void WritePrefixSet();
+
   // Loads the given full-length hashes to the csd whitelist.  If the number
   // of hashes is too large or if the kill switch URL is on the whitelist
   // we will whitelist all URLs.
@@ -283,9 +297,11 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
   MessageLoop* creation_loop_;
 
   // Lock for protecting access to variables that may be used on the
-  // IO thread.  This includes |browse_bloom_filter_|, |full_browse_hashes_|,
-  // |pending_browse_hashes_|, |prefix_miss_cache_|, |csd_whitelist_|, and
-  // |csd_whitelist_all_urls_|.
+  // IO thread.  This includes |browse_bloom_filter_|, |prefix_set_|,
+  // |full_browse_hashes_|, |pending_browse_hashes_|, |prefix_miss_cache_|,
+  // |csd_whitelist_|, and |csd_whitelist_all_urls_|.  The filter and the
+  // prefix set are never changed once built, only replaced, so lookups take
+  // references to them under the lock and check them outside it.
   base::Lock lookup_lock_;
 
   // Underlying persistent store for chunk data.
@@ -342,8 +358,10 @@ class SafeBrowsingDatabaseNew : public SafeBrowsingDatabase {
   // Used to optimize away database update.
   bool change_detected_;
 
-  // Used to check if a prefix was in the database.
-  scoped_ptr<safe_browsing::PrefixSet> prefix_set_;
+  // Used to check if a prefix was in the database.  Mapped from
+  // |prefix_set_filename_| when it was loaded at startup.
+  FilePath prefix_set_filename_;
+  scoped_refptr<safe_browsing::PrefixSet> prefix_set_;
 };
 
 #endif  // CHROME_BROWSER_SAFE_BROWSING_SAFE_BROWSING_DATABASE_H_
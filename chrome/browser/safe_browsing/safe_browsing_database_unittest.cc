@@ -12,6 +12,7 @@
 #include "base/message_loop.h"
 #include "base/time.h"
 #include "crypto/sha2.h"
+#include "chrome/browser/safe_browsing/prefix_set.h"
 #include "chrome/browser/safe_browsing/safe_browsing_database.h"
 #include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
 #include "chrome/browser/safe_browsing/safe_browsing_store_unittest_helper.h"
@@ -1488,6 +1489,46 @@ TEST_F(SafeBrowsingDatabaseTest, BinHashInsertLookup) {
   database_.reset();
 }
 
+// Test that the prefix set is saved by an update, and mapped from its file
+// when the database is opened again.
+TEST_F(SafeBrowsingDatabaseTest, PrefixSetFile) {
+  SBChunkList chunks;
+  SBChunk chunk;
+  InsertAddChunkHostPrefixUrl(&chunk, 1, "www.evil.com/",
+                              "www.evil.com/malware.html");
+  chunks.push_back(chunk);
+
+  std::vector<SBListChunkRanges> lists;
+  EXPECT_TRUE(database_->UpdateStarted(&lists));
+  database_->InsertChunks(safe_browsing_util::kMalwareList, chunks);
+  database_->UpdateFinished(true);
+
+  const FilePath prefix_set_filename =
+      SafeBrowsingDatabase::PrefixSetForFilename(
+          SafeBrowsingDatabase::BrowseDBFilename(database_filename_));
+  EXPECT_TRUE(file_util::PathExists(prefix_set_filename));
+
+  database_.reset(new SafeBrowsingDatabaseNew);
+  database_->Init(database_filename_);
+  ASSERT_TRUE(database_->prefix_set_.get());
+  EXPECT_TRUE(database_->prefix_set_->IsMapped());
+
+  std::string listname;
+  std::vector<SBPrefix> prefixes;
+  std::vector<SBFullHashResult> full_hashes;
+  const base::Time now = base::Time::Now();
+  EXPECT_TRUE(database_->ContainsBrowseUrl(
+      GURL("http://www.evil.com/malware.html"),
+      &listname, &prefixes, &full_hashes, now));
+  EXPECT_FALSE(database_->ContainsBrowseUrl(
+      GURL("http://www.evil.com/phishing.html"),
+      &listname, &prefixes, &full_hashes, now));
+
+  // Resetting the database deletes the file.
+  EXPECT_TRUE(database_->ResetDatabase());
+  EXPECT_FALSE(file_util::PathExists(prefix_set_filename));
+}
+
 // Test that an empty update doesn't actually update the database.
 // This isn't a functionality requirement, but it is a useful
 // optimization.
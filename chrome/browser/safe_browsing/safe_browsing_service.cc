@@ -4,6 +4,8 @@
 
 #include "chrome/browser/safe_browsing/safe_browsing_service.h"
 
+#include <algorithm>
+
 #include "base/callback.h"
 #include "base/command_line.h"
 #include "base/lazy_instance.h"
@@ -53,6 +55,19 @@ const int64 kDownloadUrlCheckTimeoutMs = 10000;
 // Similar to kDownloadUrlCheckTimeoutMs, but for download hash checks.
 const int64 kDownloadHashCheckTimeoutMs = 10000;
 
+// Prefixes hit within this long of each other are sent in one GetHash
+// request.  Short next to the request itself, it lets the subresources of a
+// page which hit the same or nearby prefixes share a round trip.
+const int64 kGetHashBatchWindowMs = 20;
+
+// GetHash results are reused for this long, which is as long as the
+// database trusts its own cached results without an update.
+const int kFullHashCacheMinutes = 45;
+
+// Past this many cached prefixes, expired entries are dropped, and if that
+// isn't enough the cache starts over.
+const size_t kMaxFullHashCacheSize = 1000;
+
 // TODO(lzheng): Replace this with Profile* ProfileManager::GetDefaultProfile().
 Profile* GetDefaultProfile() {
   FilePath user_data_dir;
@@ -125,11 +140,16 @@ SafeBrowsingService::SafeBrowsingCheck::SafeBrowsingCheck()
       need_get_hash(false),
       result(SAFE),
       is_download(false),
+      pending_prefixes(0),
       timeout_task(NULL) {
 }
 
 SafeBrowsingService::SafeBrowsingCheck::~SafeBrowsingCheck() {}
 
+SafeBrowsingService::CachedFullHashes::CachedFullHashes() {}
+
+SafeBrowsingService::CachedFullHashes::~CachedFullHashes() {}
+
 void SafeBrowsingService::Client::OnSafeBrowsingResult(
     const SafeBrowsingCheck& check) {
   if (!check.urls.empty()) {
@@ -166,6 +186,7 @@ SafeBrowsingService::SafeBrowsingService()
       update_in_progress_(false),
       database_update_in_progress_(false),
       closing_database_(false),
+      gethash_batch_scheduled_(false),
       download_urlcheck_timeout_ms_(kDownloadUrlCheckTimeoutMs),
       download_hashcheck_timeout_ms_(kDownloadHashCheckTimeoutMs) {
 }
@@ -385,7 +406,7 @@ void SafeBrowsingService::HandleGetHashResults(
     return;
 
   // If the service has been shut down, |check| should have been deleted.
-  DCHECK(checks_.find(check) != checks_.end());
+  DCHECK(gethash_batches_.find(check) != gethash_batches_.end());
 
   // |start| is set before calling |GetFullHash()|, which should be
   // the only path which gets to here.
@@ -393,13 +414,16 @@ void SafeBrowsingService::HandleGetHashResults(
   UMA_HISTOGRAM_LONG_TIMES("SB2.Network",
                            base::TimeTicks::Now() - check->start);
 
-  std::vector<SBPrefix> prefixes = check->prefix_hits;
-  OnHandleGetHashResults(check, full_hashes);  // 'check' is deleted here.
+  const bool hit = HandleGetHashBatch(check, full_hashes, can_cache);
+  RecordGetHashCheckStatus(hit, check->is_download, full_hashes);
 
   if (can_cache && MakeDatabaseAvailable()) {
     // Cache the GetHash results in memory:
-    database_->CacheHashResults(prefixes, full_hashes);
+    database_->CacheHashResults(check->prefix_hits, full_hashes);
   }
+
+  gethash_batches_.erase(check);
+  delete check;
 }
 
 void SafeBrowsingService::HandleChunk(const std::string& list,
@@ -432,6 +456,9 @@ void SafeBrowsingService::UpdateFinished(bool update_succeeded) {
   DCHECK(enabled_);
   if (update_in_progress_) {
     update_in_progress_ = false;
+    // The update may have added or subbed the prefixes of cached results.
+    if (update_succeeded)
+      full_hash_cache_.clear();
     safe_browsing_thread_->message_loop()->PostTask(FROM_HERE,
         NewRunnableMethod(this,
                           &SafeBrowsingService::DatabaseUpdateFinished,
@@ -521,6 +548,7 @@ void SafeBrowsingService::CloseDatabase() {
 void SafeBrowsingService::ResetDatabase() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   DCHECK(enabled_);
+  full_hash_cache_.clear();
   safe_browsing_thread_->message_loop()->PostTask(FROM_HERE, NewRunnableMethod(
       this, &SafeBrowsingService::OnResetDatabase));
 }
@@ -644,6 +672,11 @@ void SafeBrowsingService::OnIOShutdown() {
   STLDeleteElements(&checks_);
 
   gethash_requests_.clear();
+  pending_browse_prefixes_.clear();
+  pending_download_prefixes_.clear();
+  gethash_batch_scheduled_ = false;
+  STLDeleteElements(&gethash_batches_);
+  full_hash_cache_.clear();
 }
 
 bool SafeBrowsingService::DatabaseAvailable() const {
@@ -705,31 +738,11 @@ void SafeBrowsingService::OnCheckDone(SafeBrowsingCheck* check) {
   if (check->client && check->need_get_hash) {
     // We have a partial match so we need to query Google for the full hash.
     // Clean up will happen in HandleGetHashResults.
-
-    // See if we have a GetHash request already in progress for this particular
-    // prefix. If so, we just append ourselves to the list of interested parties
-    // when the results arrive. We only do this for checks involving one prefix,
-    // since that is the common case (multiple prefixes will issue the request
-    // as normal).
-    if (check->prefix_hits.size() == 1) {
-      SBPrefix prefix = check->prefix_hits[0];
-      GetHashRequests::iterator it = gethash_requests_.find(prefix);
-      if (it != gethash_requests_.end()) {
-        // There's already a request in progress.
-        it->second.push_back(check);
-        return;
-      }
-
-      // No request in progress, so we're the first for this prefix.
-      GetHashRequestors requestors;
-      requestors.push_back(check);
-      gethash_requests_[prefix] = requestors;
+    if (!QueueGetHash(check)) {
+      // Every prefix was answered from the cache.  Since this data comes
+      // from cache, don't histogram hits.
+      HandleOneCheck(check, check->full_hits);
     }
-
-    // Reset the start time so that we can measure the network time without the
-    // database time.
-    check->start = base::TimeTicks::Now();
-    protocol_manager_->GetFullHash(check, check->prefix_hits);
   } else {
     // We may have cached results for previous GetHash queries.  Since
     // this data comes from cache, don't histogram hits.
@@ -932,30 +945,157 @@ void SafeBrowsingService::CacheHashResults(
   GetDatabase()->CacheHashResults(prefixes, full_hashes);
 }
 
-void SafeBrowsingService::OnHandleGetHashResults(
-    SafeBrowsingCheck* check,
-    const std::vector<SBFullHashResult>& full_hashes) {
+bool SafeBrowsingService::GetCachedFullHashes(
+    SBPrefix prefix,
+    std::vector<SBFullHashResult>* full_hashes) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  FullHashCache::iterator it = full_hash_cache_.find(prefix);
+  if (it == full_hash_cache_.end())
+    return false;
+  if (it->second.expire_after <= base::TimeTicks::Now()) {
+    full_hash_cache_.erase(it);
+    return false;
+  }
+  full_hashes->insert(full_hashes->end(),
+                      it->second.full_hashes.begin(),
+                      it->second.full_hashes.end());
+  return true;
+}
+
+bool SafeBrowsingService::QueueGetHash(SafeBrowsingCheck* check) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+
+  // Reset the start time so that we can measure the network time without the
+  // database time.
+  check->start = base::TimeTicks::Now();
+
+  // A check counts each of its prefixes once, however many of its URLs hit
+  // them.
+  std::vector<SBPrefix> prefixes(check->prefix_hits);
+  std::sort(prefixes.begin(), prefixes.end());
+  prefixes.erase(std::unique(prefixes.begin(), prefixes.end()),
+                 prefixes.end());
+
+  check->pending_prefixes = 0;
+  for (std::vector<SBPrefix>::const_iterator it = prefixes.begin();
+       it != prefixes.end(); ++it) {
+    if (GetCachedFullHashes(*it, &check->full_hits))
+      continue;
+
+    // See if we have a GetHash request already queued or in progress for this
+    // prefix.  If so, we just append ourselves to the list of interested
+    // parties when the results arrive.
+    GetHashRequests::iterator request = gethash_requests_.find(*it);
+    if (request == gethash_requests_.end()) {
+      request = gethash_requests_.insert(
+          std::make_pair(*it, GetHashRequestors())).first;
+      if (check->is_download)
+        pending_download_prefixes_.push_back(*it);
+      else
+        pending_browse_prefixes_.push_back(*it);
+    }
+    request->second.push_back(check);
+    ++check->pending_prefixes;
+  }
+  if (!check->pending_prefixes)
+    return false;
+
+  if (!gethash_batch_scheduled_ &&
+      (!pending_browse_prefixes_.empty() ||
+       !pending_download_prefixes_.empty())) {
+    gethash_batch_scheduled_ = true;
+    MessageLoop::current()->PostDelayedTask(
+        FROM_HERE,
+        NewRunnableMethod(this, &SafeBrowsingService::IssueGetHashBatches),
+        kGetHashBatchWindowMs);
+  }
+  return true;
+}
+
+void SafeBrowsingService::IssueGetHashBatches() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
-  bool is_download = check->is_download;
-  SBPrefix prefix = check->prefix_hits[0];
-  GetHashRequests::iterator it = gethash_requests_.find(prefix);
-  if (check->prefix_hits.size() > 1 || it == gethash_requests_.end()) {
-    const bool hit = HandleOneCheck(check, full_hashes);
-    RecordGetHashCheckStatus(hit, is_download, full_hashes);
+  gethash_batch_scheduled_ = false;
+  if (!enabled_)
+    return;
+
+  IssueGetHashBatch(false, &pending_browse_prefixes_);
+  IssueGetHashBatch(true, &pending_download_prefixes_);
+}
+
+void SafeBrowsingService::IssueGetHashBatch(bool is_download,
+                                            std::vector<SBPrefix>* prefixes) {
+  if (prefixes->empty())
     return;
+
+  SafeBrowsingCheck* batch = new SafeBrowsingCheck();
+  batch->is_download = is_download;
+  batch->prefix_hits.swap(*prefixes);
+  batch->start = base::TimeTicks::Now();
+  gethash_batches_.insert(batch);
+  protocol_manager_->GetFullHash(batch, batch->prefix_hits);
+}
+
+bool SafeBrowsingService::HandleGetHashBatch(
+    SafeBrowsingCheck* batch,
+    const std::vector<SBFullHashResult>& full_hashes,
+    bool can_cache) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+
+  const base::TimeTicks now = base::TimeTicks::Now();
+  if (can_cache && full_hash_cache_.size() >= kMaxFullHashCacheSize) {
+    for (FullHashCache::iterator it = full_hash_cache_.begin();
+         it != full_hash_cache_.end(); ) {
+      if (it->second.expire_after <= now)
+        full_hash_cache_.erase(it++);
+      else
+        ++it;
+    }
+    if (full_hash_cache_.size() >= kMaxFullHashCacheSize)
+      full_hash_cache_.clear();
   }
 
   // Call back all interested parties, noting if any has a hit.
-  GetHashRequestors& requestors = it->second;
   bool hit = false;
-  for (GetHashRequestors::iterator r = requestors.begin();
-       r != requestors.end(); ++r) {
-    if (HandleOneCheck(*r, full_hashes))
-      hit = true;
-  }
-  RecordGetHashCheckStatus(hit, is_download, full_hashes);
+  for (std::vector<SBPrefix>::const_iterator it = batch->prefix_hits.begin();
+       it != batch->prefix_hits.end(); ++it) {
+    std::vector<SBFullHashResult> prefix_hashes;
+    for (std::vector<SBFullHashResult>::const_iterator full_hash =
+             full_hashes.begin();
+         full_hash != full_hashes.end(); ++full_hash) {
+      if (full_hash->hash.prefix == *it)
+        prefix_hashes.push_back(*full_hash);
+    }
+
+    // An empty result is cached too: the prefix has no full hashes.
+    if (can_cache) {
+      CachedFullHashes& cached = full_hash_cache_[*it];
+      cached.expire_after =
+          now + base::TimeDelta::FromMinutes(kFullHashCacheMinutes);
+      cached.full_hashes = prefix_hashes;
+    }
 
-  gethash_requests_.erase(it);
+    GetHashRequests::iterator request = gethash_requests_.find(*it);
+    if (request == gethash_requests_.end()) {
+      NOTREACHED();
+      continue;
+    }
+    GetHashRequestors requestors;
+    requestors.swap(request->second);
+    gethash_requests_.erase(request);
+
+    for (GetHashRequestors::iterator r = requestors.begin();
+         r != requestors.end(); ++r) {
+      SafeBrowsingCheck* check = *r;
+      check->full_hits.insert(check->full_hits.end(),
+                              prefix_hashes.begin(), prefix_hashes.end());
+      DCHECK_GT(check->pending_prefixes, 0U);
+      // 'check' is deleted once its last prefix is answered.
+      if (--check->pending_prefixes == 0 &&
+          HandleOneCheck(check, check->full_hits))
+        hit = true;
+    }
+  }
+  return hit;
 }
 
 bool SafeBrowsingService::HandleOneCheck(
@@ -86,6 +86,9 @@ class SafeBrowsingService
     std::vector<SBPrefix> prefix_hits;
     std::vector<SBFullHashResult> full_hits;
 
+    // Number of |prefix_hits| still waiting on a GetHash response.
+    size_t pending_prefixes;
+
     // Task to make the callback to safebrowsing clients in case
     // safebrowsing check takes too long to finish. Not owned by
     // this class.
@@ -269,6 +272,17 @@ class SafeBrowsingService
   typedef std::set<SafeBrowsingCheck*> CurrentChecks;
   typedef std::vector<SafeBrowsingCheck*> GetHashRequestors;
   typedef base::hash_map<SBPrefix, GetHashRequestors> GetHashRequests;
+  typedef std::set<SafeBrowsingCheck*> GetHashBatches;
+
+  // Full hashes returned by GetHash for one prefix, possibly none.
+  struct CachedFullHashes {
+    CachedFullHashes();
+    ~CachedFullHashes();
+
+    base::TimeTicks expire_after;
+    std::vector<SBFullHashResult> full_hashes;
+  };
+  typedef base::hash_map<SBPrefix, CachedFullHashes> FullHashCache;
 
   // Used for whitelisting a render view when the user ignores our warning.
   struct WhiteListedEntry;
@@ -352,9 +366,27 @@ class SafeBrowsingService
   void CacheHashResults(const std::vector<SBPrefix>& prefixes,
                         const std::vector<SBFullHashResult>& full_hashes);
 
-  // Internal worker function for processing full hashes.
-  void OnHandleGetHashResults(SafeBrowsingCheck* check,
-                              const std::vector<SBFullHashResult>& full_hashes);
+  // Looks up |prefix| in |full_hash_cache_|, appending the cached full
+  // hashes to |full_hashes|.  Returns false if the prefix is not cached or
+  // the entry has expired.
+  bool GetCachedFullHashes(SBPrefix prefix,
+                           std::vector<SBFullHashResult>* full_hashes);
+
+  // Queues the prefixes of |check| which are neither cached nor already
+  // requested for the next GetHash batch.  Returns false if the cache
+  // answered all of them.
+  bool QueueGetHash(SafeBrowsingCheck* check);
+
+  // Sends the GetHash requests queued since the batch was scheduled.
+  void IssueGetHashBatches();
+  void IssueGetHashBatch(bool is_download, std::vector<SBPrefix>* prefixes);
+
+  // Hands the full hashes of |batch| to the checks waiting on its prefixes,
+  // calling back those with no prefix left to wait on.  Returns true if any
+  // of them had a hit.
+  bool HandleGetHashBatch(SafeBrowsingCheck* batch,
+                          const std::vector<SBFullHashResult>& full_hashes,
+                          bool can_cache);
 
   // Run one check against |full_hashes|.  Returns |true| if the check
   // finds a match in |full_hashes|.
@@ -407,9 +439,24 @@ class SafeBrowsingService
 
   CurrentChecks checks_;
 
-  // Used for issuing only one GetHash request for a given prefix.
+  // Used for issuing only one GetHash request for a given prefix.  Holds the
+  // checks waiting on each prefix which is queued or in flight.
   GetHashRequests gethash_requests_;
 
+  // Prefixes waiting for the next GetHash batch, and whether one has been
+  // scheduled.
+  std::vector<SBPrefix> pending_browse_prefixes_;
+  std::vector<SBPrefix> pending_download_prefixes_;
+  bool gethash_batch_scheduled_;
+
+  // The GetHash requests in flight.  Each is made for a check of its own,
+  // without a client.
+  GetHashBatches gethash_batches_;
+
+  // GetHash results, by prefix, which are reused until they expire or the
+  // next update finishes.
+  FullHashCache full_hash_cache_;
+
   // The persistent database.  We don't use a scoped_ptr because it
   // needs to be destructed on a different thread than this object.
   SafeBrowsingDatabase* database_;
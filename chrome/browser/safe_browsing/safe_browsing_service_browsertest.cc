@@ -6,6 +6,8 @@
 // and a test protocol manager. It is used to test logics in safebrowsing
 // service.
 
+#include <algorithm>
+
 #include "base/command_line.h"
 #include "base/memory/ref_counted.h"
 #include "base/metrics/histogram.h"
@@ -185,7 +187,8 @@ class TestProtocolManager :  public SafeBrowsingProtocolManager {
                                     info_url_prefix, mackey_url_prefix,
                                     disable_auto_update),
         sb_service_(sb_service),
-        delay_ms_(0) {
+        delay_ms_(0),
+        gethash_request_count_(0) {
   }
 
   // This function is called when there is a prefix hit in local safebrowsing
@@ -195,6 +198,9 @@ class TestProtocolManager :  public SafeBrowsingProtocolManager {
   // life network issues.
   virtual void GetFullHash(SafeBrowsingService::SafeBrowsingCheck* check,
                            const std::vector<SBPrefix>& prefixes) {
+    ++gethash_request_count_;
+    last_gethash_prefixes_ = prefixes;
+
     // When we get a valid response, always cache the result.
     bool cancache = true;
     BrowserThread::PostDelayedTask(
@@ -215,10 +221,18 @@ class TestProtocolManager :  public SafeBrowsingProtocolManager {
     delay_ms_ = ms;
   }
 
+  // The number of GetHash requests made, and the prefixes of the last one.
+  int gethash_request_count() const { return gethash_request_count_; }
+  const std::vector<SBPrefix>& last_gethash_prefixes() const {
+    return last_gethash_prefixes_;
+  }
+
  private:
   std::vector<SBFullHashResult> full_hashes_;
   SafeBrowsingService* sb_service_;
   int64 delay_ms_;
+  int gethash_request_count_;
+  std::vector<SBPrefix> last_gethash_prefixes_;
 };
 
 // Factory that creates TestProtocolManager instances.
@@ -306,9 +320,10 @@ class SafeBrowsingServiceTest : public InProcessBrowserTest {
     ASSERT_TRUE(test_server()->Start());
   }
 
-  // This will setup the "url" prefix in database and prepare protocol manager
-  // to response with |full_hash| for get full hash request.
-  void SetupResponseForUrl(const GURL& url, const SBFullHashResult& full_hash) {
+  // This will setup the "url" prefix in database, so that checking it needs
+  // a get full hash request.
+  void SetupPrefixHitForUrl(const GURL& url,
+                            const SBFullHashResult& full_hash) {
     std::vector<SBPrefix> prefix_hits;
     prefix_hits.push_back(full_hash.hash.prefix);
 
@@ -317,6 +332,12 @@ class SafeBrowsingServiceTest : public InProcessBrowserTest {
     std::vector<SBFullHashResult> empty_full_hits;
     TestSafeBrowsingDatabase* db = db_factory_.GetDb();
     db->AddUrl(url, full_hash.list_name, prefix_hits, empty_full_hits);
+  }
+
+  // This will setup the "url" prefix in database and prepare protocol manager
+  // to response with |full_hash| for get full hash request.
+  void SetupResponseForUrl(const GURL& url, const SBFullHashResult& full_hash) {
+    SetupPrefixHitForUrl(url, full_hash);
 
     TestProtocolManager* pm = pm_factory_.GetProtocolManager();
     pm->SetGetFullHashResponse(full_hash);
@@ -345,6 +366,20 @@ class SafeBrowsingServiceTest : public InProcessBrowserTest {
     pm_factory_.GetProtocolManager()->IntroduceDelay(ms);
   }
 
+  int GetHashRequestCount() {
+    return pm_factory_.GetProtocolManager()->gethash_request_count();
+  }
+
+  size_t LastGetHashPrefixCount() {
+    return pm_factory_.GetProtocolManager()->last_gethash_prefixes().size();
+  }
+
+  // Forgets the full hashes the service has cached, so that the next check
+  // of a prefix goes to the protocol manager again.
+  void ClearFullHashCache(SafeBrowsingService* sb_service) {
+    sb_service->full_hash_cache_.clear();
+  }
+
   int64 DownloadUrlCheckTimeout(SafeBrowsingService* sb_service) {
     return sb_service->download_urlcheck_timeout_ms_;
   }
@@ -436,6 +471,7 @@ class TestSBClient
       public SafeBrowsingService::Client {
  public:
   TestSBClient() : result_(SafeBrowsingService::SAFE),
+                   pending_checks_(0),
                    safe_browsing_service_(g_browser_process->
                                           resource_dispatcher_host()->
                                           safe_browsing_service()) {
@@ -445,12 +481,24 @@ class TestSBClient
     return result_;
   }
 
+  // The results of the last CheckDownloadUrls(), in the order they came.
+  const std::vector<SafeBrowsingService::UrlCheckResult>& results() const {
+    return results_;
+  }
+
   void CheckDownloadUrl(const std::vector<GURL>& url_chain) {
+    CheckDownloadUrls(std::vector<std::vector<GURL> >(1, url_chain));
+  }
+
+  // Checks all of |url_chains| at once, and waits for every result.
+  void CheckDownloadUrls(const std::vector<std::vector<GURL> >& url_chains) {
+    results_.clear();
+    pending_checks_ = url_chains.size();
     BrowserThread::PostTask(
         BrowserThread::IO, FROM_HERE,
         NewRunnableMethod(this,
-                          &TestSBClient::CheckDownloadUrlOnIOThread,
-                          url_chain));
+                          &TestSBClient::CheckDownloadUrlsOnIOThread,
+                          url_chains));
     ui_test_utils::RunMessageLoop();  // Will stop in OnDownloadUrlCheckResult.
   }
 
@@ -464,8 +512,12 @@ class TestSBClient
   }
 
  private:
-  void CheckDownloadUrlOnIOThread(const std::vector<GURL>& url_chain) {
-    safe_browsing_service_->CheckDownloadUrl(url_chain, this);
+  void CheckDownloadUrlsOnIOThread(
+      const std::vector<std::vector<GURL> >& url_chains) {
+    for (size_t i = 0; i < url_chains.size(); ++i) {
+      if (safe_browsing_service_->CheckDownloadUrl(url_chains[i], this))
+        OnDownloadUrlCheckResult(url_chains[i], SafeBrowsingService::SAFE);
+    }
   }
 
   void CheckDownloadHashOnIOThread(const std::string& full_hash) {
@@ -476,6 +528,9 @@ class TestSBClient
   void OnDownloadUrlCheckResult(const std::vector<GURL>& url_chain,
                                 SafeBrowsingService::UrlCheckResult result) {
     result_ = result;
+    results_.push_back(result);
+    if (--pending_checks_ > 0)
+      return;
     BrowserThread::PostTask(BrowserThread::UI, FROM_HERE,
       NewRunnableMethod(this, &TestSBClient::DownloadCheckDone));
   }
@@ -493,6 +548,8 @@ class TestSBClient
   }
 
   SafeBrowsingService::UrlCheckResult result_;
+  std::vector<SafeBrowsingService::UrlCheckResult> results_;
+  size_t pending_checks_;
   SafeBrowsingService* safe_browsing_service_;
 
   DISALLOW_COPY_AND_ASSIGN(TestSBClient);
@@ -595,6 +652,7 @@ IN_PROC_BROWSER_TEST_F(SafeBrowsingServiceTest, CheckDownloadUrlTimedOut) {
   const int64 kOneSec = 1000;
   const int64 kOneMs = 1;
   int64 default_urlcheck_timeout = DownloadUrlCheckTimeout(sb_service);
+  ClearFullHashCache(sb_service);
   IntroduceGetHashDelay(kOneSec);
   SetDownloadUrlCheckTimeout(sb_service, kOneMs);
   client->CheckDownloadUrl(badbin_urls);
@@ -628,6 +686,7 @@ IN_PROC_BROWSER_TEST_F(SafeBrowsingServiceTest, CheckDownloadHashTimedOut) {
   const int64 kOneSec = 1000;
   const int64 kOneMs = 1;
   int64 default_hashcheck_timeout = DownloadHashCheckTimeout(sb_service);
+  ClearFullHashCache(sb_service);
   IntroduceGetHashDelay(kOneSec);
   SetDownloadHashCheckTimeout(sb_service, kOneMs);
   client->CheckDownloadHash(full_hash);
@@ -639,4 +698,53 @@ IN_PROC_BROWSER_TEST_F(SafeBrowsingServiceTest, CheckDownloadHashTimedOut) {
   SetDownloadHashCheckTimeout(sb_service, default_hashcheck_timeout);
 }
 
+IN_PROC_BROWSER_TEST_F(SafeBrowsingServiceTest, GetHashRequestsBatched) {
+  GURL badbin_url = test_server()->GetURL(kMalwareFile);
+  GURL other_url = test_server()->GetURL(kEmptyPage);
+  std::vector<GURL> badbin_urls(1, badbin_url);
+  std::vector<GURL> other_urls(1, other_url);
+
+  SBFullHashResult full_hash_result;
+  int chunk_id = 0;
+  GenUrlFullhashResult(badbin_url, safe_browsing_util::kBinUrlList,
+                       chunk_id, &full_hash_result);
+  SetupResponseForUrl(badbin_url, full_hash_result);
+
+  // |other_url| hits a prefix too, but the server has no full hash for it.
+  SBFullHashResult other_full_hash;
+  GenUrlFullhashResult(other_url, safe_browsing_util::kBinUrlList,
+                       chunk_id, &other_full_hash);
+  SetupPrefixHitForUrl(other_url, other_full_hash);
+
+  // Checks made together share one request, which asks for each prefix
+  // once.
+  std::vector<std::vector<GURL> > url_chains(3, badbin_urls);
+  url_chains.push_back(other_urls);
+  scoped_refptr<TestSBClient> client(new TestSBClient);
+  client->CheckDownloadUrls(url_chains);
+  EXPECT_EQ(1, GetHashRequestCount());
+  EXPECT_EQ(2U, LastGetHashPrefixCount());
+  ASSERT_EQ(4U, client->results().size());
+  EXPECT_EQ(3, std::count(client->results().begin(), client->results().end(),
+                          SafeBrowsingService::BINARY_MALWARE_URL));
+  EXPECT_EQ(1, std::count(client->results().begin(), client->results().end(),
+                          SafeBrowsingService::SAFE));
+
+  // Later checks are answered from the cache, misses included.
+  client->CheckDownloadUrl(badbin_urls);
+  EXPECT_EQ(SafeBrowsingService::BINARY_MALWARE_URL, client->GetResult());
+  client->CheckDownloadUrl(other_urls);
+  EXPECT_EQ(SafeBrowsingService::SAFE, client->GetResult());
+  EXPECT_EQ(1, GetHashRequestCount());
+
+  // Until the cache is dropped.
+  SafeBrowsingService* sb_service =
+      g_browser_process->resource_dispatcher_host()->safe_browsing_service();
+  ClearFullHashCache(sb_service);
+  client->CheckDownloadUrl(badbin_urls);
+  EXPECT_EQ(SafeBrowsingService::BINARY_MALWARE_URL, client->GetResult());
+  EXPECT_EQ(2, GetHashRequestCount());
+  EXPECT_EQ(1U, LastGetHashPrefixCount());
+}
+
 }  // namespace
@@ -136,13 +136,6 @@ void SBCheckPrefixMisses(const std::vector<SBAddPrefix>& add_prefixes,
   if (prefix_misses.empty())
     return;
 
-  // Record a hit for all prefixes which missed when sent to the
-  // server.
-  for (size_t i = 0; i < prefix_misses.size(); ++i) {
-    UMA_HISTOGRAM_ENUMERATION("SB2.BloomFilterFalsePositives",
-                              MISS_TYPE_ALL, MISS_TYPE_MAX);
-  }
-
   // Collect the misses which are not present in |add_prefixes|.
   // Since |add_prefixes| can contain multiple copies of the same
   // prefix, it is not sufficient to count the number of elements
@@ -153,9 +146,20 @@ void SBCheckPrefixMisses(const std::vector<SBAddPrefix>& add_prefixes,
     false_misses.erase(add_prefixes[i].prefix);
   }
 
+  SBRecordPrefixMisses(prefix_misses.size(), false_misses.size());
+}
+
+void SBRecordPrefixMisses(size_t miss_count, size_t false_miss_count) {
+  // Record a hit for all prefixes which missed when sent to the
+  // server.
+  for (size_t i = 0; i < miss_count; ++i) {
+    UMA_HISTOGRAM_ENUMERATION("SB2.BloomFilterFalsePositives",
+                              MISS_TYPE_ALL, MISS_TYPE_MAX);
+  }
+
   // Record a hit for prefixes which we shouldn't have sent in the
   // first place.
-  for (size_t i = 0; i < false_misses.size(); ++i) {
+  for (size_t i = 0; i < false_miss_count; ++i) {
     UMA_HISTOGRAM_ENUMERATION("SB2.BloomFilterFalsePositives",
                               MISS_TYPE_FALSE, MISS_TYPE_MAX);
   }
@@ -180,10 +184,6 @@ void SBProcessSubs(std::vector<SBAddPrefix>* add_prefixes,
             SBAddPrefixLess<SBAddPrefix,SBAddPrefix>);
   std::sort(sub_prefixes->begin(), sub_prefixes->end(),
             SBAddPrefixLess<SBSubPrefix,SBSubPrefix>);
-  std::sort(add_full_hashes->begin(), add_full_hashes->end(),
-            SBAddPrefixHashLess<SBAddFullHash,SBAddFullHash>);
-  std::sort(sub_full_hashes->begin(), sub_full_hashes->end(),
-            SBAddPrefixHashLess<SBSubFullHash,SBSubFullHash>);
 
   // Factor out the prefix subs.
   std::vector<SBAddPrefix> removed_adds;
@@ -192,6 +192,26 @@ void SBProcessSubs(std::vector<SBAddPrefix>* add_prefixes,
                SBAddPrefixLess<SBSubPrefix,SBAddPrefix>,
                &removed_adds);
 
+  // Remove items from the deleted chunks.  This is done after other
+  // processing to allow subs to knock out adds (and be removed) even
+  // if the add's chunk is deleted.
+  RemoveDeleted(add_prefixes, add_chunks_deleted);
+  RemoveDeleted(sub_prefixes, sub_chunks_deleted);
+
+  SBProcessFullHashSubs(removed_adds, add_full_hashes, sub_full_hashes,
+                        add_chunks_deleted, sub_chunks_deleted);
+}
+
+void SBProcessFullHashSubs(const std::vector<SBAddPrefix>& removed_adds,
+                           std::vector<SBAddFullHash>* add_full_hashes,
+                           std::vector<SBSubFullHash>* sub_full_hashes,
+                           const base::hash_set<int32>& add_chunks_deleted,
+                           const base::hash_set<int32>& sub_chunks_deleted) {
+  std::sort(add_full_hashes->begin(), add_full_hashes->end(),
+            SBAddPrefixHashLess<SBAddFullHash,SBAddFullHash>);
+  std::sort(sub_full_hashes->begin(), sub_full_hashes->end(),
+            SBAddPrefixHashLess<SBSubFullHash,SBSubFullHash>);
+
   // Remove the full-hashes corrosponding to the adds which
   // KnockoutSubs() removed.  Processing these w/in KnockoutSubs()
   // would make the code more complicated, and they are very small
@@ -215,11 +235,7 @@ void SBProcessSubs(std::vector<SBAddPrefix>* add_prefixes,
                  &removed_full_adds);
   }
 
-  // Remove items from the deleted chunks.  This is done after other
-  // processing to allow subs to knock out adds (and be removed) even
-  // if the add's chunk is deleted.
-  RemoveDeleted(add_prefixes, add_chunks_deleted);
-  RemoveDeleted(sub_prefixes, sub_chunks_deleted);
+  // As above, deleted chunks are removed last.
   RemoveDeleted(add_full_hashes, add_chunks_deleted);
   RemoveDeleted(sub_full_hashes, sub_chunks_deleted);
 }
@@ -146,11 +146,25 @@ void SBProcessSubs(std::vector<SBAddPrefix>* add_prefixes,
                    const base::hash_set<int32>& add_chunks_deleted,
                    const base::hash_set<int32>& sub_chunks_deleted);
 
+// The full-hash half of SBProcessSubs(), for callers which knock out
+// the prefix subs themselves.  |removed_adds| are the add prefixes
+// which were knocked out, ordered by SBAddPrefixLess.  The full hashes
+// need not be sorted on input.
+void SBProcessFullHashSubs(const std::vector<SBAddPrefix>& removed_adds,
+                           std::vector<SBAddFullHash>* add_full_hashes,
+                           std::vector<SBSubFullHash>* sub_full_hashes,
+                           const base::hash_set<int32>& add_chunks_deleted,
+                           const base::hash_set<int32>& sub_chunks_deleted);
+
 // Records a histogram of the number of items in |prefix_misses| which
 // are not in |add_prefixes|.
 void SBCheckPrefixMisses(const std::vector<SBAddPrefix>& add_prefixes,
                          const std::set<SBPrefix>& prefix_misses);
 
+// Records the histogram for SBCheckPrefixMisses() given the counts,
+// for callers which check the add prefixes as they stream by.
+void SBRecordPrefixMisses(size_t miss_count, size_t false_miss_count);
+
 // TODO(shess): This uses int32 rather than int because it's writing
 // specifically-sized items to files.  SBPrefix should likewise be
 // explicitly sized.
@@ -4,9 +4,12 @@
 
 #include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
 
+#include <algorithm>
+
 #include "base/callback.h"
 #include "base/metrics/histogram.h"
 #include "base/md5.h"
+#include "base/stl_util-inl.h"
 
 namespace {
 
@@ -29,6 +32,14 @@ struct ChunkHeader {
   uint32 add_hash_count, sub_hash_count;
 };
 
+// Number of items each reader and writer buffers while merging.
+const size_t kMergeBufferItems = 4096;
+
+// New prefixes are collected in memory up to this many items, then
+// sorted and spilled to a scratch file as a run.  Most updates fit in
+// a single run, which is merged straight from memory.
+const size_t kMaxRunItems = 128 * 1024;
+
 // Rewind the file.  Using fseek(2) because rewind(3) errors are
 // weird.
 bool FileRewind(FILE* fp) {
@@ -193,6 +204,302 @@ bool ReadAndVerifyHeader(const FilePath& filename,
   return true;
 }
 
+// Fold the |bytes| bytes at the current position in |fp| into the
+// checksum in |context|, then check it against the digest which
+// follows them.  Reads through a fixed-size buffer.
+bool ReadAndCheckDigest(FILE* fp, int64 bytes, MD5Context* context) {
+  std::vector<char> buffer(kMergeBufferItems * sizeof(SBAddPrefix));
+  while (bytes > 0) {
+    const size_t count =
+        static_cast<size_t>(std::min<int64>(bytes, buffer.size()));
+    if (!ReadArray(&buffer[0], count, fp, context))
+      return false;
+    bytes -= count;
+  }
+
+  MD5Digest calculated_digest;
+  MD5Final(&calculated_digest, context);
+
+  MD5Digest file_digest;
+  if (!ReadArray(&file_digest, 1, fp, NULL))
+    return false;
+  return 0 == memcmp(&file_digest, &calculated_digest, sizeof(file_digest));
+}
+
+// A file for spilling data during an update, created in the directory
+// of the store and deleted when the object goes out of scope.
+class ScratchFile {
+ public:
+  ScratchFile() {}
+  ~ScratchFile() {
+    file_.reset();
+    if (!path_.empty())
+      file_util::Delete(path_, false);
+  }
+
+  bool Open(const FilePath& dir) {
+    file_.reset(file_util::CreateAndOpenTemporaryFileInDir(dir, &path_));
+    return file_.get() != NULL;
+  }
+
+  FILE* get() const { return file_.get(); }
+
+ private:
+  file_util::ScopedFILE file_;
+  FilePath path_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScratchFile);
+};
+
+// A sorted run of items, read a buffer at a time from a file, or
+// held in memory.  Several readers may share a file, as each seeks to
+// its own position before reading.
+template <class T>
+class RunReader {
+ public:
+  // Reads the |count| items at |offset| in |fp|.
+  RunReader(FILE* fp, long offset, size_t count)
+      : fp_(fp), offset_(offset), remaining_(count), pos_(0) {
+  }
+
+  // Takes the contents of |items|.
+  explicit RunReader(std::vector<T>* items)
+      : fp_(NULL), offset_(0), remaining_(0), pos_(0) {
+    buffer_.swap(*items);
+  }
+
+  bool empty() const { return pos_ == buffer_.size(); }
+  const T& front() const { return buffer_[pos_]; }
+
+  // Drops the front item.  Returns false if reading the next ones
+  // fails.
+  bool Pop() {
+    ++pos_;
+    return !empty() || Fill();
+  }
+
+  // Reads the next buffer of items, if the current one is used up.
+  bool Fill() {
+    if (!empty() || !remaining_)
+      return true;
+
+    const size_t count = std::min(remaining_, kMergeBufferItems);
+    buffer_.clear();
+    pos_ = 0;
+    if (fseek(fp_, offset_, SEEK_SET) != 0 ||
+        !ReadToVector(&buffer_, count, fp_, NULL))
+      return false;
+    offset_ += count * sizeof(T);
+    remaining_ -= count;
+    return true;
+  }
+
+ private:
+  FILE* fp_;
+  long offset_;
+  size_t remaining_;
+  std::vector<T> buffer_;
+  size_t pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunReader);
+};
+
+// Merges sorted runs into a single sorted stream.  There are only a
+// few runs (the main file and the spilled runs of the update), so the
+// smallest front is found by scanning them.
+template <class T>
+class RunMerger {
+ public:
+  RunMerger() : front_run_(NULL), out_of_order_(false) {}
+  ~RunMerger() { STLDeleteElements(&runs_); }
+
+  // Takes ownership of |run|.  Returns false if reading it fails.
+  bool AddRun(RunReader<T>* run) {
+    runs_.push_back(run);
+    if (!run->Fill())
+      return false;
+    SelectFront();
+    return true;
+  }
+
+  bool empty() const { return front_run_ == NULL; }
+  const T& front() const { return front_run_->front(); }
+
+  // Drops the front item.  Returns false if reading fails, or if a
+  // run turns out not to be sorted.
+  bool Pop() {
+    const T item = front_run_->front();
+    if (!front_run_->Pop())
+      return false;
+    if (!front_run_->empty() &&
+        SBAddPrefixLess(front_run_->front(), item)) {
+      out_of_order_ = true;
+      return false;
+    }
+    SelectFront();
+    return true;
+  }
+
+  // True if a failure was due to an unsorted run rather than I/O.
+  bool out_of_order() const { return out_of_order_; }
+
+ private:
+  void SelectFront() {
+    front_run_ = NULL;
+    for (size_t i = 0; i < runs_.size(); ++i) {
+      if (!runs_[i]->empty() &&
+          (!front_run_ ||
+           SBAddPrefixLess(runs_[i]->front(), front_run_->front())))
+        front_run_ = runs_[i];
+    }
+  }
+
+  std::vector<RunReader<T>*> runs_;
+  RunReader<T>* front_run_;
+  bool out_of_order_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunMerger);
+};
+
+// Appends items to a file a buffer at a time.
+template <class T>
+class RunWriter {
+ public:
+  explicit RunWriter(FILE* fp) : fp_(fp), count_(0) {
+    buffer_.reserve(kMergeBufferItems);
+  }
+
+  bool Push(const T& item) {
+    buffer_.push_back(item);
+    return buffer_.size() < kMergeBufferItems || Flush();
+  }
+
+  bool Flush() {
+    if (!WriteVector(buffer_, fp_, NULL))
+      return false;
+    count_ += buffer_.size();
+    buffer_.clear();
+    return true;
+  }
+
+  // The number of items flushed to the file.
+  size_t count() const { return count_; }
+
+ private:
+  FILE* fp_;
+  std::vector<T> buffer_;
+  size_t count_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunWriter);
+};
+
+// Where a run was spilled in the scratch file.
+struct SpilledRun {
+  long offset;
+  size_t count;
+};
+
+// Sort |items| and append them to |fp| as a run, recorded in |runs|.
+// |*fp_size| tracks the size of |fp|.  Returns true on success.
+template <class T>
+bool SpillRun(std::vector<T>* items, FILE* fp, long* fp_size,
+              std::vector<SpilledRun>* runs) {
+  std::sort(items->begin(), items->end(), SBAddPrefixLess<T, T>);
+  if (!WriteVector(*items, fp, NULL))
+    return false;
+
+  SpilledRun run;
+  run.offset = *fp_size;
+  run.count = items->size();
+  runs->push_back(run);
+  *fp_size += items->size() * sizeof(T);
+  items->clear();
+  return true;
+}
+
+// Add readers for the runs in |runs| of |fp| and for the sorted
+// |items| to |merger|.  Returns true on success.
+template <class T>
+bool AddRunsToMerger(FILE* fp, const std::vector<SpilledRun>& runs,
+                     std::vector<T>* items, RunMerger<T>* merger) {
+  if (!runs.empty() && fflush(fp) != 0)
+    return false;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    if (!merger->AddRun(new RunReader<T>(fp, runs[i].offset, runs[i].count)))
+      return false;
+  }
+  std::sort(items->begin(), items->end(), SBAddPrefixLess<T, T>);
+  return merger->AddRun(new RunReader<T>(items));
+}
+
+// Stream the merged |adds| and |subs| in parallel, like KnockoutSubs()
+// in safe_browsing_store.cc, recording the adds which subs knock out
+// in |adds_removed|.  The remaining items which are not in deleted
+// chunks are kept in |adds_kept| and |subs_kept|.  Every add seen is
+// removed from |false_misses|.  Returns true on success.
+bool KnockoutSubPrefixes(RunMerger<SBAddPrefix>* adds,
+                         RunMerger<SBSubPrefix>* subs,
+                         const base::hash_set<int32>& add_del_set,
+                         const base::hash_set<int32>& sub_del_set,
+                         std::set<SBPrefix>* false_misses,
+                         std::vector<SBAddPrefix>* adds_kept,
+                         RunWriter<SBSubPrefix>* subs_kept,
+                         std::vector<SBAddPrefix>* adds_removed) {
+  while (!adds->empty() || !subs->empty()) {
+    // If the sub is less than the add, retain the sub.
+    if (adds->empty() ||
+        (!subs->empty() && SBAddPrefixLess(subs->front(), adds->front()))) {
+      const SBSubPrefix& sub = subs->front();
+      if (sub_del_set.count(sub.chunk_id) == 0 && !subs_kept->Push(sub))
+        return false;
+      if (!subs->Pop())
+        return false;
+      continue;
+    }
+
+    const SBAddPrefix& add = adds->front();
+    if (!false_misses->empty())
+      false_misses->erase(add.prefix);
+
+    // If the add is less than the sub, retain the add.
+    if (subs->empty() || SBAddPrefixLess(add, subs->front())) {
+      if (add_del_set.count(add.chunk_id) == 0)
+        adds_kept->push_back(add);
+      if (!adds->Pop())
+        return false;
+
+      // Record equal items and drop them.
+    } else {
+      adds_removed->push_back(add);
+      if (!adds->Pop() || !subs->Pop())
+        return false;
+    }
+  }
+  return subs_kept->Flush();
+}
+
+// Copy the |count| items at the start of |from| to |to|, folding them
+// into the checksum in |context|.  Returns true on success.
+template <class T>
+bool CopyRun(FILE* from, size_t count, FILE* to, MD5Context* context) {
+  RunReader<T> reader(from, 0, count);
+  if (!reader.Fill())
+    return false;
+  std::vector<T> buffer;
+  buffer.reserve(kMergeBufferItems);
+  while (!reader.empty()) {
+    buffer.push_back(reader.front());
+    if (!reader.Pop())
+      return false;
+    if (buffer.size() == kMergeBufferItems || reader.empty()) {
+      if (!WriteVector(buffer, to, context))
+        return false;
+      buffer.clear();
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
 // static
@@ -481,12 +788,16 @@ bool SafeBrowsingStoreFile::DoUpdate(
   CHECK(add_prefixes_result);
   CHECK(add_full_hashes_result);
 
-  std::vector<SBAddPrefix> add_prefixes;
-  std::vector<SBSubPrefix> sub_prefixes;
+  // The prefix lists are merged from sorted runs, so that only the
+  // add prefixes handed to the caller are held in memory in full.
+  // The full hashes are few enough to process in memory.
+  RunMerger<SBAddPrefix> add_prefixes;
+  RunMerger<SBSubPrefix> sub_prefixes;
   std::vector<SBAddFullHash> add_full_hashes;
   std::vector<SBSubFullHash> sub_full_hashes;
+  size_t add_prefix_count = 0;
 
-  // Read original data into the vectors.
+  // Verify the original data and set up readers for its prefixes.
   if (!empty_) {
     DCHECK(file_.get());
 
@@ -501,41 +812,35 @@ bool SafeBrowsingStoreFile::DoUpdate(
     if (!ReadAndVerifyHeader(filename_, file_.get(), &header, &context))
       return OnCorruptDatabase();
 
-    // Re-read the chunks-seen data to get to the later data in the
-    // file and calculate the checksum.  No new elements should be
-    // added to the sets.
-    if (!ReadToChunkSet(&add_chunks_cache_, header.add_chunk_count,
-                        file_.get(), &context) ||
-        !ReadToChunkSet(&sub_chunks_cache_, header.sub_chunk_count,
-                        file_.get(), &context))
+    // The chunks-seen data was read by BeginUpdate(), so checksum the
+    // rest of the data without keeping it.
+    const long prefix_offset = sizeof(FileHeader) +
+        (header.add_chunk_count + header.sub_chunk_count) * sizeof(int32);
+    const long sub_prefix_offset =
+        prefix_offset + header.add_prefix_count * sizeof(SBAddPrefix);
+    const long hash_offset =
+        sub_prefix_offset + header.sub_prefix_count * sizeof(SBSubPrefix);
+    const int64 data_size = hash_offset - sizeof(FileHeader) +
+        header.add_hash_count * sizeof(SBAddFullHash) +
+        header.sub_hash_count * sizeof(SBSubFullHash);
+    if (!ReadAndCheckDigest(file_.get(), data_size, &context))
       return OnCorruptDatabase();
 
-    if (!ReadToVector(&add_prefixes, header.add_prefix_count,
-                      file_.get(), &context) ||
-        !ReadToVector(&sub_prefixes, header.sub_prefix_count,
-                      file_.get(), &context) ||
+    if (fseek(file_.get(), hash_offset, SEEK_SET) != 0 ||
         !ReadToVector(&add_full_hashes, header.add_hash_count,
-                      file_.get(), &context) ||
+                      file_.get(), NULL) ||
         !ReadToVector(&sub_full_hashes, header.sub_hash_count,
-                      file_.get(), &context))
+                      file_.get(), NULL))
       return OnCorruptDatabase();
 
-    // Calculate the digest to this point.
-    MD5Digest calculated_digest;
-    MD5Final(&calculated_digest, &context);
-
-    // Read the stored checksum and verify it.
-    MD5Digest file_digest;
-    if (!ReadArray(&file_digest, 1, file_.get(), NULL))
+    // The prefixes were written in sorted order.
+    if (!add_prefixes.AddRun(new RunReader<SBAddPrefix>(
+            file_.get(), prefix_offset, header.add_prefix_count)) ||
+        !sub_prefixes.AddRun(new RunReader<SBSubPrefix>(
+            file_.get(), sub_prefix_offset, header.sub_prefix_count)))
       return OnCorruptDatabase();
-
-    if (0 != memcmp(&file_digest, &calculated_digest, sizeof(file_digest)))
-      return OnCorruptDatabase();
-
-    // Close the file so we can later rename over it.
-    file_.reset();
+    add_prefix_count += header.add_prefix_count;
   }
-  DCHECK(!file_.get());
 
   // Rewind the temporary storage.
   if (!FileRewind(new_file_.get()))
@@ -552,7 +857,14 @@ bool SafeBrowsingStoreFile::DoUpdate(
   UMA_HISTOGRAM_COUNTS("SB2.DatabaseUpdateKilobytes",
                        std::max(static_cast<int>(size / 1024), 1));
 
-  // Append the accumulated chunks onto the vectors read from |file_|.
+  // Collect the accumulated chunks into sorted runs of new prefixes,
+  // spilling them to |scratch| if the update is large.
+  ScratchFile scratch;
+  long scratch_size = 0;
+  std::vector<SpilledRun> add_runs;
+  std::vector<SpilledRun> sub_runs;
+  std::vector<SBAddPrefix> new_add_prefixes;
+  std::vector<SBSubPrefix> new_sub_prefixes;
   for (int i = 0; i < chunks_written_; ++i) {
     ChunkHeader header;
 
@@ -573,36 +885,68 @@ bool SafeBrowsingStoreFile::DoUpdate(
     if (expected_size > size)
       return false;
 
-    // TODO(shess): If the vectors were kept sorted, then this code
-    // could use std::inplace_merge() to merge everything together in
-    // sorted order.  That might still be slower than just sorting at
-    // the end if there were a large number of chunks.  In that case
-    // some sort of recursive binary merge might be in order (merge
-    // chunks pairwise, merge those chunks pairwise, and so on, then
-    // merge the result with the main list).
-    if (!ReadToVector(&add_prefixes, header.add_prefix_count,
+    if (!ReadToVector(&new_add_prefixes, header.add_prefix_count,
                       new_file_.get(), NULL) ||
-        !ReadToVector(&sub_prefixes, header.sub_prefix_count,
+        !ReadToVector(&new_sub_prefixes, header.sub_prefix_count,
                       new_file_.get(), NULL) ||
         !ReadToVector(&add_full_hashes, header.add_hash_count,
                       new_file_.get(), NULL) ||
         !ReadToVector(&sub_full_hashes, header.sub_hash_count,
                       new_file_.get(), NULL))
       return false;
+    add_prefix_count += header.add_prefix_count;
+
+    if (new_add_prefixes.size() >= kMaxRunItems ||
+        new_sub_prefixes.size() >= kMaxRunItems) {
+      if (!scratch.get() && !scratch.Open(filename_.DirName()))
+        return false;
+      if (!SpillRun(&new_add_prefixes, scratch.get(), &scratch_size,
+                    &add_runs) ||
+          !SpillRun(&new_sub_prefixes, scratch.get(), &scratch_size,
+                    &sub_runs))
+        return false;
+    }
   }
+  if (!AddRunsToMerger(scratch.get(), add_runs, &new_add_prefixes,
+                       &add_prefixes) ||
+      !AddRunsToMerger(scratch.get(), sub_runs, &new_sub_prefixes,
+                       &sub_prefixes))
+    return false;
 
   // Append items from |pending_adds|.
   add_full_hashes.insert(add_full_hashes.end(),
                          pending_adds.begin(), pending_adds.end());
 
-  // Check how often a prefix was checked which wasn't in the
-  // database.
-  SBCheckPrefixMisses(add_prefixes, prefix_misses);
+  // Knock the subs from the adds and drop deleted chunks as the
+  // prefixes are merged.  The subs which remain go to a scratch file
+  // until the adds have all been seen.  Also check how often a prefix
+  // was checked which wasn't in the database.
+  ScratchFile sub_scratch;
+  if (!sub_scratch.Open(filename_.DirName()))
+    return false;
+  RunWriter<SBSubPrefix> subs_kept(sub_scratch.get());
+  std::vector<SBAddPrefix> adds_kept;
+  adds_kept.reserve(add_prefix_count);
+  std::vector<SBAddPrefix> removed_adds;
+  std::set<SBPrefix> false_misses(prefix_misses.begin(), prefix_misses.end());
+  if (!KnockoutSubPrefixes(&add_prefixes, &sub_prefixes,
+                           add_del_cache_, sub_del_cache_, &false_misses,
+                           &adds_kept, &subs_kept, &removed_adds)) {
+    // Only the original file's runs can be out of order.
+    if (add_prefixes.out_of_order() || sub_prefixes.out_of_order())
+      return OnCorruptDatabase();
+    return false;
+  }
+  if (!prefix_misses.empty())
+    SBRecordPrefixMisses(prefix_misses.size(), false_misses.size());
+
+  // Close the file so we can later rename over it.
+  file_.reset();
 
-  // Knock the subs from the adds and process deleted chunks.
-  SBProcessSubs(&add_prefixes, &sub_prefixes,
-                &add_full_hashes, &sub_full_hashes,
-                add_del_cache_, sub_del_cache_);
+  // Knock the subbed adds from the full hashes and process deleted
+  // chunks.
+  SBProcessFullHashSubs(removed_adds, &add_full_hashes, &sub_full_hashes,
+                        add_del_cache_, sub_del_cache_);
 
   // We no longer need to track deleted chunks.
   DeleteChunksFromSet(add_del_cache_, &add_chunks_cache_);
@@ -621,18 +965,21 @@ bool SafeBrowsingStoreFile::DoUpdate(
   header.version = kFileVersion;
   header.add_chunk_count = add_chunks_cache_.size();
   header.sub_chunk_count = sub_chunks_cache_.size();
-  header.add_prefix_count = add_prefixes.size();
-  header.sub_prefix_count = sub_prefixes.size();
+  header.add_prefix_count = adds_kept.size();
+  header.sub_prefix_count = subs_kept.count();
   header.add_hash_count = add_full_hashes.size();
   header.sub_hash_count = sub_full_hashes.size();
   if (!WriteArray(&header, 1, new_file_.get(), &context))
     return false;
 
-  // Write all the chunk data.
+  // Write all the chunk data.  The prefixes stay sorted, which the
+  // next update relies on.
   if (!WriteChunkSet(add_chunks_cache_, new_file_.get(), &context) ||
       !WriteChunkSet(sub_chunks_cache_, new_file_.get(), &context) ||
-      !WriteVector(add_prefixes, new_file_.get(), &context) ||
-      !WriteVector(sub_prefixes, new_file_.get(), &context) ||
+      !WriteVector(adds_kept, new_file_.get(), &context) ||
+      fflush(sub_scratch.get()) != 0 ||
+      !CopyRun<SBSubPrefix>(sub_scratch.get(), subs_kept.count(),
+                            new_file_.get(), &context) ||
       !WriteVector(add_full_hashes, new_file_.get(), &context) ||
       !WriteVector(sub_full_hashes, new_file_.get(), &context))
     return false;
@@ -658,11 +1005,11 @@ bool SafeBrowsingStoreFile::DoUpdate(
     return false;
 
   // Record counts before swapping to caller.
-  UMA_HISTOGRAM_COUNTS("SB2.AddPrefixes", add_prefixes.size());
-  UMA_HISTOGRAM_COUNTS("SB2.SubPrefixes", sub_prefixes.size());
+  UMA_HISTOGRAM_COUNTS("SB2.AddPrefixes", adds_kept.size());
+  UMA_HISTOGRAM_COUNTS("SB2.SubPrefixes", subs_kept.count());
 
   // Pass the resulting data off to the caller.
-  add_prefixes_result->swap(add_prefixes);
+  add_prefixes_result->swap(adds_kept);
   add_full_hashes_result->swap(add_full_hashes);
 
   return true;
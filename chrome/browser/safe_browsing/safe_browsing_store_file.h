@@ -54,6 +54,10 @@
 // }
 // MD5Digest checksum;      // Checksum over preceeding data.
 //
+// The prefix and hash arrays are sorted by SBAddPrefixLess() and
+// SBAddPrefixHashLess() respectively, so that an update can merge new
+// data into them as it reads them.
+//
 // During the course of an update, uncommitted data is stored in a
 // temporary file (which is later re-used to commit).  This is an
 // array of chunks, with the count kept in memory until the end of the
@@ -91,12 +95,20 @@
 // - Open a temp file for storing new chunk info.
 // - Write new chunks to the temp file.
 // - When the transaction is finished:
-//   - Read the rest of the original file's data into buffers.
-//   - Rewind the temp file and merge the new data into buffers.
-//   - Process buffers for deletions and apply subs.
-//   - Rewind and write the buffers out to temp file.
+//   - Verify the original file's checksum and read its full hashes.
+//   - Rewind the temp file and collect the new prefixes into sorted
+//     runs, spilling them to a scratch file if there are many.  The
+//     new full hashes are read into buffers.
+//   - Merge the original file's prefixes with the new runs, applying
+//     subs and deletions as they stream by.  Remaining subs go to a
+//     scratch file, as the adds must be written out first.
+//   - Process the full hashes for deletions and subbed adds.
+//   - Rewind and write the results out to temp file.
 //   - Delete original file.
 //   - Rename temp file to original filename.
+//
+// Memory use is bounded by the add prefixes, which are returned to the
+// caller, plus the full hashes and a run of new prefixes.
 
 // TODO(shess): By using a checksum, this code can avoid doing an
 // fsync(), at the possible cost of more frequently retrieving the
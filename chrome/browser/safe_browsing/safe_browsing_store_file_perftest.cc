@@ -0,0 +1,127 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Times updates of a Safe Browsing store the size of a full malware
+// list, and logs how far they push up the peak working set:
+//   $ ./perf_tests --gtest_filter=SafeBrowsingStoreFilePerfTest.*
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/perftimer.h"
+#include "base/process_util.h"
+#include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// About the size of the malware list.
+const int kAddChunkCount = 400;
+const int kPrefixesPerChunk = 1600;
+// The incremental update adds some chunks and subs some prefixes.
+const int kUpdateChunkCount = 20;
+const int kSubsPerChunk = 400;
+
+// A deterministic source of prefixes, so that every run stores the
+// same list.
+class Generator {
+ public:
+  Generator() : state_(12345) {}
+
+  SBPrefix Next() {
+    state_ = state_ * 1103515245 + 12345;
+    return static_cast<SBPrefix>(state_ ^ (state_ >> 16));
+  }
+
+ private:
+  uint32 state_;
+};
+
+size_t PeakWorkingSetSize() {
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+  return metrics->GetPeakWorkingSetSize();
+}
+
+class SafeBrowsingStoreFilePerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    store_.reset(new SafeBrowsingStoreFile);
+    store_->Init(temp_dir_.path().AppendASCII("SafeBrowsingTestStore"),
+                 NULL);
+  }
+
+  // Writes |count| add chunks from |first_chunk_id| and, if |subs|,
+  // as many sub chunks which sub some of the prefixes of the chunks
+  // before.  The generators are shared so that the subs match.
+  void WriteChunks(int32 first_chunk_id, int count, bool subs) {
+    for (int32 chunk_id = first_chunk_id;
+         chunk_id < first_chunk_id + count; ++chunk_id) {
+      ASSERT_TRUE(store_->BeginChunk());
+      store_->SetAddChunk(chunk_id);
+      for (int i = 0; i < kPrefixesPerChunk; ++i)
+        ASSERT_TRUE(store_->WriteAddPrefix(chunk_id, add_generator_.Next()));
+      ASSERT_TRUE(store_->FinishChunk());
+
+      if (!subs)
+        continue;
+      const int32 add_chunk_id = chunk_id - first_chunk_id + 1;
+      Generator sub_generator;
+      ASSERT_TRUE(store_->BeginChunk());
+      store_->SetSubChunk(chunk_id);
+      for (int i = 0; i < kPrefixesPerChunk * add_chunk_id; ++i) {
+        const SBPrefix prefix = sub_generator.Next();
+        if (i >= kPrefixesPerChunk * (add_chunk_id - 1) &&
+            i % (kPrefixesPerChunk / kSubsPerChunk) == 0)
+          ASSERT_TRUE(store_->WriteSubPrefix(chunk_id, add_chunk_id, prefix));
+      }
+      ASSERT_TRUE(store_->FinishChunk());
+    }
+  }
+
+  // Finishes the update, logging its time and growth of the peak
+  // working set under |name|.
+  void FinishUpdate(const std::string& name, size_t expected_count) {
+    std::vector<SBAddFullHash> pending_adds;
+    std::set<SBPrefix> prefix_misses;
+    std::vector<SBAddPrefix> add_prefixes;
+    std::vector<SBAddFullHash> add_hashes;
+    const size_t peak_before = PeakWorkingSetSize();
+    PerfTimeLogger timer(name.c_str());
+    ASSERT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                     &add_prefixes, &add_hashes));
+    timer.Done();
+    const size_t peak_after = PeakWorkingSetSize();
+    LogPerfResult((name + "_peak_memory").c_str(),
+                  static_cast<double>(peak_after - peak_before) / 1024, "kb");
+    EXPECT_EQ(expected_count, add_prefixes.size());
+  }
+
+  ScopedTempDir temp_dir_;
+  scoped_ptr<SafeBrowsingStoreFile> store_;
+  Generator add_generator_;
+};
+
+}  // namespace
+
+TEST_F(SafeBrowsingStoreFilePerfTest, Update) {
+  // Download the full list.
+  ASSERT_TRUE(store_->BeginUpdate());
+  WriteChunks(1, kAddChunkCount, false);
+  FinishUpdate("SafeBrowsingStoreFile_full_update",
+               kAddChunkCount * kPrefixesPerChunk);
+
+  // Then a typical update, which subs prefixes from the first chunks.
+  ASSERT_TRUE(store_->BeginUpdate());
+  WriteChunks(kAddChunkCount + 1, kUpdateChunkCount, true);
+  FinishUpdate("SafeBrowsingStoreFile_incremental_update",
+               (kAddChunkCount + kUpdateChunkCount) * kPrefixesPerChunk -
+                   kUpdateChunkCount * kSubsPerChunk);
+}
@@ -145,4 +145,83 @@ TEST_F(SafeBrowsingStoreFileTest, DetectsCorruption) {
   EXPECT_TRUE(corruption_detected_);
 }
 
+// Test an update large enough to be merged from spilled runs, with
+// subs knocking out adds from the original file and from other chunks.
+TEST_F(SafeBrowsingStoreFileTest, MergesLargeUpdates) {
+  const int kChunkCount = 8;
+  const SBPrefix kPrefixCount = 40 * 1000;
+  const int32 kSubChunkId = 100;
+  std::vector<SBAddFullHash> pending_adds;
+  std::set<SBPrefix> prefix_misses;
+  std::vector<SBAddPrefix> add_prefixes;
+  std::vector<SBAddFullHash> add_hashes;
+
+  // Start with one add chunk.
+  EXPECT_TRUE(store_->BeginUpdate());
+  EXPECT_TRUE(store_->BeginChunk());
+  store_->SetAddChunk(1);
+  for (SBPrefix prefix = 0; prefix < kPrefixCount; ++prefix)
+    EXPECT_TRUE(store_->WriteAddPrefix(1, prefix * 7));
+  EXPECT_TRUE(store_->FinishChunk());
+  EXPECT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+  EXPECT_EQ(static_cast<size_t>(kPrefixCount), add_prefixes.size());
+
+  // Add more chunks, each written in descending order, and sub every
+  // other prefix of the first two chunks.
+  EXPECT_TRUE(store_->BeginUpdate());
+  for (int32 chunk_id = 2; chunk_id <= kChunkCount; ++chunk_id) {
+    EXPECT_TRUE(store_->BeginChunk());
+    store_->SetAddChunk(chunk_id);
+    for (SBPrefix prefix = kPrefixCount; prefix > 0; --prefix)
+      EXPECT_TRUE(store_->WriteAddPrefix(chunk_id, prefix * 7));
+    EXPECT_TRUE(store_->FinishChunk());
+  }
+  EXPECT_TRUE(store_->BeginChunk());
+  store_->SetSubChunk(kSubChunkId);
+  for (SBPrefix prefix = 0; prefix < kPrefixCount; prefix += 2) {
+    EXPECT_TRUE(store_->WriteSubPrefix(kSubChunkId, 1, prefix * 7));
+    EXPECT_TRUE(store_->WriteSubPrefix(kSubChunkId, 2, (prefix + 1) * 7));
+  }
+  // This one matches nothing, and is kept.
+  EXPECT_TRUE(store_->WriteSubPrefix(kSubChunkId, kChunkCount + 1, 3));
+  EXPECT_TRUE(store_->FinishChunk());
+  EXPECT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+
+  const size_t kExpectedCount =
+      kChunkCount * kPrefixCount - kPrefixCount / 2 - kPrefixCount / 2;
+  EXPECT_EQ(kExpectedCount, add_prefixes.size());
+  for (size_t i = 1; i < add_prefixes.size(); ++i) {
+    ASSERT_TRUE(SBAddPrefixLess(add_prefixes[i - 1], add_prefixes[i]));
+  }
+  EXPECT_EQ(1, add_prefixes[0].chunk_id);
+  EXPECT_EQ(7U, add_prefixes[0].prefix);
+  EXPECT_EQ(2, add_prefixes[kPrefixCount / 2].chunk_id);
+  EXPECT_EQ(14U, add_prefixes[kPrefixCount / 2].prefix);
+
+  // The file holds the same sorted prefixes, and the left-over sub
+  // still knocks out an add which arrives later.
+  std::vector<SBAddPrefix> file_prefixes;
+  EXPECT_TRUE(store_->GetAddPrefixes(&file_prefixes));
+  ASSERT_EQ(add_prefixes.size(), file_prefixes.size());
+  EXPECT_EQ(0, memcmp(&add_prefixes[0], &file_prefixes[0],
+                      add_prefixes.size() * sizeof(SBAddPrefix)));
+
+  EXPECT_TRUE(store_->BeginUpdate());
+  store_->DeleteAddChunk(2);
+  EXPECT_TRUE(store_->BeginChunk());
+  store_->SetAddChunk(kChunkCount + 1);
+  EXPECT_TRUE(store_->WriteAddPrefix(kChunkCount + 1, 3));
+  EXPECT_TRUE(store_->FinishChunk());
+  EXPECT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+  EXPECT_EQ(kExpectedCount - kPrefixCount / 2, add_prefixes.size());
+
+  EXPECT_TRUE(store_->BeginUpdate());
+  EXPECT_FALSE(store_->CheckAddChunk(2));
+  EXPECT_TRUE(store_->CheckAddChunk(kChunkCount + 1));
+  EXPECT_TRUE(store_->CancelUpdate());
+}
+
 }  // namespace
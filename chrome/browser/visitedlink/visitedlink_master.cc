@@ -49,6 +49,12 @@ const unsigned VisitedLinkMaster::kDefaultTableSize = 16381;
 
 const size_t VisitedLinkMaster::kBigDeleteThreshold = 64;
 
+// A new table is grown from below half full to one third full, so it takes
+// at least a sixth of its length in additions to need growing again, while
+// there are half as many slots to move. Moving several times the minimum
+// keeps the file out of date for less time.
+const int32 VisitedLinkMaster::kSlotsToMovePerAdd = 64;
+
 namespace {
 
 // Fills the given salt structure with some quasi-random values
@@ -240,6 +246,8 @@ void VisitedLinkMaster::InitMembers(Listener* listener, Profile* profile) {
   shared_memory_ = NULL;
   shared_memory_serial_ = 0;
   used_items_ = 0;
+  previous_shared_memory_ = NULL;
+  moved_slots_ = 0;
   table_size_override_ = 0;
   history_service_override_ = NULL;
   suppress_rebuild_ = false;
@@ -292,7 +300,15 @@ VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url) {
   if (used_items_ / 8 > table_length_ / 10)
     return null_hash_;  // Table is more than 80% full.
 
-  return AddFingerprint(fingerprint, true);
+  // While the table grows, the fingerprint may not have been moved out of the
+  // previous table yet.
+  if (previous_table_length_ && IsVisited(fingerprint))
+    return null_hash_;
+
+  Hash index = AddFingerprint(fingerprint, true);
+  if (previous_table_length_ && index != null_hash_)
+    return AddFingerprintToPreviousTable(fingerprint);
+  return index;
 }
 
 void VisitedLinkMaster::AddURL(const GURL& url) {
@@ -324,6 +340,7 @@ void VisitedLinkMaster::DeleteAllURLs() {
   deleted_since_rebuild_.clear();
 
   // Clear the hash table.
+  DropPreviousTable();
   used_items_ = 0;
   memset(hash_table_, 0, this->table_length_ * sizeof(Fingerprint));
 
@@ -341,6 +358,14 @@ void VisitedLinkMaster::DeleteURLs(const std::set<GURL>& urls) {
   if (urls.empty())
     return;
 
+  // Deleting from a growing table would mean deleting from the previous table
+  // too, which the renderers are still reading. Deletions are rare, so finish
+  // growing instead.
+  if (previous_table_length_) {
+    FinishMovingFingerprints();
+    WriteFullTable();
+  }
+
   listener_->Reset();
 
   if (table_builder_) {
@@ -501,6 +526,9 @@ bool VisitedLinkMaster::WriteFullTable() {
   // resize the table. We must handle this case and not try to reopen the file,
   // since there may be write operations pending on the file I/O thread.
   //
+  // A table which is still growing is finished first, so that the current
+  // table holds every fingerprint.
+  //
   // Note that once we start writing, we do not delete on error. This means
   // there can be a partial file, but the short file will be detected next time
   // we start, and will be replaced.
@@ -509,6 +537,8 @@ bool VisitedLinkMaster::WriteFullTable() {
   // We should pick up the most common types of these failures when we notice
   // that the file size is different when we load it back in, and then we will
   // regenerate the table.
+  FinishMovingFingerprints();
+
   if (!file_) {
     FilePath filename;
     GetDatabaseFileName(&filename);
@@ -680,10 +710,10 @@ bool VisitedLinkMaster::CreateURLTable(int32 num_entries, bool init_to_empty) {
     return false;
   }
 
-  if (init_to_empty) {
-    memset(shared_memory_->memory(), 0, alloc_size);
+  // New shared memory is zero-filled, so an empty table costs nothing until
+  // its pages are used.
+  if (init_to_empty)
     used_items_ = 0;
-  }
   table_length_ = num_entries;
 
   // Save the header for other processes to read.
@@ -718,6 +748,13 @@ bool VisitedLinkMaster::BeginReplaceURLTable(int32 num_entries) {
 }
 
 void VisitedLinkMaster::FreeURLTable() {
+  if (previous_shared_memory_) {
+    delete previous_shared_memory_;
+    previous_shared_memory_ = NULL;
+    previous_hash_table_ = NULL;
+    previous_table_length_ = 0;
+    moved_slots_ = 0;
+  }
   if (shared_memory_) {
     delete shared_memory_;
     shared_memory_ = NULL;
@@ -732,6 +769,11 @@ void VisitedLinkMaster::FreeURLTable() {
 bool VisitedLinkMaster::ResizeTableIfNecessary() {
   DCHECK(table_length_ > 0) << "Must have a table";
 
+  // A growing table moves some more fingerprints over with each addition, and
+  // is written out once they have all been moved.
+  if (previous_table_length_ && MoveFingerprints(kSlotsToMovePerAdd))
+    WriteFullTable();
+
   // Load limits for good performance/space. We are pretty conservative about
   // keeping the table not very full. This is because we use linear probing
   // which increases the likelihood of clumps of entries which will reduce
@@ -749,12 +791,16 @@ bool VisitedLinkMaster::ResizeTableIfNecessary() {
   int new_size = NewTableSizeForCount(used_items_);
   DCHECK(new_size > used_items_);
   DCHECK(load <= min_table_load || new_size > table_length_);
-  ResizeTable(new_size);
+  if (new_size > table_length_)
+    GrowTable(new_size);
+  else
+    ResizeTable(new_size);
   return true;
 }
 
 void VisitedLinkMaster::ResizeTable(int32 new_size) {
   DCHECK(shared_memory_ && shared_memory_->memory() && hash_table_);
+  FinishMovingFingerprints();
   shared_memory_serial_++;
 
 #ifndef NDEBUG
@@ -791,6 +837,108 @@ void VisitedLinkMaster::ResizeTable(int32 new_size) {
   WriteFullTable();
 }
 
+void VisitedLinkMaster::GrowTable(int32 new_size) {
+  DCHECK(shared_memory_ && shared_memory_->memory() && hash_table_);
+  // The previous growth should be long done; if not, finish it now.
+  FinishMovingFingerprints();
+  shared_memory_serial_++;
+
+#ifndef NDEBUG
+  DebugValidate();
+#endif
+
+  base::SharedMemory* old_shared_memory = shared_memory_;
+  Fingerprint* old_hash_table = hash_table_;
+  int32 old_table_length = table_length_;
+  int32 used_items = used_items_;
+  if (!BeginReplaceURLTable(new_size)) {
+    used_items_ = used_items;
+    return;
+  }
+
+  // Nothing is moved now, so that the cost of growing the table is spread over
+  // the following additions. Child processes keep the old table until then,
+  // and so does the file, so it is kept as the previous table and still gets
+  // every addition.
+  previous_shared_memory_ = old_shared_memory;
+  previous_hash_table_ = old_hash_table;
+  previous_table_length_ = old_table_length;
+  moved_slots_ = 0;
+  used_items_ = used_items;
+
+#ifndef NDEBUG
+  DebugValidate();
+#endif
+}
+
+// See AddFingerprint, which this follows for the previous table.
+VisitedLinkMaster::Hash VisitedLinkMaster::AddFingerprintToPreviousTable(
+    Fingerprint fingerprint) {
+  DCHECK(previous_table_length_);
+  Hash cur_hash = HashFingerprint(fingerprint, previous_table_length_);
+  Hash first_hash = cur_hash;
+  while (true) {
+    Fingerprint cur_fingerprint = previous_hash_table_[cur_hash];
+    if (cur_fingerprint == fingerprint)
+      return null_hash_;
+
+    if (cur_fingerprint == null_fingerprint_) {
+      // The item count already includes it, from the current table.
+      previous_hash_table_[cur_hash] = fingerprint;
+      return cur_hash;
+    }
+
+    cur_hash++;
+    if (cur_hash == previous_table_length_)
+      cur_hash = 0;
+    if (cur_hash == first_hash) {
+      NOTREACHED();
+      return null_hash_;
+    }
+  }
+}
+
+bool VisitedLinkMaster::MoveFingerprints(int32 slot_count) {
+  DCHECK(previous_table_length_);
+  int32 end = std::min(previous_table_length_, moved_slots_ + slot_count);
+  for (; moved_slots_ < end; moved_slots_++) {
+    Fingerprint fingerprint = previous_hash_table_[moved_slots_];
+    if (fingerprint == null_fingerprint_)
+      continue;
+
+    // The fingerprint has been counted already. This balances the increment
+    // of this value in AddFingerprint, unless it was added to both tables
+    // while the table grew, in which case there is nothing to move.
+    if (AddFingerprint(fingerprint, false) != null_hash_)
+      used_items_--;
+  }
+  if (moved_slots_ < previous_table_length_)
+    return false;
+
+  DropPreviousTable();
+  return true;
+}
+
+void VisitedLinkMaster::FinishMovingFingerprints() {
+  if (previous_table_length_)
+    MoveFingerprints(previous_table_length_);
+}
+
+void VisitedLinkMaster::DropPreviousTable() {
+  if (!previous_shared_memory_)
+    return;
+
+  delete previous_shared_memory_;
+  previous_shared_memory_ = NULL;
+  previous_hash_table_ = NULL;
+  previous_table_length_ = 0;
+  moved_slots_ = 0;
+
+  // Send an update notification to all child processes so they read the new
+  // table.
+  listener_->NewTable(shared_memory_);
+}
+
 uint32 VisitedLinkMaster::NewTableSizeForCount(int32 item_count) const {
   // These table sizes are selected to be the maximum prime number less than
   // a "convenient" multiple of 1K.
@@ -864,6 +1012,8 @@ void VisitedLinkMaster::OnTableRebuildComplete(
 
     int new_table_size = NewTableSizeForCount(
         static_cast<int>(fingerprints.size() + added_since_rebuild_.size()));
+    // A table still growing is replaced along with the previous one.
+    DropPreviousTable();
     if (BeginReplaceURLTable(new_table_size)) {
       // Free the old table.
       delete old_shared_memory;
@@ -917,25 +1067,36 @@ void VisitedLinkMaster::WriteToFile(FILE* file,
 void VisitedLinkMaster::WriteUsedItemCountToFile() {
   if (!file_)
     return;  // See comment on the file_ variable for why this might happen.
+  // While the table grows, this is also the count of the previous table.
   WriteToFile(file_, kFileHeaderUsedOffset, &used_items_, sizeof(used_items_));
 }
 
 void VisitedLinkMaster::WriteHashRangeToFile(Hash first_hash, Hash last_hash) {
   if (!file_)
     return;  // See comment on the file_ variable for why this might happen.
+
+  // While the table grows, the file holds the previous table until the
+  // current one is done.
+  Fingerprint* table = hash_table_;
+  int32 table_length = table_length_;
+  if (previous_table_length_) {
+    table = previous_hash_table_;
+    table_length = previous_table_length_;
+  }
+
   if (last_hash < first_hash) {
     // Handle wraparound at 0. This first write is first_hash->EOF
     WriteToFile(file_, first_hash * sizeof(Fingerprint) + kFileHeaderSize,
-                &hash_table_[first_hash],
-                (table_length_ - first_hash + 1) * sizeof(Fingerprint));
+                &table[first_hash],
+                (table_length - first_hash) * sizeof(Fingerprint));
 
     // Now do 0->last_lash.
-    WriteToFile(file_, kFileHeaderSize, hash_table_,
+    WriteToFile(file_, kFileHeaderSize, table,
                 (last_hash + 1) * sizeof(Fingerprint));
   } else {
     // Normal case, just write the range.
     WriteToFile(file_, first_hash * sizeof(Fingerprint) + kFileHeaderSize,
-                &hash_table_[first_hash],
+                &table[first_hash],
                 (last_hash - first_hash + 1) * sizeof(Fingerprint));
   }
 }
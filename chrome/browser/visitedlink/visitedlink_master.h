@@ -28,6 +28,12 @@ class Profile;
 // This class will defer writing operations to the file thread. This means that
 // class destruction, the file may still be open since operations are pending on
 // another thread.
+//
+// The table grows incrementally so that no single addition pays for rehashing
+// every fingerprint: each addition following GrowTable moves a few slots' worth
+// of fingerprints from the previous table into the new one. Until they have
+// all been moved, the previous table is what the listener and the file have,
+// and it gets every addition too.
 class VisitedLinkMaster : public VisitedLinkCommon {
  public:
   // Listens to the link coloring database events. The master is given this
@@ -123,6 +129,7 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, Delete);
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, BigDelete);
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, BigImport);
+  FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, IncrementalResize);
 
   // Object to rebuild the table on the history thread (see the .cc file).
   class TableBuilder;
@@ -151,12 +158,18 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // we will write the whole table to disk at once instead of individual items.
   static const size_t kBigDeleteThreshold;
 
+  // While the table grows, each addition moves the fingerprints in this many
+  // slots of the previous table into the new one. This must be enough to
+  // finish before the new table needs to grow again.
+  static const int32 kSlotsToMovePerAdd;
+
   // Backend for the constructors initializing the members.
   void InitMembers(Listener* listener, Profile* profile);
 
   // If a rebuild is in progress, we save the URL in the temporary list.
   // Otherwise, we add this to the table. Returns the index of the
-  // inserted fingerprint or null_hash_ on failure.
+  // inserted fingerprint or null_hash_ on failure. While the table grows, the
+  // index is into the previous table, which is the one in the file.
   Hash TryToAddURL(const GURL& url);
 
   // File I/O functions
@@ -249,15 +262,40 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // unallocates the Fingerprint table
   void FreeURLTable();
 
-  // For growing the table. ResizeTableIfNecessary will check to see if the
-  // table should be resized and calls ResizeTable if needed. Returns true if
-  // we decided to resize the table.
+  // For growing the table. ResizeTableIfNecessary will move some more
+  // fingerprints over if the table is growing, then check to see if the
+  // table should be resized and calls GrowTable or ResizeTable if needed.
+  // Returns true if we decided to resize the table.
   bool ResizeTableIfNecessary();
 
   // Resizes the table (growing or shrinking) as necessary to accomodate the
-  // current count.
+  // current count, rehashing every fingerprint at once and writing the new
+  // table to disk.
   void ResizeTable(int32 new_size);
 
+  // Starts growing the table to |new_size|. The current table becomes the
+  // previous one, which is kept until MoveFingerprints has moved all of its
+  // fingerprints into the new one. The listener is only given the new table
+  // then.
+  void GrowTable(int32 new_size);
+
+  // Adds the fingerprint to the previous table while the table grows, since
+  // that is the table the listener and the file have. Returns the index of
+  // the fingerprint in it, or null_hash_ if it was not added.
+  Hash AddFingerprintToPreviousTable(Fingerprint fingerprint);
+
+  // Moves the fingerprints in the next |slot_count| slots of the previous
+  // table into the current one. Returns true once the table is done growing,
+  // at which point the caller should write it to disk.
+  bool MoveFingerprints(int32 slot_count);
+
+  // Moves whatever is left of the previous table, if the table is growing.
+  void FinishMovingFingerprints();
+
+  // Frees the previous table, if the table is growing, and gives the current
+  // one to the listener.
+  void DropPreviousTable();
+
   // Returns the desired table size for |item_count| URLs.
   uint32 NewTableSizeForCount(int32 item_count) const;
 
@@ -338,9 +376,17 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // shared memory object.
   int32 shared_memory_serial_;
 
-  // Number of non-empty items in the table, used to compute fullness.
+  // Number of non-empty items in the table, used to compute fullness. While
+  // the table grows, this includes the fingerprints not moved yet, and is the
+  // number of items in the previous table.
   int32 used_items_;
 
+  // While the table grows, the shared memory holding the previous table (see
+  // previous_hash_table_), and how many of its slots have been moved into the
+  // current one. NULL and zero otherwise.
+  base::SharedMemory* previous_shared_memory_;
+  int32 moved_slots_;
+
   // Testing values -----------------------------------------------------------
   //
   // The following fields exist for testing purposes. They are not used in
@@ -381,6 +427,13 @@ inline void VisitedLinkMaster::DebugValidate() {
     if (hash_table_[i])
       used_count++;
   }
+  // The fingerprints which haven't been moved out of the previous table yet
+  // are not in the current one, unless they were added while it grew.
+  for (int32 i = moved_slots_; i < previous_table_length_; i++) {
+    Fingerprint fingerprint = previous_hash_table_[i];
+    if (fingerprint && !IsInTable(fingerprint, hash_table_, table_length_))
+      used_count++;
+  }
   DCHECK_EQ(used_count, used_items_);
 }
 #endif
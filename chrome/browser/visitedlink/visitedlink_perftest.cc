@@ -12,10 +12,12 @@
 #include "base/shared_memory.h"
 #include "base/string_util.h"
 #include "base/test/test_file_util.h"
+#include "base/time.h"
 #include "chrome/browser/visitedlink/visitedlink_master.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 using base::TimeDelta;
+using base::TimeTicks;
 
 namespace {
 
@@ -44,6 +46,25 @@ class DummyVisitedLinkEventListener : public VisitedLinkMaster::Listener {
   }
 };
 
+// Counts the tables the master hands out. Each one is mapped by every
+// renderer, so it is the cost of growing the table that they see.
+class TableCountingListener : public VisitedLinkMaster::Listener {
+ public:
+  TableCountingListener() : table_count_(0), table_bytes_(0) {}
+  virtual void NewTable(base::SharedMemory* table) {
+    table_count_++;
+    table_bytes_ += table->created_size();
+  }
+  virtual void Add(VisitedLinkCommon::Fingerprint) {}
+  virtual void Reset() {}
+
+  int table_count() const { return table_count_; }
+  int64 table_bytes() const { return table_bytes_; }
+
+ private:
+  int table_count_;
+  int64 table_bytes_;
+};
 
 // this checks IsVisited for the URLs starting with the given prefix and
 // within the given range
@@ -195,3 +216,49 @@ TEST_F(VisitedLink, TestLoad) {
   LogPerfResult("Visited_link_hot_load_time",
                 hot_sum / hot_load_times.size(), "ms");
 }
+
+// Times each URL added to a table which grows from the default size, and the
+// lookups made along the way. The longest addition is the pause the user
+// could notice.
+TEST_F(VisitedLink, TestAddLatency) {
+  TableCountingListener listener;
+  VisitedLinkMaster master(&listener, NULL, true, db_path_, 0);
+  ASSERT_TRUE(master.Init());
+
+  std::vector<GURL> urls;
+  for (int i = 0; i < load_test_add_count; i++)
+    urls.push_back(TestURL(added_prefix, i));
+
+  TimeDelta total_add_time;
+  TimeDelta max_add_time;
+  TimeDelta query_time;
+  for (int i = 0; i < load_test_add_count; i++) {
+    TimeTicks start = TimeTicks::Now();
+    master.AddURL(urls[i]);
+    TimeDelta elapsed = TimeTicks::Now() - start;
+    total_add_time += elapsed;
+    max_add_time = std::max(max_add_time, elapsed);
+
+    // Look up a few of the URLs added so far, whichever table they are in.
+    if (i % 64 == 0) {
+      start = TimeTicks::Now();
+      for (int j = 0; j <= i; j += i / 16 + 1)
+        EXPECT_TRUE(master.IsVisited(urls[j]));
+      EXPECT_FALSE(master.IsVisited(TestURL(unadded_prefix, i)));
+      query_time += TimeTicks::Now() - start;
+    }
+  }
+  EXPECT_EQ(load_test_add_count, master.GetUsedCount());
+  master.DebugValidate();
+
+  LogPerfResult("Visited_link_add_max_time", max_add_time.InMillisecondsF(),
+                "ms");
+  LogPerfResult("Visited_link_add_mean_time",
+                total_add_time.InMillisecondsF() * 1000 / load_test_add_count,
+                "us");
+  LogPerfResult("Visited_link_query_while_growing_time",
+                query_time.InMillisecondsF(), "ms");
+  LogPerfResult("Visited_link_new_tables", listener.table_count(), "tables");
+  LogPerfResult("Visited_link_new_table_size",
+                static_cast<double>(listener.table_bytes()) / 1024, "kb");
+}
@@ -43,9 +43,11 @@ class TrackingVisitedLinkEventListener : public VisitedLinkMaster::Listener {
  public:
   TrackingVisitedLinkEventListener()
       : reset_count_(0),
-        add_count_(0) {}
+        add_count_(0),
+        new_table_count_(0) {}
 
   virtual void NewTable(base::SharedMemory* table) {
+    new_table_count_++;
     if (table) {
       for (std::vector<VisitedLinkSlave>::size_type i = 0;
            i < g_slaves.size(); i++) {
@@ -61,14 +63,17 @@ class TrackingVisitedLinkEventListener : public VisitedLinkMaster::Listener {
   void SetUp() {
     reset_count_ = 0;
     add_count_ = 0;
+    new_table_count_ = 0;
   }
 
   int reset_count() const { return reset_count_; }
   int add_count() const { return add_count_; }
+  int new_table_count() const { return new_table_count_; }
 
  private:
   int reset_count_;
   int add_count_;
+  int new_table_count_;
 };
 
 class VisitedLinkTest : public testing::Test {
@@ -363,6 +368,54 @@ TEST_F(VisitedLinkTest, Resizing) {
   Reload();
 }
 
+// Tests that URLs stay visited while the table grows, when the fingerprints
+// are split between the new table and the previous one, that child processes
+// only get the new table once it is done, and that the file stays up to date.
+TEST_F(VisitedLinkTest, IncrementalResize) {
+  ASSERT_TRUE(InitHistory());
+  ASSERT_TRUE(InitVisited(0, true));
+
+  // Fill the table past half full, which starts it growing, and stop before
+  // all of the fingerprints have been moved.
+  const int total_count = VisitedLinkMaster::kDefaultTableSize / 2 + 100;
+  for (int i = 0; i < total_count; i++) {
+    master_->AddURL(TestURL(i));
+    ASSERT_EQ(i + 1, master_->GetUsedCount());
+  }
+  for (int i = 0; i < total_count; i++)
+    EXPECT_TRUE(master_->IsVisited(TestURL(i)));
+  master_->DebugValidate();
+  EXPECT_EQ(0, listener_.new_table_count());
+
+  // The file has every URL added while the table grew.
+  ClearDB();
+  ASSERT_TRUE(InitHistory());
+  ASSERT_TRUE(InitVisited(0, true));
+  EXPECT_EQ(total_count, master_->GetUsedCount());
+  for (int i = 0; i < total_count; i++)
+    EXPECT_TRUE(master_->IsVisited(TestURL(i)));
+
+  // The reloaded table is over half full, so the next addition grows it
+  // again. Deleting finishes growing the table first.
+  master_->AddURL(TestURL(total_count));
+  EXPECT_EQ(0, listener_.new_table_count());
+  std::set<GURL> deleted_urls;
+  deleted_urls.insert(TestURL(0));
+  master_->DeleteURLs(deleted_urls);
+  EXPECT_EQ(1, listener_.new_table_count());
+  EXPECT_FALSE(master_->IsVisited(TestURL(0)));
+  for (int i = 1; i <= total_count; i++)
+    EXPECT_TRUE(master_->IsVisited(TestURL(i)));
+  master_->DebugValidate();
+
+  ClearDB();
+  ASSERT_TRUE(InitHistory());
+  ASSERT_TRUE(InitVisited(0, true));
+  EXPECT_EQ(total_count, master_->GetUsedCount());
+  for (int i = 1; i <= total_count; i++)
+    EXPECT_TRUE(master_->IsVisited(TestURL(i)));
+}
+
 // Tests that if the database doesn't exist, it will be rebuilt from history.
 TEST_F(VisitedLinkTest, Rebuild) {
   ASSERT_TRUE(InitHistory());
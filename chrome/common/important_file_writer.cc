@@ -6,13 +6,21 @@
 
 #include <stdio.h>
 
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "base/file_path.h"
 #include "base/file_util.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/md5.h"
 #include "base/message_loop_proxy.h"
+#include "base/metrics/histogram.h"
+#include "base/platform_file.h"
 #include "base/string_number_conversions.h"
+#include "base/synchronization/lock.h"
 #include "base/task.h"
 #include "base/threading/thread.h"
 #include "base/time.h"
@@ -23,67 +31,350 @@ namespace {
 
 const int kDefaultCommitIntervalMs = 10000;
 
-class WriteToDiskTask : public Task {
+// The delta log starts with a header holding kDeltaLogMagic and the MD5 of
+// the file content it applies to.  Each record is then stored as its
+// length, its MD5 and its bytes.
+const uint32 kDeltaLogMagic = 0x49464c31;  // "IFL1"
+const size_t kDeltaLogHeaderSize = sizeof(uint32) + sizeof(MD5Digest);
+const size_t kDeltaRecordHeaderSize = sizeof(uint32) + sizeof(MD5Digest);
+
+void LogFailure(const FilePath& path, const std::string& message) {
+  PLOG(WARNING) << "failed to write " << path.value()
+                << ": " << message;
+}
+
+// Writes |data| at |offset| in |file| and flushes it to disk.
+bool WriteAndFlush(base::PlatformFile file, int64 offset,
+                   const std::string& data) {
+  int bytes_written = base::WritePlatformFile(file, offset, data.data(),
+                                              data.size());
+  if (bytes_written < 0 || static_cast<size_t>(bytes_written) < data.size())
+    return false;
+  return base::FlushPlatformFile(file);
+}
+
+void AppendUint32AndDigest(uint32 value, const MD5Digest& digest,
+                           std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+  out->append(reinterpret_cast<const char*>(digest.a), sizeof(digest.a));
+}
+
+std::string DeltaLogHeader(const std::string& data) {
+  MD5Digest digest;
+  MD5Sum(data.data(), data.size(), &digest);
+  std::string header;
+  AppendUint32AndDigest(kDeltaLogMagic, digest, &header);
+  return header;
+}
+
+std::string DeltaRecord(const std::string& delta) {
+  MD5Digest digest;
+  MD5Sum(delta.data(), delta.size(), &digest);
+  std::string record;
+  AppendUint32AndDigest(static_cast<uint32>(delta.size()), digest, &record);
+  record.append(delta);
+  return record;
+}
+
+// A write handed to the file thread.
+struct PendingWrite {
+  PendingWrite(const FilePath& path, const std::string& data, bool is_delta,
+               bool has_delta_log)
+      : path(path),
+        data(data),
+        is_delta(is_delta),
+        has_delta_log(has_delta_log) {
+  }
+
+  FilePath path;
+  // The whole file content, or a delta record.
+  std::string data;
+  bool is_delta;
+  // For full writes: whether to start a new delta log for |data|.
+  bool has_delta_log;
+};
+
+// Writes the temporary file for a full write of |write|.  Returns the
+// temporary path, or an empty path on failure.
+FilePath WriteTemporaryFile(const PendingWrite& write) {
+  // Ensure that the temp file is on the same volume as target file, so it
+  // can be moved in one step, and that the temp file is securely created.
+  FilePath tmp_file_path;
+  if (!file_util::CreateTemporaryFileInDir(write.path.DirName(),
+                                           &tmp_file_path)) {
+    LogFailure(write.path, "could not create temporary file");
+    return FilePath();
+  }
+
+  base::PlatformFile tmp_file = base::CreatePlatformFile(
+      tmp_file_path,
+      base::PLATFORM_FILE_OPEN | base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  if (tmp_file == base::kInvalidPlatformFileValue) {
+    LogFailure(write.path, "could not open temporary file");
+    file_util::Delete(tmp_file_path, false);
+    return FilePath();
+  }
+
+  bool written = WriteAndFlush(tmp_file, 0, write.data);
+  if (!base::ClosePlatformFile(tmp_file)) {
+    LogFailure(write.path, "failed to close temporary file");
+    file_util::Delete(tmp_file_path, false);
+    return FilePath();
+  }
+  if (!written) {
+    LogFailure(write.path, "error writing temporary file");
+    file_util::Delete(tmp_file_path, false);
+    return FilePath();
+  }
+  return tmp_file_path;
+}
+
+// Appends |records| to the delta log of |path| and flushes it once.  On
+// failure, cuts off whatever part of |records| made it to the log, so that
+// the log ends with a whole record.
+bool AppendToDeltaLog(const FilePath& path, const std::string& records) {
+  FilePath log_path = ImportantFileWriter::GetDeltaLogPath(path);
+  base::PlatformFile log_file = base::CreatePlatformFile(
+      log_path, base::PLATFORM_FILE_OPEN | base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  if (log_file == base::kInvalidPlatformFileValue) {
+    // The log is started by every full write, so it's only missing if that
+    // failed.  Its records would be relative to a file we don't have.
+    LogFailure(log_path, "delta log is missing");
+    return false;
+  }
+  base::PlatformFileInfo info;
+  if (!base::GetPlatformFileInfo(log_file, &info)) {
+    base::ClosePlatformFile(log_file);
+    LogFailure(log_path, "could not read delta log size");
+    return false;
+  }
+  bool appended = WriteAndFlush(log_file, info.size, records);
+  if (!appended) {
+    LogFailure(log_path, "could not append to delta log");
+    if (!base::TruncatePlatformFile(log_file, info.size) ||
+        !base::FlushPlatformFile(log_file))
+      LogFailure(log_path, "could not truncate delta log");
+  }
+  base::ClosePlatformFile(log_file);
+  return appended;
+}
+
+// Starts a new delta log for |data|, the new content of |path|.  Returns
+// false, leaving no log behind, on failure.
+bool StartDeltaLog(const FilePath& path, const std::string& data) {
+  FilePath log_path = ImportantFileWriter::GetDeltaLogPath(path);
+  base::PlatformFile log_file = base::CreatePlatformFile(
+      log_path,
+      base::PLATFORM_FILE_CREATE_ALWAYS | base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  if (log_file == base::kInvalidPlatformFileValue) {
+    LogFailure(log_path, "could not create delta log");
+    return false;
+  }
+  bool started = WriteAndFlush(log_file, 0, DeltaLogHeader(data));
+  base::ClosePlatformFile(log_file);
+  if (!started) {
+    LogFailure(log_path, "could not write delta log header");
+    file_util::Delete(log_path, false);
+  }
+  return started;
+}
+
+// Commits the writes posted to a file thread as a group.  The first write
+// added while a thread has none pending posts the task which commits them;
+// writes added before that task runs join its group.
+//
+// Also keeps track of the files whose last write failed.  Their deltas are
+// dropped, as they would be relative to changes which didn't make it to
+// disk, until the next full write.
+class WriteQueue {
  public:
-  WriteToDiskTask(const FilePath& path, const std::string& data)
-      : path_(path),
-        data_(data) {
+  WriteQueue() {}
+
+  // Returns true if the caller must post a task calling Commit(|proxy|) to
+  // |proxy|.
+  bool Add(base::MessageLoopProxy* proxy, const PendingWrite& write) {
+    base::AutoLock lock(lock_);
+    std::vector<PendingWrite>& writes = pending_writes_[proxy];
+    writes.push_back(write);
+    return writes.size() == 1;
   }
 
-  virtual void Run() {
-    // Write the data to a temp file then rename to avoid data loss if we crash
-    // while writing the file. Ensure that the temp file is on the same volume
-    // as target file, so it can be moved in one step, and that the temp file
-    // is securely created.
-    FilePath tmp_file_path;
-    FILE* tmp_file = file_util::CreateAndOpenTemporaryFileInDir(
-        path_.DirName(), &tmp_file_path);
-    if (!tmp_file) {
-      LogFailure("could not create temporary file");
-      return;
+  // Returns true if |path| must be written in full before deltas can be
+  // logged for it again.
+  bool NeedsFullWrite(const FilePath& path) {
+    base::AutoLock lock(lock_);
+    return needs_full_write_.count(path) != 0;
+  }
+
+  void Commit(base::MessageLoopProxy* proxy) {
+    std::vector<PendingWrite> writes;
+    {
+      base::AutoLock lock(lock_);
+      PendingWritesMap::iterator it = pending_writes_.find(proxy);
+      if (it == pending_writes_.end())
+        return;
+      writes.swap(it->second);
+      pending_writes_.erase(it);
     }
+    CommitWrites(writes);
+  }
 
-    size_t bytes_written = fwrite(data_.data(), 1, data_.length(), tmp_file);
-    if (!file_util::CloseFile(tmp_file)) {
-      LogFailure("failed to close temporary file");
-      file_util::Delete(tmp_file_path, false);
-      return;
+ private:
+  typedef std::map<base::MessageLoopProxy*, std::vector<PendingWrite> >
+      PendingWritesMap;
+
+  void SetNeedsFullWrite(const FilePath& path, bool needs_full_write) {
+    base::AutoLock lock(lock_);
+    if (needs_full_write)
+      needs_full_write_.insert(path);
+    else
+      needs_full_write_.erase(path);
+  }
+
+  void CommitWrites(const std::vector<PendingWrite>& writes) {
+    // A full write of a file supersedes everything queued before it for
+    // the same file.
+    std::map<FilePath, size_t> last_full_write;
+    for (size_t i = 0; i < writes.size(); ++i) {
+      if (!writes[i].is_delta)
+        last_full_write[writes[i].path] = i;
     }
-    if (bytes_written < data_.length()) {
-      LogFailure("error writing, bytes_written=" +
-                 base::Uint64ToString(bytes_written));
-      file_util::Delete(tmp_file_path, false);
-      return;
+
+    // Write and flush all of the temporary files first, so that the
+    // flushes of the whole group happen back to back...
+    std::vector<FilePath> tmp_file_paths(writes.size());
+    int64 bytes_written = 0;
+    int files_written = 0;
+    for (size_t i = 0; i < writes.size(); ++i) {
+      if (writes[i].is_delta || last_full_write[writes[i].path] != i)
+        continue;
+      tmp_file_paths[i] = WriteTemporaryFile(writes[i]);
+      if (!tmp_file_paths[i].empty()) {
+        bytes_written += writes[i].data.size();
+        UMA_HISTOGRAM_COUNTS("ImportantFile.FullWriteBytes",
+                             writes[i].data.size());
+      }
     }
 
-    if (!file_util::ReplaceFile(tmp_file_path, path_)) {
-      LogFailure("could not rename temporary file");
-      file_util::Delete(tmp_file_path, false);
-      return;
+    // ... then move them into place.  Deltas queued after a full write of
+    // their file are logged after the log was restarted for it, and are
+    // dropped if that write failed.
+    for (size_t i = 0; i < writes.size(); ++i) {
+      const PendingWrite& write = writes[i];
+      std::map<FilePath, size_t>::const_iterator full_write =
+          last_full_write.find(write.path);
+      if (!write.is_delta) {
+        if (full_write->second != i)
+          continue;
+        bool written = !tmp_file_paths[i].empty();
+        if (written && !file_util::ReplaceFile(tmp_file_paths[i],
+                                               write.path)) {
+          LogFailure(write.path, "could not rename temporary file");
+          file_util::Delete(tmp_file_paths[i], false);
+          written = false;
+        }
+        if (written) {
+          files_written++;
+          SetNeedsFullWrite(write.path, write.has_delta_log &&
+                                        !StartDeltaLog(write.path, write.data));
+        } else {
+          // Any existing log doesn't match what the serializer's deltas
+          // will be relative to.
+          file_util::Delete(ImportantFileWriter::GetDeltaLogPath(write.path),
+                            false);
+          SetNeedsFullWrite(write.path, true);
+        }
+      }
     }
+
+    // Append the deltas of each file in one go.
+    std::map<FilePath, std::string> delta_records;
+    for (size_t i = 0; i < writes.size(); ++i) {
+      const PendingWrite& write = writes[i];
+      if (!write.is_delta)
+        continue;
+      std::map<FilePath, size_t>::const_iterator full_write =
+          last_full_write.find(write.path);
+      if (full_write != last_full_write.end() && full_write->second > i)
+        continue;
+      if (NeedsFullWrite(write.path))
+        continue;
+      delta_records[write.path].append(DeltaRecord(write.data));
+    }
+    for (std::map<FilePath, std::string>::const_iterator it =
+             delta_records.begin(); it != delta_records.end(); ++it) {
+      if (AppendToDeltaLog(it->first, it->second)) {
+        bytes_written += it->second.size();
+        files_written++;
+        UMA_HISTOGRAM_COUNTS("ImportantFile.DeltaWriteBytes",
+                             it->second.size());
+      } else {
+        SetNeedsFullWrite(it->first, true);
+      }
+    }
+
+    UMA_HISTOGRAM_COUNTS("ImportantFile.BytesWrittenPerCommit",
+                         bytes_written);
+    UMA_HISTOGRAM_COUNTS_100("ImportantFile.FilesWrittenPerCommit",
+                             files_written);
   }
 
- private:
-  void LogFailure(const std::string& message) {
-    PLOG(WARNING) << "failed to write " << path_.value()
-                  << ": " << message;
+  base::Lock lock_;
+  PendingWritesMap pending_writes_;
+  std::set<FilePath> needs_full_write_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteQueue);
+};
+
+base::LazyInstance<WriteQueue> g_write_queue(base::LINKER_INITIALIZED);
+
+class CommitWritesTask : public Task {
+ public:
+  explicit CommitWritesTask(base::MessageLoopProxy* proxy)
+      : proxy_(proxy) {
   }
 
-  const FilePath path_;
-  const std::string data_;
+  virtual void Run() {
+    g_write_queue.Get().Commit(proxy_.get());
+  }
 
-  DISALLOW_COPY_AND_ASSIGN(WriteToDiskTask);
+ private:
+  scoped_refptr<base::MessageLoopProxy> proxy_;
+
+  DISALLOW_COPY_AND_ASSIGN(CommitWritesTask);
 };
 
+// Returns the delay until the next multiple of |interval| (counted from the
+// TimeTicks origin), which is never more than |interval| away.  Writers whose
+// intervals divide each other therefore commit in the same window.
+TimeDelta DelayToCommitWindow(const TimeDelta& interval) {
+  int64 interval_us = interval.InMicroseconds();
+  if (interval_us <= 0)
+    return interval;
+  int64 now_us = (base::TimeTicks::Now() - base::TimeTicks()).InMicroseconds();
+  int64 window_us = (now_us / interval_us + 1) * interval_us;
+  return TimeDelta::FromMicroseconds(window_us - now_us);
+}
+
 }  // namespace
 
+bool ImportantFileWriter::DataSerializer::SerializeDelta(std::string* delta) {
+  return false;
+}
+
 ImportantFileWriter::ImportantFileWriter(
     const FilePath& path, base::MessageLoopProxy* file_message_loop_proxy)
         : path_(path),
           file_message_loop_proxy_(file_message_loop_proxy),
           serializer_(NULL),
           commit_interval_(TimeDelta::FromMilliseconds(
-              kDefaultCommitIntervalMs)) {
+              kDefaultCommitIntervalMs)),
+          max_delta_log_size_(0),
+          snapshot_size_(-1),
+          delta_log_size_(0) {
   DCHECK(CalledOnValidThread());
   DCHECK(file_message_loop_proxy_.get());
 }
@@ -106,16 +397,9 @@ void ImportantFileWriter::WriteNow(const std::string& data) {
   if (HasPendingWrite())
     timer_.Stop();
 
-  if (!file_message_loop_proxy_->PostTask(
-      FROM_HERE, new WriteToDiskTask(path_, data))) {
-    // Posting the task to background message loop is not expected
-    // to fail, but if it does, avoid losing data and just hit the disk
-    // on the current thread.
-    NOTREACHED();
-
-    WriteToDiskTask write_task(path_, data);
-    write_task.Run();
-  }
+  PostWrite(data, false);
+  snapshot_size_ = data.size();
+  delta_log_size_ = 0;
 }
 
 void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
@@ -131,13 +415,28 @@ void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
   }
 
   if (!timer_.IsRunning()) {
-    timer_.Start(commit_interval_, this,
+    timer_.Start(DelayToCommitWindow(commit_interval_), this,
                  &ImportantFileWriter::DoScheduledWrite);
   }
 }
 
 void ImportantFileWriter::DoScheduledWrite() {
   DCHECK(serializer_);
+  if (max_delta_log_size_ > 0 && snapshot_size_ >= 0 &&
+      delta_log_size_ <= max_delta_log_size_ &&
+      delta_log_size_ <= snapshot_size_ &&
+      !g_write_queue.Get().NeedsFullWrite(path_)) {
+    std::string delta;
+    if (serializer_->SerializeDelta(&delta)) {
+      if (HasPendingWrite())
+        timer_.Stop();
+      PostWrite(delta, true);
+      delta_log_size_ += kDeltaRecordHeaderSize + delta.size();
+      serializer_ = NULL;
+      return;
+    }
+  }
+
   std::string data;
   if (serializer_->SerializeData(&data)) {
     WriteNow(data);
@@ -147,3 +446,54 @@ void ImportantFileWriter::DoScheduledWrite() {
   }
   serializer_ = NULL;
 }
+
+// static
+FilePath ImportantFileWriter::GetDeltaLogPath(const FilePath& path) {
+  return FilePath(path.value() + FILE_PATH_LITERAL(".log"));
+}
+
+// static
+bool ImportantFileWriter::ReadDeltaLog(const FilePath& path,
+                                       const std::string& data,
+                                       std::vector<std::string>* records) {
+  std::string log;
+  if (!file_util::ReadFileToString(GetDeltaLogPath(path), &log))
+    return false;
+  if (log.size() < kDeltaLogHeaderSize ||
+      log.compare(0, kDeltaLogHeaderSize, DeltaLogHeader(data)) != 0)
+    return false;
+
+  size_t offset = kDeltaLogHeaderSize;
+  while (log.size() - offset >= kDeltaRecordHeaderSize) {
+    uint32 length;
+    memcpy(&length, log.data() + offset, sizeof(length));
+    if (log.size() - offset - kDeltaRecordHeaderSize < length)
+      break;
+    std::string delta = log.substr(offset + kDeltaRecordHeaderSize, length);
+    if (log.compare(offset, kDeltaRecordHeaderSize, DeltaRecord(delta), 0,
+                    kDeltaRecordHeaderSize) != 0)
+      break;
+    records->push_back(delta);
+    offset += kDeltaRecordHeaderSize + length;
+  }
+  if (offset != log.size())
+    LOG(WARNING) << "ignoring truncated delta log record for " << path.value();
+  return true;
+}
+
+void ImportantFileWriter::PostWrite(const std::string& data, bool is_delta) {
+  PendingWrite write(path_, data, is_delta, max_delta_log_size_ > 0);
+  if (!g_write_queue.Get().Add(file_message_loop_proxy_, write))
+    return;
+
+  if (!file_message_loop_proxy_->PostTask(
+      FROM_HERE, new CommitWritesTask(file_message_loop_proxy_))) {
+    // Posting the task to background message loop is not expected
+    // to fail, but if it does, avoid losing data and just hit the disk
+    // on the current thread.
+    NOTREACHED();
+
+    CommitWritesTask commit_task(file_message_loop_proxy_);
+    commit_task.Run();
+  }
+}
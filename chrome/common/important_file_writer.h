@@ -7,6 +7,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/file_path.h"
@@ -36,6 +37,20 @@ class Thread;
 //
 // If you want to know more about this approach and ext3/ext4 fsync issues, see
 // http://valhenson.livejournal.com/37921.html
+//
+// Writes handed to the same file thread before it gets around to them are
+// committed as a group: all of the temporary files are written and flushed
+// first, then renamed into place, so bursts of commits from several writers
+// share one flush window.  Scheduled writes are also committed at the next
+// multiple of their commit interval, never later than one interval away,
+// which lines up writers with related intervals.
+//
+// Writers whose serializer can describe individual changes may additionally
+// enable a delta log (see set_max_delta_log_size()): scheduled writes then
+// append small records to a log next to the file instead of rewriting it,
+// and the file is only rewritten (compacting the log away) once the log has
+// grown too large, or after a write of the file or of its log failed.
+// Readers apply the records with ReadDeltaLog().
 class ImportantFileWriter : public base::NonThreadSafe {
  public:
   // Used by ScheduleSave to lazily provide the data to be saved. Allows us
@@ -48,6 +63,15 @@ class ImportantFileWriter : public base::NonThreadSafe {
     // serialization. Will be called on the same thread on which
     // ImportantFileWriter has been created.
     virtual bool SerializeData(std::string* data) = 0;
+
+    // Should put a record describing the changes made since the last
+    // successful SerializeData() or SerializeDelta() call in |delta| and
+    // return true, or return false if the changes can't be expressed as a
+    // delta, in which case SerializeData() is used.  Only called when the
+    // writer's delta log is enabled.  The record format is up to the
+    // serializer; whoever reads the file back must be able to apply the
+    // records returned by ReadDeltaLog() in order.
+    virtual bool SerializeDelta(std::string* delta);
   };
 
   // Initialize the writer.
@@ -73,7 +97,7 @@ class ImportantFileWriter : public base::NonThreadSafe {
   void WriteNow(const std::string& data);
 
   // Schedule a save to target filename. Data will be serialized and saved
-  // to disk after the commit interval. If another ScheduleWrite is issued
+  // to disk within the commit interval. If another ScheduleWrite is issued
   // before that, only one serialization and write to disk will happen, and
   // the most recent |serializer| will be used. This operation does not block.
   // |serializer| should remain valid through the lifetime of
@@ -81,6 +105,8 @@ class ImportantFileWriter : public base::NonThreadSafe {
   void ScheduleWrite(DataSerializer* serializer);
 
   // Serialize data pending to be saved and execute write on backend thread.
+  // If the delta log is enabled and not due for compaction, and the
+  // serializer can provide a delta, only the delta is written.
   void DoScheduledWrite();
 
   base::TimeDelta commit_interval() const {
@@ -91,7 +117,32 @@ class ImportantFileWriter : public base::NonThreadSafe {
     commit_interval_ = interval;
   }
 
+  // Enables the delta log when |size| is positive.  Once the log holds more
+  // than |size| bytes, or more than the last full write of the file, the
+  // next scheduled write rewrites the whole file and starts a new log.
+  // Deltas are only logged after this writer has written the full file at
+  // least once, so that the log always matches the file.
+  void set_max_delta_log_size(int64 size) {
+    max_delta_log_size_ = size;
+  }
+
+  // Returns the path of the delta log kept next to |path|.
+  static FilePath GetDeltaLogPath(const FilePath& path);
+
+  // Reads the records appended to the delta log of |path|, whose current
+  // content is |data|, into |records|.  A log which was not started for
+  // exactly |data| (for example, one left over by a crash during
+  // compaction) is ignored, as is a truncated record at the end of the log.
+  // Returns false if there is no usable log.  Must be called on a thread
+  // on which file I/O is allowed.
+  static bool ReadDeltaLog(const FilePath& path,
+                           const std::string& data,
+                           std::vector<std::string>* records);
+
  private:
+  // Hands a write of the whole file or of a delta to the file thread.
+  void PostWrite(const std::string& data, bool is_delta);
+
   // Path being written to.
   const FilePath path_;
 
@@ -107,6 +158,14 @@ class ImportantFileWriter : public base::NonThreadSafe {
   // Time delta after which scheduled data will be written to disk.
   base::TimeDelta commit_interval_;
 
+  // Maximum size of the delta log; zero when delta logging is disabled.
+  int64 max_delta_log_size_;
+
+  // Size of the last full write, and of the deltas logged since.  A
+  // negative |snapshot_size_| means we haven't written the full file yet.
+  int64 snapshot_size_;
+  int64 delta_log_size_;
+
   DISALLOW_COPY_AND_ASSIGN(ImportantFileWriter);
 };
 
@@ -0,0 +1,113 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/common/important_file_writer.h"
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Roughly the size of a well-used Preferences file.
+const size_t kFileSize = 256 * 1024;
+const int kNumChanges = 500;
+
+// Stands in for a pref store: a large file receiving a stream of small
+// changes, each of which can be logged as a delta.
+class PrefsLikeSerializer : public ImportantFileWriter::DataSerializer {
+ public:
+  PrefsLikeSerializer() : data_(kFileSize, ' '), bytes_written_(0) {
+  }
+
+  void Change(int i) {
+    std::string change = "\"pref" + base::IntToString(i) + "\": true,";
+    data_.append(change);
+    delta_.append(change);
+  }
+
+  virtual bool SerializeData(std::string* output) {
+    output->assign(data_);
+    delta_.clear();
+    bytes_written_ += output->size();
+    return true;
+  }
+
+  virtual bool SerializeDelta(std::string* delta) {
+    delta->swap(delta_);
+    delta_.clear();
+    bytes_written_ += delta->size();
+    return true;
+  }
+
+  // Bytes handed to the writer so far.
+  int64 bytes_written() const { return bytes_written_; }
+
+ private:
+  std::string data_;
+  std::string delta_;
+  int64 bytes_written_;
+};
+
+class ImportantFileWriterPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  // Commits kNumChanges changes one by one, as a pref store would if each
+  // change hit a commit window of its own.
+  void RunChanges(const char* name, int64 max_delta_log_size) {
+    FilePath path = temp_dir_.path().AppendASCII(name);
+    ImportantFileWriter writer(
+        path, base::MessageLoopProxy::CreateForCurrentThread());
+    writer.set_max_delta_log_size(max_delta_log_size);
+    PrefsLikeSerializer serializer;
+
+    std::string data;
+    ASSERT_TRUE(serializer.SerializeData(&data));
+    writer.WriteNow(data);
+    loop_.RunAllPending();
+
+    int64 initial_bytes = serializer.bytes_written();
+    PerfTimeLogger timer(name);
+    for (int i = 0; i < kNumChanges; ++i) {
+      serializer.Change(i);
+      writer.ScheduleWrite(&serializer);
+      writer.DoScheduledWrite();
+      loop_.RunAllPending();
+    }
+    timer.Done();
+    LogPerfResult((std::string(name) + "_bytes_written").c_str(),
+                  static_cast<double>(serializer.bytes_written() -
+                                      initial_bytes), "bytes");
+
+    int64 file_size = 0, log_size = 0;
+    ASSERT_TRUE(file_util::GetFileSize(path, &file_size));
+    file_util::GetFileSize(ImportantFileWriter::GetDeltaLogPath(path),
+                           &log_size);
+    LogPerfResult((std::string(name) + "_disk_size").c_str(),
+                  static_cast<double>(file_size + log_size), "bytes");
+  }
+
+  MessageLoop loop_;
+  ScopedTempDir temp_dir_;
+};
+
+}  // namespace
+
+TEST_F(ImportantFileWriterPerfTest, FullWrites) {
+  RunChanges("ImportantFileWriter_full_writes", 0);
+}
+
+TEST_F(ImportantFileWriterPerfTest, DeltaLog) {
+  RunChanges("ImportantFileWriter_delta_log", 64 * 1024);
+}
@@ -4,6 +4,9 @@
 
 #include "chrome/common/important_file_writer.h"
 
+#include <string>
+#include <vector>
+
 #include "base/compiler_specific.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
@@ -38,6 +41,46 @@ class DataSerializer : public ImportantFileWriter::DataSerializer {
   const std::string data_;
 };
 
+// Serializes the initial data followed by the changes appended since, and
+// hands out those changes as deltas.
+class DeltaSerializer : public ImportantFileWriter::DataSerializer {
+ public:
+  explicit DeltaSerializer(const std::string& data) : data_(data) {
+  }
+
+  void Append(const std::string& change) {
+    data_.append(change);
+    delta_.append(change);
+  }
+
+  virtual bool SerializeData(std::string* output) {
+    output->assign(data_);
+    delta_.clear();
+    return true;
+  }
+
+  virtual bool SerializeDelta(std::string* delta) {
+    delta->swap(delta_);
+    delta_.clear();
+    return true;
+  }
+
+ private:
+  std::string data_;
+  std::string delta_;
+};
+
+// Returns the content of |path| with its delta log applied.
+std::string GetFileContentWithDeltas(const FilePath& path) {
+  std::string content = GetFileContent(path);
+  std::vector<std::string> records;
+  if (ImportantFileWriter::ReadDeltaLog(path, content, &records)) {
+    for (size_t i = 0; i < records.size(); ++i)
+      content.append(records[i]);
+  }
+  return content;
+}
+
 }  // namespace
 
 class ImportantFileWriterTest : public testing::Test {
@@ -113,3 +156,152 @@ TEST_F(ImportantFileWriterTest, BatchingWrites) {
   ASSERT_TRUE(file_util::PathExists(writer.path()));
   EXPECT_EQ("baz", GetFileContent(writer.path()));
 }
+
+TEST_F(ImportantFileWriterTest, GroupCommit) {
+  scoped_refptr<base::MessageLoopProxy> proxy(
+      base::MessageLoopProxy::CreateForCurrentThread());
+  ImportantFileWriter writer1(file_, proxy);
+  ImportantFileWriter writer2(file_.DirName().AppendASCII("other-file"), proxy);
+  writer1.WriteNow("foo");
+  writer2.WriteNow("bar");
+  writer1.WriteNow("baz");
+  loop_.RunAllPending();
+
+  EXPECT_EQ("baz", GetFileContent(writer1.path()));
+  EXPECT_EQ("bar", GetFileContent(writer2.path()));
+}
+
+TEST_F(ImportantFileWriterTest, DeltaLog) {
+  ImportantFileWriter writer(file_,
+                             base::MessageLoopProxy::CreateForCurrentThread());
+  writer.set_max_delta_log_size(1024);
+  // The log is compacted once it outgrows the file, so start with a file
+  // big enough to hold a few records.
+  const std::string data(100, '-');
+  DeltaSerializer serializer(data);
+
+  // The first write is always a full one.
+  serializer.Append("1");
+  writer.ScheduleWrite(&serializer);
+  writer.DoScheduledWrite();
+  loop_.RunAllPending();
+  EXPECT_EQ(data + "1", GetFileContent(writer.path()));
+
+  serializer.Append("2");
+  writer.ScheduleWrite(&serializer);
+  writer.DoScheduledWrite();
+  serializer.Append("3");
+  writer.ScheduleWrite(&serializer);
+  writer.DoScheduledWrite();
+  loop_.RunAllPending();
+
+  // The deltas were appended to the log, leaving the file alone.
+  EXPECT_EQ(data + "1", GetFileContent(writer.path()));
+  std::vector<std::string> records;
+  ASSERT_TRUE(ImportantFileWriter::ReadDeltaLog(writer.path(), data + "1",
+                                                &records));
+  ASSERT_EQ(2U, records.size());
+  EXPECT_EQ("2", records[0]);
+  EXPECT_EQ("3", records[1]);
+  EXPECT_EQ(data + "123", GetFileContentWithDeltas(writer.path()));
+}
+
+TEST_F(ImportantFileWriterTest, DeltaLogCompaction) {
+  ImportantFileWriter writer(file_,
+                             base::MessageLoopProxy::CreateForCurrentThread());
+  writer.set_max_delta_log_size(64);
+  const std::string data(100, '-');
+  DeltaSerializer serializer(data);
+  writer.WriteNow(data);
+
+  // Keep appending until the log outgrows its limit and the file is
+  // rewritten.
+  int i = 0;
+  do {
+    serializer.Append(std::string(10, 'a' + i++));
+    writer.ScheduleWrite(&serializer);
+    writer.DoScheduledWrite();
+    loop_.RunAllPending();
+    ASSERT_LT(i, 20);
+  } while (GetFileContent(writer.path()) == data);
+
+  std::string expected(data);
+  for (int j = 0; j < i; ++j)
+    expected.append(std::string(10, 'a' + j));
+  EXPECT_EQ(expected, GetFileContent(writer.path()));
+
+  // The compaction started a new, empty log.
+  std::vector<std::string> records;
+  ASSERT_TRUE(ImportantFileWriter::ReadDeltaLog(writer.path(), expected,
+                                                &records));
+  EXPECT_TRUE(records.empty());
+}
+
+TEST_F(ImportantFileWriterTest, StaleDeltaLogIgnored) {
+  ImportantFileWriter writer(file_,
+                             base::MessageLoopProxy::CreateForCurrentThread());
+  writer.set_max_delta_log_size(1024);
+  DeltaSerializer serializer("data");
+  writer.WriteNow("data");
+  serializer.Append("1");
+  writer.ScheduleWrite(&serializer);
+  writer.DoScheduledWrite();
+  loop_.RunAllPending();
+
+  // A log which doesn't match the file, as left behind by a crash between
+  // renaming a full write into place and restarting the log, is ignored.
+  std::vector<std::string> records;
+  EXPECT_TRUE(ImportantFileWriter::ReadDeltaLog(writer.path(), "data",
+                                                &records));
+  EXPECT_FALSE(ImportantFileWriter::ReadDeltaLog(writer.path(), "other",
+                                                 &records));
+
+  // So is a record torn by a crash during an append.
+  std::string log;
+  FilePath log_path = ImportantFileWriter::GetDeltaLogPath(writer.path());
+  ASSERT_TRUE(file_util::ReadFileToString(log_path, &log));
+  log.append("\x10\x00\x00\x00torn");
+  ASSERT_EQ(static_cast<int>(log.size()),
+            file_util::WriteFile(log_path, log.data(), log.size()));
+  EXPECT_EQ("data1", GetFileContentWithDeltas(writer.path()));
+}
+
+TEST_F(ImportantFileWriterTest, FailedDeltaForcesFullWrite) {
+  ImportantFileWriter writer(file_,
+                             base::MessageLoopProxy::CreateForCurrentThread());
+  writer.set_max_delta_log_size(1024);
+  const std::string data(100, '-');
+  DeltaSerializer serializer(data);
+  writer.WriteNow(data);
+  loop_.RunAllPending();
+
+  // The delta can't be appended once the log is gone...
+  FilePath log_path = ImportantFileWriter::GetDeltaLogPath(writer.path());
+  ASSERT_TRUE(file_util::Delete(log_path, false));
+  serializer.Append("1");
+  writer.ScheduleWrite(&serializer);
+  writer.DoScheduledWrite();
+  loop_.RunAllPending();
+  EXPECT_EQ(data, GetFileContent(writer.path()));
+  EXPECT_FALSE(file_util::PathExists(log_path));
+
+  // ... so the next write saves the whole file, including the lost change,
+  // and starts a new log.
+  serializer.Append("2");
+  writer.ScheduleWrite(&serializer);
+  writer.DoScheduledWrite();
+  loop_.RunAllPending();
+  EXPECT_EQ(data + "12", GetFileContent(writer.path()));
+  std::vector<std::string> records;
+  ASSERT_TRUE(ImportantFileWriter::ReadDeltaLog(writer.path(), data + "12",
+                                                &records));
+  EXPECT_TRUE(records.empty());
+
+  // Deltas are logged again after that.
+  serializer.Append("3");
+  writer.ScheduleWrite(&serializer);
+  writer.DoScheduledWrite();
+  loop_.RunAllPending();
+  EXPECT_EQ(data + "12", GetFileContent(writer.path()));
+  EXPECT_EQ(data + "123", GetFileContentWithDeltas(writer.path()));
+}
@@ -9,7 +9,13 @@
 #include "base/bind.h"
 #include "base/callback.h"
 #include "base/file_util.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/json/string_escape.h"
 #include "base/memory/ref_counted.h"
+#include "base/metrics/histogram.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
 #include "base/values.h"
 #include "content/browser/browser_thread.h"
 #include "content/common/json_value_serializer.h"
@@ -19,6 +25,54 @@ namespace {
 // Some extensions we'll tack on to copies of the Preferences files.
 const FilePath::CharType* kBadExtension = FILE_PATH_LITERAL("bad");
 
+// Once the delta log holds this many bytes, the next scheduled write
+// rewrites the whole file.
+const int64 kMaxDeltaLogSize = 512 * 1024;
+
+// Keys of the delta records written by SerializeDelta().
+const char kDeltaSetKey[] = "set";
+const char kDeltaRemoveKey[] = "remove";
+
+#if defined(OS_WIN)
+const char kLineEnding[] = "\r\n";
+#else
+const char kLineEnding[] = "\n";
+#endif
+
+// Returns the top-level key of the subtree holding the pref |key|.
+std::string GetSubtreeKey(const std::string& key) {
+  return key.substr(0, key.find('.'));
+}
+
+// Pretty-prints the top-level subtree |value| into |json|, indented as it
+// is in the file.  Returns false if the subtree is left empty once its empty
+// children are pruned, in which case it isn't written at all.
+bool SerializeSubtree(const std::string& key,
+                      const Value* value,
+                      std::string* json) {
+  DictionaryValue dict;
+  dict.SetWithoutPathExpansion(key, value->DeepCopy());
+  scoped_ptr<DictionaryValue> pruned(dict.DeepCopyWithoutEmptyChildren());
+  Value* pruned_value = NULL;
+  if (!pruned->GetWithoutPathExpansion(key, &pruned_value))
+    return false;
+
+  std::string unindented;
+  base::JSONWriter::Write(pruned_value, true, &unindented);
+  // Drop the line ending JSONWriter ends with and indent every line by one
+  // level.  Strings can't hold raw line breaks, so this only affects the
+  // layout.
+  unindented.resize(unindented.size() - arraysize(kLineEnding) + 1);
+  json->clear();
+  json->reserve(unindented.size());
+  for (size_t i = 0; i < unindented.size(); ++i) {
+    json->push_back(unindented[i]);
+    if (unindented[i] == '\n')
+      json->append("   ");
+  }
+  return true;
+}
+
 // Differentiates file loading between UI and FILE threads.
 class FileThreadDeserializer
     : public base::RefCountedThreadSafe<FileThreadDeserializer> {
@@ -37,16 +91,12 @@ class FileThreadDeserializer
                           path));
   }
 
-  // Deserializes JSON on the FILE thread.
+  // Reads the file on the FILE thread.
   void ReadFileAndReport(const FilePath& path) {
     DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
 
-    int error_code;
-    std::string error_msg;
-    JSONFileValueSerializer serializer(path);
-    value_.reset(serializer.Deserialize(&error_code, &error_msg));
-
-    HandleErrors(value_.get(), path, error_code, error_msg, &error_);
+    contents_.reset(new JsonPrefStore::FileContents);
+    error_ = ReadFile(path, contents_.get());
 
     no_dir_ = !file_util::PathExists(path.DirName());
 
@@ -59,9 +109,14 @@ class FileThreadDeserializer
   // Reports deserialization result on the UI thread.
   void ReportOnUIThread() {
     DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
-    delegate_->OnFileRead(value_.release(), error_, no_dir_);
+    delegate_->OnFileRead(contents_.release(), error_, no_dir_);
   }
 
+  // Reads |path| and its delta log into |contents|.
+  static PersistentPrefStore::PrefReadError ReadFile(
+      const FilePath& path,
+      JsonPrefStore::FileContents* contents);
+
   static void HandleErrors(const Value* value,
                            const FilePath& path,
                            int error_code,
@@ -73,10 +128,38 @@ class FileThreadDeserializer
 
   bool no_dir_;
   PersistentPrefStore::PrefReadError error_;
-  scoped_ptr<Value> value_;
+  scoped_ptr<JsonPrefStore::FileContents> contents_;
   scoped_refptr<JsonPrefStore> delegate_;
 };
 
+// static
+PersistentPrefStore::PrefReadError FileThreadDeserializer::ReadFile(
+    const FilePath& path,
+    JsonPrefStore::FileContents* contents) {
+  base::TimeTicks start = base::TimeTicks::Now();
+  int error_code = 0;
+  std::string error_msg;
+  JSONFileValueSerializer serializer(path);
+  scoped_ptr<Value> value(serializer.Deserialize(&error_code, &error_msg));
+
+  PersistentPrefStore::PrefReadError error;
+  HandleErrors(value.get(), path, error_code, error_msg, &error);
+  if (error != PersistentPrefStore::PREF_READ_ERROR_NONE)
+    return error;
+  contents->prefs.reset(static_cast<DictionaryValue*>(value.release()));
+
+  // The delta log is tied to the exact contents of the file, which only
+  // have to be read again if there is a log.
+  std::string data;
+  if (file_util::PathExists(ImportantFileWriter::GetDeltaLogPath(path)) &&
+      file_util::ReadFileToString(path, &data)) {
+    ImportantFileWriter::ReadDeltaLog(path, data, &contents->deltas);
+  }
+  UMA_HISTOGRAM_TIMES("Settings.JsonDataReadTime",
+                      base::TimeTicks::Now() - start);
+  return PersistentPrefStore::PREF_READ_ERROR_NONE;
+}
+
 // static
 void FileThreadDeserializer::HandleErrors(
     const Value* value,
@@ -125,12 +208,19 @@ void FileThreadDeserializer::HandleErrors(
 
 }  // namespace
 
+JsonPrefStore::FileContents::FileContents() {
+}
+
+JsonPrefStore::FileContents::~FileContents() {
+}
+
 JsonPrefStore::JsonPrefStore(const FilePath& filename,
                              base::MessageLoopProxy* file_message_loop_proxy)
     : path_(filename),
       prefs_(new DictionaryValue()),
       read_only_(false),
       writer_(filename, file_message_loop_proxy) {
+  writer_.set_max_delta_log_size(kMaxDeltaLogSize);
 }
 
 JsonPrefStore::~JsonPrefStore() {
@@ -157,6 +247,9 @@ void JsonPrefStore::RemoveObserver(PrefStore::Observer* observer) {
 
 PrefStore::ReadResult JsonPrefStore::GetMutableValue(const std::string& key,
                                                      Value** result) {
+  // The caller may change the value, and has to call ReportValueChanged()
+  // if it does.  Forget the serialized subtree now in case it doesn't.
+  PrepareForChange(key);
   return prefs_->Get(key, result) ? READ_OK : READ_NO_VALUE;
 }
 
@@ -166,6 +259,7 @@ void JsonPrefStore::SetValue(const std::string& key, Value* value) {
   Value* old_value = NULL;
   prefs_->Get(key, &old_value);
   if (!old_value || !value->Equals(old_value)) {
+    PrepareForChange(key);
     prefs_->Set(key, new_value.release());
     FOR_EACH_OBSERVER(PrefStore::Observer, observers_, OnPrefValueChanged(key));
   }
@@ -176,12 +270,16 @@ void JsonPrefStore::SetValueSilently(const std::string& key, Value* value) {
   scoped_ptr<Value> new_value(value);
   Value* old_value = NULL;
   prefs_->Get(key, &old_value);
-  if (!old_value || !value->Equals(old_value))
+  if (!old_value || !value->Equals(old_value)) {
+    PrepareForChange(key);
     prefs_->Set(key, new_value.release());
+  }
 }
 
 void JsonPrefStore::RemoveValue(const std::string& key) {
-  if (prefs_->Remove(key, NULL)) {
+  if (prefs_->Get(key, NULL)) {
+    PrepareForChange(key);
+    prefs_->Remove(key, NULL);
     FOR_EACH_OBSERVER(PrefStore::Observer, observers_, OnPrefValueChanged(key));
   }
 }
@@ -190,10 +288,10 @@ bool JsonPrefStore::ReadOnly() const {
   return read_only_;
 }
 
-void JsonPrefStore::OnFileRead(Value* value_owned,
+void JsonPrefStore::OnFileRead(FileContents* contents_owned,
                                PersistentPrefStore::PrefReadError error,
                                bool no_dir) {
-  scoped_ptr<Value> value(value_owned);
+  scoped_ptr<FileContents> contents(contents_owned);
   switch (error) {
     case PREF_READ_ERROR_ACCESS_DENIED:
     case PREF_READ_ERROR_FILE_OTHER:
@@ -202,8 +300,12 @@ void JsonPrefStore::OnFileRead(Value* value_owned,
       read_only_ = true;
       break;
     case PREF_READ_ERROR_NONE:
-      DCHECK(value.get());
-      prefs_.reset(static_cast<DictionaryValue*>(value.release()));
+      DCHECK(contents.get());
+      prefs_.reset(contents->prefs.release());
+      serialized_subtrees_.clear();
+      for (size_t i = 0; i < contents->deltas.size(); ++i)
+        ApplyDelta(contents->deltas[i]);
+      changed_keys_.clear();
       break;
     case PREF_READ_ERROR_NO_FILE:
       // If the file just doesn't exist, maybe this is first run.  In any case
@@ -248,20 +350,11 @@ PersistentPrefStore::PrefReadError JsonPrefStore::ReadPrefs() {
     return PREF_READ_ERROR_FILE_NOT_SPECIFIED;
   }
 
-  int error_code = 0;
-  std::string error_msg;
-
-  JSONFileValueSerializer serializer(path_);
-  scoped_ptr<Value> value(serializer.Deserialize(&error_code, &error_msg));
-
-  PersistentPrefStore::PrefReadError error;
-  FileThreadDeserializer::HandleErrors(value.get(),
-                                       path_,
-                                       error_code,
-                                       error_msg,
-                                       &error);
+  FileContents* contents = new FileContents;
+  PersistentPrefStore::PrefReadError error =
+      FileThreadDeserializer::ReadFile(path_, contents);
 
-  OnFileRead(value.release(), error, false);
+  OnFileRead(contents, error, false);
 
   return error;
 }
@@ -292,14 +385,107 @@ void JsonPrefStore::CommitPendingWrite() {
 }
 
 void JsonPrefStore::ReportValueChanged(const std::string& key) {
+  PrepareForChange(key);
   FOR_EACH_OBSERVER(PrefStore::Observer, observers_, OnPrefValueChanged(key));
 }
 
 bool JsonPrefStore::SerializeData(std::string* output) {
   // TODO(tc): Do we want to prune webkit preferences that match the default
   // value?
-  JSONStringValueSerializer serializer(output);
-  serializer.set_pretty_print(true);
-  scoped_ptr<DictionaryValue> copy(prefs_->DeepCopyWithoutEmptyChildren());
-  return serializer.Serialize(*(copy.get()));
+  // Only the subtrees which changed since the last write are serialized
+  // again; the layout matches what JSONWriter would produce for the whole
+  // dictionary.
+  for (DictionaryValue::key_iterator it = prefs_->begin_keys();
+       it != prefs_->end_keys(); ++it) {
+    if (serialized_subtrees_.count(*it))
+      continue;
+    Value* subtree = NULL;
+    prefs_->GetWithoutPathExpansion(*it, &subtree);
+    std::string json;
+    if (SerializeSubtree(*it, subtree, &json))
+      serialized_subtrees_[*it].swap(json);
+  }
+
+  output->clear();
+  output->append("{");
+  output->append(kLineEnding);
+  for (std::map<std::string, std::string>::const_iterator it =
+           serialized_subtrees_.begin();
+       it != serialized_subtrees_.end(); ++it) {
+    if (it != serialized_subtrees_.begin()) {
+      output->append(",");
+      output->append(kLineEnding);
+    }
+    output->append("   ");
+    base::JsonDoubleQuote(UTF8ToUTF16(it->first), true, output);
+    output->append(": ");
+    output->append(it->second);
+  }
+  output->append(kLineEnding);
+  output->append("}");
+  output->append(kLineEnding);
+
+  changed_keys_.clear();
+  return true;
+}
+
+bool JsonPrefStore::SerializeDelta(std::string* delta) {
+  // Record the current value of every changed pref, or its removal.
+  DictionaryValue record;
+  DictionaryValue* set = new DictionaryValue;
+  record.Set(kDeltaSetKey, set);
+  ListValue* remove = new ListValue;
+  record.Set(kDeltaRemoveKey, remove);
+  for (std::set<std::string>::const_iterator it = changed_keys_.begin();
+       it != changed_keys_.end(); ++it) {
+    Value* value = NULL;
+    if (prefs_->Get(*it, &value))
+      set->SetWithoutPathExpansion(*it, value->DeepCopy());
+    else
+      remove->Append(Value::CreateStringValue(*it));
+  }
+  base::JSONWriter::Write(&record, false, delta);
+
+  changed_keys_.clear();
+  return true;
+}
+
+void JsonPrefStore::PrepareForChange(const std::string& key) {
+  serialized_subtrees_.erase(GetSubtreeKey(key));
+  changed_keys_.insert(key);
+}
+
+void JsonPrefStore::ApplyDelta(const std::string& delta) {
+  base::JSONReader reader;
+  scoped_ptr<Value> record_value(reader.JsonToValue(delta, true, false));
+  if (!record_value.get() ||
+      !record_value->IsType(Value::TYPE_DICTIONARY)) {
+    LOG(ERROR) << "Ignoring unparsable preferences delta: "
+               << reader.GetErrorMessage();
+    return;
+  }
+  DictionaryValue* record = static_cast<DictionaryValue*>(record_value.get());
+
+  // Every recorded value is the pref's value at the time of the record, so
+  // applying the changes before the removals can't undo either.
+  DictionaryValue* set = NULL;
+  if (record->GetDictionary(kDeltaSetKey, &set)) {
+    for (DictionaryValue::key_iterator it = set->begin_keys();
+         it != set->end_keys(); ++it) {
+      Value* value = NULL;
+      set->GetWithoutPathExpansion(*it, &value);
+      PrepareForChange(*it);
+      prefs_->Set(*it, value->DeepCopy());
+    }
+  }
+  ListValue* remove = NULL;
+  if (record->GetList(kDeltaRemoveKey, &remove)) {
+    for (size_t i = 0; i < remove->GetSize(); ++i) {
+      std::string key;
+      if (!remove->GetString(i, &key))
+        continue;
+      PrepareForChange(key);
+      prefs_->Remove(key, NULL);
+    }
+  }
 }
@@ -6,7 +6,10 @@
 #define CHROME_COMMON_JSON_PREF_STORE_H_
 #pragma once
 
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/file_path.h"
@@ -24,6 +27,11 @@ class FilePath;
 class Value;
 
 // A writable PrefStore implementation that is used for user preferences.
+//
+// Full writes reuse the JSON of every top-level subtree which hasn't changed
+// since it was last written, and scheduled writes only append the changed
+// prefs to the ImportantFileWriter delta log, which is replayed when the file
+// is next read.
 class JsonPrefStore : public PersistentPrefStore,
                       public ImportantFileWriter::DataSerializer {
  public:
@@ -61,18 +69,44 @@ class JsonPrefStore : public PersistentPrefStore,
   virtual void CommitPendingWrite();
   virtual void ReportValueChanged(const std::string& key);
 
+  // The parsed preferences file and the records of its delta log.
+  struct FileContents {
+    FileContents();
+    ~FileContents();
+
+    scoped_ptr<DictionaryValue> prefs;
+    std::vector<std::string> deltas;
+  };
+
   // This method is called after JSON file has been read. Method takes
-  // ownership of the |value| pointer.
-  void OnFileRead(Value* value_owned, PrefReadError error, bool no_dir);
+  // ownership of the |contents| pointer.
+  void OnFileRead(FileContents* contents_owned,
+                  PrefReadError error,
+                  bool no_dir);
 
  private:
   // ImportantFileWriter::DataSerializer overrides:
   virtual bool SerializeData(std::string* output);
+  virtual bool SerializeDelta(std::string* delta);
+
+  // Forgets the serialized JSON of the subtree holding |key|, as |key| is
+  // about to change.  |key| is also added to the next delta.
+  void PrepareForChange(const std::string& key);
+
+  // Applies a record written by SerializeDelta().
+  void ApplyDelta(const std::string& delta);
 
   FilePath path_;
 
   scoped_ptr<DictionaryValue> prefs_;
 
+  // Pretty-printed JSON of the top-level subtrees which haven't changed
+  // since they were last serialized.
+  std::map<std::string, std::string> serialized_subtrees_;
+
+  // Prefs changed since the last SerializeData() or SerializeDelta() call.
+  std::set<std::string> changed_keys_;
+
   bool read_only_;
 
   // Helper for safely writing pref data.
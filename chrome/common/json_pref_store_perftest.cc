@@ -0,0 +1,123 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/file_util.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
+#include "base/perftimer.h"
+#include "base/string_number_conversions.h"
+#include "base/values.h"
+#include "chrome/common/json_pref_store.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Extension state makes up most of a large managed profile's preferences.
+const int kNumExtensions = 3000;
+const int kNumPolicies = 2000;
+const size_t kMinFileSize = 5 * 1024 * 1024;
+
+class JsonPrefStorePerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    pref_file_ = temp_dir_.path().AppendASCII("Preferences");
+    message_loop_proxy_ = base::MessageLoopProxy::CreateForCurrentThread();
+
+    DictionaryValue prefs;
+    prefs.SetBoolean("browser.show_home_button", true);
+    prefs.SetString("homepage", "http://www.google.com/");
+    for (int i = 0; i < kNumExtensions; ++i) {
+      std::string id = "extension" + base::IntToString(i);
+      DictionaryValue* extension = new DictionaryValue;
+      extension->SetString("path", "/extensions/" + id + "/1.0");
+      extension->SetInteger("state", 1);
+      extension->SetString("manifest.name", "Extension " + id);
+      extension->SetString("manifest.description", std::string(1024, 'd'));
+      ListValue* permissions = new ListValue;
+      for (int j = 0; j < 20; ++j)
+        permissions->Append(Value::CreateStringValue("http://*.example.com/"));
+      extension->Set("manifest.permissions", permissions);
+      DictionaryValue* settings = NULL;
+      if (!prefs.GetDictionary("extensions.settings", &settings)) {
+        settings = new DictionaryValue;
+        prefs.Set("extensions.settings", settings);
+      }
+      settings->SetWithoutPathExpansion(id, extension);
+    }
+    for (int i = 0; i < kNumPolicies; ++i) {
+      prefs.SetString("policy.value" + base::IntToString(i),
+                      std::string(256, 'p'));
+    }
+
+    std::string json;
+    base::JSONWriter::Write(&prefs, true, &json);
+    ASSERT_LE(kMinFileSize, json.size());
+    ASSERT_EQ(static_cast<int>(json.size()),
+              file_util::WriteFile(pref_file_, json.data(), json.size()));
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath pref_file_;
+  MessageLoop message_loop_;
+  scoped_refptr<base::MessageLoopProxy> message_loop_proxy_;
+};
+
+}  // namespace
+
+// Parsing the whole file with one JSONReader, to compare with Startup, which
+// also reads the file and replays its delta log.
+TEST_F(JsonPrefStorePerfTest, ParseWholeFile) {
+  PerfTimeLogger timer("JsonPrefStore_parse_whole_file");
+  std::string json;
+  ASSERT_TRUE(file_util::ReadFileToString(pref_file_, &json));
+  scoped_ptr<Value> value(base::JSONReader::Read(json, false));
+  timer.Done();
+  ASSERT_TRUE(value.get());
+}
+
+// Startup: read the file and look up the prefs needed to show a window.
+TEST_F(JsonPrefStorePerfTest, Startup) {
+  scoped_refptr<JsonPrefStore> pref_store =
+      new JsonPrefStore(pref_file_, message_loop_proxy_.get());
+  PerfTimeLogger timer("JsonPrefStore_startup");
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE,
+            pref_store->ReadPrefs());
+  const Value* value = NULL;
+  EXPECT_EQ(PrefStore::READ_OK,
+            pref_store->GetValue("browser.show_home_button", &value));
+  EXPECT_EQ(PrefStore::READ_OK, pref_store->GetValue("homepage", &value));
+  timer.Done();
+}
+
+// Writing the file after a small change, first in full and then as a delta.
+TEST_F(JsonPrefStorePerfTest, WriteAfterChange) {
+  scoped_refptr<JsonPrefStore> pref_store =
+      new JsonPrefStore(pref_file_, message_loop_proxy_.get());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE,
+            pref_store->ReadPrefs());
+
+  PerfTimeLogger full_timer("JsonPrefStore_full_write_after_change");
+  pref_store->SetValue("homepage",
+                       Value::CreateStringValue("http://www.example.com/"));
+  pref_store->ScheduleWritePrefs();
+  pref_store->CommitPendingWrite();
+  message_loop_.RunAllPending();
+  full_timer.Done();
+
+  PerfTimeLogger delta_timer("JsonPrefStore_delta_write_after_change");
+  pref_store->SetValue("homepage",
+                       Value::CreateStringValue("http://www.google.com/"));
+  pref_store->ScheduleWritePrefs();
+  pref_store->CommitPendingWrite();
+  message_loop_.RunAllPending();
+  delta_timer.Done();
+}
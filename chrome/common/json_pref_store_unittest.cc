@@ -160,3 +160,136 @@ TEST_F(JsonPrefStoreTest, Basic) {
   EXPECT_TRUE(file_util::TextContentsEqual(golden_output_file, output_file));
   ASSERT_TRUE(file_util::Delete(output_file, false));
 }
+
+// Test that the file is laid out as if the whole dictionary had been
+// serialized, both when every subtree is written and when only the changed
+// ones are.
+TEST_F(JsonPrefStoreTest, UnchangedSubtrees) {
+  const char kInput[] =
+      "{\n"
+      "   \"a\": {\n"
+      "      \"b\": [ 1, 2, {\n"
+      "         \"c\": \"}]\\\"\"\n"
+      "      } ],\n"
+      "      \"empty\": {\n"
+      "      }\n"
+      "   },\n"
+      "   \"d\\u0065\": true,\n"
+      "   \"e\": 1.5\n"
+      "}\n";
+  FilePath input_file = temp_dir_.path().AppendASCII("unchanged.json");
+  ASSERT_EQ(static_cast<int>(arraysize(kInput) - 1),
+            file_util::WriteFile(input_file, kInput, arraysize(kInput) - 1));
+  scoped_refptr<JsonPrefStore> pref_store =
+      new JsonPrefStore(input_file, message_loop_proxy_.get());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE, pref_store->ReadPrefs());
+
+  const Value* actual;
+  std::string string_value;
+  ASSERT_EQ(PrefStore::READ_OK, pref_store->GetValue("de", &actual));
+  bool boolean = false;
+  EXPECT_TRUE(actual->GetAsBoolean(&boolean));
+  EXPECT_TRUE(boolean);
+  EXPECT_EQ(PrefStore::READ_NO_VALUE, pref_store->GetValue("a.x", &actual));
+
+  // The first write serializes every subtree, pruning empty children.
+  ASSERT_TRUE(pref_store->WritePrefs());
+  MessageLoop::current()->RunAllPending();
+  std::string output;
+  ASSERT_TRUE(file_util::ReadFileToString(input_file, &output));
+  EXPECT_EQ("{\n"
+            "   \"a\": {\n"
+            "      \"b\": [ 1, 2, {\n"
+            "         \"c\": \"}]\\\"\"\n"
+            "      } ]\n"
+            "   },\n"
+            "   \"de\": true,\n"
+            "   \"e\": 1.5\n"
+            "}\n", output);
+
+  // Changing "a" serializes only it again; "de" and "e" are reused.
+  pref_store->SetValue("a.x", Value::CreateIntegerValue(3));
+  ASSERT_TRUE(pref_store->WritePrefs());
+  MessageLoop::current()->RunAllPending();
+  output.clear();
+  ASSERT_TRUE(file_util::ReadFileToString(input_file, &output));
+  EXPECT_EQ("{\n"
+            "   \"a\": {\n"
+            "      \"b\": [ 1, 2, {\n"
+            "         \"c\": \"}]\\\"\"\n"
+            "      } ],\n"
+            "      \"x\": 3\n"
+            "   },\n"
+            "   \"de\": true,\n"
+            "   \"e\": 1.5\n"
+            "}\n", output);
+}
+
+// Test that a file whose dictionary can be split, but which holds an invalid
+// value, is reported as corrupt and moved aside.
+TEST_F(JsonPrefStoreTest, UnparsableSubtree) {
+  const char kInput[] = "{ \"a\": { \"b\": tru }, \"c\": 1 }";
+  FilePath input_file = temp_dir_.path().AppendASCII("broken.json");
+  ASSERT_EQ(static_cast<int>(arraysize(kInput) - 1),
+            file_util::WriteFile(input_file, kInput, arraysize(kInput) - 1));
+  scoped_refptr<JsonPrefStore> pref_store =
+      new JsonPrefStore(input_file, message_loop_proxy_.get());
+  EXPECT_EQ(PersistentPrefStore::PREF_READ_ERROR_JSON_PARSE,
+            pref_store->ReadPrefs());
+  EXPECT_FALSE(file_util::PathExists(input_file));
+  FilePath bad_file = temp_dir_.path().AppendASCII("broken.bad");
+  std::string output;
+  ASSERT_TRUE(file_util::ReadFileToString(bad_file, &output));
+  EXPECT_EQ(kInput, output);
+
+  const Value* actual;
+  EXPECT_EQ(PrefStore::READ_NO_VALUE, pref_store->GetValue("c", &actual));
+}
+
+// Test that scheduled writes after the first only log the changed prefs,
+// and that the log is replayed when the file is read again.
+TEST_F(JsonPrefStoreTest, DeltaLog) {
+  FilePath pref_file = temp_dir_.path().AppendASCII("delta.json");
+  {
+    scoped_refptr<JsonPrefStore> pref_store =
+        new JsonPrefStore(pref_file, message_loop_proxy_.get());
+    EXPECT_EQ(PersistentPrefStore::PREF_READ_ERROR_NO_FILE,
+              pref_store->ReadPrefs());
+    pref_store->SetValue("a.b", Value::CreateIntegerValue(1));
+    pref_store->SetValue("a.c", Value::CreateIntegerValue(2));
+    pref_store->SetValue("d", Value::CreateStringValue("d"));
+    pref_store->ScheduleWritePrefs();
+    pref_store->CommitPendingWrite();
+    MessageLoop::current()->RunAllPending();
+    std::string snapshot;
+    ASSERT_TRUE(file_util::ReadFileToString(pref_file, &snapshot));
+
+    pref_store->SetValue("a.b", Value::CreateIntegerValue(10));
+    pref_store->RemoveValue("d");
+    pref_store->SetValue("e.f", Value::CreateBooleanValue(true));
+    pref_store->ScheduleWritePrefs();
+    pref_store->CommitPendingWrite();
+    MessageLoop::current()->RunAllPending();
+
+    // Only the log changed.
+    std::string output;
+    ASSERT_TRUE(file_util::ReadFileToString(pref_file, &output));
+    EXPECT_EQ(snapshot, output);
+    EXPECT_TRUE(file_util::PathExists(
+        ImportantFileWriter::GetDeltaLogPath(pref_file)));
+  }
+
+  scoped_refptr<JsonPrefStore> pref_store =
+      new JsonPrefStore(pref_file, message_loop_proxy_.get());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE, pref_store->ReadPrefs());
+  const Value* actual;
+  int integer = 0;
+  ASSERT_EQ(PrefStore::READ_OK, pref_store->GetValue("a.b", &actual));
+  EXPECT_TRUE(actual->GetAsInteger(&integer));
+  EXPECT_EQ(10, integer);
+  ASSERT_EQ(PrefStore::READ_OK, pref_store->GetValue("a.c", &actual));
+  EXPECT_TRUE(actual->GetAsInteger(&integer));
+  EXPECT_EQ(2, integer);
+  EXPECT_EQ(PrefStore::READ_NO_VALUE, pref_store->GetValue("d", &actual));
+  EXPECT_EQ(PrefStore::READ_OK, pref_store->GetValue("e.f", &actual));
+}
@@ -15,7 +15,9 @@ const VisitedLinkCommon::Hash VisitedLinkCommon::null_hash_ = -1;
 
 VisitedLinkCommon::VisitedLinkCommon()
     : hash_table_(NULL),
-      table_length_(0) {
+      table_length_(0),
+      previous_hash_table_(NULL),
+      previous_table_length_(0) {
   memset(salt_, 0, sizeof(salt_));
 }
 
@@ -38,13 +40,24 @@ bool VisitedLinkCommon::IsVisited(const GURL& url) const {
 }
 
 bool VisitedLinkCommon::IsVisited(Fingerprint fingerprint) const {
+  return IsInTable(fingerprint, hash_table_, table_length_) ||
+      IsInTable(fingerprint, previous_hash_table_, previous_table_length_);
+}
+
+// static
+bool VisitedLinkCommon::IsInTable(Fingerprint fingerprint,
+                                  const Fingerprint* table,
+                                  int32 table_length) {
+  if (!table || table_length == 0)
+    return false;
+
   // Go through the table until we find the item or an empty spot (meaning it
   // wasn't found). This loop will terminate as long as the table isn't full,
   // which should be enforced by AddFingerprint.
-  Hash first_hash = HashFingerprint(fingerprint);
+  Hash first_hash = HashFingerprint(fingerprint, table_length);
   Hash cur_hash = first_hash;
   while (true) {
-    Fingerprint cur_fingerprint = FingerprintAt(cur_hash);
+    Fingerprint cur_fingerprint = table[cur_hash];
     if (cur_fingerprint == null_fingerprint_)
       return false;  // End of probe sequence found.
     if (cur_fingerprint == fingerprint)
@@ -53,7 +66,7 @@ bool VisitedLinkCommon::IsVisited(Fingerprint fingerprint) const {
     // This spot was taken, but not by the item we're looking for, search in
     // the next position.
     cur_hash++;
-    if (cur_hash == table_length_)
+    if (cur_hash == table_length)
       cur_hash = 0;
     if (cur_hash == first_hash) {
       // Wrapped around and didn't find an empty space, this means we're in an
@@ -34,6 +34,10 @@ class GURL;
 // master does a lot of work to manage the table, reading and writing it to and
 // from disk, and resizing it when it gets too full.
 //
+// The master grows the table a little at a time, moving the fingerprints of
+// the previous table over as more links are added. The slaves keep reading the
+// previous table, which gets those additions too, until the new one is done.
+//
 // To ask whether a page is in history, we compute a 64-bit fingerprint of the
 // URL. This URL is hashed and we see if it is in the URL hashtable. If it is,
 // we consider it visited. Otherwise, it is unvisited. Note that it is possible
@@ -119,12 +123,22 @@ class VisitedLinkCommon {
     return HashFingerprint(fingerprint, table_length_);
   }
 
+  // Looks up the fingerprint in the |table_length| entries of |table|.
+  static bool IsInTable(Fingerprint fingerprint,
+                        const Fingerprint* table,
+                        int32 table_length);
+
   // pointer to the first item
   VisitedLinkCommon::Fingerprint* hash_table_;
 
   // the number of items in the hash table
   int32 table_length_;
 
+  // While the master grows the table, the table whose fingerprints have not
+  // all been moved yet, which lookups also consult. Slaves never set these.
+  Fingerprint* previous_hash_table_;
+  int32 previous_table_length_;
+
   // salt used for each URL when computing the fingerprint
   uint8 salt_[LINK_SALT_LENGTH];
 
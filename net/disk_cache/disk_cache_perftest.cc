@@ -255,3 +255,77 @@ TEST_F(DiskCacheTest, BlockFilesPerformance) {
   MessageLoop::current()->RunAllPending();
   delete[] address;
 }
+
+// Seeking within a large sparse entry (a media file, for instance) needs to
+// find out how much of the data after the new position is stored. This test
+// measures that lookup, and the first read after it, on an entry that spans
+// many children.
+TEST_F(DiskCacheTest, SparseSeekPerformance) {
+  MessageLoopForIO message_loop;
+
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+
+  ScopedTestCache test_cache;
+  TestCompletionCallback cb;
+  disk_cache::Backend* cache;
+  int rv = disk_cache::CreateCacheBackend(
+               net::DISK_CACHE, test_cache.path(), 0, false,
+               cache_thread.message_loop_proxy(), NULL, &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  disk_cache::Entry* entry;
+  rv = cache->CreateEntry("http://www.google.com/video", &entry, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  // 16 MB of contiguous data.
+  const int kTotalSize = 16 * 1024 * 1024;
+  const int kWriteSize = 256 * 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kWriteSize));
+  CacheTestFillBuffer(buffer->data(), kWriteSize, false);
+  for (int offset = 0; offset < kTotalSize; offset += kWriteSize) {
+    rv = entry->WriteSparseData(offset, buffer, kWriteSize, &cb);
+    ASSERT_EQ(kWriteSize, cb.GetResult(rv));
+  }
+
+  // The whole entry is found with a single lookup.
+  int64 start;
+  rv = entry->GetAvailableRange(0, kTotalSize, &start, &cb);
+  EXPECT_EQ(kTotalSize, cb.GetResult(rv));
+  EXPECT_EQ(0, start);
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  const int kNumSeeks = 1000;
+  const int kReadSize = 64 * 1024;
+  int64 lookups = 0;
+
+  PerfTimeLogger timer("Seek within a sparse entry");
+
+  for (int i = 0; i < kNumSeeks; i++) {
+    int64 seek = rand() % (kTotalSize - kReadSize);
+    int64 offset = seek;
+    int len = kTotalSize - static_cast<int>(seek);
+    while (len > 0) {
+      lookups++;
+      rv = entry->GetAvailableRange(offset, len, &start, &cb);
+      rv = cb.GetResult(rv);
+      ASSERT_GT(rv, 0);
+      ASSERT_EQ(offset, start);
+      offset += rv;
+      len -= rv;
+    }
+
+    rv = entry->ReadSparseData(seek, buffer, kReadSize, &cb);
+    EXPECT_EQ(kReadSize, cb.GetResult(rv));
+  }
+
+  timer.Done();
+  EXPECT_EQ(kNumSeeks, lookups);
+
+  entry->Close();
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+}
@@ -47,6 +47,7 @@ class DiskCacheEntryTest : public DiskCacheTestWithCache {
   void BasicSparseIO();
   void HugeSparseIO();
   void GetAvailableRange();
+  void GetAvailableRangeAcrossChildren();
   void CouldBeSparse();
   void UpdateSparseEntry();
   void DoomSparseEntry();
@@ -1451,6 +1452,65 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyGetAvailableRange) {
   GetAvailableRange();
 }
 
+// Tests that the stored data is returned as a single range, no matter how many
+// child entries hold it.
+void DiskCacheEntryTest::GetAvailableRangeAcrossChildren() {
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+
+  const int kSize = 64 * 1024;
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buf->data(), kSize, false);
+
+  // Write 2.5 MB starting at 960 KB, through three children, then more data
+  // after a gap.
+  const int64 kStart = 0xF0000;
+  const int kLength = 0x280000;
+  for (int64 offset = kStart; offset < kStart + kLength; offset += kSize)
+    EXPECT_EQ(kSize, WriteSparseData(entry, offset, buf, kSize));
+  EXPECT_EQ(kSize, WriteSparseData(entry, kStart + kLength + kSize, buf,
+                                   kSize));
+
+  int64 start;
+  TestCompletionCallback cb;
+  int rv = entry->GetAvailableRange(0, 0x1000000, &start, &cb);
+  EXPECT_EQ(kLength, cb.GetResult(rv));
+  EXPECT_EQ(kStart, start);
+
+  // A range that starts in the middle of a child.
+  rv = entry->GetAvailableRange(kStart + 0x18000, 0x1000000, &start, &cb);
+  EXPECT_EQ(kLength - 0x18000, cb.GetResult(rv));
+  EXPECT_EQ(kStart + 0x18000, start);
+
+  // The |len| argument is still respected.
+  rv = entry->GetAvailableRange(kStart, 0x180000, &start, &cb);
+  EXPECT_EQ(0x180000, cb.GetResult(rv));
+  EXPECT_EQ(kStart, start);
+
+  // The data after the gap.
+  rv = entry->GetAvailableRange(kStart + kLength, 0x1000000, &start, &cb);
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+  EXPECT_EQ(kStart + kLength + kSize, start);
+
+  // The range can be read as a whole.
+  scoped_refptr<net::IOBuffer> buf2(new net::IOBuffer(kLength));
+  EXPECT_EQ(kLength, ReadSparseData(entry, kStart, buf2, kLength));
+
+  entry->Close();
+}
+
+TEST_F(DiskCacheEntryTest, GetAvailableRangeAcrossChildren) {
+  InitCache();
+  GetAvailableRangeAcrossChildren();
+}
+
+TEST_F(DiskCacheEntryTest, MemoryOnlyGetAvailableRangeAcrossChildren) {
+  SetMemoryOnlyMode();
+  InitCache();
+  GetAvailableRangeAcrossChildren();
+}
+
 void DiskCacheEntryTest::CouldBeSparse() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -293,7 +293,8 @@ int SparseControl::GetAvailableRange(int64 offset, int len, int64* start) {
   range_found_ = false;
   int result = StartIO(kGetRangeOperation, offset, NULL, len, NULL);
   if (range_found_) {
-    *start = offset_;
+    // |offset_| is now at the end of the range found.
+    *start = offset_ - result;
     return result;
   }
 
@@ -665,7 +666,8 @@ void SparseControl::DoChildrenIO() {
     entry_->net_log().EndEvent(
         net::NetLog::TYPE_SPARSE_GET_RANGE,
         make_scoped_refptr(
-            new GetAvailableRangeResultParameters(offset_, result_)));
+            new GetAvailableRangeResultParameters(offset_ - result_,
+                                                  result_)));
   }
   if (finished_) {
     if (kGetRangeOperation != operation_ &&
@@ -742,8 +744,14 @@ bool SparseControl::DoChildIO() {
 }
 
 int SparseControl::DoGetAvailableRange() {
-  if (!child_)
-    return child_len_;  // Move on to the next child.
+  if (!child_) {
+    if (!range_found_)
+      return child_len_;  // Move on to the next child.
+
+    // The range found ends with the previous child.
+    buf_len_ = 0;
+    return 0;
+  }
 
   // Check that there are no holes in this range.
   int last_bit = (child_offset_ + child_len_ + 1023) >> 10;
@@ -754,11 +762,12 @@ int SparseControl::DoGetAvailableRange() {
 
   // We don't care if there is a partial block in the middle of the range.
   int block_offset = child_offset_ & (kBlockSize - 1);
-  if (!bits_found && partial_start_bytes <= block_offset)
-    return child_len_;
-
-  // We are done. Just break the loop and reset result_ to our real result.
-  range_found_ = true;
+  if (!bits_found && partial_start_bytes <= block_offset) {
+    if (!range_found_)
+      return child_len_;
+    buf_len_ = 0;
+    return 0;
+  }
 
   // found now points to the first 1. Lets see if we have zeros before it.
   int empty_start = std::max((found << 10) - child_offset_, 0);
@@ -772,20 +781,34 @@ int SparseControl::DoGetAvailableRange() {
   // If the user is searching past the end of this child, bits_found is the
   // right result; otherwise, we have some empty space at the start of this
   // query that we have to subtract from the range that we searched.
-  result_ = std::min(bytes_found, child_len_ - empty_start);
+  int result = std::min(bytes_found, child_len_ - empty_start);
 
   if (!bits_found) {
-    result_ = std::min(partial_start_bytes - block_offset, child_len_);
+    result = std::min(partial_start_bytes - block_offset, child_len_);
     empty_start = 0;
   }
 
-  // Only update offset_ when this query found zeros at the start.
-  if (empty_start)
+  if (range_found_) {
+    // This child only extends the range found if it stores the first bytes.
+    if (empty_start) {
+      buf_len_ = 0;
+      return 0;
+    }
+  } else {
+    // This is the start of the range. Drop the sizes of the empty children
+    // scanned so far.
+    range_found_ = true;
+    result_ = 0;
     offset_ += empty_start;
+    buf_len_ -= empty_start;
+  }
 
-  // This will actually break the loop.
-  buf_len_ = 0;
-  return 0;
+  // The range continues on the next child only if it reaches the end of this
+  // one. Otherwise, this is the last piece; let the loop end after it.
+  if (child_offset_ + empty_start + result < kMaxEntrySize)
+    buf_len_ = result;
+
+  return result;
 }
 
 void SparseControl::DoChildIOCompleted(int result) {
@@ -1,4 +1,4 @@
-// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
@@ -65,24 +65,29 @@ HttpAuthCache::HttpAuthCache() {
 HttpAuthCache::~HttpAuthCache() {
 }
 
-// Performance: O(n), where n is the number of realm entries.
+// Performance: O(n), where n is the number of realm entries of |origin|.
 HttpAuthCache::Entry* HttpAuthCache::Lookup(const GURL& origin,
                                             const std::string& realm,
                                             HttpAuth::Scheme scheme) {
   CheckOriginIsValid(origin);
 
-  // Linear scan through the realm entries.
-  for (EntryList::iterator it = entries_.begin(); it != entries_.end(); ++it) {
-    if (it->origin() == origin && it->realm() == realm &&
-        it->scheme() == scheme)
-      return &(*it);
+  OriginEntries* origin_entries = GetOriginEntries(origin);
+  if (!origin_entries)
+    return NULL;
+
+  // Linear scan through the realm entries of this origin.
+  for (OriginEntries::iterator it = origin_entries->begin();
+       it != origin_entries->end(); ++it) {
+    Entry* entry = &(**it);
+    if (entry->realm() == realm && entry->scheme() == scheme)
+      return entry;
   }
   return NULL;  // No realm entry found.
 }
 
-// Performance: O(n*m), where n is the number of realm entries, m is the number
-// of path entries per realm. Both n amd m are expected to be small; m is
-// kept small because AddPath() only keeps the shallowest entry.
+// Performance: O(n*m), where n is the number of realm entries of |origin|, m
+// is the number of path entries per realm. Both n amd m are expected to be
+// small; m is kept small because AddPath() only keeps the shallowest entry.
 HttpAuthCache::Entry* HttpAuthCache::LookupByPath(const GURL& origin,
                                                   const std::string& path) {
   HttpAuthCache::Entry* best_match = NULL;
@@ -90,19 +95,25 @@ HttpAuthCache::Entry* HttpAuthCache::LookupByPath(const GURL& origin,
   CheckOriginIsValid(origin);
   CheckPathIsValid(path);
 
+  OriginEntries* origin_entries = GetOriginEntries(origin);
+  if (!origin_entries)
+    return NULL;
+
   // RFC 2617 section 2:
   // A client SHOULD assume that all paths at or deeper than the depth of
   // the last symbolic element in the path field of the Request-URI also are
   // within the protection space ...
   std::string parent_dir = GetParentDirectory(path);
 
-  // Linear scan through the realm entries.
-  for (EntryList::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+  // Linear scan through the realm entries of this origin.
+  for (OriginEntries::iterator it = origin_entries->begin();
+       it != origin_entries->end(); ++it) {
+    Entry* entry = &(**it);
     size_t len = 0;
-    if (it->origin() == origin && it->HasEnclosingPath(parent_dir, &len) &&
+    if (entry->HasEnclosingPath(parent_dir, &len) &&
         (!best_match || len > best_match_length)) {
       best_match_length = len;
-      best_match = &(*it);
+      best_match = entry;
     }
   }
   return best_match;
@@ -124,10 +135,11 @@ HttpAuthCache::Entry* HttpAuthCache::Add(const GURL& origin,
     // Failsafe to prevent unbounded memory growth of the cache.
     if (entries_.size() >= kMaxNumRealmEntries) {
       LOG(WARNING) << "Num auth cache entries reached limit -- evicting";
-      entries_.pop_back();
+      RemoveEntry(--entries_.end());
     }
 
     entries_.push_front(Entry());
+    origins_[origin.spec()].push_front(entries_.begin());
     entry = &entries_.front();
     entry->origin_ = origin;
     entry->realm_ = realm;
@@ -201,11 +213,16 @@ bool HttpAuthCache::Remove(const GURL& origin,
                            HttpAuth::Scheme scheme,
                            const string16& username,
                            const string16& password) {
-  for (EntryList::iterator it = entries_.begin(); it != entries_.end(); ++it) {
-    if (it->origin() == origin && it->realm() == realm &&
-        it->scheme() == scheme) {
-      if (username == it->username() && password == it->password()) {
-        entries_.erase(it);
+  OriginEntries* origin_entries = GetOriginEntries(origin);
+  if (!origin_entries)
+    return false;
+
+  for (OriginEntries::iterator it = origin_entries->begin();
+       it != origin_entries->end(); ++it) {
+    EntryList::iterator entry = *it;
+    if (entry->realm() == realm && entry->scheme() == scheme) {
+      if (username == entry->username() && password == entry->password()) {
+        RemoveEntry(entry);
         return true;
       }
       return false;
@@ -225,4 +242,21 @@ bool HttpAuthCache::UpdateStaleChallenge(const GURL& origin,
   return true;
 }
 
+HttpAuthCache::OriginEntries* HttpAuthCache::GetOriginEntries(
+    const GURL& origin) {
+  OriginMap::iterator it = origins_.find(origin.spec());
+  if (it == origins_.end())
+    return NULL;
+  return &it->second;
+}
+
+void HttpAuthCache::RemoveEntry(EntryList::iterator entry) {
+  OriginMap::iterator it = origins_.find(entry->origin().spec());
+  DCHECK(it != origins_.end());
+  it->second.remove(entry);
+  if (it->second.empty())
+    origins_.erase(it);
+  entries_.erase(entry);
+}
+
 }  // namespace net
@@ -9,7 +9,9 @@
 #include <list>
 #include <string>
 
+#include "base/basictypes.h"
 #include "base/gtest_prod_util.h"
+#include "base/hash_tables.h"
 #include "base/memory/ref_counted.h"
 #include "base/string16.h"
 #include "googleurl/src/gurl.h"
@@ -25,6 +27,8 @@ namespace net {
 //   - the last auth handler used (contains realm and authentication scheme)
 //   - the list of paths which used this realm
 // Entries can be looked up by either (origin, realm, scheme) or (origin, path).
+// Both lookups only visit the entries of |origin|, so their cost does not grow
+// with the number of other servers the cache knows about.
 class HttpAuthCache {
  public:
   class Entry;
@@ -32,9 +36,9 @@ class HttpAuthCache {
   // Prevent unbounded memory growth. These are safeguards for abuse; it is
   // not expected that the limits will be reached in ordinary usage.
   // This also defines the worst-case lookup times (which grow linearly
-  // with number of elements in the cache).
+  // with the number of realm entries of a single origin).
   enum { kMaxNumPathsPerRealmEntry = 10 };
-  enum { kMaxNumRealmEntries = 10 };
+  enum { kMaxNumRealmEntries = 100 };
 
   HttpAuthCache();
   ~HttpAuthCache();
@@ -104,7 +108,22 @@ class HttpAuthCache {
 
  private:
   typedef std::list<Entry> EntryList;
+  typedef std::list<EntryList::iterator> OriginEntries;
+  typedef base::hash_map<std::string, OriginEntries> OriginMap;
+
+  // Returns the entries of |origin|, or NULL if there are none.
+  OriginEntries* GetOriginEntries(const GURL& origin);
+
+  // Removes |entry| from |origins_| and |entries_|.
+  void RemoveEntry(EntryList::iterator entry);
+
+  // All the entries, most recently created first.
   EntryList entries_;
+
+  // The entries of |entries_|, by origin, in the same order.
+  OriginMap origins_;
+
+  DISALLOW_COPY_AND_ASSIGN(HttpAuthCache);
 };
 
 // An authentication realm entry.
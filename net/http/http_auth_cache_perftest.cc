@@ -0,0 +1,131 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Logs how long the auth cache lookups take when the cache is full, and the
+// auth overhead of a request that preemptively authenticates, and of one to a
+// proxy that uses a connection-based scheme:
+//   $ ./perf_tests --gtest_filter=HttpAuthCachePerfTest.*
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "googleurl/src/gurl.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/test_completion_callback.h"
+#include "net/http/http_auth_cache.h"
+#include "net/http/http_auth_controller.h"
+#include "net/http/http_auth_handler_basic.h"
+#include "net/http/http_auth_handler_factory.h"
+#include "net/http/http_auth_handler_ntlm.h"
+#include "net/http/http_request_headers.h"
+#include "net/http/http_request_info.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kIterations = 100000;
+
+// Two realms per origin, leaving room for the proxy entry.
+const int kNumOrigins = (HttpAuthCache::kMaxNumRealmEntries - 1) / 2;
+
+GURL GetOrigin(int i) {
+  return GURL(base::StringPrintf("http://host%d.example.com", i));
+}
+
+void FillCache(HttpAuthCache* cache) {
+  for (int i = 0; i < kNumOrigins; ++i) {
+    GURL origin(GetOrigin(i));
+    cache->Add(origin, "Realm1", HttpAuth::AUTH_SCHEME_BASIC,
+               "Basic realm=\"Realm1\"", ASCIIToUTF16("user"),
+               ASCIIToUTF16("pass"), "/private/index.html");
+    cache->Add(origin, "Realm2", HttpAuth::AUTH_SCHEME_BASIC,
+               "Basic realm=\"Realm2\"", ASCIIToUTF16("user"),
+               ASCIIToUTF16("pass"), "/admin/index.html");
+  }
+}
+
+// Logs the time taken by |kIterations| requests to get their authorization
+// headers for |target| at |auth_url|.
+void TimeRequests(const char* name,
+                  HttpAuth::Target target,
+                  const GURL& auth_url,
+                  HttpAuthCache* cache,
+                  HttpAuthHandlerFactory* factory,
+                  bool expect_header) {
+  HttpRequestInfo request;
+  request.method = "GET";
+  request.url = GURL("http://host0.example.com/private/photos/1.jpg");
+  BoundNetLog net_log;
+  TestCompletionCallback callback;
+
+  PerfTimeLogger timer(name);
+  for (int i = 0; i < kIterations; ++i) {
+    scoped_refptr<HttpAuthController> controller(
+        new HttpAuthController(target, auth_url, cache, factory));
+    EXPECT_EQ(OK, controller->MaybeGenerateAuthToken(&request, &callback,
+                                                     net_log));
+    EXPECT_EQ(expect_header, controller->HaveAuth());
+    if (controller->HaveAuth()) {
+      HttpRequestHeaders headers;
+      controller->AddAuthorizationHeader(&headers);
+      EXPECT_TRUE(headers.HasHeader(HttpAuth::GetAuthorizationHeaderName(
+          target)));
+    }
+  }
+  timer.Done();
+}
+
+}  // namespace
+
+TEST(HttpAuthCachePerfTest, Lookup) {
+  HttpAuthCache cache;
+  FillCache(&cache);
+
+  GURL origin(GetOrigin(0));
+  GURL unknown_origin("http://unknown.example.com");
+
+  PerfTimeLogger lookup_timer("HttpAuthCache_lookup");
+  for (int i = 0; i < kIterations; ++i) {
+    EXPECT_TRUE(cache.Lookup(origin, "Realm2", HttpAuth::AUTH_SCHEME_BASIC));
+    EXPECT_FALSE(cache.Lookup(unknown_origin, "Realm2",
+                              HttpAuth::AUTH_SCHEME_BASIC));
+  }
+  lookup_timer.Done();
+
+  PerfTimeLogger path_timer("HttpAuthCache_lookup_by_path");
+  for (int i = 0; i < kIterations; ++i) {
+    EXPECT_TRUE(cache.LookupByPath(origin, "/admin/users/list.html"));
+    EXPECT_FALSE(cache.LookupByPath(unknown_origin, "/admin/users/list.html"));
+  }
+  path_timer.Done();
+}
+
+TEST(HttpAuthCachePerfTest, RequestOverhead) {
+  HttpAuthCache cache;
+  FillCache(&cache);
+
+  // A proxy that was authenticated with NTLM.
+  GURL proxy("http://proxy.example.com:8080");
+  cache.Add(proxy, "", HttpAuth::AUTH_SCHEME_NTLM, "NTLM",
+            ASCIIToUTF16("DOMAIN\\user"), ASCIIToUTF16("pass"), "/");
+
+  HttpAuthHandlerRegistryFactory factory;
+  factory.RegisterSchemeFactory("basic", new HttpAuthHandlerBasic::Factory());
+  factory.RegisterSchemeFactory("ntlm", new HttpAuthHandlerNTLM::Factory());
+
+  TimeRequests("HttpAuthController_preemptive_basic", HttpAuth::AUTH_SERVER,
+               GURL("http://host0.example.com/private/photos/1.jpg"), &cache,
+               &factory, true);
+  TimeRequests("HttpAuthController_connection_based_proxy",
+               HttpAuth::AUTH_PROXY, proxy, &cache, &factory, false);
+}
+
+}  // namespace net
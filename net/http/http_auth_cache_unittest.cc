@@ -368,6 +368,50 @@ TEST(HttpAuthCacheTest, Remove) {
   EXPECT_FALSE(NULL == entry);
 }
 
+// Test that entries of different origins, with the same realm and paths, are
+// kept apart.
+TEST(HttpAuthCacheTest, MultipleOrigins) {
+  GURL origin1("http://www.foobar.com");
+  GURL origin2("http://www.foobar.com:8080");
+  GURL origin3("https://www.foobar.com");
+
+  HttpAuthCache cache;
+  cache.Add(origin1, kRealm1, HttpAuth::AUTH_SCHEME_BASIC,
+            "basic realm=Realm1", kAlice, k123, "/foo/bar");
+  cache.Add(origin2, kRealm1, HttpAuth::AUTH_SCHEME_BASIC,
+            "basic realm=Realm1", kAdmin, kPassword, "/foo/bar");
+
+  HttpAuthCache::Entry* entry =
+      cache.Lookup(origin1, kRealm1, HttpAuth::AUTH_SCHEME_BASIC);
+  ASSERT_FALSE(NULL == entry);
+  EXPECT_EQ(kAlice, entry->username());
+  EXPECT_EQ(entry, cache.LookupByPath(origin1, "/foo/bar/baz"));
+
+  entry = cache.Lookup(origin2, kRealm1, HttpAuth::AUTH_SCHEME_BASIC);
+  ASSERT_FALSE(NULL == entry);
+  EXPECT_EQ(kAdmin, entry->username());
+  EXPECT_EQ(entry, cache.LookupByPath(origin2, "/foo/bar/baz"));
+
+  EXPECT_TRUE(NULL == cache.Lookup(origin3, kRealm1,
+                                   HttpAuth::AUTH_SCHEME_BASIC));
+  EXPECT_TRUE(NULL == cache.LookupByPath(origin3, "/foo/bar/baz"));
+
+  // Removing the entry of one origin leaves the other one alone.
+  EXPECT_TRUE(cache.Remove(
+      origin1, kRealm1, HttpAuth::AUTH_SCHEME_BASIC, kAlice, k123));
+  EXPECT_TRUE(NULL == cache.LookupByPath(origin1, "/foo/bar/baz"));
+  entry = cache.LookupByPath(origin2, "/foo/bar/baz");
+  ASSERT_FALSE(NULL == entry);
+  EXPECT_EQ(kAdmin, entry->username());
+
+  // The origin can be added again.
+  cache.Add(origin1, kRealm1, HttpAuth::AUTH_SCHEME_BASIC,
+            "basic realm=Realm1", kAlice2, k1234, "/");
+  entry = cache.LookupByPath(origin1, "/foo/bar/baz");
+  ASSERT_FALSE(NULL == entry);
+  EXPECT_EQ(kAlice2, entry->username());
+}
+
 TEST(HttpAuthCacheTest, UpdateStaleChallenge) {
   HttpAuthCache cache;
   GURL origin("http://foobar2.com");
@@ -491,6 +535,27 @@ TEST_F(HttpAuthCacheEvictionTest, RealmEntryEviction) {
     CheckRealmExistence(i + 3, true);
 }
 
+// Same as above, with each realm entry on its own origin.
+TEST_F(HttpAuthCacheEvictionTest, RealmEntryEvictionAcrossOrigins) {
+  for (int i = 0; i < kMaxRealms + 3; ++i) {
+    GURL origin(base::StringPrintf("http://www.google.com:%d", 1000 + i));
+    cache_.Add(origin, GenerateRealm(i), HttpAuth::AUTH_SCHEME_BASIC, "",
+               kUsername, kPassword, GeneratePath(i, 0));
+  }
+
+  for (int i = 0; i < kMaxRealms + 3; ++i) {
+    GURL origin(base::StringPrintf("http://www.google.com:%d", 1000 + i));
+    const HttpAuthCache::Entry* entry =
+        cache_.LookupByPath(origin, GeneratePath(i, 0));
+    if (i < 3) {
+      EXPECT_TRUE(entry == NULL);
+    } else {
+      ASSERT_FALSE(entry == NULL);
+      EXPECT_EQ(GenerateRealm(i), entry->realm());
+    }
+  }
+}
+
 // Add the maximum number of paths to a single realm entry. Each of these
 // paths should be retrievable. Next add 3 more paths -- since the cache is
 // full this causes FIFO eviction of the first three paths.
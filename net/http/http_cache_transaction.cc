@@ -114,6 +114,7 @@ HttpCache::Transaction::Transaction(HttpCache* cache)
       invalid_range_(false),
       truncated_(false),
       is_sparse_(false),
+      is_variant_(false),
       server_responded_206_(false),
       cache_pending_(false),
       read_offset_(0),
@@ -995,7 +996,7 @@ int HttpCache::Transaction::DoUpdateCachedResponse() {
   response_.response_time = new_response_->response_time;
   response_.request_time = new_response_->request_time;
 
-  if (response_.headers->HasHeaderValue("cache-control", "no-store")) {
+  if (response_.headers->cache_directives().no_store) {
     int ret = cache_->DoomEntry(cache_key_, NULL);
     DCHECK_EQ(OK, ret);
   } else {
@@ -1169,6 +1170,11 @@ int HttpCache::Transaction::DoCacheReadResponseComplete(int result) {
     return ERR_CACHE_READ_FAILURE;
   }
 
+  if (SwitchToVariantEntry()) {
+    next_state_ = STATE_INIT_ENTRY;
+    return OK;
+  }
+
   next_state_ = STATE_NOTIFY_BEFORE_SEND_HEADERS;
   return OK;
 }
@@ -1515,6 +1521,36 @@ int HttpCache::Transaction::BeginCacheValidation() {
   return OK;
 }
 
+// Each variant of a resource with a Vary header is stored in its own entry.
+// The first response received is stored under the regular key, and serves as
+// the index of the variants: requests that don't match it use the key of the
+// variant instead, made of the regular key and the hash of the request headers
+// named by the Vary header of that first response.
+bool HttpCache::Transaction::SwitchToVariantEntry() {
+  if (is_variant_ || mode_ != READ_WRITE || cache_->mode() != NORMAL ||
+      partial_.get() || truncated_ || !response_.vary_data.is_valid() ||
+      response_.headers->response_code() != 200) {
+    return false;
+  }
+
+  HttpVaryData request_vary_data;
+  if (!request_vary_data.Init(*request_, *response_.headers) ||
+      request_vary_data.Equals(response_.vary_data)) {
+    return false;
+  }
+
+  // Leave the entry as is, for the requests that match it.
+  cache_->DoneWritingToEntry(entry_, true);
+  entry_ = NULL;
+  response_ = HttpResponseInfo();
+
+  // A URL spec without a reference never holds a '#'.
+  cache_key_.append("#vary=");
+  cache_key_.append(request_vary_data.GetDigestString());
+  is_variant_ = true;
+  return true;
+}
+
 int HttpCache::Transaction::BeginPartialCacheValidation() {
   DCHECK(mode_ == READ_WRITE);
 
@@ -1887,7 +1923,7 @@ int HttpCache::Transaction::WriteResponseInfoToEntry(bool truncated) {
   // errors) and no SSL blocking page is shown.  An alternative would be to
   // reverse-map the cert status to a net error and replay the net error.
   if ((cache_->mode() != RECORD &&
-       response_.headers->HasHeaderValue("cache-control", "no-store")) ||
+       response_.headers->cache_directives().no_store) ||
       net::IsCertStatusError(response_.ssl_info.cert_status)) {
     DoneWritingToEntry(false);
     return OK;
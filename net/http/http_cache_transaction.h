@@ -236,6 +236,12 @@ class HttpCache::Transaction : public HttpTransaction {
   // Called to begin validating the cache entry.  Returns network error code.
   int BeginCacheValidation();
 
+  // Called when the cached response varies from the one this request asks
+  // for, to look up the entry that stores the matching variant instead.
+  // Returns true if the entry was released and the key changed, in which case
+  // the caller should restart from STATE_INIT_ENTRY.
+  bool SwitchToVariantEntry();
+
   // Called to begin validating an entry that stores partial content.  Returns
   // a network error code.
   int BeginPartialCacheValidation();
@@ -349,6 +355,7 @@ class HttpCache::Transaction : public HttpTransaction {
   bool invalid_range_;  // We may bypass the cache for this request.
   bool truncated_;  // We don't have all the response data.
   bool is_sparse_;  // The data is stored in sparse byte ranges.
+  bool is_variant_;  // The key is that of a variant of the resource.
   bool server_responded_206_;
   bool cache_pending_;  // We are waiting for the HttpCache.
   scoped_refptr<IOBuffer> read_buf_;
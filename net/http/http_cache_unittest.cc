@@ -25,6 +25,7 @@
 #include "net/http/http_transaction.h"
 #include "net/http/http_transaction_unittest.h"
 #include "net/http/http_util.h"
+#include "net/http/partial_data.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 using base::Time;
@@ -38,13 +39,16 @@ int GetTestModeForEntry(const std::string& key) {
   // TODO(darin): It breaks the abstraction a bit that we assume 'key' is an
   // URL corresponding to a registered MockTransaction.  It would be good to
   // have another way to access the test_mode.
+  // The key of a variant of a resource is followed by a reference, which is
+  // dropped as well.
+  std::string spec = key.substr(0, key.find('#'));
   GURL url;
-  if (isdigit(key[0])) {
-    size_t slash = key.find('/');
+  if (isdigit(spec[0])) {
+    size_t slash = spec.find('/');
     DCHECK(slash != std::string::npos);
-    url = GURL(key.substr(slash + 1));
+    url = GURL(spec.substr(slash + 1));
   } else {
-    url = GURL(key);
+    url = GURL(spec);
   }
   const MockTransaction* t = FindMockTransaction(url);
   DCHECK(t);
@@ -1032,6 +1036,22 @@ struct Context {
   scoped_ptr<net::HttpTransaction> trans;
 };
 
+// Sets, for its lifetime, the length under which a cached range between two
+// network requests is fetched again rather than read from the cache.
+class ScopedMinCachedRangeLen {
+ public:
+  explicit ScopedMinCachedRangeLen(int len)
+      : old_len_(net::PartialData::SetMinCachedRangeLenForTesting(len)) {}
+  ~ScopedMinCachedRangeLen() {
+    net::PartialData::SetMinCachedRangeLenForTesting(old_len_);
+  }
+
+ private:
+  int old_len_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedMinCachedRangeLen);
+};
+
 }  // namespace
 
 
@@ -2751,6 +2771,147 @@ TEST(HttpCache, UrlContainingHash) {
   EXPECT_EQ(1, cache.disk_cache()->create_count());
 }
 
+// Tests that the variants of a resource with a Vary header are stored in
+// their own entries, and that each is used for the requests it matches.
+TEST(HttpCache, Vary_StoresVariants) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kTypicalGET_Transaction);
+  transaction.request_headers = "Accept-Encoding: gzip\r\n";
+  transaction.response_headers = "Cache-Control: max-age=10000\n"
+                                 "Vary: Accept-Encoding\n";
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  // Another variant is fetched, and does not replace the first one.
+  MockTransaction transaction2(transaction);
+  transaction2.request_headers = "Accept-Encoding: identity\r\n";
+  RunTransactionTest(cache.http_cache(), transaction2);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+
+  // Both are read from the cache now.
+  RunTransactionTest(cache.http_cache(), transaction);
+  RunTransactionTest(cache.http_cache(), transaction2);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
+// Tests that a stale variant is validated in its own entry.
+TEST(HttpCache, Vary_ValidatesVariant) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kETagGET_Transaction);
+  transaction.request_headers = "Accept-Encoding: gzip\r\n";
+  transaction.response_headers = "Cache-Control: max-age=10000\n"
+                                 "Etag: foopy\n"
+                                 "Vary: Accept-Encoding\n";
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  MockTransaction transaction2(transaction);
+  transaction2.request_headers = "Accept-Encoding: identity\r\n";
+  RunTransactionTest(cache.http_cache(), transaction2);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+
+  // The variant is validated, and both entries are kept.
+  transaction.request_headers = "Accept-Encoding: identity\r\n";
+  transaction.load_flags = net::LOAD_VALIDATE_CACHE;
+  transaction.handler = ETagGet_ConditionalRequest_Handler;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  EXPECT_EQ(3, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+
+  transaction.request_headers = "Accept-Encoding: gzip\r\n";
+  transaction.load_flags = net::LOAD_NORMAL;
+  transaction.handler = NULL;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  EXPECT_EQ(3, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
+// Tests that requests that may only read from the cache keep using the first
+// response stored.
+TEST(HttpCache, Vary_LoadOnlyFromCache) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kTypicalGET_Transaction);
+  transaction.request_headers = "Accept-Encoding: gzip\r\n";
+  transaction.response_headers = "Cache-Control: max-age=10000\n"
+                                 "Vary: Accept-Encoding\n";
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  MockTransaction transaction2(transaction);
+  transaction2.request_headers = "Accept-Encoding: identity\r\n";
+  transaction2.load_flags = net::LOAD_ONLY_FROM_CACHE;
+  RunTransactionTest(cache.http_cache(), transaction2);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Replays requests for a few resources that vary by Accept-Encoding and
+// User-Agent, from clients that alternate between the variants.  Before the
+// variants had their own entries, each request replaced the variant stored
+// by the previous one, and none could be served from the cache.
+TEST(HttpCache, Vary_MixedTraffic) {
+  MockHttpCache cache;
+
+  const char* kEncodings[] = { "gzip", "identity", "gzip,deflate" };
+  const char* kUserAgents[] = { "Mozilla/5.0 (Linux)", "Mozilla/5.0 (X11)" };
+  const int kVariants = arraysize(kEncodings) * arraysize(kUserAgents);
+  const int kResources = 10;
+  const int kRounds = 20;
+
+  std::vector<std::string> urls;
+  std::vector<std::string> request_headers;
+  for (int i = 0; i < kResources; ++i)
+    urls.push_back(base::StringPrintf("http://www.google.com/vary%d", i));
+  for (size_t i = 0; i < arraysize(kEncodings); ++i) {
+    for (size_t j = 0; j < arraysize(kUserAgents); ++j) {
+      request_headers.push_back(base::StringPrintf(
+          "Accept-Encoding: %s\r\nUser-Agent: %s\r\n", kEncodings[i],
+          kUserAgents[j]));
+    }
+  }
+
+  std::vector<MockTransaction> transactions(kResources,
+                                            kTypicalGET_Transaction);
+  for (int i = 0; i < kResources; ++i) {
+    transactions[i].url = urls[i].c_str();
+    transactions[i].response_headers = "Cache-Control: max-age=10000\n"
+                                       "Vary: Accept-Encoding, User-Agent\n";
+    AddMockTransaction(&transactions[i]);
+  }
+
+  // Each round requests every resource, each time with another variant.
+  for (int round = 0; round < kRounds; ++round) {
+    for (int i = 0; i < kResources; ++i) {
+      MockTransaction transaction(transactions[i]);
+      transaction.request_headers =
+          request_headers[(round + i) % kVariants].c_str();
+      RunTransactionTest(cache.http_cache(), transaction);
+    }
+  }
+
+  // Only the first request for each variant reaches the network.
+  EXPECT_EQ(kResources * kVariants, cache.network_layer()->transaction_count());
+  EXPECT_EQ(kResources * kVariants, cache.disk_cache()->create_count());
+
+  for (int i = 0; i < kResources; ++i)
+    RemoveMockTransaction(&transactions[i]);
+}
+
 TEST(HttpCache, SimplePOST_LoadOnlyFromCache_Miss) {
   MockHttpCache cache;
 
@@ -2932,6 +3093,8 @@ TEST(HttpCache, RangeGET_NoStrongValidators) {
 // Tests that we can cache range requests and fetch random blocks from the
 // cache and the network.
 TEST(HttpCache, RangeGET_OK) {
+  // Read every cached range from the cache, however short.
+  ScopedMinCachedRangeLen min_cached_range_len(0);
   MockHttpCache cache;
   AddMockTransaction(&kRangeGET_TransactionOK);
   std::string headers;
@@ -2987,6 +3150,8 @@ TEST(HttpCache, RangeGET_OK) {
 // Tests that we can cache range requests and fetch random blocks from the
 // cache and the network, with synchronous responses.
 TEST(HttpCache, RangeGET_SyncOK) {
+  // Read every cached range from the cache, however short.
+  ScopedMinCachedRangeLen min_cached_range_len(0);
   MockHttpCache cache;
 
   MockTransaction transaction(kRangeGET_TransactionOK);
@@ -3039,6 +3204,55 @@ TEST(HttpCache, RangeGET_SyncOK) {
   RemoveMockTransaction(&transaction);
 }
 
+// Tests that a short cached range between two ranges missing from the cache
+// is fetched again with them, in a single network request, while a longer one
+// is still read from the cache.
+TEST(HttpCache, RangeGET_FoldShortCachedRange) {
+  MockHttpCache cache;
+  AddMockTransaction(&kRangeGET_TransactionOK);
+  std::string headers;
+
+  // Write to the cache (30-49).
+  MockTransaction transaction(kRangeGET_TransactionOK);
+  transaction.request_headers = "Range: bytes = 30-49\r\n" EXTRA_HEADER;
+  transaction.data = "rg: 30-39 rg: 40-49 ";
+  RunTransactionTestWithResponse(cache.http_cache(), transaction, &headers);
+
+  Verify206Response(headers, 30, 49);
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+
+  // Make sure we are done with the previous transaction.
+  MessageLoop::current()->RunAllPending();
+
+  // 30-49 is only read from the cache if 20 bytes are enough.
+  {
+    ScopedMinCachedRangeLen min_cached_range_len(20);
+    transaction.request_headers = "Range: bytes = 20-59\r\n" EXTRA_HEADER;
+    transaction.data = "rg: 20-29 rg: 30-39 rg: 40-49 rg: 50-59 ";
+    RunTransactionTestWithResponse(cache.http_cache(), transaction, &headers);
+
+    Verify206Response(headers, 20, 59);
+    EXPECT_EQ(3, cache.network_layer()->transaction_count());
+  }
+
+  // Make sure we are done with the previous transaction.
+  MessageLoop::current()->RunAllPending();
+
+  // 20-59 is now cached, but it is too short by default, so 10-69 takes a
+  // single request.
+  transaction.request_headers = "Range: bytes = 10-69\r\n" EXTRA_HEADER;
+  transaction.data = "rg: 10-19 rg: 20-29 rg: 30-39 rg: 40-49 rg: 50-59 "
+                     "rg: 60-69 ";
+  RunTransactionTestWithResponse(cache.http_cache(), transaction, &headers);
+
+  Verify206Response(headers, 10, 69);
+  EXPECT_EQ(4, cache.network_layer()->transaction_count());
+  EXPECT_EQ(2, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  RemoveMockTransaction(&kRangeGET_TransactionOK);
+}
+
 // Tests that we don't revalidate an entry unless we are required to do so.
 TEST(HttpCache, RangeGET_Revalidate1) {
   MockHttpCache cache;
@@ -3282,6 +3496,8 @@ TEST(HttpCache, UnknownRangeGET_304) {
 
 // Tests that we can handle non-range requests when we have cached a range.
 TEST(HttpCache, GET_Previous206) {
+  // Read every cached range from the cache, however short.
+  ScopedMinCachedRangeLen min_cached_range_len(0);
   MockHttpCache cache;
   AddMockTransaction(&kRangeGET_TransactionOK);
   std::string headers;
@@ -129,6 +129,16 @@ struct HttpResponseHeaders::ParsedHeader {
 
 //-----------------------------------------------------------------------------
 
+HttpResponseHeaders::CacheDirectives::CacheDirectives()
+    : no_cache(false),
+      no_store(false),
+      must_revalidate(false),
+      pragma_no_cache(false),
+      vary_star(false),
+      has_max_age(false),
+      max_age_seconds(0) {
+}
+
 HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
     : response_code_(-1) {
   Parse(raw_input);
@@ -325,6 +335,7 @@ void HttpResponseHeaders::ReplaceStatusLine(const std::string& new_status) {
 
 void HttpResponseHeaders::Parse(const std::string& raw_input) {
   raw_headers_.reserve(raw_input.size());
+  cache_directives_ = CacheDirectives();
 
   // ParseStatusLine adds a normalized status line to raw_headers_
   std::string::const_iterator line_begin = raw_input.begin();
@@ -360,6 +371,8 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
               headers.values_begin(),
               headers.values_end());
   }
+
+  ParseCacheDirectives();
 }
 
 // Append all of our headers to the final output string.
@@ -699,6 +712,66 @@ void HttpResponseHeaders::AddToParsed(std::string::const_iterator name_begin,
   parsed_.push_back(header);
 }
 
+void HttpResponseHeaders::ParseCacheDirectives() {
+  enum { OTHER, CACHE_CONTROL, PRAGMA, VARY } header = OTHER;
+
+  const char kMaxAgePrefix[] = "max-age=";
+  const size_t kMaxAgePrefixLen = arraysize(kMaxAgePrefix) - 1;
+
+  // Each value of a header is a separate entry of parsed_, so a single pass
+  // looks at every directive.
+  for (size_t i = 0; i < parsed_.size(); ++i) {
+    const ParsedHeader& parsed = parsed_[i];
+    if (!parsed.is_continuation()) {
+      if (LowerCaseEqualsASCII(parsed.name_begin, parsed.name_end,
+                               "cache-control"))
+        header = CACHE_CONTROL;
+      else if (LowerCaseEqualsASCII(parsed.name_begin, parsed.name_end,
+                                    "pragma"))
+        header = PRAGMA;
+      else if (LowerCaseEqualsASCII(parsed.name_begin, parsed.name_end,
+                                    "vary"))
+        header = VARY;
+      else
+        header = OTHER;
+    }
+
+    const std::string::const_iterator& value_begin = parsed.value_begin;
+    const std::string::const_iterator& value_end = parsed.value_end;
+    switch (header) {
+      case CACHE_CONTROL:
+        if (LowerCaseEqualsASCII(value_begin, value_end, "no-cache")) {
+          cache_directives_.no_cache = true;
+        } else if (LowerCaseEqualsASCII(value_begin, value_end, "no-store")) {
+          cache_directives_.no_store = true;
+        } else if (LowerCaseEqualsASCII(value_begin, value_end,
+                                        "must-revalidate")) {
+          cache_directives_.must_revalidate = true;
+        } else if (!cache_directives_.has_max_age &&
+                   static_cast<size_t>(value_end - value_begin) >
+                       kMaxAgePrefixLen &&
+                   LowerCaseEqualsASCII(value_begin,
+                                        value_begin + kMaxAgePrefixLen,
+                                        kMaxAgePrefix)) {
+          cache_directives_.has_max_age = true;
+          base::StringToInt64(value_begin + kMaxAgePrefixLen, value_end,
+                              &cache_directives_.max_age_seconds);
+        }
+        break;
+      case PRAGMA:
+        if (LowerCaseEqualsASCII(value_begin, value_end, "no-cache"))
+          cache_directives_.pragma_no_cache = true;
+        break;
+      case VARY:
+        if (value_end - value_begin == 1 && *value_begin == '*')
+          cache_directives_.vary_star = true;
+        break;
+      case OTHER:
+        break;
+    }
+  }
+}
+
 void HttpResponseHeaders::AddNonCacheableHeaders(HeaderSet* result) const {
   // Add server specified transients.  Any 'cache-control: no-cache="foo,bar"'
   // headers present in the response specify additional headers that we should
@@ -872,10 +945,10 @@ TimeDelta HttpResponseHeaders::GetFreshnessLifetime(
   // Check for headers that force a response to never be fresh.  For backwards
   // compat, we treat "Pragma: no-cache" as a synonym for "Cache-Control:
   // no-cache" even though RFC 2616 does not specify it.
-  if (HasHeaderValue("cache-control", "no-cache") ||
-      HasHeaderValue("cache-control", "no-store") ||
-      HasHeaderValue("pragma", "no-cache") ||
-      HasHeaderValue("vary", "*"))  // see RFC 2616 section 13.6
+  if (cache_directives_.no_cache ||
+      cache_directives_.no_store ||
+      cache_directives_.pragma_no_cache ||
+      cache_directives_.vary_star)  // see RFC 2616 section 13.6
     return TimeDelta();  // not fresh
 
   // NOTE: "Cache-Control: max-age" overrides Expires, so we only check the
@@ -925,7 +998,7 @@ TimeDelta HttpResponseHeaders::GetFreshnessLifetime(
   //
   if ((response_code_ == 200 || response_code_ == 203 ||
        response_code_ == 206) &&
-      !HasHeaderValue("cache-control", "must-revalidate")) {
+      !cache_directives_.must_revalidate) {
     // TODO(darin): Implement a smarter heuristic.
     Time last_modified_value;
     if (GetLastModifiedValue(&last_modified_value)) {
@@ -993,29 +1066,11 @@ TimeDelta HttpResponseHeaders::GetCurrentAge(const Time& request_time,
 }
 
 bool HttpResponseHeaders::GetMaxAgeValue(TimeDelta* result) const {
-  std::string name = "cache-control";
-  std::string value;
-
-  const char kMaxAgePrefix[] = "max-age=";
-  const size_t kMaxAgePrefixLen = arraysize(kMaxAgePrefix) - 1;
-
-  void* iter = NULL;
-  while (EnumerateHeader(&iter, name, &value)) {
-    if (value.size() > kMaxAgePrefixLen) {
-      if (LowerCaseEqualsASCII(value.begin(),
-                               value.begin() + kMaxAgePrefixLen,
-                               kMaxAgePrefix)) {
-        int64 seconds;
-        base::StringToInt64(value.begin() + kMaxAgePrefixLen,
-                            value.end(),
-                            &seconds);
-        *result = TimeDelta::FromSeconds(seconds);
-        return true;
-      }
-    }
-  }
+  if (!cache_directives_.has_max_age)
+    return false;
 
-  return false;
+  *result = TimeDelta::FromSeconds(cache_directives_.max_age_seconds);
+  return true;
 }
 
 bool HttpResponseHeaders::GetAgeValue(TimeDelta* result) const {
@@ -246,6 +246,28 @@ class NET_EXPORT HttpResponseHeaders
   // Returns the raw header string.
   const std::string& raw_headers() const { return raw_headers_; }
 
+  // The Cache-Control, Pragma and Vary directives that the cache freshness
+  // logic looks at.  They are parsed once with the headers, rather than on
+  // each query.  Directive values are compared case insensitively, and must
+  // match exactly: 'no-cache="foo"' is not 'no-cache'.
+  struct CacheDirectives {
+    CacheDirectives();
+
+    bool no_cache;         // Cache-Control: no-cache
+    bool no_store;         // Cache-Control: no-store
+    bool must_revalidate;  // Cache-Control: must-revalidate
+    bool pragma_no_cache;  // Pragma: no-cache
+    bool vary_star;        // Vary: *
+
+    // The first Cache-Control: max-age value, if any.
+    bool has_max_age;
+    int64 max_age_seconds;
+  };
+
+  const CacheDirectives& cache_directives() const {
+    return cache_directives_;
+  }
+
  private:
   friend class base::RefCountedThreadSafe<HttpResponseHeaders>;
 
@@ -296,6 +318,9 @@ class NET_EXPORT HttpResponseHeaders
                    std::string::const_iterator value_begin,
                    std::string::const_iterator value_end);
 
+  // Fills cache_directives_ from parsed_.
+  void ParseCacheDirectives();
+
   // Replaces the current headers with the merged version of |raw_headers| and
   // the current headers without the headers in |headers_to_remove|. Note that
   // |headers_to_remove| are removed from the current headers (before the
@@ -342,6 +367,8 @@ class NET_EXPORT HttpResponseHeaders
   // The parsed http version number (not normalized).
   HttpVersion parsed_http_version_;
 
+  CacheDirectives cache_directives_;
+
   DISALLOW_COPY_AND_ASSIGN(HttpResponseHeaders);
 };
 
@@ -1659,3 +1659,103 @@ TEST(HttpResponseHeadersTest, ReplaceStatus) {
     EXPECT_EQ(std::string(tests[i].expected_headers), resulting_headers);
   }
 }
+
+TEST(HttpResponseHeadersTest, CacheDirectives) {
+  const char* tests[] = {
+    "HTTP/1.1 200 OK\n",
+    "HTTP/1.1 200 OK\n"
+    "Cache-Control: private, no-cache=\"foo\", max-age=3600\n",
+    "HTTP/1.1 200 OK\n"
+    "cache-control: NO-CACHE\n"
+    "Pragma: no-cache\n",
+    "HTTP/1.1 200 OK\n"
+    "Content-Type: text/html\n"
+    "Cache-Control: private,no-store ,  must-revalidate\n"
+    "Vary: *\n",
+    "HTTP/1.1 200 OK\n"
+    "Cache-Control: max-age=\n"
+    "Cache-Control: MAX-AGE=10, max-age=20\n"
+    "Vary: Accept, *x\n",
+    "HTTP/1.1 200 OK\n"
+    "Pragma: no-cache=\"set-cookie\"\n"
+    "X-Cache-Control: no-store\n"
+    "Cache-Control: max-age=-5\n",
+  };
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(tests); ++i) {
+    std::string headers(tests[i]);
+    HeadersToRaw(&headers);
+    scoped_refptr<net::HttpResponseHeaders> parsed(
+        new net::HttpResponseHeaders(headers));
+
+    // The directives parsed with the headers agree with looking them up.
+    const net::HttpResponseHeaders::CacheDirectives& directives =
+        parsed->cache_directives();
+    EXPECT_EQ(parsed->HasHeaderValue("cache-control", "no-cache"),
+              directives.no_cache) << "Failed test case " << i;
+    EXPECT_EQ(parsed->HasHeaderValue("cache-control", "no-store"),
+              directives.no_store) << "Failed test case " << i;
+    EXPECT_EQ(parsed->HasHeaderValue("cache-control", "must-revalidate"),
+              directives.must_revalidate) << "Failed test case " << i;
+    EXPECT_EQ(parsed->HasHeaderValue("pragma", "no-cache"),
+              directives.pragma_no_cache) << "Failed test case " << i;
+    EXPECT_EQ(parsed->HasHeaderValue("vary", "*"),
+              directives.vary_star) << "Failed test case " << i;
+  }
+}
+
+TEST(HttpResponseHeadersTest, CacheDirectivesMaxAge) {
+  const struct {
+    const char* headers;
+    bool expected_has_max_age;
+    int64 expected_max_age_seconds;
+  } tests[] = {
+    { "HTTP/1.1 200 OK\n",
+      false, 0
+    },
+    { "HTTP/1.1 200 OK\n"
+      "Cache-Control: private, max-age=3600\n",
+      true, 3600
+    },
+    // "max-age=" alone is skipped, and the first value is used.
+    { "HTTP/1.1 200 OK\n"
+      "Cache-Control: max-age=\n"
+      "Cache-Control: MAX-AGE=10, max-age=20\n",
+      true, 10
+    },
+  };
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(tests); ++i) {
+    std::string headers(tests[i].headers);
+    HeadersToRaw(&headers);
+    scoped_refptr<net::HttpResponseHeaders> parsed(
+        new net::HttpResponseHeaders(headers));
+
+    const net::HttpResponseHeaders::CacheDirectives& directives =
+        parsed->cache_directives();
+    EXPECT_EQ(tests[i].expected_has_max_age, directives.has_max_age) <<
+        "Failed test case " << i;
+    base::TimeDelta max_age;
+    EXPECT_EQ(tests[i].expected_has_max_age, parsed->GetMaxAgeValue(&max_age))
+        << "Failed test case " << i;
+    if (tests[i].expected_has_max_age) {
+      EXPECT_EQ(tests[i].expected_max_age_seconds, max_age.InSeconds()) <<
+          "Failed test case " << i;
+    }
+  }
+}
+
+TEST(HttpResponseHeadersTest, CacheDirectivesFollowChanges) {
+  std::string headers("HTTP/1.1 200 OK\n"
+                      "Cache-Control: max-age=60\n");
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed(
+      new net::HttpResponseHeaders(headers));
+  EXPECT_FALSE(parsed->cache_directives().no_store);
+
+  parsed->AddHeader("Cache-Control: no-store");
+  EXPECT_TRUE(parsed->cache_directives().no_store);
+  EXPECT_TRUE(parsed->cache_directives().has_max_age);
+
+  parsed->RemoveHeader("cache-control");
+  EXPECT_FALSE(parsed->cache_directives().no_store);
+  EXPECT_FALSE(parsed->cache_directives().has_max_age);
+}
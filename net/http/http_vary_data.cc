@@ -1,4 +1,4 @@
-// Copyright (c) 2006-2008 The Chromium Authors. All rights reserved.
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 
 #include "base/pickle.h"
+#include "base/string_number_conversions.h"
 #include "base/string_util.h"
 #include "net/http/http_request_headers.h"
 #include "net/http/http_request_info.h"
@@ -15,18 +16,31 @@
 
 namespace net {
 
+namespace {
+
+// The two halves of the digest are FNV-1a hashes with distinct offset bases
+// and multipliers, so that a collision in one is unlikely to be one in the
+// other.
+const uint64 kOffsetBasisA = GG_UINT64_C(0xcbf29ce484222325);
+const uint64 kOffsetBasisB = GG_UINT64_C(0x84222325cbf29ce4);
+const uint64 kPrimeA = GG_UINT64_C(0x100000001b3);
+const uint64 kPrimeB = GG_UINT64_C(0xc6a4a7935bd1e995);
+
+}  // namespace
+
 HttpVaryData::HttpVaryData() : is_valid_(false) {
 }
 
 bool HttpVaryData::Init(const HttpRequestInfo& request_info,
                         const HttpResponseHeaders& response_headers) {
-  MD5Context ctx;
-  MD5Init(&ctx);
+  Digest digest;
+  digest.a = kOffsetBasisA;
+  digest.b = kOffsetBasisB;
 
   is_valid_ = false;
   bool processed_header = false;
 
-  // Feed the MD5 context in the order of the Vary header enumeration.  If the
+  // Feed the hash in the order of the Vary header enumeration.  If the
   // Vary header repeats a header name, then that's OK.
   //
   // If the Vary header contains '*' then we should not construct any vary data
@@ -37,7 +51,7 @@ bool HttpVaryData::Init(const HttpRequestInfo& request_info,
   while (response_headers.EnumerateHeader(&iter, name, &request_header)) {
     if (request_header == "*")
       return false;
-    AddField(request_info, request_header, &ctx);
+    AddField(request_info, request_header, &digest);
     processed_header = true;
   }
 
@@ -53,14 +67,14 @@ bool HttpVaryData::Init(const HttpRequestInfo& request_info,
   //
   std::string location;
   if (response_headers.IsRedirect(&location)) {
-    AddField(request_info, "cookie", &ctx);
+    AddField(request_info, "cookie", &digest);
     processed_header = true;
   }
 
   if (!processed_header)
     return false;
 
-  MD5Final(&request_digest_, &ctx);
+  request_digest_ = digest;
   return is_valid_ = true;
 }
 
@@ -89,8 +103,18 @@ bool HttpVaryData::MatchesRequest(
     NOTREACHED();
     return false;
   }
-  return memcmp(&new_vary_data.request_digest_, &request_digest_,
-                sizeof(request_digest_)) == 0;
+  return Equals(new_vary_data);
+}
+
+bool HttpVaryData::Equals(const HttpVaryData& other) const {
+  return is_valid_ && other.is_valid_ &&
+      request_digest_.a == other.request_digest_.a &&
+      request_digest_.b == other.request_digest_.b;
+}
+
+std::string HttpVaryData::GetDigestString() const {
+  DCHECK(is_valid());
+  return base::HexEncode(&request_digest_, sizeof(request_digest_));
 }
 
 // static
@@ -115,7 +139,7 @@ std::string HttpVaryData::GetRequestValue(
 // static
 void HttpVaryData::AddField(const HttpRequestInfo& request_info,
                             const std::string& request_header,
-                            MD5Context* ctx) {
+                            Digest* digest) {
   std::string request_value = GetRequestValue(request_info, request_header);
 
   // Append a character that cannot appear in the request header line so that we
@@ -124,7 +148,11 @@ void HttpVaryData::AddField(const HttpRequestInfo& request_info,
   // For example, "foo: 12\nbar: 3" looks like "foo: 1\nbar: 23" otherwise.
   request_value.append(1, '\n');
 
-  MD5Update(ctx, request_value.data(), request_value.size());
+  for (size_t i = 0; i < request_value.size(); ++i) {
+    const uint8 c = static_cast<uint8>(request_value[i]);
+    digest->a = (digest->a ^ c) * kPrimeA;
+    digest->b = (digest->b ^ c) * kPrimeB;
+  }
 }
 
 }  // namespace net
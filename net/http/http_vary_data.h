@@ -1,4 +1,4 @@
-// Copyright (c) 2006-2008 The Chromium Authors. All rights reserved.
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
@@ -6,7 +6,9 @@
 #define NET_HTTP_HTTP_VARY_DATA_H__
 #pragma once
 
-#include "base/md5.h"
+#include <string>
+
+#include "base/basictypes.h"
 
 class Pickle;
 
@@ -15,13 +17,15 @@ namespace net {
 struct HttpRequestInfo;
 class HttpResponseHeaders;
 
-// Used to implement the HTTP/1.1 Vary header.  This class contains a MD5 hash
-// over the request headers indicated by a Vary header.
+// Used to implement the HTTP/1.1 Vary header.  This class contains a hash over
+// the request headers indicated by a Vary header.
 //
 // While RFC 2616 requires strict request header comparisons, it is much
-// cheaper to store a MD5 sum, which should be sufficient.  Storing a hash also
+// cheaper to store a hash, which should be sufficient.  Storing a hash also
 // avoids messy privacy issues as some of the request headers could hold
-// sensitive data (e.g., cookies).
+// sensitive data (e.g., cookies).  The hash is computed on every cache lookup
+// of a response with a Vary header, so it is a 128-bit FNV-1a variant rather
+// than a cryptographic hash.
 //
 // NOTE: This class does not hold onto the contents of the Vary header.
 // Instead, it relies on the consumer to store that and to supply it again to
@@ -63,18 +67,32 @@ class HttpVaryData {
   bool MatchesRequest(const HttpRequestInfo& request_info,
                       const HttpResponseHeaders& cached_response_headers) const;
 
+  // Returns true if both objects are valid and were generated from the same
+  // request header values.
+  bool Equals(const HttpVaryData& other) const;
+
+  // Returns the hash as a string of 32 hexadecimal digits, to tell apart the
+  // variants of a resource.  Illegal to call this on an invalid object.
+  std::string GetDigestString() const;
+
  private:
+  // Persisted as is, so it must keep its size.
+  struct Digest {
+    uint64 a;
+    uint64 b;
+  };
+
   // Returns the corresponding request header value.
   static std::string GetRequestValue(const HttpRequestInfo& request_info,
                                      const std::string& request_header);
 
-  // Append to the MD5 context for the given request header.
+  // Adds the given request header to the hash in |digest|.
   static void AddField(const HttpRequestInfo& request_info,
                        const std::string& request_header,
-                       MD5Context* context);
+                       Digest* digest);
 
   // A digested version of the request headers corresponding to the Vary header.
-  MD5Digest request_digest_;
+  Digest request_digest_;
 
   // True when request_digest_ contains meaningful data.
   bool is_valid_;
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 
+#include "base/pickle.h"
 #include "net/http/http_request_info.h"
 #include "net/http/http_response_headers.h"
 #include "net/http/http_vary_data.h"
@@ -145,3 +146,40 @@ TEST(HttpVaryDataTest, ImplicitCookieForRedirect2) {
 
   EXPECT_FALSE(v.MatchesRequest(b.request, *b.response));
 }
+
+TEST(HttpVaryDataTest, DigestString) {
+  TestTransaction a;
+  a.Init("Accept-Encoding: gzip", "HTTP/1.1 200 OK\nVary: accept-encoding\n\n");
+
+  TestTransaction b;
+  b.Init("Accept-Encoding: identity",
+         "HTTP/1.1 200 OK\nVary: accept-encoding\n\n");
+
+  net::HttpVaryData v1, v2, v3;
+  EXPECT_FALSE(v1.Equals(v2));
+  EXPECT_TRUE(v1.Init(a.request, *a.response));
+  EXPECT_TRUE(v2.Init(a.request, *a.response));
+  EXPECT_TRUE(v3.Init(b.request, *b.response));
+
+  EXPECT_TRUE(v1.Equals(v2));
+  EXPECT_FALSE(v1.Equals(v3));
+  EXPECT_EQ(32U, v1.GetDigestString().size());
+  EXPECT_EQ(v1.GetDigestString(), v2.GetDigestString());
+  EXPECT_NE(v1.GetDigestString(), v3.GetDigestString());
+}
+
+TEST(HttpVaryDataTest, Persist) {
+  TestTransaction a;
+  a.Init("Foo: 1\r\nbar: 23", "HTTP/1.1 200 OK\nVary: foo, bar\n\n");
+
+  net::HttpVaryData v1;
+  EXPECT_TRUE(v1.Init(a.request, *a.response));
+  Pickle pickle;
+  v1.Persist(&pickle);
+
+  net::HttpVaryData v2;
+  void* iter = NULL;
+  EXPECT_TRUE(v2.InitFromPickle(pickle, &iter));
+  EXPECT_TRUE(v1.Equals(v2));
+  EXPECT_TRUE(v2.MatchesRequest(a.request, *a.response));
+}
@@ -23,6 +23,18 @@ const char kLengthHeader[] = "Content-Length";
 const char kRangeHeader[] = "Content-Range";
 const int kDataStream = 1;
 
+// A range stored in the cache that is shorter than this, and that comes after
+// a range that has to be fetched from the network, is fetched again along with
+// it: that costs less than serving it from the cache between two network
+// requests.
+const int kMinCachedRangeLen = 32 * 1024;
+
+// The most ranges skipped that way for a single network request.
+const int kMaxSkippedRanges = 8;
+
+// The value of kMinCachedRangeLen in use, which tests can change.
+int g_min_cached_range_len = kMinCachedRangeLen;
+
 void AddRangeHeader(int64 start, int64 end, HttpRequestHeaders* headers) {
   DCHECK(start >= 0 || end >= 0);
   std::string my_start, my_end;
@@ -99,8 +111,13 @@ int PartialData::Core::GetAvailableRange(disk_cache::Entry* entry, int64 offset,
 }
 
 void PartialData::Core::OnIOComplete(int result) {
-  if (owner_)
-    owner_->GetAvailableRangeCompleted(result, start_);
+  if (owner_) {
+    // Detach first, so that the owner can start another operation.
+    PartialData* owner = owner_;
+    Cancel();
+    owner->core_ = NULL;
+    owner->GetAvailableRangeCompleted(result, start_);
+  }
   delete this;
 }
 
@@ -113,7 +130,9 @@ PartialData::PartialData()
       truncated_(false),
       initial_validation_(false),
       core_(NULL),
-      callback_(NULL) {
+      callback_(NULL),
+      entry_(NULL),
+      skipped_ranges_(0) {
 }
 
 PartialData::~PartialData() {
@@ -171,9 +190,9 @@ int PartialData::ShouldValidateCache(disk_cache::Entry* entry,
 
   if (sparse_entry_) {
     DCHECK(!callback_);
-    Core* core = Core::CreateCore(this);
-    cached_min_len_ = core->GetAvailableRange(entry, current_range_start_, len,
-                                              &cached_start_);
+    entry_ = entry;
+    skipped_ranges_ = 0;
+    cached_min_len_ = FindCachedRange(current_range_start_);
 
     if (cached_min_len_ == ERR_IO_PENDING) {
       callback_ = callback;
@@ -472,11 +491,49 @@ int PartialData::GetNextRangeLen() {
   return static_cast<int32>(range_len);
 }
 
+// static
+int PartialData::SetMinCachedRangeLenForTesting(int len) {
+  int old_len = g_min_cached_range_len;
+  g_min_cached_range_len = len;
+  return old_len;
+}
+
+int PartialData::FindCachedRange(int64 offset) {
+  while (true) {
+    int len = GetNextRangeLen() -
+              static_cast<int>(offset - current_range_start_);
+    Core* core = Core::CreateCore(this);
+    int rv = core->GetAvailableRange(entry_, offset, len, &cached_start_);
+    if (rv < 0 || !ShouldSkipCachedRange(rv))
+      return rv;
+    offset = cached_start_ + rv;
+  }
+}
+
+bool PartialData::ShouldSkipCachedRange(int cached_len) {
+  // Only a range that is not the last one, and that comes after one that is
+  // missing from the cache, would cost an extra network request.
+  if (!cached_len || cached_len >= g_min_cached_range_len ||
+      cached_start_ == current_range_start_ ||
+      cached_start_ + cached_len >= current_range_start_ + GetNextRangeLen() ||
+      skipped_ranges_ >= kMaxSkippedRanges) {
+    return false;
+  }
+  skipped_ranges_++;
+  return true;
+}
+
 void PartialData::GetAvailableRangeCompleted(int result, int64 start) {
   DCHECK(callback_);
   DCHECK_NE(ERR_IO_PENDING, result);
 
   cached_start_ = start;
+  if (result > 0 && ShouldSkipCachedRange(result)) {
+    result = FindCachedRange(start + result);
+    if (result == ERR_IO_PENDING)
+      return;
+  }
+
   cached_min_len_ = result;
   if (result >= 0)
     result = 1;  // Return success, go ahead and validate the entry.
@@ -115,11 +115,27 @@ class PartialData {
 
   bool initial_validation() const { return initial_validation_; }
 
+  // Sets the length under which a cached range that comes after one missing
+  // from the cache is fetched again from the network, rather than read from
+  // the cache. Zero never fetches cached data again. Returns the previous
+  // length.
+  static int SetMinCachedRangeLenForTesting(int len);
+
  private:
   class Core;
   // Returns the length to use when scanning the cache.
   int GetNextRangeLen();
 
+  // Looks for the next range to read from the cache, starting at |offset|, and
+  // stores its start in |cached_start_|. Returns its length, a net error code,
+  // or ERR_IO_PENDING, in which case GetAvailableRangeCompleted() finishes the
+  // lookup.
+  int FindCachedRange(int64 offset);
+
+  // Returns true if the range of |cached_len| bytes at |cached_start_| should
+  // be fetched from the network with the data that comes before it.
+  bool ShouldSkipCachedRange(int cached_len);
+
   // Completion routine for our callback.
   void GetAvailableRangeCompleted(int result, int64 start);
 
@@ -137,6 +153,8 @@ class PartialData {
   bool initial_validation_;  // Only used for truncated entries.
   Core* core_;
   CompletionCallback* callback_;
+  disk_cache::Entry* entry_;  // The entry being scanned by FindCachedRange().
+  int skipped_ranges_;
 
   DISALLOW_COPY_AND_ASSIGN(PartialData);
 };
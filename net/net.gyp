@@ -1111,6 +1111,8 @@
       'sources': [
         'base/cookie_monster_perftest.cc',
         'disk_cache/disk_cache_perftest.cc',
+        'http/http_auth_cache_perftest.cc',
+        'http/http_response_headers_perftest.cc',
         'proxy/proxy_resolver_perftest.cc',
       ],
       'conditions': [